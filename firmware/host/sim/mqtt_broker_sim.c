@@ -0,0 +1,325 @@
+/*
+    \file   mqtt_broker_sim.c
+
+    \brief  Loopback MQTT broker for the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include "mqtt_broker_sim.h"
+
+#define SIM_BROKER_STREAM_SIZE 4096
+
+sim_broker_config_t simBrokerConfig;
+
+static sim_broker_stats_t   simBrokerStats;
+static sim_broker_publish_t simBrokerLog[SIM_BROKER_PUBLISH_LOG];
+static uint16_t             simBrokerLogCount;
+static SOCKET               simBrokerSocket = -1;
+static uint8_t              simBrokerStream[SIM_BROKER_STREAM_SIZE];
+static uint16_t             simBrokerStreamLength;
+
+static uint16_t simBrokerEncodeLength(uint32_t length, uint8_t* output)
+{
+    uint16_t i = 0;
+
+    do
+    {
+        output[i] = length % 128;
+        length /= 128;
+        if (length > 0)
+        {
+            output[i] |= 0x80;
+        }
+        i++;
+    } while (length > 0);
+
+    return i;
+}
+
+static void simBrokerReply(const uint8_t* data, uint16_t length)
+{
+    SIM_WINC_Inject(simBrokerSocket, data, length);
+}
+
+static void simBrokerConnect(const uint8_t* body, uint32_t length)
+{
+    uint8_t connack[4] = {0x20, 0x02, 0x00, 0x00};
+
+    simBrokerStats.connects++;
+    // Protocol name (6), level (1), connect flags (1), keep alive (2)
+    if (length < 10)
+    {
+        simBrokerStats.malformed++;
+        return;
+    }
+    simBrokerStats.lastCleanSession = (body[7] & 0x02) != 0;
+
+    if (simBrokerConfig.answerConnect)
+    {
+        connack[2] = simBrokerConfig.sessionPresent ? 0x01 : 0x00;
+        connack[3] = simBrokerConfig.connackCode;
+        simBrokerReply(connack, sizeof(connack));
+    }
+}
+
+static void simBrokerPublish(uint8_t flags, const uint8_t* body, uint32_t length)
+{
+    sim_broker_publish_t* entry;
+    uint16_t              topicLength;
+    uint32_t              offset;
+    uint8_t               qos = (flags >> 1) & 0x03;
+
+    simBrokerStats.publishes++;
+    if (length < 2)
+    {
+        simBrokerStats.malformed++;
+        return;
+    }
+    topicLength = (uint16_t)(body[0] << 8) | body[1];
+    offset      = 2 + topicLength + ((qos > 0) ? 2 : 0);
+    if (offset > length || topicLength >= SIM_BROKER_TOPIC_MAX || length - offset > SIM_BROKER_PAYLOAD_MAX)
+    {
+        simBrokerStats.malformed++;
+        return;
+    }
+
+    if (simBrokerLogCount < SIM_BROKER_PUBLISH_LOG)
+    {
+        entry = &simBrokerLog[simBrokerLogCount++];
+        memset(entry, 0, sizeof(*entry));
+        memcpy(entry->topic, &body[2], topicLength);
+        entry->qos           = qos;
+        entry->dup           = (flags & 0x08) != 0;
+        entry->packetId      = (qos > 0) ? (uint16_t)((body[2 + topicLength] << 8) | body[3 + topicLength]) : 0;
+        entry->payloadLength = (uint16_t)(length - offset);
+        memcpy(entry->payload, &body[offset], entry->payloadLength);
+    }
+
+    if (qos == 1 && simBrokerConfig.autoPuback)
+    {
+        SIM_BROKER_SendPuback((uint16_t)((body[2 + topicLength] << 8) | body[3 + topicLength]));
+    }
+}
+
+static void simBrokerSubscribe(const uint8_t* body, uint32_t length)
+{
+    uint8_t  suback[4 + SIM_BROKER_SUBACK_CODES];
+    uint8_t  count = 0;
+    uint32_t offset;
+    uint16_t topicLength;
+
+    simBrokerStats.subscribes++;
+    if (length < 2)
+    {
+        simBrokerStats.malformed++;
+        return;
+    }
+
+    for (offset = 2; offset + 2 < length && count < SIM_BROKER_SUBACK_CODES; count++)
+    {
+        topicLength = (uint16_t)(body[offset] << 8) | body[offset + 1];
+        offset += 2 + topicLength;
+        if (offset >= length)
+        {
+            simBrokerStats.malformed++;
+            return;
+        }
+        suback[4 + count] = body[offset++];
+    }
+
+    if (simBrokerConfig.subackCodeCount > 0)
+    {
+        count = simBrokerConfig.subackCodeCount;
+        memcpy(&suback[4], simBrokerConfig.subackCodes, count);
+    }
+
+    suback[0] = 0x90;
+    suback[1] = 2 + count;
+    suback[2] = body[0];
+    suback[3] = body[1];
+    simBrokerReply(suback, 4 + count);
+}
+
+static void simBrokerUnsubscribe(const uint8_t* body, uint32_t length)
+{
+    uint8_t unsuback[4] = {0xB0, 0x02, 0x00, 0x00};
+
+    simBrokerStats.unsubscribes++;
+    if (length < 2)
+    {
+        simBrokerStats.malformed++;
+        return;
+    }
+    unsuback[2] = body[0];
+    unsuback[3] = body[1];
+    simBrokerReply(unsuback, sizeof(unsuback));
+}
+
+static void simBrokerPacket(const uint8_t* packet, uint8_t headerLength, uint32_t length)
+{
+    static const uint8_t pingresp[2] = {0xD0, 0x00};
+    const uint8_t*       body        = &packet[headerLength];
+
+    switch (packet[0] >> 4)
+    {
+        case 1:
+            simBrokerConnect(body, length);
+            break;
+        case 3:
+            simBrokerPublish(packet[0] & 0x0F, body, length);
+            break;
+        case 8:
+            simBrokerSubscribe(body, length);
+            break;
+        case 10:
+            simBrokerUnsubscribe(body, length);
+            break;
+        case 12:
+            simBrokerStats.pingreqs++;
+            simBrokerReply(pingresp, sizeof(pingresp));
+            break;
+        case 14:
+            simBrokerStats.disconnects++;
+            break;
+        default:
+            simBrokerStats.malformed++;
+            break;
+    }
+}
+
+static void simBrokerReceive(SOCKET sock, const uint8_t* data, uint16_t length)
+{
+    uint32_t remainingLength;
+    uint32_t multiplier;
+    uint16_t consumed = 0;
+    uint8_t  i;
+
+    if (sock != simBrokerSocket)
+    {
+        // A new connection
+        simBrokerSocket       = sock;
+        simBrokerStreamLength = 0;
+    }
+
+    if (simBrokerStreamLength + length > SIM_BROKER_STREAM_SIZE)
+    {
+        simBrokerStats.malformed++;
+        simBrokerStreamLength = 0;
+        return;
+    }
+    memcpy(&simBrokerStream[simBrokerStreamLength], data, length);
+    simBrokerStreamLength += length;
+
+    while (simBrokerStreamLength - consumed >= 2)
+    {
+        remainingLength = 0;
+        multiplier      = 1;
+        for (i = 1; i <= 4 && consumed + i < simBrokerStreamLength; i++)
+        {
+            remainingLength += (simBrokerStream[consumed + i] & 0x7F) * multiplier;
+            multiplier *= 128;
+            if ((simBrokerStream[consumed + i] & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        if (i > 4 || consumed + i >= simBrokerStreamLength || consumed + i + 1 + remainingLength > simBrokerStreamLength)
+        {
+            break;
+        }
+
+        simBrokerPacket(&simBrokerStream[consumed], i + 1, remainingLength);
+        consumed += i + 1 + remainingLength;
+    }
+
+    memmove(simBrokerStream, &simBrokerStream[consumed], simBrokerStreamLength - consumed);
+    simBrokerStreamLength -= consumed;
+}
+
+void SIM_BROKER_Reset(void)
+{
+    memset(&simBrokerConfig, 0, sizeof(simBrokerConfig));
+    simBrokerConfig.answerConnect = true;
+    simBrokerConfig.autoPuback    = true;
+
+    memset(&simBrokerStats, 0, sizeof(simBrokerStats));
+    simBrokerLogCount     = 0;
+    simBrokerSocket       = -1;
+    simBrokerStreamLength = 0;
+
+    SIM_WINC_SetTxHandler(simBrokerReceive);
+}
+
+uint16_t SIM_BROKER_PublishCount(void)
+{
+    return simBrokerLogCount;
+}
+
+const sim_broker_publish_t* SIM_BROKER_Publish(uint16_t index)
+{
+    return (index < simBrokerLogCount) ? &simBrokerLog[index] : NULL;
+}
+
+void SIM_BROKER_ClearPublishLog(void)
+{
+    simBrokerLogCount = 0;
+}
+
+const sim_broker_stats_t* SIM_BROKER_Stats(void)
+{
+    return &simBrokerStats;
+}
+
+void SIM_BROKER_SendPuback(uint16_t packetId)
+{
+    uint8_t puback[4] = {0x40, 0x02, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+
+    simBrokerReply(puback, sizeof(puback));
+}
+
+uint16_t SIM_BROKER_EncodePublish(uint8_t* buffer, const char* topic, const uint8_t* payload, uint16_t payloadLength)
+{
+    uint16_t topicLength = (uint16_t)strlen(topic);
+    uint16_t length;
+
+    buffer[0] = 0x30;
+    length    = 1 + simBrokerEncodeLength(2 + topicLength + payloadLength, &buffer[1]);
+    buffer[length++] = (uint8_t)(topicLength >> 8);
+    buffer[length++] = (uint8_t)topicLength;
+    memcpy(&buffer[length], topic, topicLength);
+    length += topicLength;
+    memcpy(&buffer[length], payload, payloadLength);
+    return length + payloadLength;
+}
+
+void SIM_BROKER_SendPublish(const char* topic, const uint8_t* payload, uint16_t payloadLength)
+{
+    static uint8_t packet[1 + 4 + 2 + SIM_BROKER_TOPIC_MAX + SIM_BROKER_SEND_PAYLOAD_MAX];
+
+    if (strlen(topic) >= SIM_BROKER_TOPIC_MAX || payloadLength > SIM_BROKER_SEND_PAYLOAD_MAX)
+    {
+        return;
+    }
+    simBrokerReply(packet, SIM_BROKER_EncodePublish(packet, topic, payload, payloadLength));
+}
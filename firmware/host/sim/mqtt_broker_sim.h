@@ -0,0 +1,92 @@
+/*
+    \file   mqtt_broker_sim.h
+
+    \brief  Loopback MQTT broker for the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef MQTT_BROKER_SIM_H
+#define MQTT_BROKER_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "winc_socket_sim.h"
+
+// Parses what the client writes to the simulated WINC socket and answers
+// CONNECT, PUBLISH (QoS 1), SUBSCRIBE, UNSUBSCRIBE and PINGREQ through the
+// receive queue of the same socket.
+
+#define SIM_BROKER_PUBLISH_LOG   64
+#define SIM_BROKER_TOPIC_MAX     128
+#define SIM_BROKER_PAYLOAD_MAX   1024
+#define SIM_BROKER_SUBACK_CODES  8
+#define SIM_BROKER_SEND_PAYLOAD_MAX 4096
+
+typedef struct
+{
+    char     topic[SIM_BROKER_TOPIC_MAX];
+    uint8_t  payload[SIM_BROKER_PAYLOAD_MAX];
+    uint16_t payloadLength;
+    uint16_t packetId;
+    uint8_t  qos;
+    bool     dup;
+} sim_broker_publish_t;
+
+typedef struct
+{
+    bool    answerConnect;     // Send CONNACK, default true
+    bool    sessionPresent;
+    uint8_t connackCode;
+    bool    autoPuback;        // Acknowledge QoS 1 PUBLISH at once, default true
+    uint8_t subackCodeCount;   // 0 grants the requested QoS for every filter
+    uint8_t subackCodes[SIM_BROKER_SUBACK_CODES];
+} sim_broker_config_t;
+
+typedef struct
+{
+    uint32_t connects;
+    bool     lastCleanSession;
+    uint32_t publishes;
+    uint32_t subscribes;
+    uint32_t unsubscribes;
+    uint32_t pingreqs;
+    uint32_t disconnects;
+    uint32_t malformed;
+} sim_broker_stats_t;
+
+extern sim_broker_config_t simBrokerConfig;
+
+// Resets the configuration and the log and installs the broker as the WINC TX handler
+void SIM_BROKER_Reset(void);
+
+uint16_t                    SIM_BROKER_PublishCount(void);
+const sim_broker_publish_t* SIM_BROKER_Publish(uint16_t index);
+void                        SIM_BROKER_ClearPublishLog(void);
+const sim_broker_stats_t*   SIM_BROKER_Stats(void);
+
+// Packets sent to the client
+void     SIM_BROKER_SendPuback(uint16_t packetId);
+void     SIM_BROKER_SendPublish(const char* topic, const uint8_t* payload, uint16_t payloadLength);
+uint16_t SIM_BROKER_EncodePublish(uint8_t* buffer, const char* topic, const uint8_t* payload, uint16_t payloadLength);
+
+#endif   // MQTT_BROKER_SIM_H
@@ -0,0 +1,168 @@
+/*
+    \file   mqtt_client_sim.c
+
+    \brief  Cloud service stand-in driving the MQTT client in the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include "mqtt_client_sim.h"
+#include "winc_socket_sim.h"
+#include "services/iot/cloud/mqtt_packetPopulation/mqtt_packetPopulate.h"
+
+#define SIM_CLIENT_ID         "host-test"
+#define SIM_CLIENT_KEEP_ALIVE 120
+
+static void simClientConnected(void);
+
+static pf_MQTT_CLIENT simClient = {
+    .MQTT_CLIENT_receive   = MQTT_GetReceivedData,
+    .MQTT_CLIENT_connected = simClientConnected,
+};
+
+pf_MQTT_CLIENT* pf_mqtt_client = &simClient;
+
+static packetReceptionHandler_t simClientRecvTable[2];
+static int8_t                   simClientUnusedSocket = -1;
+static uint32_t                 simClientConnectedCount;
+
+static void simClientConnected(void)
+{
+    simClientConnectedCount++;
+}
+
+static void simClientSocketHandler(SOCKET sock, uint8_t msgType, void* pMsg)
+{
+    BSD_SocketHandler(sock, msgType, pMsg);
+}
+
+void SIM_CLIENT_Init(void)
+{
+    socketDeinit();
+    socketInit();
+    registerSocketCallback(simClientSocketHandler, NULL);
+
+    MQTT_ClientInitialize();
+
+    memset(simClientRecvTable, 0, sizeof(simClientRecvTable));
+    simClientRecvTable[0].socket       = MQTT_GetClientConnectionInfo()->tcpClientSocket;
+    simClientRecvTable[0].recvCallBack = pf_mqtt_client->MQTT_CLIENT_receive;
+    // getSocketInfo() looks at both entries
+    simClientRecvTable[1].socket = &simClientUnusedSocket;
+    BSD_SetRecvHandlerTable(simClientRecvTable);
+
+    simClientConnectedCount = 0;
+}
+
+bool SIM_CLIENT_OpenSocket(void)
+{
+    mqttContext*           context = MQTT_GetClientConnectionInfo();
+    struct bsd_sockaddr_in addr;
+
+    *context->tcpClientSocket = BSD_socket(PF_INET, BSD_SOCK_STREAM, 1);
+    if (*context->tcpClientSocket < 0)
+    {
+        return false;
+    }
+    simClientRecvTable[0].socketState = SOCKET_CLOSED;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = PF_INET;
+    addr.sin_port        = BSD_htons(8883);
+    addr.sin_addr.s_addr = 0x0100007F;
+    if (BSD_connect(*context->tcpClientSocket, (struct bsd_sockaddr*)&addr, sizeof(addr)) != BSD_SUCCESS)
+    {
+        return false;
+    }
+
+    while (SIM_WINC_HandleEvents())
+    {
+    }
+    return (simClientRecvTable[0].socketState == SOCKET_CONNECTED);
+}
+
+void SIM_CLIENT_Connect(bool cleanSession)
+{
+    mqttConnectPacket connectPacket;
+
+    memset(&connectPacket, 0, sizeof(connectPacket));
+    connectPacket.connectVariableHeader.connectFlagsByte.cleanSession = cleanSession ? 1 : 0;
+    connectPacket.connectVariableHeader.keepAliveTimer                = SIM_CLIENT_KEEP_ALIVE;
+    connectPacket.clientID                                            = (uint8_t*)SIM_CLIENT_ID;
+
+    MQTT_CreateConnectPacket(&connectPacket);
+}
+
+bool SIM_CLIENT_Subscribe(const char* topic, uint8_t qos)
+{
+    mqttSubscribePacket subscribePacket;
+
+    memset(&subscribePacket, 0, sizeof(subscribePacket));
+    subscribePacket.packetIdentifierLSB                 = 1;
+    subscribePacket.subscribePayload[0].topic           = (uint8_t*)topic;
+    subscribePacket.subscribePayload[0].topicLength     = (uint16_t)strlen(topic);
+    subscribePacket.subscribePayload[0].requestedQoS    = qos;
+
+    return MQTT_CreateSubscribePacket(&subscribePacket);
+}
+
+void SIM_CLIENT_Task(void)
+{
+    mqttContext* context = MQTT_GetClientConnectionInfo();
+
+    while (SIM_WINC_HandleEvents())
+    {
+    }
+
+    MQTT_sched();
+
+    if (simClientRecvTable[0].socketState == SOCKET_CONNECTED)
+    {
+        MQTT_ReceptionHandler(context);
+        MQTT_TransmissionHandler(context);
+        MQTT_Receive(context);
+    }
+}
+
+void SIM_CLIENT_Run(uint16_t passes)
+{
+    while (passes-- > 0)
+    {
+        SIM_CLIENT_Task();
+    }
+}
+
+socketState_t SIM_CLIENT_SocketState(void)
+{
+    return simClientRecvTable[0].socketState;
+}
+
+uint32_t SIM_CLIENT_ConnectedCount(void)
+{
+    return simClientConnectedCount;
+}
+
+mqttContext* SIM_CLIENT_Context(void)
+{
+    return MQTT_GetClientConnectionInfo();
+}
@@ -0,0 +1,54 @@
+/*
+    \file   mqtt_client_sim.h
+
+    \brief  Cloud service stand-in driving the MQTT client in the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef MQTT_CLIENT_SIM_H
+#define MQTT_CLIENT_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mqtt/mqtt_core/mqtt_core.h"
+#include "services/iot/cloud/bsd_adapter/bsdWINC.h"
+
+// Follows what cloud_service.c does with the MQTT core: reInit() sets up the
+// socket callback and the receive handler table, and every pass of
+// CLOUD_task() with a connected socket runs the reception handler, the
+// transmission handler and MQTT_Receive().
+
+void SIM_CLIENT_Init(void);
+bool SIM_CLIENT_OpenSocket(void);
+void SIM_CLIENT_Connect(bool cleanSession);
+bool SIM_CLIENT_Subscribe(const char* topic, uint8_t qos);
+
+// One CLOUD_task() pass after all pending WINC events are delivered
+void SIM_CLIENT_Task(void);
+void SIM_CLIENT_Run(uint16_t passes);
+
+socketState_t SIM_CLIENT_SocketState(void);
+uint32_t      SIM_CLIENT_ConnectedCount(void);
+mqttContext*  SIM_CLIENT_Context(void);
+
+#endif   // MQTT_CLIENT_SIM_H
@@ -0,0 +1,383 @@
+/*
+    \file   sim_system.c
+
+    \brief  Simulated system services and peripherals for the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "sim_system.h"
+
+#define SIM_TIMERS          16
+#define SIM_CONSOLE_SIZE    16384
+
+typedef struct
+{
+    SYS_TIME_CALLBACK callback;
+    uintptr_t         context;
+    uint64_t          due;
+    uint64_t          period;   // 0 for a single shot
+    bool              active;
+} sim_timer_t;
+
+static uint64_t    simNow;
+static sim_timer_t simTimers[SIM_TIMERS];
+static bool        simInterruptsEnabled = true;
+static char        simConsole[SIM_CONSOLE_SIZE];
+static size_t      simConsoleLength;
+static ssize_t     simConsoleFreeSpace = SIM_CONSOLE_SIZE;
+
+sim_peripherals_t simPeripherals;
+
+void SIM_SystemReset(void)
+{
+    simNow = 0;
+    memset(simTimers, 0, sizeof(simTimers));
+    memset(&simPeripherals, 0, sizeof(simPeripherals));
+    simInterruptsEnabled = true;
+    simConsoleFreeSpace  = SIM_CONSOLE_SIZE;
+    SIM_ConsoleClear();
+}
+
+// *****************************************************************************
+// System Time
+// *****************************************************************************
+
+static SYS_TIME_HANDLE simTimerCreate(SYS_TIME_CALLBACK callback, uintptr_t context, uint32_t ms, bool periodic)
+{
+    SYS_TIME_HANDLE handle;
+
+    for (handle = 0; handle < SIM_TIMERS; handle++)
+    {
+        if (!simTimers[handle].active)
+        {
+            simTimers[handle].callback = callback;
+            simTimers[handle].context  = context;
+            simTimers[handle].due      = simNow + (uint64_t)ms * 1000;
+            simTimers[handle].period   = periodic ? (uint64_t)ms * 1000 : 0;
+            simTimers[handle].active   = true;
+            return handle;
+        }
+    }
+
+    return SYS_TIME_HANDLE_INVALID;
+}
+
+SYS_TIME_HANDLE SYS_TIME_CallbackRegisterMS(SYS_TIME_CALLBACK callback, uintptr_t context, uint32_t ms, SYS_TIME_CALLBACK_TYPE type)
+{
+    return simTimerCreate(callback, context, ms, type == SYS_TIME_PERIODIC);
+}
+
+SYS_TIME_RESULT SYS_TIME_TimerStop(SYS_TIME_HANDLE handle)
+{
+    if (handle >= SIM_TIMERS)
+    {
+        return SYS_TIME_ERROR;
+    }
+    simTimers[handle].active = false;
+    return SYS_TIME_SUCCESS;
+}
+
+SYS_TIME_RESULT SYS_TIME_TimerDestroy(SYS_TIME_HANDLE handle)
+{
+    return SYS_TIME_TimerStop(handle);
+}
+
+SYS_TIME_RESULT SYS_TIME_DelayMS(uint32_t ms, SYS_TIME_HANDLE* handle)
+{
+    *handle = simTimerCreate(NULL, 0, ms, false);
+    return *handle == SYS_TIME_HANDLE_INVALID ? SYS_TIME_ERROR : SYS_TIME_SUCCESS;
+}
+
+// A caller polling for the delay is waiting, so time moves on to its end
+bool SYS_TIME_DelayIsComplete(SYS_TIME_HANDLE handle)
+{
+    if (handle >= SIM_TIMERS || !simTimers[handle].active)
+    {
+        return true;
+    }
+    if (simTimers[handle].due > simNow)
+    {
+        SIM_TimeAdvanceUs(simTimers[handle].due - simNow);
+    }
+    simTimers[handle].active = false;
+    return true;
+}
+
+uint32_t SYS_TIME_FrequencyGet(void)
+{
+    return SIM_TIME_FREQUENCY;
+}
+
+uint32_t SYS_TIME_CounterGet(void)
+{
+    return (uint32_t)simNow;
+}
+
+uint64_t SYS_TIME_Counter64Get(void)
+{
+    return simNow;
+}
+
+uint32_t SYS_TIME_CountToUS(uint32_t count)
+{
+    return count;
+}
+
+uint32_t SYS_TIME_MSToCount(uint32_t ms)
+{
+    return ms * 1000;
+}
+
+uint64_t SIM_TimeNowUs(void)
+{
+    return simNow;
+}
+
+void SIM_TimeAdvanceUs(uint64_t us)
+{
+    uint64_t end = simNow + us;
+    int      next;
+    int      i;
+
+    for (;;)
+    {
+        next = -1;
+        for (i = 0; i < SIM_TIMERS; i++)
+        {
+            if (simTimers[i].active && simTimers[i].callback != NULL && simTimers[i].due <= end &&
+                (next < 0 || simTimers[i].due < simTimers[next].due))
+            {
+                next = i;
+            }
+        }
+        if (next < 0)
+        {
+            break;
+        }
+
+        simNow = simTimers[next].due;
+        if (simTimers[next].period > 0)
+        {
+            simTimers[next].due += simTimers[next].period;
+        }
+        else
+        {
+            simTimers[next].active = false;
+        }
+        simTimers[next].callback(simTimers[next].context);
+    }
+
+    simNow = end;
+}
+
+void SIM_TimeAdvanceMs(uint32_t ms)
+{
+    SIM_TimeAdvanceUs((uint64_t)ms * 1000);
+}
+
+// *****************************************************************************
+// Interrupts
+// *****************************************************************************
+
+bool SYS_INT_Disable(void)
+{
+    bool state = simInterruptsEnabled;
+
+    simInterruptsEnabled = false;
+    return state;
+}
+
+void SYS_INT_Restore(bool state)
+{
+    simInterruptsEnabled = state;
+}
+
+// *****************************************************************************
+// Console
+// *****************************************************************************
+
+const char* SIM_ConsoleOutput(void)
+{
+    return simConsole;
+}
+
+void SIM_ConsoleClear(void)
+{
+    simConsoleLength = 0;
+    simConsole[0]    = '\0';
+}
+
+void SIM_ConsoleSetFreeSpace(ssize_t freeSpace)
+{
+    simConsoleFreeSpace = freeSpace;
+}
+
+ssize_t SYS_CONSOLE_Write(const SYS_CONSOLE_HANDLE handle, const void* buf, size_t count)
+{
+    if (count > SIM_CONSOLE_SIZE - 1 - simConsoleLength)
+    {
+        // Keep the latest output
+        SIM_ConsoleClear();
+        if (count > SIM_CONSOLE_SIZE - 1)
+        {
+            count = SIM_CONSOLE_SIZE - 1;
+        }
+    }
+
+    memcpy(&simConsole[simConsoleLength], buf, count);
+    simConsoleLength += count;
+    simConsole[simConsoleLength] = '\0';
+    return (ssize_t)count;
+}
+
+bool SYS_CONSOLE_Flush(const SYS_CONSOLE_HANDLE handle)
+{
+    return true;
+}
+
+ssize_t SYS_CONSOLE_WriteFreeBufferCountGet(const SYS_CONSOLE_HANDLE handle)
+{
+    return simConsoleFreeSpace;
+}
+
+void SYS_CONSOLE_Message(const SYS_CONSOLE_HANDLE handle, const char* message)
+{
+    SYS_CONSOLE_Write(handle, message, strlen(message));
+}
+
+// *****************************************************************************
+// OSAL
+// *****************************************************************************
+
+OSAL_RESULT OSAL_MUTEX_Create(OSAL_MUTEX_HANDLE_TYPE* mutexID)
+{
+    *mutexID = 1;
+    return OSAL_RESULT_TRUE;
+}
+
+OSAL_RESULT OSAL_MUTEX_Lock(OSAL_MUTEX_HANDLE_TYPE* mutexID, uint16_t waitMS)
+{
+    if (*mutexID == 1)
+    {
+        *mutexID = 0;
+        return OSAL_RESULT_TRUE;
+    }
+    return OSAL_RESULT_FALSE;
+}
+
+OSAL_RESULT OSAL_MUTEX_Unlock(OSAL_MUTEX_HANDLE_TYPE* mutexID)
+{
+    *mutexID = 1;
+    return OSAL_RESULT_TRUE;
+}
+
+// *****************************************************************************
+// Peripherals
+// *****************************************************************************
+
+void RTC_RTCCTimeGet(struct tm* currentTime)
+{
+    memset(currentTime, 0, sizeof(*currentTime));
+    currentTime->tm_year = 122;
+    currentTime->tm_mday = 1;
+}
+
+void ADC_Enable(void)
+{
+}
+
+uint16_t ADC_ConversionResultGet(void)
+{
+    return simPeripherals.adcResult;
+}
+
+void ADC_CallbackRegister(ADC_CALLBACK callback, uintptr_t context)
+{
+    simPeripherals.adcCallback = callback;
+}
+
+void TC4_TimerStart(void)
+{
+}
+
+uint32_t TC4_TimerFrequencyGet(void)
+{
+    return 1024;
+}
+
+void TC4_Timer16bitPeriodSet(uint16_t period)
+{
+    simPeripherals.tc4Period = period;
+}
+
+bool SERCOM3_I2C_WriteRead(uint16_t address, uint8_t* wdata, uint32_t wlength, uint8_t* rdata, uint32_t rlength)
+{
+    if (simPeripherals.i2cBusy)
+    {
+        return false;
+    }
+    simPeripherals.i2cReadBuffer = rdata;
+    return true;
+}
+
+bool SERCOM3_I2C_IsBusy(void)
+{
+    return simPeripherals.i2cBusy;
+}
+
+SERCOM_I2C_ERROR SERCOM3_I2C_ErrorGet(void)
+{
+    return simPeripherals.i2cError;
+}
+
+void SERCOM3_I2C_CallbackRegister(SERCOM_I2C_CALLBACK callback, uintptr_t contextHandle)
+{
+    simPeripherals.i2cCallback = callback;
+}
+
+void LED_SetBlue(led_set_state_t newState)
+{
+}
+
+void LED_SetGreen(led_set_state_t newState)
+{
+}
+
+void LED_SetYellow(led_set_state_t newState)
+{
+}
+
+void LED_SetRed(led_set_state_t newState)
+{
+    simPeripherals.ledRed = newState;
+}
+
+void LED_SetWiFi(led_indicator_name_t state)
+{
+}
+
+void LED_SetCloud(led_indicator_name_t state)
+{
+}
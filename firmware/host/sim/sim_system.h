@@ -0,0 +1,66 @@
+/*
+    \file   sim_system.h
+
+    \brief  Simulated system services and peripherals for the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef SIM_SYSTEM_H
+#define SIM_SYSTEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "definitions.h"
+#include "led.h"
+
+// SYS_TIME counts microseconds and only moves when a test advances it.
+// Timer callbacks run from SIM_TimeAdvanceUs() in due order, as the
+// firmware's run from the TC3 interrupt.
+#define SIM_TIME_FREQUENCY 1000000UL
+
+void     SIM_SystemReset(void);
+void     SIM_TimeAdvanceUs(uint64_t us);
+void     SIM_TimeAdvanceMs(uint32_t ms);
+uint64_t SIM_TimeNowUs(void);
+
+// Console output is kept so tests can check what was printed
+const char* SIM_ConsoleOutput(void);
+void        SIM_ConsoleClear(void);
+void        SIM_ConsoleSetFreeSpace(ssize_t freeSpace);
+
+// Peripheral state seen and driven by tests
+typedef struct
+{
+    ADC_CALLBACK        adcCallback;
+    uint16_t            adcResult;
+    uint16_t            tc4Period;
+    SERCOM_I2C_CALLBACK i2cCallback;
+    uint8_t*            i2cReadBuffer;
+    SERCOM_I2C_ERROR    i2cError;
+    bool                i2cBusy;
+    led_set_state_t     ledRed;
+} sim_peripherals_t;
+
+extern sim_peripherals_t simPeripherals;
+
+#endif   // SIM_SYSTEM_H
@@ -0,0 +1,468 @@
+/*
+    \file   winc_socket_sim.c
+
+    \brief  Simulated WINC socket layer for the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include "winc_socket_sim.h"
+
+typedef struct
+{
+    bool     used;
+    bool     connectPending;
+    bool     recvPending;
+    uint8_t* userBuffer;
+    uint16_t userBufferSize;
+} sim_socket_t;
+
+typedef struct
+{
+    SOCKET   sock;
+    bool     close;
+    uint16_t length;
+    uint8_t  data[SIM_WINC_SEGMENT_MAX];
+} sim_segment_t;
+
+static sim_socket_t          simSockets[SIM_WINC_SOCKETS];
+static sim_segment_t         simRxQueue[SIM_WINC_RX_QUEUE];
+static uint8_t               simRxHead;
+static uint8_t               simRxCount;
+static tpfAppSocketCb        simSocketCb;
+static sim_winc_tx_handler_t simTxHandler;
+static int8_t                simConnectError;
+static int16_t               simSendError;
+static sim_winc_stats_t      simStats;
+static uint8_t               simTxScratch[SOCKET_BUFFER_MAX_LENGTH];
+
+void SIM_WINC_Reset(void)
+{
+    memset(simSockets, 0, sizeof(simSockets));
+    simRxHead       = 0;
+    simRxCount      = 0;
+    simSocketCb     = NULL;
+    simTxHandler    = NULL;
+    simConnectError = SOCK_ERR_NO_ERROR;
+    simSendError    = SOCK_ERR_NO_ERROR;
+    SIM_WINC_ClearStats();
+}
+
+void SIM_WINC_SetTxHandler(sim_winc_tx_handler_t handler)
+{
+    simTxHandler = handler;
+}
+
+void SIM_WINC_SetConnectError(int8_t error)
+{
+    simConnectError = error;
+}
+
+void SIM_WINC_SetSendError(int16_t error)
+{
+    simSendError = error;
+}
+
+static bool simSocketValid(SOCKET sock)
+{
+    return (sock >= 0 && sock < SIM_WINC_SOCKETS && simSockets[sock].used);
+}
+
+static sim_segment_t* simQueueSegment(SOCKET sock)
+{
+    sim_segment_t* segment;
+
+    if (simRxCount >= SIM_WINC_RX_QUEUE)
+    {
+        return NULL;
+    }
+    segment = &simRxQueue[(simRxHead + simRxCount) % SIM_WINC_RX_QUEUE];
+    simRxCount++;
+
+    segment->sock   = sock;
+    segment->close  = false;
+    segment->length = 0;
+    return segment;
+}
+
+bool SIM_WINC_Inject(SOCKET sock, const uint8_t* data, uint16_t length)
+{
+    sim_segment_t* segment;
+    uint16_t       chunk;
+
+    while (length > 0)
+    {
+        segment = simQueueSegment(sock);
+        if (segment == NULL)
+        {
+            return false;
+        }
+        chunk = (length > SIM_WINC_SEGMENT_MAX) ? SIM_WINC_SEGMENT_MAX : length;
+        memcpy(segment->data, data, chunk);
+        segment->length = chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    return true;
+}
+
+void SIM_WINC_InjectClose(SOCKET sock)
+{
+    sim_segment_t* segment = simQueueSegment(sock);
+
+    if (segment != NULL)
+    {
+        segment->close = true;
+    }
+}
+
+static void simDropSegments(SOCKET sock)
+{
+    uint8_t        count = simRxCount;
+    sim_segment_t  segment;
+
+    // Keep the segments of the other sockets in order
+    while (count-- > 0)
+    {
+        segment   = simRxQueue[simRxHead];
+        simRxHead = (simRxHead + 1) % SIM_WINC_RX_QUEUE;
+        simRxCount--;
+        if (segment.sock != sock)
+        {
+            simRxQueue[(simRxHead + simRxCount) % SIM_WINC_RX_QUEUE] = segment;
+            simRxCount++;
+        }
+    }
+}
+
+bool SIM_WINC_HandleEvents(void)
+{
+    tstrSocketConnectMsg connectMsg;
+    tstrSocketRecvMsg    recvMsg;
+    sim_segment_t*       segment;
+    sim_socket_t*        socket;
+    uint16_t             offset;
+    uint16_t             chunk;
+    SOCKET               sock;
+
+    for (sock = 0; sock < SIM_WINC_SOCKETS; sock++)
+    {
+        if (simSockets[sock].used && simSockets[sock].connectPending)
+        {
+            simSockets[sock].connectPending = false;
+            connectMsg.sock                 = sock;
+            connectMsg.s8Error              = simConnectError;
+            if (simSocketCb)
+            {
+                simSocketCb(sock, SOCKET_MSG_CONNECT, &connectMsg);
+            }
+            return true;
+        }
+    }
+
+    if (simRxCount == 0)
+    {
+        return false;
+    }
+
+    segment = &simRxQueue[simRxHead];
+    if (!simSocketValid(segment->sock))
+    {
+        // The socket was closed while the data was on its way
+        simRxHead = (simRxHead + 1) % SIM_WINC_RX_QUEUE;
+        simRxCount--;
+        return true;
+    }
+
+    socket = &simSockets[segment->sock];
+    if (!socket->recvPending)
+    {
+        // The WINC holds the data until the application calls recv()
+        return false;
+    }
+
+    simRxHead = (simRxHead + 1) % SIM_WINC_RX_QUEUE;
+    simRxCount--;
+    socket->recvPending = false;
+
+    memset(&recvMsg, 0, sizeof(recvMsg));
+    if (segment->close)
+    {
+        recvMsg.s16BufferSize = SOCK_ERR_CONN_ABORTED;
+        if (simSocketCb)
+        {
+            simSocketCb(segment->sock, SOCKET_MSG_RECV, &recvMsg);
+        }
+        return true;
+    }
+
+    // As Socket_ReadSocketData(), a segment larger than the buffer of the
+    // last recv() call is delivered as consecutive chunks into that buffer
+    recvMsg.u16RemainingSize = segment->length;
+    for (offset = 0; offset < segment->length && socket->used; offset += chunk)
+    {
+        chunk = segment->length - offset;
+        if (chunk > socket->userBufferSize)
+        {
+            chunk = socket->userBufferSize;
+        }
+        memcpy(socket->userBuffer, &segment->data[offset], chunk);
+
+        recvMsg.pu8Buffer     = socket->userBuffer;
+        recvMsg.s16BufferSize = (int16_t)chunk;
+        recvMsg.u16RemainingSize -= chunk;
+        simStats.recvEvents++;
+        if (simSocketCb)
+        {
+            simSocketCb(segment->sock, SOCKET_MSG_RECV, &recvMsg);
+        }
+    }
+    return true;
+}
+
+bool SIM_WINC_IsOpen(SOCKET sock)
+{
+    return simSocketValid(sock);
+}
+
+const sim_winc_stats_t* SIM_WINC_Stats(void)
+{
+    return &simStats;
+}
+
+void SIM_WINC_ClearStats(void)
+{
+    memset(&simStats, 0, sizeof(simStats));
+}
+
+// *****************************************************************************
+// WINC socket API
+// *****************************************************************************
+
+void socketInit(void)
+{
+    memset(simSockets, 0, sizeof(simSockets));
+}
+
+void socketDeinit(void)
+{
+    memset(simSockets, 0, sizeof(simSockets));
+    simRxCount  = 0;
+    simSocketCb = NULL;
+}
+
+void registerSocketCallback(tpfAppSocketCb socket_cb, tpfAppResolveCb resolve_cb)
+{
+    (void)resolve_cb;
+    simSocketCb = socket_cb;
+}
+
+SOCKET socket(uint16_t u16Domain, uint8_t u8Type, uint8_t u8Flags)
+{
+    SOCKET sock;
+
+    (void)u16Domain;
+    (void)u8Flags;
+
+    if (u8Type != SOCK_STREAM)
+    {
+        return -1;
+    }
+    for (sock = 0; sock < SIM_WINC_SOCKETS; sock++)
+    {
+        if (!simSockets[sock].used)
+        {
+            memset(&simSockets[sock], 0, sizeof(simSockets[sock]));
+            simSockets[sock].used = true;
+            simDropSegments(sock);
+            return sock;
+        }
+    }
+    return -1;
+}
+
+int8_t connect(SOCKET sock, struct sockaddr* pstrAddr, uint8_t u8AddrLen)
+{
+    if (!simSocketValid(sock) || pstrAddr == NULL || u8AddrLen == 0)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    simSockets[sock].connectPending = true;
+    return SOCK_ERR_NO_ERROR;
+}
+
+int8_t setsockopt(SOCKET socket, uint8_t u8Level, uint8_t option_name, const void* option_value, uint16_t u16OptionLen)
+{
+    (void)u8Level;
+    (void)option_name;
+    (void)option_value;
+    (void)u16OptionLen;
+    return simSocketValid(socket) ? SOCK_ERR_NO_ERROR : SOCK_ERR_INVALID_ARG;
+}
+
+int8_t getsockopt(SOCKET sock, uint8_t u8Level, uint8_t u8OptName, const void* pvOptValue, uint8_t* pu8OptLen)
+{
+    (void)sock;
+    (void)u8Level;
+    (void)u8OptName;
+    (void)pvOptValue;
+    (void)pu8OptLen;
+    return SOCK_ERR_INVALID_ARG;
+}
+
+int16_t sendv(SOCKET sock, tstrSocketIovec* pstrIov, uint8_t u8IovCount, uint16_t u16Flags)
+{
+    uint32_t length = 0;
+    uint8_t  i;
+
+    (void)u16Flags;
+
+    if (!simSocketValid(sock) || pstrIov == NULL || u8IovCount == 0 || u8IovCount > SOCKET_IOV_MAX)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    for (i = 0; i < u8IovCount; i++)
+    {
+        if (pstrIov[i].pvBuf == NULL && pstrIov[i].u16Len != 0)
+        {
+            return SOCK_ERR_INVALID_ARG;
+        }
+        length += pstrIov[i].u16Len;
+    }
+    if (length > SOCKET_BUFFER_MAX_LENGTH)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    if (simSendError != SOCK_ERR_NO_ERROR)
+    {
+        return simSendError;
+    }
+
+    simStats.sendCalls++;
+    simStats.blockWrites += SIM_WINC_HIF_BLOCKS;
+    simStats.spiBytes += SIM_WINC_HIF_BLOCKS * SIM_WINC_SPI_BLOCK_OVERHEAD + SIM_WINC_HIF_CONTROL_BYTES;
+    simStats.bytesSent += length;
+
+    // Empty segments are skipped by hif_send_segments()
+    length = 0;
+    for (i = 0; i < u8IovCount; i++)
+    {
+        if (pstrIov[i].u16Len == 0)
+        {
+            continue;
+        }
+        simStats.blockWrites++;
+        simStats.spiBytes += SIM_WINC_SPI_BLOCK_OVERHEAD + pstrIov[i].u16Len;
+        memcpy(&simTxScratch[length], pstrIov[i].pvBuf, pstrIov[i].u16Len);
+        length += pstrIov[i].u16Len;
+    }
+
+    if (simTxHandler)
+    {
+        simTxHandler(sock, simTxScratch, (uint16_t)length);
+    }
+    return SOCK_ERR_NO_ERROR;
+}
+
+int16_t send(SOCKET sock, void* pvSendBuffer, uint16_t u16SendLength, uint16_t u16Flags)
+{
+    tstrSocketIovec iov;
+
+    if (pvSendBuffer == NULL || u16SendLength == 0)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    iov.pvBuf  = pvSendBuffer;
+    iov.u16Len = u16SendLength;
+    return sendv(sock, &iov, 1, u16Flags);
+}
+
+int16_t recv(SOCKET sock, void* pvRecvBuf, uint16_t u16BufLen, uint32_t u32Timeoutmsec)
+{
+    (void)u32Timeoutmsec;
+
+    if (!simSocketValid(sock) || pvRecvBuf == NULL || u16BufLen == 0)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+
+    // As in socket.c, the latest buffer is used even while a receive is pending
+    simSockets[sock].userBuffer     = (uint8_t*)pvRecvBuf;
+    simSockets[sock].userBufferSize = u16BufLen;
+    simSockets[sock].recvPending    = true;
+    return SOCK_ERR_NO_ERROR;
+}
+
+int16_t recvfrom(SOCKET sock, void* pvRecvBuf, uint16_t u16BufLen, uint32_t u32Timeoutmsec)
+{
+    (void)sock;
+    (void)pvRecvBuf;
+    (void)u16BufLen;
+    (void)u32Timeoutmsec;
+    return SOCK_ERR_INVALID_ARG;
+}
+
+int16_t sendto(SOCKET sock, void* pvSendBuffer, uint16_t u16SendLength, uint16_t flags, struct sockaddr* pstrDestAddr, uint8_t u8AddrLen)
+{
+    (void)sock;
+    (void)pvSendBuffer;
+    (void)u16SendLength;
+    (void)flags;
+    (void)pstrDestAddr;
+    (void)u8AddrLen;
+    return SOCK_ERR_INVALID_ARG;
+}
+
+int8_t bind(SOCKET sock, struct sockaddr* pstrAddr, uint8_t u8AddrLen)
+{
+    (void)sock;
+    (void)pstrAddr;
+    (void)u8AddrLen;
+    return SOCK_ERR_INVALID_ARG;
+}
+
+int8_t listen(SOCKET sock, uint8_t backlog)
+{
+    (void)sock;
+    (void)backlog;
+    return SOCK_ERR_INVALID_ARG;
+}
+
+int8_t accept(SOCKET sock, struct sockaddr* addr, uint8_t* addrlen)
+{
+    (void)sock;
+    (void)addr;
+    (void)addrlen;
+    return SOCK_ERR_INVALID_ARG;
+}
+
+int8_t shutdown(SOCKET sock)
+{
+    if (!simSocketValid(sock))
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    simSockets[sock].used = false;
+    simDropSegments(sock);
+    return SOCK_ERR_NO_ERROR;
+}
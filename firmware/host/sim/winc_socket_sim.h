@@ -0,0 +1,83 @@
+/*
+    \file   winc_socket_sim.h
+
+    \brief  Simulated WINC socket layer for the host build
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef WINC_SOCKET_SIM_H
+#define WINC_SOCKET_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "socket.h"
+
+// Stands in for socket.c and the HIF below it. Sockets connect at once, data
+// written by send()/sendv() is handed to a TX handler (the loopback broker)
+// and received data is queued as TCP segments. Events are delivered one at a
+// time from SIM_WINC_HandleEvents(), the counterpart of
+// m2m_wifi_handle_events(), with the chunking rules of Socket_ReadSocketData().
+
+#define SIM_WINC_SOCKETS     2
+#define SIM_WINC_RX_QUEUE    32
+#define SIM_WINC_SEGMENT_MAX SOCKET_BUFFER_MAX_LENGTH
+
+// Bytes clocked around the data of every nm_write_block() in nmspi.c: 8 byte
+// DMA command, 2 response bytes, data start token, 2 byte data CRC and 3 byte
+// data response
+#define SIM_WINC_SPI_BLOCK_OVERHEAD 16
+
+// hif_send_segments() writes the 8 byte HIF header and the 16 byte
+// tstrSendCmd as two blocks in front of the data segments
+#define SIM_WINC_HIF_BLOCKS        2
+#define SIM_WINC_HIF_CONTROL_BYTES (8 + 16)
+
+typedef void (*sim_winc_tx_handler_t)(SOCKET sock, const uint8_t* data, uint16_t length);
+
+typedef struct
+{
+    uint32_t sendCalls;     // send() and sendv() calls accepted
+    uint32_t blockWrites;   // nm_write_block() transactions the HIF would issue
+    uint32_t spiBytes;      // Bytes clocked on the SPI bus for those transactions
+    uint32_t bytesSent;     // TCP payload bytes
+    uint32_t recvEvents;    // SOCKET_MSG_RECV callbacks with data
+} sim_winc_stats_t;
+
+void SIM_WINC_Reset(void);
+void SIM_WINC_SetTxHandler(sim_winc_tx_handler_t handler);
+void SIM_WINC_SetConnectError(int8_t error);
+void SIM_WINC_SetSendError(int16_t error);
+
+// Queue data from the peer, split into segments of at most SIM_WINC_SEGMENT_MAX
+bool SIM_WINC_Inject(SOCKET sock, const uint8_t* data, uint16_t length);
+// Queue a close from the peer
+void SIM_WINC_InjectClose(SOCKET sock);
+
+// Deliver one pending event. Returns false if nothing could be delivered.
+bool SIM_WINC_HandleEvents(void);
+bool SIM_WINC_IsOpen(SOCKET sock);
+
+const sim_winc_stats_t* SIM_WINC_Stats(void);
+void                    SIM_WINC_ClearStats(void);
+
+#endif   // WINC_SOCKET_SIM_H
@@ -0,0 +1,52 @@
+/*
+    \file   az_span.h
+
+    \brief  Host replacement for the az_span subset used by the MQTT client headers
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef _az_SPAN_H
+#define _az_SPAN_H
+
+#include <stdint.h>
+
+// The host build does not link the Azure SDK for C. The MQTT client headers
+// only need the span type for declarations.
+typedef struct
+{
+    struct
+    {
+        uint8_t* ptr;
+        int32_t  size;
+    } _internal;
+} az_span;
+
+#define AZ_SPAN_LITERAL_FROM_STR(STRING_LITERAL)           \
+    {                                                      \
+        ._internal = {                                     \
+            .ptr  = (uint8_t*)(STRING_LITERAL),            \
+            .size = sizeof(STRING_LITERAL) - 1,            \
+        },                                                 \
+    }
+
+#endif   // _az_SPAN_H
@@ -0,0 +1,137 @@
+/*
+    \file   definitions.h
+
+    \brief  Host replacement for the Harmony definitions.h
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef DEFINITIONS_H
+#define DEFINITIONS_H
+
+// Only the system services and peripheral libraries used by the modules in
+// the host build are declared, with the same prototypes as the Harmony
+// headers. They are implemented by sim/sim_system.c.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <time.h>
+
+#define __DMB()
+
+// System Time
+typedef uintptr_t SYS_TIME_HANDLE;
+#define SYS_TIME_HANDLE_INVALID ((SYS_TIME_HANDLE)(-1))
+
+typedef enum
+{
+    SYS_TIME_SUCCESS,
+    SYS_TIME_ERROR
+} SYS_TIME_RESULT;
+
+typedef enum
+{
+    SYS_TIME_SINGLE,
+    SYS_TIME_PERIODIC
+} SYS_TIME_CALLBACK_TYPE;
+
+typedef void (*SYS_TIME_CALLBACK)(uintptr_t context);
+
+SYS_TIME_HANDLE SYS_TIME_CallbackRegisterMS(SYS_TIME_CALLBACK callback, uintptr_t context, uint32_t ms, SYS_TIME_CALLBACK_TYPE type);
+SYS_TIME_RESULT SYS_TIME_TimerStop(SYS_TIME_HANDLE handle);
+SYS_TIME_RESULT SYS_TIME_TimerDestroy(SYS_TIME_HANDLE handle);
+SYS_TIME_RESULT SYS_TIME_DelayMS(uint32_t ms, SYS_TIME_HANDLE* handle);
+bool            SYS_TIME_DelayIsComplete(SYS_TIME_HANDLE handle);
+uint32_t        SYS_TIME_FrequencyGet(void);
+uint32_t        SYS_TIME_CounterGet(void);
+uint64_t        SYS_TIME_Counter64Get(void);
+uint32_t        SYS_TIME_CountToUS(uint32_t count);
+uint32_t        SYS_TIME_MSToCount(uint32_t ms);
+
+// Interrupts
+bool SYS_INT_Disable(void);
+void SYS_INT_Restore(bool state);
+
+// Console
+typedef uintptr_t SYS_CONSOLE_HANDLE;
+
+ssize_t SYS_CONSOLE_Write(const SYS_CONSOLE_HANDLE handle, const void* buf, size_t count);
+bool    SYS_CONSOLE_Flush(const SYS_CONSOLE_HANDLE handle);
+ssize_t SYS_CONSOLE_WriteFreeBufferCountGet(const SYS_CONSOLE_HANDLE handle);
+void    SYS_CONSOLE_Message(const SYS_CONSOLE_HANDLE handle, const char* message);
+
+// OSAL without an RTOS
+typedef uint8_t OSAL_MUTEX_HANDLE_TYPE;
+#define OSAL_WAIT_FOREVER (uint16_t)0xFFFF
+
+typedef enum OSAL_RESULT
+{
+    OSAL_RESULT_NOT_IMPLEMENTED = -1,
+    OSAL_RESULT_FALSE           = 0,
+    OSAL_RESULT_TRUE            = 1
+} OSAL_RESULT;
+
+OSAL_RESULT OSAL_MUTEX_Create(OSAL_MUTEX_HANDLE_TYPE* mutexID);
+OSAL_RESULT OSAL_MUTEX_Lock(OSAL_MUTEX_HANDLE_TYPE* mutexID, uint16_t waitMS);
+OSAL_RESULT OSAL_MUTEX_Unlock(OSAL_MUTEX_HANDLE_TYPE* mutexID);
+
+// RTC
+void RTC_RTCCTimeGet(struct tm* currentTime);
+
+// ADC
+typedef enum
+{
+    ADC_STATUS_RESRDY  = 0x01,
+    ADC_STATUS_OVERRUN = 0x02,
+    ADC_STATUS_WINMON  = 0x04,
+    ADC_STATUS_INVALID = 0xFFFFFFFF
+} ADC_STATUS;
+
+typedef void (*ADC_CALLBACK)(ADC_STATUS status, uintptr_t context);
+
+void     ADC_Enable(void);
+uint16_t ADC_ConversionResultGet(void);
+void     ADC_CallbackRegister(ADC_CALLBACK callback, uintptr_t context);
+
+// TC4
+void     TC4_TimerStart(void);
+uint32_t TC4_TimerFrequencyGet(void);
+void     TC4_Timer16bitPeriodSet(uint16_t period);
+
+// SERCOM3 I2C master
+typedef enum
+{
+    SERCOM_I2C_ERROR_NONE,
+    SERCOM_I2C_ERROR_NAK,
+    SERCOM_I2C_ERROR_BUS,
+} SERCOM_I2C_ERROR;
+
+typedef void (*SERCOM_I2C_CALLBACK)(uintptr_t contextHandle);
+
+bool             SERCOM3_I2C_WriteRead(uint16_t address, uint8_t* wdata, uint32_t wlength, uint8_t* rdata, uint32_t rlength);
+bool             SERCOM3_I2C_IsBusy(void);
+SERCOM_I2C_ERROR SERCOM3_I2C_ErrorGet(void);
+void             SERCOM3_I2C_CallbackRegister(SERCOM_I2C_CALLBACK callback, uintptr_t contextHandle);
+
+#endif   // DEFINITIONS_H
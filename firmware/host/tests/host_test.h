@@ -0,0 +1,79 @@
+/*
+    \file   host_test.h
+
+    \brief  Check macros for the host tests
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// Minimal checks for the host tests. A failed check is reported with its
+// location and the test keeps going; HOST_TEST_RESULT() is the exit code.
+
+static unsigned hostTestChecks;
+static unsigned hostTestFailures;
+
+#define CHECK(condition)                                                      \
+    do                                                                        \
+    {                                                                         \
+        hostTestChecks++;                                                     \
+        if (!(condition))                                                     \
+        {                                                                     \
+            hostTestFailures++;                                               \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        }                                                                     \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                           \
+    do                                                                                       \
+    {                                                                                        \
+        long long hostTestActual   = (long long)(actual);                                    \
+        long long hostTestExpected = (long long)(expected);                                  \
+        hostTestChecks++;                                                                    \
+        if (hostTestActual != hostTestExpected)                                              \
+        {                                                                                    \
+            hostTestFailures++;                                                              \
+            printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual,        \
+                   hostTestActual, hostTestExpected);                                        \
+        }                                                                                    \
+    } while (0)
+
+#define CHECK_MEM(actual, expected, length) CHECK(memcmp((actual), (expected), (length)) == 0)
+
+#define RUN_TEST(test)          \
+    do                          \
+    {                           \
+        printf("- %s\n", #test); \
+        test();                 \
+    } while (0)
+
+#define HOST_TEST_RESULT()                                                             \
+    (printf("%u checks, %u failures\n", hostTestChecks, hostTestFailures), \
+     hostTestFailures == 0 ? 0 : 1)
+
+#endif   // HOST_TEST_H
@@ -0,0 +1,177 @@
+/*
+    \file   test_debug_print_deferred.c
+
+    \brief  Host tests of deferred debug logging
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <stdarg.h>
+#include "host_test.h"
+#include "sim_system.h"
+#include "debug_print.h"
+
+// Built with CFG_DEBUG_DEFERRED=1: messages are recorded by debug_printer()
+// and only formatted by debug_flush()
+
+#define TEST_PREFIX "host-test"
+
+// What the immediate mode prints for the same call
+static const char* expected(debug_severity_t severity, debug_errorLevel_t level, const char* format, ...)
+{
+    static char line[600];
+    char        message[512];
+    va_list     args;
+
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    snprintf(line, sizeof(line), "%s %s %s %s\r\n" CSI_RESET, TEST_PREFIX, severity_strings[severity], level_strings[level], message);
+    return line;
+}
+
+static void startLog(void)
+{
+    SIM_SystemReset();
+    debug_init(TEST_PREFIX);
+    debug_setSeverity(SEVERITY_TRACE);
+    debug_disable(false);
+    debug_flush();
+    SIM_ConsoleClear();
+}
+
+static void test_formatted_at_flush(void)
+{
+    startLog();
+    debug_printInfo(" MQTT: Connected to %s:%d", "hub.azure-devices.net", 8883);
+    CHECK_EQ(strlen(SIM_ConsoleOutput()), 0);
+
+    debug_flush();
+    CHECK(strcmp(SIM_ConsoleOutput(),
+                 expected(SEVERITY_INFO, LEVEL_INFO, " MQTT: Connected to %s:%d" CSI_RESET, "hub.azure-devices.net", 8883)) == 0);
+}
+
+static void test_conversions(void)
+{
+    int         value   = -42;
+    const char* pointer = "pointer";
+
+    startLog();
+    debug_printWarn(" %u %x %5d|%-5d| %c %%", 4000000000U, 0xBEEF, 12, -3, 'z');
+    debug_flush();
+    CHECK(strcmp(SIM_ConsoleOutput(), expected(SEVERITY_WARN, LEVEL_WARN, " %u %x %5d|%-5d| %c %%" CSI_RESET, 4000000000U, 0xBEEF, 12, -3, 'z')) == 0);
+
+    SIM_ConsoleClear();
+    debug_printError(" %lu %lld %llu %ld", 123456789UL, -9000000000LL, 18000000000ULL, -5L);
+    debug_flush();
+    CHECK(strcmp(SIM_ConsoleOutput(), expected(SEVERITY_ERROR, LEVEL_ERROR, " %lu %lld %llu %ld" CSI_RESET, 123456789UL, -9000000000LL, 18000000000ULL, -5L)) == 0);
+
+    SIM_ConsoleClear();
+    debug_printGood(" %.2f %e %*d %.*s %p", 3.14159, 1e-5, 6, value, 3, "abcdef", (const void*)pointer);
+    debug_flush();
+    CHECK(strcmp(SIM_ConsoleOutput(), expected(SEVERITY_DEBUG, LEVEL_GOOD, " %.2f %e %*d %.*s %p" CSI_RESET, 3.14159, 1e-5, 6, value, 3, "abcdef", (const void*)pointer)) == 0);
+}
+
+static void test_string_copied(void)
+{
+    char topic[32];
+
+    startLog();
+    strcpy(topic, "devices/one");
+    debug_printTrace(" topic %s", topic);
+    strcpy(topic, "devices/two");
+    debug_flush();
+    CHECK(strstr(SIM_ConsoleOutput(), "devices/one") != NULL);
+}
+
+static void test_long_string_truncated(void)
+{
+    char text[100];
+
+    startLog();
+    memset(text, 'x', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    debug_printInfo(" [%s]", text);
+    debug_flush();
+    CHECK(strstr(SIM_ConsoleOutput(), "[xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx]") != NULL);
+}
+
+static void test_severity_filter(void)
+{
+    startLog();
+    debug_setSeverity(SEVERITY_WARN);
+    debug_printInfo(" filtered");
+    debug_printWarn(" kept");
+    debug_flush();
+    CHECK(strstr(SIM_ConsoleOutput(), "filtered") == NULL);
+    CHECK(strstr(SIM_ConsoleOutput(), "kept") != NULL);
+}
+
+static void test_console_full_keeps_record(void)
+{
+    startLog();
+    debug_printInfo(" waiting for console space");
+
+    SIM_ConsoleSetFreeSpace(10);
+    debug_flush();
+    CHECK_EQ(strlen(SIM_ConsoleOutput()), 0);
+
+    SIM_ConsoleSetFreeSpace(4096);
+    debug_flush();
+    CHECK(strstr(SIM_ConsoleOutput(), "waiting for console space") != NULL);
+}
+
+static void test_ring_overflow_reported(void)
+{
+    int i;
+
+    startLog();
+    for (i = 0; i < 200; i++)
+    {
+        debug_printInfo(" message %d of %s", i, "a burst");
+    }
+    debug_flush();
+
+    CHECK(strstr(SIM_ConsoleOutput(), " message 0 of a burst") != NULL);
+    CHECK(strstr(SIM_ConsoleOutput(), " message 199 of a burst") == NULL);
+    CHECK(strstr(SIM_ConsoleOutput(), "log messages dropped") != NULL);
+
+    // Space is available again after the flush
+    SIM_ConsoleClear();
+    debug_printInfo(" after the burst");
+    debug_flush();
+    CHECK(strstr(SIM_ConsoleOutput(), "after the burst") != NULL);
+    CHECK(strstr(SIM_ConsoleOutput(), "dropped") == NULL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_formatted_at_flush);
+    RUN_TEST(test_conversions);
+    RUN_TEST(test_string_copied);
+    RUN_TEST(test_long_string_truncated);
+    RUN_TEST(test_severity_filter);
+    RUN_TEST(test_console_full_keeps_record);
+    RUN_TEST(test_ring_overflow_reported);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,176 @@
+/*
+    \file   test_exchange_buffer.c
+
+    \brief  Host tests of the MQTT exchange buffer ring
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include "host_test.h"
+#include "mqtt/mqtt_exchange_buffer/mqtt_exchange_buffer.h"
+
+// The exchange buffers are rings since the zero-copy receive path went in.
+// An odd size makes every operation wrap at a different offset.
+#define TEST_BUFFER_SIZE 37
+#define TEST_MODEL_SIZE  1024
+#define TEST_ITERATIONS  200000
+
+static void test_wrap_around(void)
+{
+    uint8_t        memory[TEST_BUFFER_SIZE];
+    exchangeBuffer buffer = {memory, memory, sizeof(memory), 0};
+    uint8_t        data[16];
+    uint8_t*       span;
+    uint16_t       length;
+
+    MQTT_ExchangeBufferInit(&buffer);
+
+    CHECK_EQ(MQTT_ExchangeBufferWrite(&buffer, (uint8_t*)"0123456789012345678901234567890", 30), 30);
+    CHECK_EQ(MQTT_ExchangeBufferRead(&buffer, data, 16), 16);
+    CHECK_EQ(MQTT_ExchangeBufferRead(&buffer, data, 10), 10);
+
+    // 4 bytes left at the end of the memory, the next 12 wrap
+    CHECK_EQ(MQTT_ExchangeBufferWrite(&buffer, (uint8_t*)"abcdefghijkl", 12), 12);
+    CHECK_EQ(buffer.dataLength, 16);
+
+    length = MQTT_ExchangeBufferReadSpan(&buffer, &span);
+    CHECK_EQ(length, 11);
+    CHECK_MEM(span, "6789abcdefg", 11);
+    MQTT_ExchangeBufferConsume(&buffer, length);
+
+    length = MQTT_ExchangeBufferReadSpan(&buffer, &span);
+    CHECK_EQ(length, 5);
+    CHECK_MEM(span, "hijkl", 5);
+
+    CHECK_EQ(MQTT_ExchangeBufferPeek(&buffer, data, sizeof(data)), 5);
+    CHECK_EQ(buffer.dataLength, 5);
+}
+
+static void test_full_and_empty(void)
+{
+    uint8_t        memory[TEST_BUFFER_SIZE];
+    uint8_t        data[TEST_BUFFER_SIZE + 8];
+    exchangeBuffer buffer = {memory, memory, sizeof(memory), 0};
+    uint8_t*       span;
+
+    MQTT_ExchangeBufferInit(&buffer);
+    memset(data, 0x5A, sizeof(data));
+
+    CHECK_EQ(MQTT_ExchangeBufferReadSpan(&buffer, &span), 0);
+    CHECK_EQ(MQTT_ExchangeBufferRead(&buffer, data, 1), 0);
+    CHECK_EQ(MQTT_ExchangeBufferWrite(&buffer, data, sizeof(data)), TEST_BUFFER_SIZE);
+    CHECK_EQ(MQTT_ExchangeBufferWrite(&buffer, data, 1), 0);
+    CHECK_EQ(MQTT_ExchangeBufferWriteSpan(&buffer, &span), 0);
+}
+
+// Random operations checked against a flat model of the byte stream
+static void test_random_against_model(void)
+{
+    uint8_t        memory[TEST_BUFFER_SIZE];
+    exchangeBuffer buffer = {memory, memory, sizeof(memory), 0};
+    uint8_t        model[TEST_MODEL_SIZE];
+    uint32_t       head = 0, tail = 0;
+    uint8_t        counter = 0;
+    unsigned       errors  = 0;
+    int            i, k;
+
+    MQTT_ExchangeBufferInit(&buffer);
+    srand(1);
+
+    for (i = 0; i < TEST_ITERATIONS && errors == 0; i++)
+    {
+        uint8_t  data[64];
+        uint8_t* span;
+        uint16_t length = rand() % 50;
+        uint16_t done;
+        uint16_t expected;
+
+        switch (rand() % 4)
+        {
+            case 0:
+                for (k = 0; k < length; k++)
+                {
+                    data[k] = counter + k;
+                }
+                done     = MQTT_ExchangeBufferWrite(&buffer, data, length);
+                expected = (length < TEST_BUFFER_SIZE - (tail - head)) ? length : TEST_BUFFER_SIZE - (tail - head);
+                errors += (done != expected);
+                for (k = 0; k < done; k++)
+                {
+                    model[tail++ % TEST_MODEL_SIZE] = data[k];
+                }
+                counter += done;
+                break;
+
+            case 1:
+                done     = MQTT_ExchangeBufferRead(&buffer, data, length);
+                expected = (length < tail - head) ? length : tail - head;
+                errors += (done != expected);
+                for (k = 0; k < done; k++)
+                {
+                    errors += (data[k] != model[head++ % TEST_MODEL_SIZE]);
+                }
+                break;
+
+            case 2:
+                done = MQTT_ExchangeBufferPeek(&buffer, data, length);
+                for (k = 0; k < done; k++)
+                {
+                    errors += (data[k] != model[(head + k) % TEST_MODEL_SIZE]);
+                }
+                break;
+
+            default:
+                done = MQTT_ExchangeBufferWriteSpan(&buffer, &span);
+                done = (length < done) ? length : done;
+                for (k = 0; k < done; k++)
+                {
+                    span[k]                         = counter + k;
+                    model[tail++ % TEST_MODEL_SIZE] = counter + k;
+                }
+                MQTT_ExchangeBufferCommit(&buffer, done);
+                counter += done;
+
+                done = MQTT_ExchangeBufferReadSpan(&buffer, &span);
+                errors += (done > tail - head) || (done == 0 && tail != head);
+                if (done > 0)
+                {
+                    errors += (span[0] != model[head % TEST_MODEL_SIZE]);
+                }
+                break;
+        }
+
+        errors += (buffer.dataLength != tail - head);
+    }
+
+    CHECK_EQ(errors, 0);
+    CHECK_EQ(i, TEST_ITERATIONS);
+}
+
+int main(void)
+{
+    RUN_TEST(test_wrap_around);
+    RUN_TEST(test_full_and_empty);
+    RUN_TEST(test_random_against_model);
+    return HOST_TEST_RESULT();
+}
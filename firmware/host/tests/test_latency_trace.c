@@ -0,0 +1,231 @@
+/*
+    \file   test_latency_trace.c
+
+    \brief  Host tests of the direct method latency trace
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include "host_test.h"
+#include "sim_system.h"
+#include "mqtt_client_sim.h"
+#include "mqtt_broker_sim.h"
+#include "latency_trace.h"
+#include "iot_config/mqtt_config.h"
+#include "mqtt/mqtt_packetTransfer_interface.h"
+
+#define TEST_HANDLER_US  300
+#define TEST_RESPONSE_US 40
+
+static bool     telemetryAhead;
+static uint16_t responseId = 1;
+
+static bool publish(const char* topic, uint8_t qos, const char* payload)
+{
+    mqttPublishPacket packet;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.publishHeaderFlags.qos = qos;
+    packet.packetIdentifierLSB    = (uint8_t)responseId;
+    packet.packetIdentifierMSB    = (uint8_t)(responseId >> 8);
+    packet.topic                  = (uint8_t*)topic;
+    packet.payload                = (uint8_t*)payload;
+    packet.payloadLength          = (uint16_t)strlen(payload);
+    responseId++;
+
+    return MQTT_CreatePublishPacket(&packet);
+}
+
+// Hits the tracepoints where app.c and azutil.c do for a direct method
+static void methodHandler(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength)
+{
+    TRACE_Point(TRACE_METHOD_RECEIVED);
+    SIM_TimeAdvanceUs(TEST_HANDLER_US);
+    TRACE_Point(TRACE_METHOD_HANDLED);
+
+    if (telemetryAhead)
+    {
+        publish("devices/host-test/messages/events/", 0, "{\"light\":120}");
+    }
+
+    SIM_TimeAdvanceUs(TEST_RESPONSE_US);
+    publish("$iothub/methods/res/200/?$rid=1", 0, "{\"status\":\"Success\"}");
+    TRACE_Point(TRACE_RESPONSE_QUEUED);
+}
+
+static publishReceptionHandler_t methodTable[MAX_NUM_TOPICS_SUBSCRIBE] = {
+    {(uint8_t*)"$iothub/methods/POST/#", methodHandler},
+};
+
+static bool connectClient(void)
+{
+    SIM_SystemReset();
+    SIM_WINC_Reset();
+    SIM_BROKER_Reset();
+    SIM_CLIENT_Init();
+    MQTT_DiscardSession();
+    MQTT_SetPublishReceptionHandlerTable(methodTable);
+
+    if (!SIM_CLIENT_OpenSocket())
+    {
+        return false;
+    }
+    SIM_CLIENT_Connect(true);
+    SIM_CLIENT_Run(4);
+    return MQTT_GetConnectionState() == CONNECTED;
+}
+
+static void invokeMethod(void)
+{
+    static const uint8_t payload[] = "{\"delay\":\"PT5S\"}";
+
+    SIM_BROKER_SendPublish("$iothub/methods/POST/reboot/?$rid=1", payload, sizeof(payload) - 1);
+    SIM_CLIENT_Run(2);
+}
+
+static void test_direct_method_round_trip(void)
+{
+    trace_stage_stats_t stats;
+    trace_record_t      records[TRACE_RING_SIZE];
+    uint8_t             count;
+
+    CHECK(connectClient());
+    TRACE_Reset();
+    telemetryAhead = false;
+    invokeMethod();
+
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+
+    TRACE_GetStageStats(TRACE_STAGE_HANDLER, &stats);
+    CHECK_EQ(stats.count, 1);
+    CHECK_EQ(stats.minUs, TEST_HANDLER_US);
+
+    TRACE_GetStageStats(TRACE_STAGE_RESPONSE, &stats);
+    CHECK_EQ(stats.maxUs, TEST_RESPONSE_US);
+
+    TRACE_GetStageStats(TRACE_STAGE_TOTAL, &stats);
+    CHECK_EQ(stats.count, 1);
+    CHECK_EQ(stats.totalUs, TEST_HANDLER_US + TEST_RESPONSE_US);
+
+    count = TRACE_GetRecords(records, TRACE_RING_SIZE);
+    CHECK_EQ(count, TRACE_POINT_COUNT);
+    CHECK_EQ(records[0].point, TRACE_SOCKET_RECV);
+    CHECK_EQ(records[count - 1].point, TRACE_PUBLISH_SENT);
+    CHECK_EQ(records[count - 1].timestamp - records[0].timestamp, TEST_HANDLER_US + TEST_RESPONSE_US);
+}
+
+static void test_response_behind_telemetry(void)
+{
+    trace_stage_stats_t stats;
+    trace_record_t      records[TRACE_RING_SIZE];
+    uint8_t             count;
+
+    CHECK(connectClient());
+    TRACE_Reset();
+    telemetryAhead = true;
+    invokeMethod();
+
+    // The telemetry PUBLISH queued first does not end the trace
+    CHECK_EQ(SIM_BROKER_PublishCount(), 2);
+    CHECK(strncmp(SIM_BROKER_Publish(1)->topic, "$iothub/methods/res/", 20) == 0);
+    TRACE_GetStageStats(TRACE_STAGE_TOTAL, &stats);
+    CHECK_EQ(stats.count, 1);
+
+    count = TRACE_GetRecords(records, TRACE_RING_SIZE);
+    CHECK_EQ(count, TRACE_POINT_COUNT);
+}
+
+static void test_out_of_order_points_ignored(void)
+{
+    trace_stage_stats_t stats;
+
+    TRACE_Reset();
+    TRACE_Point(TRACE_PUBLISH_SENT);
+    TRACE_Point(TRACE_METHOD_HANDLED);
+    TRACE_Point(TRACE_RESPONSE_QUEUED);
+
+    TRACE_GetStageStats(TRACE_STAGE_TOTAL, &stats);
+    CHECK_EQ(stats.count, 0);
+    CHECK_EQ(TRACE_GetRecords(NULL, 0), 0);
+}
+
+static void test_percentiles(void)
+{
+    trace_stage_stats_t stats;
+
+    memset(&stats, 0, sizeof(stats));
+    CHECK_EQ(TRACE_GetPercentileUs(&stats, 99), 0);
+
+    // 90 samples in 64..127 us, 10 in 4096..8191 us
+    stats.count         = 100;
+    stats.histogram[6]  = 90;
+    stats.histogram[12] = 10;
+    stats.maxUs         = 5000;
+
+    CHECK_EQ(TRACE_GetPercentileUs(&stats, 50), 127);
+    CHECK_EQ(TRACE_GetPercentileUs(&stats, 90), 127);
+    CHECK_EQ(TRACE_GetPercentileUs(&stats, 91), 5000);
+}
+
+static void test_histogram_counts_past_16_bits(void)
+{
+    trace_stage_stats_t stats;
+    uint32_t            i;
+
+    CHECK(connectClient());
+    TRACE_Reset();
+    for (i = 0; i < 70000; i++)
+    {
+        TRACE_Point(TRACE_SOCKET_RECV);
+        TRACE_Point(TRACE_METHOD_RECEIVED);
+        TRACE_Point(TRACE_METHOD_HANDLED);
+        TRACE_Point(TRACE_PUBLISH_SENT);
+    }
+
+    // Without a queued response the trace is abandoned at TRACE_RESPONSE_QUEUED
+    TRACE_GetStageStats(TRACE_STAGE_TOTAL, &stats);
+    CHECK_EQ(stats.count, 0);
+
+    for (i = 0; i < 70000; i++)
+    {
+        TRACE_Point(TRACE_SOCKET_RECV);
+        TRACE_Point(TRACE_METHOD_RECEIVED);
+        TRACE_Point(TRACE_METHOD_HANDLED);
+        publish("$iothub/methods/res/200/?$rid=1", 0, "{}");
+        TRACE_Point(TRACE_RESPONSE_QUEUED);
+        SIM_CLIENT_Task();
+    }
+
+    TRACE_GetStageStats(TRACE_STAGE_TOTAL, &stats);
+    CHECK_EQ(stats.count, 70000);
+    CHECK_EQ(stats.histogram[0], 70000);
+}
+
+int main(void)
+{
+    RUN_TEST(test_direct_method_round_trip);
+    RUN_TEST(test_response_behind_telemetry);
+    RUN_TEST(test_out_of_order_points_ignored);
+    RUN_TEST(test_percentiles);
+    RUN_TEST(test_histogram_counts_past_16_bits);
+    return HOST_TEST_RESULT();
+}
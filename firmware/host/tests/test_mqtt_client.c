@@ -0,0 +1,544 @@
+/*
+    \file   test_mqtt_client.c
+
+    \brief  Host tests of the MQTT client against the loopback broker
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include "host_test.h"
+#include "sim_system.h"
+#include "mqtt_client_sim.h"
+#include "mqtt_broker_sim.h"
+#include "iot_config/mqtt_config.h"
+#include "mqtt/mqtt_packetTransfer_interface.h"
+#include "services/iot/cloud/store_forward.h"
+
+#define TEST_TOPIC "devices/host-test/messages/events/"
+
+static char     receivedTopics[4][64];
+static uint8_t  receivedPayloads[4][1200];
+static uint16_t receivedPayloadLengths[4];
+static uint8_t  receivedCount;
+
+static void receiveHandler(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength)
+{
+    if (receivedCount < 4 && topicLength < sizeof(receivedTopics[0]) && payloadLength <= sizeof(receivedPayloads[0]))
+    {
+        memcpy(receivedTopics[receivedCount], topic, topicLength);
+        receivedTopics[receivedCount][topicLength] = '\0';
+        memcpy(receivedPayloads[receivedCount], payload, payloadLength);
+        receivedPayloadLengths[receivedCount] = payloadLength;
+    }
+    receivedCount++;
+}
+
+static publishReceptionHandler_t receiveTable[MAX_NUM_TOPICS_SUBSCRIBE] = {
+    {(uint8_t*)"$iothub/methods/POST/#", receiveHandler},
+};
+
+// Fresh simulator, client and broker with the client connected
+static bool connectClient(bool cleanSession)
+{
+    SIM_SystemReset();
+    SIM_WINC_Reset();
+    SIM_BROKER_Reset();
+    SIM_CLIENT_Init();
+    MQTT_DiscardSession();
+    MQTT_SetPublishReceptionHandlerTable(receiveTable);
+    receivedCount = 0;
+
+    if (!SIM_CLIENT_OpenSocket())
+    {
+        return false;
+    }
+    SIM_CLIENT_Connect(cleanSession);
+    SIM_CLIENT_Run(4);
+
+    return MQTT_GetConnectionState() == CONNECTED;
+}
+
+static mqttPubackPacket lastPuback;
+static uint8_t          pubackCount;
+
+static void recordPuback(mqttPubackPacket* data)
+{
+    lastPuback = *data;
+    pubackCount++;
+}
+
+// As MQTT_CLIENT_iothub_puback_callback()
+static void storeForwardPuback(mqttPubackPacket* data)
+{
+    if (data->notDelivered)
+    {
+        STORE_FORWARD_Retry((uint16_t)(data->packetIdentifierMSB << 8 | data->packetIdentifierLSB));
+    }
+    else
+    {
+        STORE_FORWARD_Acknowledge((uint16_t)(data->packetIdentifierMSB << 8 | data->packetIdentifierLSB));
+    }
+}
+
+static bool publish(uint16_t packetId, uint8_t qos, const char* payload)
+{
+    mqttPublishPacket packet;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.publishHeaderFlags.qos = qos;
+    packet.packetIdentifierLSB    = (uint8_t)packetId;
+    packet.packetIdentifierMSB    = (uint8_t)(packetId >> 8);
+    packet.topic                  = (uint8_t*)TEST_TOPIC;
+    packet.payload                = (uint8_t*)payload;
+    packet.payloadLength          = (uint16_t)strlen(payload);
+
+    return MQTT_CreatePublishPacket(&packet);
+}
+
+static void test_connect(void)
+{
+    CHECK(connectClient(true));
+    CHECK_EQ(SIM_BROKER_Stats()->connects, 1);
+    CHECK(SIM_BROKER_Stats()->lastCleanSession);
+    CHECK_EQ(SIM_BROKER_Stats()->malformed, 0);
+
+    CHECK(connectClient(false));
+    CHECK(!SIM_BROKER_Stats()->lastCleanSession);
+}
+
+static void test_connack_refused(void)
+{
+    SIM_SystemReset();
+    SIM_WINC_Reset();
+    SIM_BROKER_Reset();
+    SIM_CLIENT_Init();
+    simBrokerConfig.connackCode = 5;   // Not authorized
+
+    CHECK(SIM_CLIENT_OpenSocket());
+    SIM_CLIENT_Connect(true);
+    SIM_CLIENT_Run(4);
+    CHECK(MQTT_GetConnectionState() != CONNECTED);
+}
+
+static void test_subscribe(void)
+{
+    CHECK(connectClient(true));
+    CHECK(SIM_CLIENT_Subscribe("$iothub/methods/POST/#", 0));
+    SIM_CLIENT_Run(4);
+    CHECK_EQ(SIM_BROKER_Stats()->subscribes, 1);
+    CHECK_EQ(MQTT_GetConnectionState(), CONNECTED);
+    CHECK_EQ(SIM_CLIENT_ConnectedCount(), 1);
+
+    // A refused filter drops the connection
+    CHECK(connectClient(true));
+    simBrokerConfig.subackCodeCount = 1;
+    simBrokerConfig.subackCodes[0]  = 0x80;
+    CHECK(SIM_CLIENT_Subscribe("$iothub/methods/POST/#", 0));
+    SIM_CLIENT_Run(4);
+    CHECK_EQ(MQTT_GetConnectionState(), DISCONNECTED);
+    CHECK_EQ(SIM_CLIENT_ConnectedCount(), 0);
+}
+
+static void test_qos0_publish(void)
+{
+    const sim_broker_publish_t* received;
+
+    CHECK(connectClient(true));
+    CHECK(publish(0, 0, "{\"temperature\":25}"));
+    SIM_CLIENT_Run(2);
+
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+    received = SIM_BROKER_Publish(0);
+    CHECK(received != NULL && strcmp(received->topic, TEST_TOPIC) == 0);
+    CHECK(received != NULL && received->qos == 0 && received->payloadLength == 18);
+    CHECK(received != NULL && memcmp(received->payload, "{\"temperature\":25}", 18) == 0);
+    CHECK_EQ(MQTT_GetInflightPublishCount(), 0);
+}
+
+static void test_qos1_window(void)
+{
+    mqttPublishQueueStats stats;
+    uint16_t              id;
+
+    CHECK(connectClient(true));
+    simBrokerConfig.autoPuback = false;
+
+    for (id = 1; id <= 6; id++)
+    {
+        CHECK(publish(id, 1, "window"));
+    }
+    SIM_CLIENT_Run(2);
+
+    // Sent back to back up to the in-flight window
+    CHECK_EQ(SIM_BROKER_PublishCount(), MQTT_MAX_INFLIGHT_PUBLISH);
+    CHECK_EQ(MQTT_GetInflightPublishCount(), MQTT_MAX_INFLIGHT_PUBLISH);
+    MQTT_GetPublishQueueStats(&stats);
+    CHECK_EQ(stats.queued, 6 - MQTT_MAX_INFLIGHT_PUBLISH);
+
+    // PUBACKs out of order each open one slot
+    SIM_BROKER_SendPuback(3);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(SIM_BROKER_PublishCount(), MQTT_MAX_INFLIGHT_PUBLISH + 1);
+    CHECK_EQ(SIM_BROKER_Publish(MQTT_MAX_INFLIGHT_PUBLISH)->packetId, 5);
+
+    SIM_BROKER_SendPuback(1);
+    SIM_BROKER_SendPuback(2);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 6);
+
+    // Unknown packet identifiers are ignored
+    SIM_BROKER_SendPuback(99);
+    for (id = 4; id <= 6; id++)
+    {
+        SIM_BROKER_SendPuback(id);
+    }
+    // One segment is read per pass
+    SIM_CLIENT_Run(4);
+    CHECK_EQ(MQTT_GetInflightPublishCount(), 0);
+    MQTT_GetPublishQueueStats(&stats);
+    CHECK_EQ(stats.inUse, 0);
+    CHECK_EQ(stats.arenaInUse, 0);
+    CHECK_EQ(MQTT_GetConnectionState(), CONNECTED);
+}
+
+static void test_qos1_retransmit(void)
+{
+    const sim_broker_publish_t* received;
+
+    CHECK(connectClient(true));
+    simBrokerConfig.autoPuback = false;
+
+    CHECK(publish(7, 1, "retry"));
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+    CHECK(!SIM_BROKER_Publish(0)->dup);
+
+    SIM_TimeAdvanceMs(9999);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+
+    // Sent again with DUP once WAITFORPUBACK_TIMEOUT has passed
+    SIM_TimeAdvanceMs(1);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 2);
+    received = SIM_BROKER_Publish(1);
+    CHECK(received != NULL && received->dup && received->packetId == 7);
+    CHECK(received != NULL && received->payloadLength == 5 && memcmp(received->payload, "retry", 5) == 0);
+
+    SIM_BROKER_SendPuback(7);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(MQTT_GetInflightPublishCount(), 0);
+}
+
+static void test_qos1_not_delivered(void)
+{
+    uint8_t attempt;
+
+    CHECK(connectClient(true));
+    simBrokerConfig.autoPuback = false;
+    MQTT_Set_Puback_callback(recordPuback);
+    pubackCount = 0;
+
+    CHECK(publish(8, 1, "lost"));
+    SIM_CLIENT_Run(2);
+    for (attempt = 0; attempt < MQTT_MAX_PUBLISH_RETRANSMIT; attempt++)
+    {
+        SIM_TimeAdvanceMs(10000);
+        SIM_CLIENT_Run(2);
+    }
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1 + MQTT_MAX_PUBLISH_RETRANSMIT);
+    CHECK_EQ(pubackCount, 0);
+
+    // Reported to the sender once the last re-send has timed out
+    SIM_TimeAdvanceMs(10000);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(pubackCount, 1);
+    CHECK(lastPuback.notDelivered);
+    CHECK_EQ(lastPuback.packetIdentifierLSB, 8);
+    CHECK_EQ(MQTT_GetInflightPublishCount(), 0);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1 + MQTT_MAX_PUBLISH_RETRANSMIT);
+
+    MQTT_Set_Puback_callback(NULL);
+}
+
+// Sends stored telemetry as cloudSendStoredTelemetry() does
+static void sendStored(uint16_t* packetId)
+{
+    store_forward_message_t message;
+    mqttPublishPacket       packet;
+
+    while (STORE_FORWARD_GetNext(&message))
+    {
+        memset(&packet, 0, sizeof(packet));
+        packet.publishHeaderFlags.qos = 1;
+        packet.packetIdentifierLSB    = (uint8_t)*packetId;
+        packet.packetIdentifierMSB    = (uint8_t)(*packetId >> 8);
+        packet.topic                  = message.topic;
+        packet.payload                = message.payload;
+        packet.payloadLength          = message.payloadLength;
+
+        if (!MQTT_CreatePublishPacket(&packet))
+        {
+            break;
+        }
+        STORE_FORWARD_MarkSent(&message, (*packetId)++);
+    }
+}
+
+static void test_qos1_redelivered_after_reconnect(void)
+{
+    store_forward_stats_t stats;
+    uint16_t              packetId = 20;
+
+    CHECK(connectClient(true));
+    simBrokerConfig.autoPuback = false;
+    MQTT_Set_Puback_callback(storeForwardPuback);
+
+    CHECK(STORE_FORWARD_Put((const uint8_t*)TEST_TOPIC, strlen(TEST_TOPIC), (const uint8_t*)"stored", 6));
+    sendStored(&packetId);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+
+    // Queued, not sent yet
+    CHECK(STORE_FORWARD_Put((const uint8_t*)TEST_TOPIC, strlen(TEST_TOPIC), (const uint8_t*)"queued", 6));
+    sendStored(&packetId);
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.inflight, 2);
+
+    // The connection is reset before the PUBACK, as CLOUD_reset() does, and
+    // a new session is started
+    SIM_CLIENT_Init();
+    CHECK(SIM_CLIENT_OpenSocket());
+    simBrokerConfig.autoPuback = true;
+    SIM_CLIENT_Connect(true);
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.stored, 2);
+    CHECK_EQ(stats.inflight, 1);
+
+    // The queued packet goes out after CONNACK, the sent one is published again
+    SIM_CLIENT_Run(4);
+    CHECK_EQ(MQTT_GetConnectionState(), CONNECTED);
+    sendStored(&packetId);
+    SIM_CLIENT_Run(4);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 3);
+    CHECK(SIM_BROKER_Publish(1) != NULL && SIM_BROKER_Publish(1)->packetId == 21 && memcmp(SIM_BROKER_Publish(1)->payload, "queued", 6) == 0);
+    CHECK(SIM_BROKER_Publish(2) != NULL && SIM_BROKER_Publish(2)->packetId == 22 && memcmp(SIM_BROKER_Publish(2)->payload, "stored", 6) == 0);
+    CHECK(SIM_BROKER_Publish(2) != NULL && !SIM_BROKER_Publish(2)->dup);
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.stored, 0);
+
+    MQTT_Set_Puback_callback(NULL);
+}
+
+static void test_qos1_resent_in_kept_session(void)
+{
+    CHECK(connectClient(false));
+    simBrokerConfig.autoPuback = false;
+    MQTT_Set_Puback_callback(recordPuback);
+    pubackCount = 0;
+
+    CHECK(publish(30, 1, "kept"));
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+
+    // Reconnect with cleanSession = 0, the packet stays in flight
+    SIM_CLIENT_Init();
+    CHECK(SIM_CLIENT_OpenSocket());
+    SIM_CLIENT_Connect(false);
+    CHECK_EQ(MQTT_GetInflightPublishCount(), 1);
+    CHECK_EQ(pubackCount, 0);
+
+    // Re-sent with DUP and the same packet identifier right after CONNACK
+    SIM_CLIENT_Run(4);
+    CHECK_EQ(MQTT_GetConnectionState(), CONNECTED);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 2);
+    CHECK(SIM_BROKER_Publish(1) != NULL && SIM_BROKER_Publish(1)->dup && SIM_BROKER_Publish(1)->packetId == 30);
+
+    SIM_BROKER_SendPuback(30);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(MQTT_GetInflightPublishCount(), 0);
+    CHECK_EQ(pubackCount, 1);
+    CHECK(!lastPuback.notDelivered);
+
+    MQTT_Set_Puback_callback(NULL);
+}
+
+static void test_publish_copied_when_queued(void)
+{
+    char payload[32];
+
+    CHECK(connectClient(true));
+    strcpy(payload, "original");
+    CHECK(publish(0, 0, payload));
+    strcpy(payload, "reused!!");
+    SIM_CLIENT_Run(2);
+
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+    CHECK(SIM_BROKER_Publish(0) != NULL && memcmp(SIM_BROKER_Publish(0)->payload, "original", 8) == 0);
+}
+
+static void test_publish_not_connected(void)
+{
+    SIM_SystemReset();
+    SIM_WINC_Reset();
+    SIM_BROKER_Reset();
+    SIM_CLIENT_Init();
+    CHECK(!publish(1, 1, "early"));
+}
+
+static void test_receive_several_packets_per_segment(void)
+{
+    uint8_t  stream[256];
+    uint16_t length;
+
+    CHECK(connectClient(true));
+    length = SIM_BROKER_EncodePublish(stream, "$iothub/methods/POST/reboot/?$rid=1", (const uint8_t*)"{}", 2);
+    length += SIM_BROKER_EncodePublish(&stream[length], "$iothub/methods/POST/blink/?$rid=2", (const uint8_t*)"{\"n\":3}", 7);
+    SIM_WINC_Inject(0, stream, length);
+    SIM_CLIENT_Run(2);
+
+    CHECK_EQ(receivedCount, 2);
+    CHECK(strcmp(receivedTopics[0], "$iothub/methods/POST/reboot/?$rid=1") == 0);
+    CHECK(strcmp(receivedTopics[1], "$iothub/methods/POST/blink/?$rid=2") == 0);
+    CHECK_EQ(receivedPayloadLengths[1], 7);
+    CHECK_MEM(receivedPayloads[1], "{\"n\":3}", 7);
+}
+
+static void test_receive_packet_split_across_reads(void)
+{
+    uint8_t  stream[256];
+    uint16_t length;
+    uint16_t offset;
+
+    CHECK(connectClient(true));
+    length = SIM_BROKER_EncodePublish(stream, "$iothub/methods/POST/split/?$rid=3", (const uint8_t*)"0123456789", 10);
+
+    // One byte at a time, the remaining length included
+    for (offset = 0; offset < length; offset++)
+    {
+        SIM_WINC_Inject(0, &stream[offset], 1);
+        SIM_CLIENT_Run(1);
+        CHECK_EQ(receivedCount, (offset + 1 == length) ? 1 : 0);
+    }
+    CHECK(strcmp(receivedTopics[0], "$iothub/methods/POST/split/?$rid=3") == 0);
+    CHECK_MEM(receivedPayloads[0], "0123456789", 10);
+}
+
+static void test_receive_large_publish(void)
+{
+    static uint8_t payload[900];
+    uint16_t       i;
+
+    for (i = 0; i < sizeof(payload); i++)
+    {
+        payload[i] = (uint8_t)i;
+    }
+
+    CHECK(connectClient(true));
+    SIM_BROKER_SendPublish("$iothub/methods/POST/large/?$rid=4", payload, sizeof(payload));
+    SIM_CLIENT_Run(4);
+
+    CHECK_EQ(receivedCount, 1);
+    CHECK_EQ(receivedPayloadLengths[0], sizeof(payload));
+    CHECK_MEM(receivedPayloads[0], payload, sizeof(payload));
+}
+
+static void test_receive_oversized_packet_skipped(void)
+{
+    static uint8_t       payload[3000];
+    static uint8_t       stream[3200];
+    static const uint8_t small[] = "{\"after\":1}";
+    uint16_t             length;
+
+    memset(payload, 'x', sizeof(payload));
+    CHECK(connectClient(true));
+
+    // Larger than the 1024 byte RX buffer, between two packets that fit. The
+    // stream arrives as 1400 byte segments with packet boundaries inside them.
+    length = SIM_BROKER_EncodePublish(stream, "$iothub/methods/POST/small/?$rid=4", small, sizeof(small) - 1);
+    length += SIM_BROKER_EncodePublish(&stream[length], "$iothub/methods/POST/huge/?$rid=5", payload, sizeof(payload));
+    length += SIM_BROKER_EncodePublish(&stream[length], "$iothub/methods/POST/small/?$rid=6", small, sizeof(small) - 1);
+    CHECK(SIM_WINC_Inject(0, stream, length));
+    SIM_CLIENT_Run(10);
+
+    CHECK_EQ(MQTT_GetConnectionState(), CONNECTED);
+    CHECK_EQ(SIM_CLIENT_SocketState(), SOCKET_CONNECTED);
+    CHECK_EQ(receivedCount, 2);
+    CHECK(strcmp(receivedTopics[0], "$iothub/methods/POST/small/?$rid=4") == 0);
+    CHECK(strcmp(receivedTopics[1], "$iothub/methods/POST/small/?$rid=6") == 0);
+    CHECK_EQ(receivedPayloadLengths[1], sizeof(small) - 1);
+    CHECK_MEM(receivedPayloads[1], small, sizeof(small) - 1);
+
+    // The skip does not outlive the connection
+    SIM_BROKER_SendPublish("$iothub/methods/POST/huge/?$rid=7", payload, sizeof(payload));
+    SIM_CLIENT_Run(1);
+    CHECK(connectClient(true));
+    SIM_BROKER_SendPublish("$iothub/methods/POST/small/?$rid=8", small, sizeof(small) - 1);
+    SIM_CLIENT_Run(2);
+    CHECK_EQ(receivedCount, 1);
+    CHECK(strcmp(receivedTopics[0], "$iothub/methods/POST/small/?$rid=8") == 0);
+}
+
+// SPI transactions of one QoS 1 PUBLISH as the HIF would issue them
+static void test_publish_spi_transactions(void)
+{
+    const sim_winc_stats_t* stats;
+
+    CHECK(connectClient(true));
+    SIM_WINC_ClearStats();
+    CHECK(publish(9, 1, "{\"temperature\":25}"));
+    SIM_CLIENT_Run(2);
+
+    stats = SIM_WINC_Stats();
+    CHECK_EQ(stats->sendCalls, 1);
+    printf("  QoS 1 PUBLISH: %lu SPI block writes, %lu SPI bytes for %lu TCP bytes\n",
+           (unsigned long)stats->blockWrites, (unsigned long)stats->spiBytes, (unsigned long)stats->bytesSent);
+    CHECK_EQ(stats->bytesSent, 2 + 2 + strlen(TEST_TOPIC) + 2 + 18);
+
+    // Header, topic and packet identifier in one segment, the payload in another
+    CHECK_EQ(stats->blockWrites, SIM_WINC_HIF_BLOCKS + 2);
+    CHECK_EQ(stats->spiBytes, SIM_WINC_HIF_BLOCKS * SIM_WINC_SPI_BLOCK_OVERHEAD + SIM_WINC_HIF_CONTROL_BYTES +
+                                  2 * SIM_WINC_SPI_BLOCK_OVERHEAD + stats->bytesSent);
+    CHECK_EQ(SIM_BROKER_PublishCount(), 1);
+    CHECK(strcmp(SIM_BROKER_Publish(0)->topic, TEST_TOPIC) == 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_connect);
+    RUN_TEST(test_connack_refused);
+    RUN_TEST(test_subscribe);
+    RUN_TEST(test_qos0_publish);
+    RUN_TEST(test_qos1_window);
+    RUN_TEST(test_qos1_retransmit);
+    RUN_TEST(test_qos1_not_delivered);
+    RUN_TEST(test_qos1_redelivered_after_reconnect);
+    RUN_TEST(test_qos1_resent_in_kept_session);
+    RUN_TEST(test_publish_copied_when_queued);
+    RUN_TEST(test_publish_not_connected);
+    RUN_TEST(test_receive_several_packets_per_segment);
+    RUN_TEST(test_receive_packet_split_across_reads);
+    RUN_TEST(test_receive_large_publish);
+    RUN_TEST(test_receive_oversized_packet_skipped);
+    RUN_TEST(test_publish_spi_transactions);
+    return HOST_TEST_RESULT();
+}
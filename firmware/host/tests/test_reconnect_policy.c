@@ -0,0 +1,276 @@
+/*
+    \file   test_reconnect_policy.c
+
+    \brief  Host tests and fleet benchmark of the reconnect policy
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include "host_test.h"
+#include "sim_system.h"
+
+// Included so the fleet benchmark can swap the per device state
+#include "services/iot/cloud/reconnect_policy.c"
+
+static void resetPolicy(uint32_t seed)
+{
+    SIM_SystemReset();
+    memset(reconnectStages, 0, sizeof(reconnectStages));
+    RECONNECT_Seed(seed);
+}
+
+static void test_backoff_grows_within_bounds(void)
+{
+    reconnect_stage_stats_t stats;
+    uint32_t                previousMs = 0;
+    int                     i;
+
+    resetPolicy(1);
+    CHECK(RECONNECT_Allowed(RECONNECT_STAGE_TLS));
+    CHECK_EQ(RECONNECT_GetRetryMs(RECONNECT_STAGE_TLS), 1000);
+
+    for (i = 0; i < CFG_RECONNECT_BREAKER_FAILURES - 1; i++)
+    {
+        RECONNECT_Attempt(RECONNECT_STAGE_TLS);
+        RECONNECT_Failure(RECONNECT_STAGE_TLS);
+        RECONNECT_GetStats(RECONNECT_STAGE_TLS, &stats);
+
+        CHECK(stats.backoffMs >= 1000);
+        CHECK(stats.backoffMs <= 3 * ((previousMs < 1000) ? 1000 : previousMs));
+        CHECK(stats.backoffMs <= 120000);
+        CHECK_EQ(stats.breaker, RECONNECT_BREAKER_CLOSED);
+        previousMs = stats.backoffMs;
+
+        CHECK(!RECONNECT_Allowed(RECONNECT_STAGE_TLS));
+        SIM_TimeAdvanceMs(stats.backoffMs - 1);
+        CHECK(!RECONNECT_Allowed(RECONNECT_STAGE_TLS));
+        SIM_TimeAdvanceMs(1);
+        CHECK(RECONNECT_Allowed(RECONNECT_STAGE_TLS));
+    }
+
+    RECONNECT_Success(RECONNECT_STAGE_TLS);
+    RECONNECT_GetStats(RECONNECT_STAGE_TLS, &stats);
+    CHECK_EQ(stats.backoffMs, 0);
+    CHECK_EQ(stats.consecutiveFailures, 0);
+    CHECK_EQ(stats.attempts, CFG_RECONNECT_BREAKER_FAILURES - 1);
+}
+
+static void test_backoff_capped(void)
+{
+    reconnect_stage_stats_t stats;
+    int                     i;
+
+    resetPolicy(2);
+    for (i = 0; i < 200; i++)
+    {
+        RECONNECT_Failure(RECONNECT_STAGE_DNS);
+        RECONNECT_GetStats(RECONNECT_STAGE_DNS, &stats);
+        CHECK(stats.backoffMs <= 60000 || stats.breaker == RECONNECT_BREAKER_OPEN);
+
+        // Keep the breaker closed, only the backoff is under test
+        reconnectStages[RECONNECT_STAGE_DNS].stats.consecutiveFailures = 0;
+    }
+}
+
+static void test_breaker_opens_and_half_opens(void)
+{
+    reconnect_stage_stats_t stats;
+    int                     i;
+
+    resetPolicy(3);
+    for (i = 0; i < CFG_RECONNECT_BREAKER_FAILURES; i++)
+    {
+        RECONNECT_Failure(RECONNECT_STAGE_CONNACK);
+    }
+
+    RECONNECT_GetStats(RECONNECT_STAGE_CONNACK, &stats);
+    CHECK_EQ(stats.breaker, RECONNECT_BREAKER_OPEN);
+    CHECK_EQ(stats.breakerTrips, 1);
+    CHECK(stats.backoffMs >= CFG_RECONNECT_BREAKER_OPEN_MS);
+    CHECK(stats.backoffMs <= CFG_RECONNECT_BREAKER_OPEN_MS * 3 / 2);
+
+    // A reset waits for the open breaker
+    CHECK(RECONNECT_GetResetDelayMs(2000, 4000) >= stats.backoffMs - 1);
+
+    SIM_TimeAdvanceMs(stats.backoffMs);
+    CHECK(RECONNECT_Allowed(RECONNECT_STAGE_CONNACK));
+    RECONNECT_GetStats(RECONNECT_STAGE_CONNACK, &stats);
+    CHECK_EQ(stats.breaker, RECONNECT_BREAKER_HALF_OPEN);
+
+    // The trial attempt fails, the breaker opens again at once
+    RECONNECT_Failure(RECONNECT_STAGE_CONNACK);
+    RECONNECT_GetStats(RECONNECT_STAGE_CONNACK, &stats);
+    CHECK_EQ(stats.breaker, RECONNECT_BREAKER_OPEN);
+    CHECK_EQ(stats.breakerTrips, 2);
+
+    SIM_TimeAdvanceMs(stats.backoffMs);
+    CHECK(RECONNECT_Allowed(RECONNECT_STAGE_CONNACK));
+    RECONNECT_Success(RECONNECT_STAGE_CONNACK);
+    RECONNECT_GetStats(RECONNECT_STAGE_CONNACK, &stats);
+    CHECK_EQ(stats.breaker, RECONNECT_BREAKER_CLOSED);
+}
+
+static void test_dps_does_not_hold_reset(void)
+{
+    uint32_t delayMs;
+
+    resetPolicy(4);
+    RECONNECT_Failure(RECONNECT_STAGE_DPS);
+    CHECK(RECONNECT_GetRetryMs(RECONNECT_STAGE_DPS) >= 120000);
+
+    delayMs = RECONNECT_GetResetDelayMs(2000, 4000);
+    CHECK(delayMs >= 2000 && delayMs <= 6000);
+}
+
+// Fleet benchmark: devices that lost the hub together reconnect against a
+// hub that grants FLEET_CAPACITY CONNACKs per second. The former fixed 2 s
+// retry is compared with the reset delay and CONNACK backoff of the policy.
+#define FLEET_DEVICES  1000
+#define FLEET_CAPACITY 50
+#define FLEET_STEP_MS  10
+#define FLEET_END_MS   (3600UL * 1000UL)
+
+typedef struct
+{
+    reconnect_stage_state_t stages[RECONNECT_STAGE_COUNT];
+    uint32_t                randomState;
+    uint32_t                nextMs;
+    bool                    up;
+} fleet_device_t;
+
+typedef struct
+{
+    uint32_t peakPerSecond;
+    uint32_t attempts;
+    uint32_t allUpMs;
+} fleet_result_t;
+
+static fleet_device_t fleet[FLEET_DEVICES];
+
+static void fleetLoad(int i)
+{
+    memcpy(reconnectStages, fleet[i].stages, sizeof(reconnectStages));
+    reconnectRandomState = fleet[i].randomState;
+}
+
+static void fleetSave(int i)
+{
+    memcpy(fleet[i].stages, reconnectStages, sizeof(reconnectStages));
+    fleet[i].randomState = reconnectRandomState;
+}
+
+static void fleetRun(bool policy, fleet_result_t* result)
+{
+    uint32_t nowMs, second = UINT32_MAX, perSecond = 0, granted = 0, upCount = 0;
+    int      i;
+
+    memset(result, 0, sizeof(*result));
+    memset(fleet, 0, sizeof(fleet));
+    SIM_SystemReset();
+
+    for (i = 0; i < FLEET_DEVICES; i++)
+    {
+        char        id[32];
+        const char* p;
+        uint32_t    seed = 0x811C9DC5UL;
+
+        // Seeded from the device ID as app.c does
+        snprintf(id, sizeof(id), "sn0123%08X", i * 7919);
+        for (p = id; *p != '\0'; p++)
+        {
+            seed = (seed ^ (uint8_t)*p) * 16777619UL;
+        }
+
+        fleetLoad(i);
+        RECONNECT_Seed(seed);
+        fleet[i].nextMs = policy ? RECONNECT_GetResetDelayMs(2000, 4000) : 2000;
+        fleetSave(i);
+    }
+
+    for (nowMs = 0; nowMs < FLEET_END_MS && upCount < FLEET_DEVICES; nowMs += FLEET_STEP_MS)
+    {
+        SIM_TimeAdvanceMs(FLEET_STEP_MS);
+        if (nowMs / 1000 != second)
+        {
+            second    = nowMs / 1000;
+            perSecond = 0;
+            granted   = 0;
+        }
+
+        for (i = 0; i < FLEET_DEVICES; i++)
+        {
+            if (fleet[i].up || fleet[i].nextMs > nowMs)
+            {
+                continue;
+            }
+
+            fleetLoad(i);
+            RECONNECT_Attempt(RECONNECT_STAGE_CONNACK);
+            result->attempts++;
+            if (++perSecond > result->peakPerSecond)
+            {
+                result->peakPerSecond = perSecond;
+            }
+
+            if (granted < FLEET_CAPACITY)
+            {
+                granted++;
+                upCount++;
+                fleet[i].up = true;
+                RECONNECT_Success(RECONNECT_STAGE_CONNACK);
+                result->allUpMs = nowMs;
+            }
+            else
+            {
+                RECONNECT_Failure(RECONNECT_STAGE_CONNACK);
+                fleet[i].nextMs = nowMs + (policy ? RECONNECT_GetResetDelayMs(2000, 4000) : 2000);
+            }
+            fleetSave(i);
+        }
+    }
+
+    printf("  %-20s peak %4lu attempts/s, %6lu attempts, all up after %6.1f s\n", policy ? "reconnect policy" : "fixed 2 s retry",
+           (unsigned long)result->peakPerSecond, (unsigned long)result->attempts, result->allUpMs / 1000.0);
+}
+
+static void test_fleet_reconnect(void)
+{
+    fleet_result_t fixed, policy;
+
+    fleetRun(false, &fixed);
+    fleetRun(true, &policy);
+
+    CHECK(policy.peakPerSecond < fixed.peakPerSecond);
+    CHECK(policy.attempts < fixed.attempts);
+    CHECK(policy.allUpMs < FLEET_END_MS);
+}
+
+int main(void)
+{
+    RUN_TEST(test_backoff_grows_within_bounds);
+    RUN_TEST(test_backoff_capped);
+    RUN_TEST(test_breaker_opens_and_half_opens);
+    RUN_TEST(test_dps_does_not_hold_reset);
+    RUN_TEST(test_fleet_reconnect);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,186 @@
+/*
+    \file   test_sensors.c
+
+    \brief  Host tests of the sensor sampling
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include "host_test.h"
+#include "sim_system.h"
+#include "sensors.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
+
+// One light sensor conversion, as the ADC result ready interrupt
+static void adcResult(uint16_t result)
+{
+    simPeripherals.adcResult = result;
+    simPeripherals.adcCallback(ADC_STATUS_RESRDY, 0);
+}
+
+// Completes the temperature read started by SENSOR_Tasks()
+static void i2cComplete(uint8_t msb, uint8_t lsb, SERCOM_I2C_ERROR error)
+{
+    simPeripherals.i2cError = error;
+    if (simPeripherals.i2cReadBuffer != NULL)
+    {
+        simPeripherals.i2cReadBuffer[0] = msb;
+        simPeripherals.i2cReadBuffer[1] = lsb;
+    }
+    simPeripherals.i2cCallback(0);
+}
+
+static void startSensors(void)
+{
+    SIM_SystemReset();
+    SENSOR_Initialize();
+}
+
+static void test_light_timer_period(void)
+{
+    startSensors();
+    // 1024 Hz TC4 clock
+    CHECK_EQ(simPeripherals.tc4Period, CFG_SENSOR_LIGHT_PERIOD_MS * 1024 / 1000 - 1);
+    CHECK(simPeripherals.adcCallback != NULL);
+}
+
+static void test_light_average(void)
+{
+    sensor_sample_t sample;
+    int32_t         value;
+    int             i;
+
+    startSensors();
+    CHECK(!SENSOR_GetLatest(SENSOR_LIGHT, &sample));
+    CHECK(!SENSOR_GetAverage(SENSOR_LIGHT, 0, &value));
+
+    // Full scale and zero every 100 ms
+    for (i = 0; i < 40; i++)
+    {
+        adcResult((i % 2) ? 4095 : 0);
+        SIM_TimeAdvanceMs(100);
+    }
+
+    CHECK(SENSOR_GetLatest(SENSOR_LIGHT, &sample));
+    CHECK_EQ(sample.value, 1650);
+    CHECK(SENSOR_GetAverage(SENSOR_LIGHT, 0, &value));
+    CHECK_EQ(value, 1650);
+
+    // Samples 100 to 400 ms old, two of each value
+    CHECK(SENSOR_GetAverage(SENSOR_LIGHT, 400, &value));
+    CHECK_EQ(value, 825);
+
+    // Limited to the ring
+    CHECK(SENSOR_GetAverage(SENSOR_LIGHT, 100000, &value));
+    CHECK_EQ(value, 825);
+
+    SIM_TimeAdvanceMs(5000);
+    CHECK(!SENSOR_GetAverage(SENSOR_LIGHT, 400, &value));
+}
+
+static void test_read_samples_cursor(void)
+{
+    sensor_sample_t samples[8];
+    uint32_t        cursor = 0;
+    uint8_t         count;
+    int             i;
+
+    startSensors();
+    for (i = 0; i < 5; i++)
+    {
+        adcResult(i * 819);
+    }
+
+    count = SENSOR_ReadSamples(SENSOR_LIGHT, &cursor, samples, 8);
+    CHECK_EQ(count, 5);
+    CHECK_EQ(cursor, 5);
+    CHECK_EQ(samples[0].value, 0);
+    CHECK_EQ(samples[4].value, 1320);
+    CHECK_EQ(SENSOR_ReadSamples(SENSOR_LIGHT, &cursor, samples, 8), 0);
+
+    // Samples overwritten before they were read are skipped
+    for (i = 0; i < 40; i++)
+    {
+        adcResult(i);
+    }
+    count = SENSOR_ReadSamples(SENSOR_LIGHT, &cursor, samples, 8);
+    CHECK_EQ(count, 8);
+    CHECK_EQ(cursor, 45 - CFG_SENSOR_RING_SIZE + 8);
+    count = SENSOR_ReadSamples(SENSOR_LIGHT, &cursor, samples, 8);
+    CHECK_EQ(count, 8);
+    CHECK_EQ(cursor, 45);
+}
+
+static void test_temperature(void)
+{
+    sensor_sample_t sample;
+    sensor_stats_t  stats;
+
+    startSensors();
+
+    // +25.25 C with the alert flag bits set
+    SENSOR_Tasks();
+    CHECK(simPeripherals.i2cReadBuffer != NULL);
+    i2cComplete(0xC1, 0x94, SERCOM_I2C_ERROR_NONE);
+    CHECK(SENSOR_GetLatest(SENSOR_TEMPERATURE, &sample));
+    CHECK_EQ(sample.value, 25 * 16 + 4);
+
+    // Not due yet, a completion of somebody else's transfer is ignored
+    SENSOR_Tasks();
+    i2cComplete(0x00, 0x00, SERCOM_I2C_ERROR_NONE);
+    SENSOR_GetStats(SENSOR_TEMPERATURE, &stats);
+    CHECK_EQ(stats.samples, 1);
+
+    // -1 C
+    SIM_TimeAdvanceMs(CFG_SENSOR_TEMP_PERIOD_MS);
+    SENSOR_Tasks();
+    i2cComplete(0x1F, 0xF0, SERCOM_I2C_ERROR_NONE);
+    CHECK(SENSOR_GetLatest(SENSOR_TEMPERATURE, &sample));
+    CHECK_EQ(sample.value, -16);
+
+    // A failed read is counted and shown on the red LED
+    SIM_TimeAdvanceMs(CFG_SENSOR_TEMP_PERIOD_MS);
+    SENSOR_Tasks();
+    i2cComplete(0, 0, SERCOM_I2C_ERROR_NAK);
+    SENSOR_Tasks();
+    CHECK_EQ(simPeripherals.ledRed, LED_STATE_BLINK_SLOW);
+
+    // The crypto HAL holds the bus
+    SIM_TimeAdvanceMs(CFG_SENSOR_TEMP_PERIOD_MS);
+    simPeripherals.i2cBusy = true;
+    SENSOR_Tasks();
+    simPeripherals.i2cBusy = false;
+
+    SENSOR_GetStats(SENSOR_TEMPERATURE, &stats);
+    CHECK_EQ(stats.samples, 2);
+    CHECK_EQ(stats.errors, 1);
+    CHECK_EQ(stats.busy, 1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_light_timer_period);
+    RUN_TEST(test_light_average);
+    RUN_TEST(test_read_samples_cursor);
+    RUN_TEST(test_temperature);
+    return HOST_TEST_RESULT();
+}
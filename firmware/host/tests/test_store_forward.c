@@ -0,0 +1,243 @@
+/*
+    \file   test_store_forward.c
+
+    \brief  Host tests of the store-and-forward queue
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <stdlib.h>
+#include "host_test.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
+#include "services/iot/cloud/store_forward.h"
+
+#define TEST_TOPIC        "devices/host-test/messages/events/"
+#define TEST_TOPIC_LENGTH (sizeof(TEST_TOPIC) - 1)
+
+// The store keeps its state in static variables, every test leaves it empty
+static uint16_t testPacketId = 1;
+
+static bool put(const char* payload)
+{
+    return STORE_FORWARD_Put((const uint8_t*)TEST_TOPIC, TEST_TOPIC_LENGTH, (const uint8_t*)payload, (uint16_t)strlen(payload));
+}
+
+static void drain(void)
+{
+    store_forward_message_t message;
+
+    STORE_FORWARD_Requeue();
+    while (STORE_FORWARD_GetNext(&message))
+    {
+        STORE_FORWARD_MarkSent(&message, testPacketId);
+        STORE_FORWARD_Acknowledge(testPacketId++);
+    }
+}
+
+static void test_send_and_acknowledge_in_order(void)
+{
+    store_forward_message_t message;
+    store_forward_stats_t   stats;
+    uint16_t                first, second;
+
+    CHECK(put("first"));
+    CHECK(put("second"));
+
+    CHECK(STORE_FORWARD_GetNext(&message));
+    CHECK_EQ(message.topicLength, TEST_TOPIC_LENGTH);
+    CHECK_MEM(message.topic, TEST_TOPIC, TEST_TOPIC_LENGTH + 1);
+    CHECK_EQ(message.payloadLength, 5);
+    CHECK_MEM(message.payload, "first", 5);
+    first = testPacketId++;
+    STORE_FORWARD_MarkSent(&message, first);
+
+    CHECK(STORE_FORWARD_GetNext(&message));
+    CHECK_MEM(message.payload, "second", 6);
+    second = testPacketId++;
+    STORE_FORWARD_MarkSent(&message, second);
+
+    CHECK(!STORE_FORWARD_GetNext(&message));
+
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.stored, 2);
+    CHECK_EQ(stats.inflight, 2);
+
+    // Out of order PUBACK, the space is reclaimed once the oldest is released
+    STORE_FORWARD_Acknowledge(second);
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.inflight, 1);
+    CHECK(stats.bytesUsed > 0);
+
+    STORE_FORWARD_Acknowledge(first);
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.stored, 0);
+    CHECK_EQ(stats.bytesUsed, 0);
+}
+
+static void test_requeue_after_reconnect(void)
+{
+    store_forward_message_t message;
+    store_forward_stats_t   stats;
+
+    CHECK(put("lost"));
+    CHECK(STORE_FORWARD_GetNext(&message));
+    STORE_FORWARD_MarkSent(&message, testPacketId++);
+    CHECK(!STORE_FORWARD_GetNext(&message));
+
+    STORE_FORWARD_Requeue();
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.inflight, 0);
+    CHECK(STORE_FORWARD_GetNext(&message));
+    CHECK_MEM(message.payload, "lost", 4);
+
+    // A PUBACK for the old packet id does not release the requeued message
+    STORE_FORWARD_Acknowledge(testPacketId - 1);
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.stored, 1);
+
+    drain();
+}
+
+static void test_retry_not_delivered(void)
+{
+    store_forward_message_t message;
+    store_forward_stats_t   stats;
+    uint16_t                packetId;
+
+    CHECK(put("retry"));
+    CHECK(STORE_FORWARD_GetNext(&message));
+    packetId = testPacketId++;
+    STORE_FORWARD_MarkSent(&message, packetId);
+
+    // Only the message sent with that packet id is sent again
+    STORE_FORWARD_Retry(packetId + 1);
+    CHECK(!STORE_FORWARD_GetNext(&message));
+
+    STORE_FORWARD_Retry(packetId);
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.inflight, 0);
+    CHECK(STORE_FORWARD_GetNext(&message));
+    CHECK_MEM(message.payload, "retry", 5);
+
+    drain();
+}
+
+static void test_full_drops_oldest(void)
+{
+    store_forward_message_t message;
+    store_forward_stats_t   stats;
+    char                    payload[64];
+    uint32_t                dropsBefore;
+    int                     i;
+
+    STORE_FORWARD_GetStats(&stats);
+    dropsBefore = stats.dropCount;
+
+    for (i = 0; i < CFG_STORE_FORWARD_BUFFER_SIZE / 32; i++)
+    {
+        snprintf(payload, sizeof(payload), "message %d", i);
+        CHECK(put(payload));
+    }
+
+    STORE_FORWARD_GetStats(&stats);
+    CHECK(stats.dropCount > dropsBefore);
+    CHECK(stats.bytesUsed <= CFG_STORE_FORWARD_BUFFER_SIZE);
+    CHECK_EQ(stats.highWater <= CFG_STORE_FORWARD_BUFFER_SIZE, 1);
+
+    // The newest messages are kept
+    CHECK(STORE_FORWARD_GetNext(&message));
+    snprintf(payload, sizeof(payload), "message %lu", (unsigned long)(i - stats.stored));
+    CHECK_EQ(message.payloadLength, strlen(payload));
+    CHECK_MEM(message.payload, payload, message.payloadLength);
+
+    drain();
+}
+
+static void test_too_large(void)
+{
+    static uint8_t payload[CFG_STORE_FORWARD_BUFFER_SIZE];
+
+    CHECK(!STORE_FORWARD_Put((const uint8_t*)TEST_TOPIC, TEST_TOPIC_LENGTH, payload, sizeof(payload)));
+    CHECK(!STORE_FORWARD_Put((const uint8_t*)TEST_TOPIC, 0, payload, 1));
+}
+
+// Random mix of puts, sends, PUBACKs and reconnects checked for consistency
+static void test_random_stress(void)
+{
+    store_forward_message_t message;
+    store_forward_stats_t   stats;
+    char                    payload[96];
+    unsigned                errors = 0;
+    int                     i;
+
+    srand(7);
+
+    for (i = 0; i < 20000; i++)
+    {
+        snprintf(payload, sizeof(payload), "payload-%d-%.*s", i, rand() % 60,
+                 "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+        errors += !put(payload);
+
+        if (i % 3 == 0)
+        {
+            while (STORE_FORWARD_GetNext(&message))
+            {
+                errors += (memcmp(message.topic, TEST_TOPIC, TEST_TOPIC_LENGTH + 1) != 0);
+                errors += (memcmp(message.payload, "payload-", 8) != 0);
+                STORE_FORWARD_MarkSent(&message, testPacketId++);
+            }
+        }
+
+        if (i % 11 == 0)
+        {
+            STORE_FORWARD_Requeue();
+        }
+
+        if (i % 2 == 0)
+        {
+            STORE_FORWARD_Acknowledge(testPacketId - 1);
+            STORE_FORWARD_Acknowledge(testPacketId - 2 - rand() % 4);
+        }
+
+        STORE_FORWARD_GetStats(&stats);
+        errors += (stats.bytesUsed > CFG_STORE_FORWARD_BUFFER_SIZE);
+        errors += (stats.inflight > stats.stored);
+    }
+
+    CHECK_EQ(errors, 0);
+
+    drain();
+    STORE_FORWARD_GetStats(&stats);
+    CHECK_EQ(stats.stored, 0);
+    CHECK_EQ(stats.bytesUsed, 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_send_and_acknowledge_in_order);
+    RUN_TEST(test_requeue_after_reconnect);
+    RUN_TEST(test_retry_not_delivered);
+    RUN_TEST(test_full_drops_oldest);
+    RUN_TEST(test_too_large);
+    RUN_TEST(test_random_stress);
+    return HOST_TEST_RESULT();
+}
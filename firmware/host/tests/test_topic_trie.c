@@ -0,0 +1,259 @@
+/*
+    \file   test_topic_trie.c
+
+    \brief  Host tests and lookup benchmark of the PUBLISH topic dispatch
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <time.h>
+#include "host_test.h"
+#include "iot_config/mqtt_config.h"
+#include "mqtt/mqtt_packetTransfer_interface.h"
+
+static int handlerHit;
+
+static void handler0(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength)
+{
+    handlerHit = 0;
+}
+
+static void handler1(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength)
+{
+    handlerHit = 1;
+}
+
+static void handler2(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength)
+{
+    handlerHit = 2;
+}
+
+static void handler3(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength)
+{
+    handlerHit = 3;
+}
+
+static void handler4(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength)
+{
+    handlerHit = 4;
+}
+
+// Same filters as the IoT Hub table in cloud_service.c, plus '+' and a
+// literal level that overlaps a wildcard
+static publishReceptionHandler_t handlerTable[MAX_NUM_TOPICS_SUBSCRIBE] = {
+    {(uint8_t*)"$iothub/methods/POST/#", handler0},
+    {(uint8_t*)"$iothub/twin/PATCH/properties/desired/#", handler1},
+    {(uint8_t*)"$iothub/twin/res/#", handler2},
+    {(uint8_t*)"a/+/c", handler3},
+    {(uint8_t*)"a/b/c", handler4},
+};
+
+static int dispatch(const char* topic)
+{
+    publishReceptionHandler_t* handler = MQTT_GetPublishReceptionHandler((uint8_t*)topic, (uint16_t)strlen(topic));
+
+    if (handler == NULL)
+    {
+        return -1;
+    }
+
+    handlerHit = -2;
+    handler->mqttHandlePublishDataCallBack((uint8_t*)topic, (uint16_t)strlen(topic), NULL, 0);
+    return handlerHit;
+}
+
+static void test_iothub_topics(void)
+{
+    CHECK_EQ(dispatch("$iothub/methods/POST/reboot/?$rid=1"), 0);
+    CHECK_EQ(dispatch("$iothub/twin/PATCH/properties/desired/?$version=3"), 1);
+    CHECK_EQ(dispatch("$iothub/twin/res/200/?$rid=2"), 2);
+    CHECK_EQ(dispatch("$iothub/other/x"), -1);
+    CHECK_EQ(dispatch("$iothub/twin/PATCH/properties"), -1);
+}
+
+static void test_multi_level_wildcard_matches_parent(void)
+{
+    // "#" also matches the level it follows
+    CHECK_EQ(dispatch("$iothub/twin/res"), 2);
+}
+
+static void test_single_level_wildcard(void)
+{
+    CHECK_EQ(dispatch("a/x/c"), 3);
+    CHECK_EQ(dispatch("a//c"), 3);
+    CHECK_EQ(dispatch("a/x/c/d"), -1);
+    CHECK_EQ(dispatch("a/x"), -1);
+}
+
+static void test_literal_before_wildcard(void)
+{
+    CHECK_EQ(dispatch("a/b/c"), 4);
+}
+
+static void test_topic_not_terminated(void)
+{
+    // Topics point into the receive buffer, only topicLength bytes count
+    const char* buffer = "a/x/cTRAILING";
+    publishReceptionHandler_t* handler = MQTT_GetPublishReceptionHandler((uint8_t*)buffer, 5);
+
+    CHECK(handler == &handlerTable[3]);
+}
+
+// Lookup benchmark: N filters under $iothub, the received topic matches the
+// last one. The trie is compared with the linear matchTopicSubscribe() scan
+// mqttProcessPublish() ran over the handler table before.
+#define BENCH_LOOKUPS 200000UL
+
+static char benchFilters[MAX_NUM_TOPICS_SUBSCRIBE][32];
+
+static bool matchTopicSubscribe(char* SubTopic, char* publishTopic)
+{
+    while (SubTopic != NULL && publishTopic != NULL)
+    {
+        int   subTopicLen, publishTopicLen;
+        char* endSubTopic     = strchr(SubTopic, '/');
+        char* endPublishTopic = strchr(publishTopic, '/');
+        if (endSubTopic == NULL && endPublishTopic == NULL)
+        {
+            return true;
+        }
+
+        if (endSubTopic == NULL)
+        {
+            subTopicLen = strlen(SubTopic);
+        }
+        else
+        {
+            subTopicLen = endSubTopic - SubTopic;
+        }
+
+        if (endPublishTopic == NULL)
+        {
+            publishTopicLen = strlen(publishTopic);
+        }
+        else
+        {
+            publishTopicLen = endPublishTopic - publishTopic;
+        }
+
+        if (memcmp(SubTopic, "+", 1) == 0 && subTopicLen == 1)
+        {
+            // wildcard
+        }
+        else if (memcmp(SubTopic, "#", 1) == 0 && subTopicLen == 1)
+        {
+            return true;   // end wild card
+        }
+        else if (memcmp(SubTopic, publishTopic, publishTopicLen) != 0 || publishTopicLen != subTopicLen)
+        {
+            break;
+        }
+
+        SubTopic     = endSubTopic + 1;
+        publishTopic = endPublishTopic + 1;
+    }
+
+    return false;
+}
+
+static publishReceptionHandler_t* linearLookup(publishReceptionHandler_t* table, char* topic)
+{
+    uint8_t i;
+
+    for (i = 0; i < MAX_NUM_TOPICS_SUBSCRIBE; i++)
+    {
+        if (table[i].topic != NULL && matchTopicSubscribe((char*)table[i].topic, topic))
+        {
+            return &table[i];
+        }
+    }
+
+    return NULL;
+}
+
+static double benchElapsedNs(const struct timespec* start)
+{
+    struct timespec end;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+static void test_lookup_benchmark(void)
+{
+    publishReceptionHandler_t  table[MAX_NUM_TOPICS_SUBSCRIBE];
+    publishReceptionHandler_t* volatile sink;
+    struct timespec            start;
+    char                       topic[48];
+    unsigned long              n;
+    int                        count;
+
+    for (count = 1; count <= (int)MAX_NUM_TOPICS_SUBSCRIBE; count++)
+    {
+        double trieNs, linearNs;
+        int    i;
+
+        memset(table, 0, sizeof(table));
+        for (i = 0; i < count; i++)
+        {
+            snprintf(benchFilters[i], sizeof(benchFilters[i]), "$iothub/filter%d/res/#", i);
+            table[i].topic                         = (uint8_t*)benchFilters[i];
+            table[i].mqttHandlePublishDataCallBack = handler0;
+        }
+        MQTT_SetPublishReceptionHandlerTable(table);
+        snprintf(topic, sizeof(topic), "$iothub/filter%d/res/200/?$rid=42", count - 1);
+
+        CHECK(MQTT_GetPublishReceptionHandler((uint8_t*)topic, (uint16_t)strlen(topic)) == &table[count - 1]);
+        CHECK(linearLookup(table, topic) == &table[count - 1]);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (n = 0; n < BENCH_LOOKUPS; n++)
+        {
+            sink = MQTT_GetPublishReceptionHandler((uint8_t*)topic, (uint16_t)strlen(topic));
+        }
+        trieNs = benchElapsedNs(&start) / BENCH_LOOKUPS;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (n = 0; n < BENCH_LOOKUPS; n++)
+        {
+            sink = linearLookup(table, topic);
+        }
+        linearNs = benchElapsedNs(&start) / BENCH_LOOKUPS;
+
+        printf("  %d filters: trie %6.1f ns/lookup, linear scan %6.1f ns/lookup\n", count, trieNs, linearNs);
+    }
+
+    MQTT_SetPublishReceptionHandlerTable(handlerTable);
+}
+
+int main(void)
+{
+    MQTT_SetPublishReceptionHandlerTable(handlerTable);
+
+    RUN_TEST(test_iothub_topics);
+    RUN_TEST(test_multi_level_wildcard_matches_parent);
+    RUN_TEST(test_single_level_wildcard);
+    RUN_TEST(test_literal_before_wildcard);
+    RUN_TEST(test_topic_not_terminated);
+    RUN_TEST(test_lookup_benchmark);
+    return HOST_TEST_RESULT();
+}
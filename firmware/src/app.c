@@ -66,6 +66,9 @@
 #include "debug_print.h"
 #include "led.h"
 #include "azutil.h"
+#include "latency_trace.h"
+#include "sensors.h"
+#include "config/SAMD21_WG_IOT/peripheral/sercom/spi_slave/dti.h"
 #include "services/iot/cloud/mqtt_packetPopulation/mqtt_packetPopulate.h"
 #include "services/iot/cloud/mqtt_packetPopulation/mqtt_iothub_packetPopulate.h"
 #include "services/iot/cloud/mqtt_packetPopulation/mqtt_iotprovisioning_packetPopulate.h"
@@ -147,11 +150,15 @@ static DRV_HANDLE wdrvHandle;
 static uint8_t    wifi_mode = WIFI_DEFAULT;
 
 static SYS_TIME_HANDLE App_DataTaskHandle      = SYS_TIME_HANDLE_INVALID;
-volatile bool          App_DataTaskTmrExpired  = false;
+static SYS_TIME_HANDLE App_SampleTaskHandle    = SYS_TIME_HANDLE_INVALID;
 static SYS_TIME_HANDLE App_CloudTaskHandle     = SYS_TIME_HANDLE_INVALID;
-volatile bool          App_CloudTaskTmrExpired = false;
 volatile bool          App_WifiScanPending     = false;
 
+// Pending APP_EVENT bits and the counter value of the first post of each
+static volatile uint32_t App_PendingEvents = 0;
+static volatile uint32_t App_EventPostCount[APP_EVENT_COUNT];
+static APP_EVENT_LATENCY App_EventLatency[APP_EVENT_COUNT];
+
 static time_t     previousTransmissionTime;
 volatile uint32_t telemetryInterval = CFG_DEFAULT_TELEMETRY_INTERVAL_SEC;
 
@@ -202,12 +209,90 @@ const az_span device_model_id_span = AZ_SPAN_LITERAL_FROM_STR(IOT_PLUG_AND_PLAY_
 // *****************************************************************************
 void APP_CloudTaskcb(uintptr_t context)
 {
-    App_CloudTaskTmrExpired = true;
+    APP_PostEvent(APP_EVENT_CLOUD_TIMER);
 }
 
 void APP_DataTaskcb(uintptr_t context)
 {
-    App_DataTaskTmrExpired = true;
+    APP_PostEvent(APP_EVENT_DATA_TIMER);
+}
+
+void APP_SampleTaskcb(uintptr_t context)
+{
+    APP_PostEvent(APP_EVENT_SAMPLE_TIMER);
+}
+
+// Called from the SERCOM5 RX interrupt for every byte received
+static void APP_ConsoleRxcb(SERCOM_USART_EVENT event, uintptr_t context)
+{
+    APP_PostEvent(APP_EVENT_CONSOLE_RX);
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Application Events
+// *****************************************************************************
+// *****************************************************************************
+
+// Safe to call from interrupt handlers
+void APP_PostEvent(APP_EVENT event)
+{
+    uint32_t mask           = 1UL << event;
+    bool     interruptState = SYS_INT_Disable();
+
+    if ((App_PendingEvents & mask) == 0)
+    {
+        App_EventPostCount[event] = SYS_TIME_CounterGet();
+        App_PendingEvents |= mask;
+    }
+    SYS_INT_Restore(interruptState);
+}
+
+bool APP_IsIdle(void)
+{
+    return appData.state == APP_STATE_WDRV_ACTIV && App_PendingEvents == 0 && !App_WifiScanPending;
+}
+
+void APP_GetEventLatency(APP_EVENT event, APP_EVENT_LATENCY* latency)
+{
+    *latency = App_EventLatency[event];
+}
+
+// Atomically take all pending events along with their post times
+static uint32_t APP_TakeEvents(uint32_t* postCount)
+{
+    uint32_t events;
+    bool     interruptState = SYS_INT_Disable();
+
+    events            = App_PendingEvents;
+    App_PendingEvents = 0;
+    memcpy(postCount, (const void*)App_EventPostCount, sizeof(App_EventPostCount));
+    SYS_INT_Restore(interruptState);
+
+    return events;
+}
+
+// Returns true if event was taken and records its post-to-handler latency
+static bool APP_DispatchEvent(uint32_t events, const uint32_t* postCount, APP_EVENT event)
+{
+    APP_EVENT_LATENCY* latency = &App_EventLatency[event];
+    uint32_t           us;
+
+    if ((events & (1UL << event)) == 0)
+    {
+        return false;
+    }
+
+    us              = SYS_TIME_CountToUS(SYS_TIME_CounterGet() - postCount[event]);
+    latency->lastUs = us;
+    latency->totalUs += us;
+    latency->count++;
+    if (us > latency->maxUs)
+    {
+        latency->maxUs = us;
+    }
+
+    return true;
 }
 // *****************************************************************************
 // *****************************************************************************
@@ -236,6 +321,7 @@ void APP_SW0_Handler(void)
     LED_ToggleRed();
     button_press_data.sw0_press_count++;
     button_press_data.flag.sw0 = 1;
+    APP_PostEvent(APP_EVENT_BUTTON);
 }
 
 void APP_SW1_Handler(void)
@@ -243,6 +329,7 @@ void APP_SW1_Handler(void)
     LED_ToggleRed();
     button_press_data.sw1_press_count++;
     button_press_data.flag.sw1 = 1;
+    APP_PostEvent(APP_EVENT_BUTTON);
 }
 
 // *****************************************************************************
@@ -295,10 +382,13 @@ void APP_Initialize(void)
             wifi_mode = WIFI_SOFT_AP;
         }
     }
-    /* Open I2C driver client */
-    ADC_Enable();
+    SENSOR_Initialize();
     LED_test();
     sys_cmd_init();   // CLI init
+    SERCOM5_USART_ReadCallbackRegister(APP_ConsoleRxcb, 0);
+    SERCOM5_USART_ReadThresholdSet(1);
+    SERCOM5_USART_ReadNotificationEnable(true, true);
+    DTI_Initialize();
 
 #if (CFG_APP_WINC_DEBUG == 1)
     WDRV_WINC_DebugRegisterCallback(debug_printer);
@@ -380,6 +470,9 @@ static void APP_DHCPAddressEventCb(DRV_HANDLE handle, uint32_t ipAddress)
     shared_networking_params.haveIpAddress = 1;
     shared_networking_params.haveERROR     = 0;
     shared_networking_params.reported      = 0;
+
+    // Start the host lookup without waiting for the next cloud tick
+    APP_PostEvent(APP_EVENT_SOCKET);
 }
 
 static void APP_ProvisionRespCb(DRV_HANDLE              handle,
@@ -490,7 +583,20 @@ void APP_Tasks(void)
 
 #ifdef CFG_MQTT_PROVISIONING_HOST
             pf_mqtt_iotprovisioning_client.MQTT_CLIENT_task_completed = iot_provisioning_completed;
-            CLOUD_init_host(CFG_MQTT_PROVISIONING_HOST, attDeviceID, &pf_mqtt_iotprovisioning_client);
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+            if (MQTT_CLIENT_iotprovisioning_cachedHub())
+            {
+                // Warm restart : connect to the hub assigned last time, DPS runs
+                // only if that hub cannot be reached
+                pf_mqtt_iothub_client.MQTT_CLIENT_task_completed = iot_connection_completed;
+                CLOUD_init_host(hub_hostname, attDeviceID, &pf_mqtt_iothub_client);
+                CLOUD_setFallbackHost(CFG_MQTT_PROVISIONING_HOST, &pf_mqtt_iotprovisioning_client);
+            }
+            else
+#endif
+            {
+                CLOUD_init_host(CFG_MQTT_PROVISIONING_HOST, attDeviceID, &pf_mqtt_iotprovisioning_client);
+            }
 #else
             CLOUD_init_host(hub_hostname, attDeviceID, &pf_mqtt_iothub_client);
 #endif   // CFG_MQTT_PROVISIONING_HOST
@@ -500,6 +606,10 @@ void APP_Tasks(void)
                 but this also registers the callback for notifications. */
                 WDRV_WINC_IPUseDHCPSet(wdrvHandle, &APP_DHCPAddressEventCb);
 
+                // The cloud tick stays periodic: CLOUD_task() polls deadlines that are not
+                // events, the DNS retry, the reconnect backoff and the WiFi/DHCP flags of the
+                // WINC driver, and MQTT_TransmissionHandler() checks the PUBACK timeouts on
+                // each call. Events only make it run sooner.
                 debug_printGood("  APP: registering APP_CloudTaskcb");
                 App_CloudTaskHandle = SYS_TIME_CallbackRegisterMS(APP_CloudTaskcb, 0, APP_CLOUDTASK_INTERVAL, SYS_TIME_PERIODIC);
                 WDRV_WINC_BSSReconnect(wdrvHandle, &APP_ConnectNotifyCb);
@@ -512,23 +622,62 @@ void APP_Tasks(void)
 
         case APP_STATE_WDRV_ACTIV:
         {
-            if (App_CloudTaskTmrExpired == true)
+            uint32_t postCount[APP_EVENT_COUNT];
+            uint32_t events = APP_TakeEvents(postCount);
+            bool     runCloudTask;
+
+            // Socket activity and queued packets are handled right away
+            // instead of waiting for the next cloud tick
+            runCloudTask = APP_DispatchEvent(events, postCount, APP_EVENT_CLOUD_TIMER);
+            runCloudTask |= APP_DispatchEvent(events, postCount, APP_EVENT_SOCKET);
+            runCloudTask |= APP_DispatchEvent(events, postCount, APP_EVENT_CLOUD_TX);
+
+            // SYS_CMD_Tasks() reads one console byte per pass. While bytes are unread the
+            // event is posted again, so the cloud task also runs after the pass that read
+            // the last byte and ran its command, e.g. reconnect
+            if (APP_DispatchEvent(events, postCount, APP_EVENT_CONSOLE_RX))
+            {
+                runCloudTask = true;
+                if (SYS_CONSOLE_ReadCountGet(SYS_CONSOLE_DEFAULT_INSTANCE) > 0)
+                {
+                    APP_PostEvent(APP_EVENT_CONSOLE_RX);
+                }
+            }
+
+            if (runCloudTask)
             {
-                App_CloudTaskTmrExpired = false;
                 CLOUD_task();
             }
 
-            if (App_DataTaskTmrExpired == true)
+            if (APP_DispatchEvent(events, postCount, APP_EVENT_SAMPLE_TIMER))
+            {
+                // Batched telemetry is captured whether or not it can be sent
+                check_telemetry_sample();
+            }
+
+            if (APP_DispatchEvent(events, postCount, APP_EVENT_DATA_TIMER))
             {
-                App_DataTaskTmrExpired = false;
                 APP_DataTask();
             }
 
+            if (APP_DispatchEvent(events, postCount, APP_EVENT_BUTTON) && CLOUD_isConnected())
+            {
+                check_button_status();
+            }
+
+            if (APP_DispatchEvent(events, postCount, APP_EVENT_DTI))
+            {
+                DTI_Tasks();
+            }
+
             if (App_WifiScanPending)
             {
                 APP_WifiScanTask(wdrvHandle);
             }
 
+            // Resume a sendMsg relay, the console TX interrupts wake the loop as the ring drains
+            check_sendMsg_relay();
+
             CLOUD_sched();
             wifi_sched();
             MQTT_sched();
@@ -550,8 +699,12 @@ static void APP_DataTask(void)
     struct tm sys_time;
     RTC_RTCCTimeGet(&sys_time);
     timeNow = mktime(&sys_time);
-    // Example of how to send data when MQTT is connected every 1 second based on the system clock
-    if (CLOUD_isConnected())
+
+    SENSOR_Tasks();
+
+    // With store-and-forward, telemetry keeps being generated during an outage
+    // and is sent once IoT Hub is connected again
+    if (CLOUD_isConnected() || (CFG_STORE_FORWARD_ENABLE == 1 && iothubConnected))
     {
         // How many seconds since the last time this loop ran?
         int32_t delta = difftime(timeNow, previousTransmissionTime);
@@ -564,6 +717,27 @@ static void APP_DataTask(void)
             APP_SendToCloud();
         }
 
+        if (iothubConnected)
+        {
+            // send queued telemetry samples once the batch is full or old enough
+            check_telemetry_batch();
+
+            // send aggregation window summaries and exceptions
+            check_telemetry_aggregation();
+        }
+    }
+
+    // Diagnostics, button events and reported properties need the connection
+    if (CLOUD_isConnected())
+    {
+        if (iothubConnected)
+        {
+            check_diagnostics_telemetry();
+
+            // publish queued reported properties as one PATCH
+            check_reported_property();
+        }
+
         check_button_status();
 
         if (shared_networking_params.reported == 0)
@@ -604,6 +778,9 @@ static void APP_DataTask(void)
     else
     {
         debug_printWarn("  APP: Not Connected");
+
+        // The response to a PATCH in flight will not come
+        reset_reported_property();
     }
 
     if (shared_networking_params.haveAPConnection)
@@ -643,7 +820,7 @@ static void APP_DataTask(void)
 /**********************************************
  * Command (Direct Method)
  **********************************************/
-void APP_ReceivedFromCloud_methods(uint8_t* topic, uint8_t* payload)
+void APP_ReceivedFromCloud_methods(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len)
 {
     az_result rc;
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
@@ -652,7 +829,7 @@ void APP_ReceivedFromCloud_methods(uint8_t* topic, uint8_t* payload)
     az_iot_hub_client_method_request method_request;
 #endif
 
-    debug_printInfo("  APP: %s() Topic %s Payload %s", __FUNCTION__, topic, payload);
+    TRACE_Point(TRACE_METHOD_RECEIVED);
 
     if (topic == NULL)
     {
@@ -660,7 +837,10 @@ void APP_ReceivedFromCloud_methods(uint8_t* topic, uint8_t* payload)
         return;
     }
 
-    az_span command_topic_span = az_span_create(topic, strlen((char*)topic));
+    debug_printInfo("  APP: %s() Topic %.*s Payload %.*s", __FUNCTION__, topic_len, topic, payload_len, payload);
+
+    az_span command_topic_span   = az_span_create(topic, topic_len);
+    az_span command_payload_span = az_span_create(payload, payload_len);
 
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
     rc = az_iot_pnp_client_commands_parse_received_topic(&pnp_client, command_topic_span, &command_request);
@@ -670,30 +850,30 @@ void APP_ReceivedFromCloud_methods(uint8_t* topic, uint8_t* payload)
 
     if (az_result_succeeded(rc))
     {
-        debug_printTrace("  APP: Command Topic  : %s", az_span_ptr(command_topic_span));
+        debug_printTrace("  APP: Command Topic  : %.*s", topic_len, topic);
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-        debug_printTrace("  APP: Command Name   : %s", az_span_ptr(command_request.command_name));
+        debug_printTrace("  APP: Command Name   : %.*s", az_span_size(command_request.command_name), az_span_ptr(command_request.command_name));
 #else
-        debug_printTrace("  APP: Method Name   : %s", az_span_ptr(method_request.name));
+        debug_printTrace("  APP: Method Name   : %.*s", az_span_size(method_request.name), az_span_ptr(method_request.name));
 #endif
-        debug_printTrace("  APP: Command Payload: %s", (char*)payload);
+        debug_printTrace("  APP: Command Payload: %.*s", payload_len, payload);
 
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-        process_direct_method_command(payload, &command_request);
+        process_direct_method_command(command_payload_span, &command_request);
 #else
-        process_direct_method_command(payload, &method_request);
+        process_direct_method_command(command_payload_span, &method_request);
 #endif
     }
     else
     {
-        debug_printError("  APP: Command from unknown topic: '%s' return code 0x%08x.", az_span_ptr(command_topic_span), rc);
+        debug_printError("  APP: Command from unknown topic: '%.*s' return code 0x%08x.", topic_len, topic, rc);
     }
 }
 
 /**********************************************
  * Properties (Device Twin)
  **********************************************/
-void APP_ReceivedFromCloud_patch(uint8_t* topic, uint8_t* payload)
+void APP_ReceivedFromCloud_patch(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len)
 {
     az_result         rc;
     twin_properties_t twin_properties;
@@ -702,9 +882,11 @@ void APP_ReceivedFromCloud_patch(uint8_t* topic, uint8_t* payload)
 
     twin_properties.flag.is_initial_get = 0;
 
-    debug_printInfo("  APP: %s() Payload %s", __FUNCTION__, payload);
+    debug_printInfo("  APP: %s() Payload %.*s", __FUNCTION__, payload_len, payload);
 
-    if (az_result_failed(rc = process_device_twin_property(topic, payload, &twin_properties)))
+    if (az_result_failed(rc = process_device_twin_property(az_span_create(topic, topic_len),
+                                                           az_span_create(payload, payload_len),
+                                                           &twin_properties)))
     {
         // If the item can't be found, the desired temp might not be set so take no action
         debug_printError("  APP: Could not parse desired property, return code 0x%08x\n", rc);
@@ -734,7 +916,7 @@ void APP_ReceivedFromCloud_patch(uint8_t* topic, uint8_t* payload)
 }
 
 
-void APP_ReceivedFromCloud_twin(uint8_t* topic, uint8_t* payload)
+void APP_ReceivedFromCloud_twin(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len)
 {
     az_result         rc;
     twin_properties_t twin_properties;
@@ -747,9 +929,11 @@ void APP_ReceivedFromCloud_twin(uint8_t* topic, uint8_t* payload)
         return;
     }
 
-    debug_printTrace("  APP: %s() Payload %s", __FUNCTION__, payload);
+    debug_printTrace("  APP: %s() Payload %.*s", __FUNCTION__, payload_len, payload);
 
-    if (az_result_failed(rc = process_device_twin_property(topic, payload, &twin_properties)))
+    if (az_result_failed(rc = process_device_twin_property(az_span_create(topic, topic_len),
+                                                           az_span_create(payload, payload_len),
+                                                           &twin_properties)))
     {
         // If the item can't be found, the desired temp might not be set so take no action
         debug_printError("  APP: Could not parse desired property, return code 0x%08x\n", rc);
@@ -790,44 +974,14 @@ void APP_ReceivedFromCloud_twin(uint8_t* topic, uint8_t* payload)
  **********************************************/
 float APP_GetTempSensorValue(void)
 {
-    float retVal = 0;
-    /* TA: AMBIENT TEMPERATURE REGISTER ADDRESS: 0x5 */
-    uint8_t registerAddr = 0x5;
-    /* Temp sensor read buffer */
-    uint8_t rxBuffer[2];
+    int32_t value;
 
-    while (SERCOM3_I2C_IsBusy() == true)
+    if (!SENSOR_GetAverage(SENSOR_TEMPERATURE, CFG_SENSOR_AVERAGE_MS, &value))
     {
-        /* Wait for the I2C */
+        return 0;
     }
 
-    if (SERCOM3_I2C_WriteRead(0x18, (uint8_t*)&registerAddr, 1, (uint8_t*)rxBuffer, 2) == true)
-    {
-        while (SERCOM3_I2C_IsBusy() == true)
-        {
-            /* Wait for the I2C transfer to complete */
-        }
-
-        /* Transfer complete. Check if the transfer was successful */
-        if (SERCOM3_I2C_ErrorGet() == SERCOM_I2C_ERROR_NONE)
-        {
-            rxBuffer[0] = rxBuffer[0] & 0x1F;   // Clear flag bits
-            if ((rxBuffer[0] & 0x10) == 0x10)
-            {
-                rxBuffer[0] = rxBuffer[0] & 0x0F;   // Clear SIGN
-                retVal      = 256.0 - (rxBuffer[0] * 16.0 + rxBuffer[1] / 16.0);
-            }
-            else
-            {
-                retVal = ((rxBuffer[0] * 16.0) + (rxBuffer[1] / 16.0));
-            }
-        }
-        else
-        {
-            LED_SetRed(LED_STATE_BLINK_SLOW);
-        }
-    }
-    return retVal;
+    return value / 16.0;
 }
 
 /**********************************************
@@ -835,21 +989,14 @@ float APP_GetTempSensorValue(void)
  **********************************************/
 int32_t APP_GetLightSensorValue(void)
 {
-    uint32_t input_voltage = 0;
-    int32_t  retVal        = 0;
-    uint16_t adc_count     = 0;
+    int32_t value;
 
-    while (!ADC_ConversionStatusGet())
+    if (!SENSOR_GetAverage(SENSOR_LIGHT, CFG_SENSOR_AVERAGE_MS, &value))
     {
-        // Obtain result from Light sensor
+        return 0;
     }
 
-    /* Read the ADC result */
-    adc_count     = ADC_ConversionResultGet();
-    input_voltage = adc_count * 1650 / 4095U;
-    retVal        = input_voltage;
-
-    return retVal;
+    return value;
 }
 
 /**********************************************
@@ -873,6 +1020,11 @@ void iot_connection_completed(void)
     LED_SetCloud(LED_INDICATOR_SUCCESS);
 
     App_DataTaskHandle = SYS_TIME_CallbackRegisterMS(APP_DataTaskcb, 0, APP_DATATASK_INTERVAL, SYS_TIME_PERIODIC);
+
+    if (App_SampleTaskHandle == SYS_TIME_HANDLE_INVALID)
+    {
+        App_SampleTaskHandle = SYS_TIME_CallbackRegisterMS(APP_SampleTaskcb, 0, CFG_TELEMETRY_SAMPLE_TICK_MS, SYS_TIME_PERIODIC);
+    }
 }
 
 #ifdef CFG_MQTT_PROVISIONING_HOST
@@ -234,14 +234,42 @@ typedef union
 extern shared_networking_params_t shared_networking_params;
 
 void    iot_connection_completed(void);
-void    APP_ReceivedFromCloud_methods(uint8_t* topic, uint8_t* payload);
-void    APP_ReceivedFromCloud_patch(uint8_t* topic, uint8_t* payload);
-void    APP_ReceivedFromCloud_twin(uint8_t* topic, uint8_t* payload);
+void    APP_ReceivedFromCloud_methods(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len);
+void    APP_ReceivedFromCloud_patch(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len);
+void    APP_ReceivedFromCloud_twin(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len);
 int32_t APP_GetLightSensorValue(void);
 float   APP_GetTempSensorValue(void);
 void    APP_WifiGetStatus(char* buffer);
 void    APP_WifiScan(char* buffer);
 
+// Events posted to APP_Tasks() from callbacks and interrupt handlers.
+// Posting an event that is already pending is coalesced into the pending one.
+typedef enum
+{
+    APP_EVENT_CLOUD_TIMER = 0,   // Periodic cloud state machine tick
+    APP_EVENT_DATA_TIMER,        // Periodic telemetry tick
+    APP_EVENT_SAMPLE_TIMER,      // Telemetry batch sample tick
+    APP_EVENT_SOCKET,            // Socket connect/send/receive or DNS response
+    APP_EVENT_CLOUD_TX,          // MQTT packet queued for transmission
+    APP_EVENT_BUTTON,            // SW0/SW1 pressed
+    APP_EVENT_DTI,               // DTI frame received from the host MCU
+    APP_EVENT_CONSOLE_RX,        // Byte received on the console UART (CLI)
+    APP_EVENT_COUNT
+} APP_EVENT;
+
+// Time from posting an event until its handler ran
+typedef struct
+{
+    uint32_t count;
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+} APP_EVENT_LATENCY;
+
+void APP_PostEvent(APP_EVENT event);
+bool APP_IsIdle(void);
+void APP_GetEventLatency(APP_EVENT event, APP_EVENT_LATENCY* latency);
+
 #endif /* _APP_H */
 
 // DOM-IGNORE-BEGIN
@@ -1,10 +1,12 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 // SPDX-License-Identifier: MIT
 
+#include <math.h>
 #include "azutil.h"
+#include "latency_trace.h"
+#include "sensors.h"
 #include "nmdrv.h"
 #include "config/SAMD21_WG_IOT/peripheral/sercom/spi_slave/dti.h"
-#include "config/SAMD21_WG_IOT/peripheral/sercom/usart/plib_sercom5_usart.h"
 
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
 extern az_iot_pnp_client pnp_client;
@@ -20,8 +22,6 @@ extern led_status_t led_status;
 
 extern uint16_t packet_identifier;
 
-extern uint16_t DTI_bufferPtr;
-
 userdata_status_t userdata_status;
 
 static char pnp_telemetry_topic_buffer[128];
@@ -29,10 +29,10 @@ static char pnp_telemetry_payload_buffer[128];
 
 // use another set of buffers in case two telemetry collides
 static char pnp_uart_telemetry_topic_buffer[128];
-static char pnp_uart_telemetry_payload_buffer[128 + DTI_PAYLOADDATA_NUMBYTES];
+static char pnp_uart_telemetry_payload_buffer[384 + DTI_PAYLOADDATA_NUMBYTES];
 
 static char pnp_property_topic_buffer[128];
-static char pnp_property_payload_buffer[512];
+static char pnp_property_payload_buffer[1024];
 
 static char command_topic_buffer[128];
 static char command_resp_buffer[128];
@@ -60,6 +60,39 @@ static const az_span telemetry_name_string_4   = AZ_SPAN_LITERAL_FROM_STR("telem
 // Telemetry Interval writable property
 static const az_span property_telemetry_interval_span = AZ_SPAN_LITERAL_FROM_STR("telemetryInterval");
 
+// Telemetry batching writable properties
+static const az_span property_telemetry_batch_size_span  = AZ_SPAN_LITERAL_FROM_STR("telemetryBatchSize");
+static const az_span property_telemetry_batch_flush_span  = AZ_SPAN_LITERAL_FROM_STR("telemetryBatchFlushMs");
+static const az_span property_telemetry_batch_sample_span = AZ_SPAN_LITERAL_FROM_STR("telemetryBatchSampleMs");
+static const az_span telemetry_name_timestamp_span        = AZ_SPAN_LITERAL_FROM_STR("ts");
+
+#if (CFG_TELEMETRY_RING_SIZE & (CFG_TELEMETRY_RING_SIZE - 1)) != 0 || CFG_TELEMETRY_RING_SIZE < CFG_TELEMETRY_BATCH_MAX_SAMPLES
+#error "CFG_TELEMETRY_RING_SIZE must be a power of two of at least CFG_TELEMETRY_BATCH_MAX_SAMPLES"
+#endif
+
+typedef struct
+{
+    uint32_t offset_ms;   // Time since telemetry_batch_start_counter
+    int32_t  light;
+    int16_t  temperature;
+} telemetry_sample_t;
+
+static uint32_t           telemetry_batch_size      = CFG_DEFAULT_TELEMETRY_BATCH_SIZE;
+static uint32_t           telemetry_batch_flush_ms  = CFG_DEFAULT_TELEMETRY_BATCH_FLUSH_MS;
+static uint32_t           telemetry_batch_sample_ms = CFG_DEFAULT_TELEMETRY_BATCH_SAMPLE_MS;
+static telemetry_sample_t telemetry_batch[CFG_TELEMETRY_RING_SIZE];   // Ring of captured samples
+static uint8_t            telemetry_batch_head         = 0;           // Oldest sample
+static uint8_t            telemetry_batch_count        = 0;
+static uint32_t           telemetry_batch_dropped      = 0;
+static time_t             telemetry_batch_start_time;                 // RTC time when the ring was last empty
+static uint64_t           telemetry_batch_start_counter;
+static uint64_t           telemetry_sample_due_counter = 0;           // Next capture, 0 while not sampling
+static char               pnp_telemetry_batch_payload_buffer[2 + CFG_TELEMETRY_BATCH_MAX_SAMPLES * 64];
+
+// Direct method latency diagnostics
+static char     pnp_diagnostics_payload_buffer[32 + TRACE_STAGE_COUNT * 48];
+static uint64_t diagnostics_last_counter = 0;
+
 // Button Press
 button_press_data_t button_press_data = {0};
 static char         button_event_buffer[128];
@@ -97,6 +130,71 @@ static const az_span fw_version_property_name_span = AZ_SPAN_LITERAL_FROM_STR("f
 static const az_span disable_telemetry_name_span = AZ_SPAN_LITERAL_FROM_STR("disableTelemetry");
 static uint32_t telemetry_disable_flag = 0;
 
+// Telemetry encoding writable property
+static const az_span property_telemetry_encoding_span = AZ_SPAN_LITERAL_FROM_STR("telemetryEncoding");
+static uint32_t      telemetry_encoding               = CFG_DEFAULT_TELEMETRY_ENCODING;
+#define TELEMETRY_ENCODING_JSON 0
+#define TELEMETRY_ENCODING_CBOR 1
+static char          telemetry_properties_buffer[32];
+
+// Telemetry aggregation writable properties
+static const az_span property_telemetry_window_span     = AZ_SPAN_LITERAL_FROM_STR("telemetryWindowSec");
+static const az_span property_light_deadband_span       = AZ_SPAN_LITERAL_FROM_STR("lightDeadband");
+static const az_span property_light_high_span           = AZ_SPAN_LITERAL_FROM_STR("lightHigh");
+static const az_span property_light_low_span            = AZ_SPAN_LITERAL_FROM_STR("lightLow");
+static const az_span property_temperature_deadband_span = AZ_SPAN_LITERAL_FROM_STR("temperatureDeadband");
+static const az_span property_temperature_high_span     = AZ_SPAN_LITERAL_FROM_STR("temperatureHigh");
+static const az_span property_temperature_low_span      = AZ_SPAN_LITERAL_FROM_STR("temperatureLow");
+static const az_span telemetry_name_window_span         = AZ_SPAN_LITERAL_FROM_STR("windowSec");
+
+typedef struct
+{
+    uint32_t deadband;   // 0 = no deadband reports
+    int32_t  high;       // Thresholds, off while high <= low
+    int32_t  low;
+} telemetry_limits_t;
+
+typedef struct
+{
+    az_span             name_span;
+    sensor_id_t         sensor;
+    uint32_t            disable_flag;   // DISABLE_xxx
+    double              scale;          // Sensor units per telemetry unit
+    telemetry_limits_t* limits;
+} telemetry_channel_t;
+
+typedef struct
+{
+    uint32_t    cursor;          // SENSOR_ReadSamples() position
+    uint32_t    count;           // Samples in the current window
+    double      mean;
+    double      m2;              // Sum of squared differences from the mean
+    double      min;
+    double      max;
+    double      reference;       // Value of the last message sent, or the first sample
+    bool        has_reference;
+    int8_t      zone;            // -1 below low, 0 in range, 1 above high
+    const char* alert;           // Exception to send, NULL if none
+    double      alert_value;
+    bool        alert_due;       // alert goes into the next exception message
+    bool        alerted;         // alert_counter is valid
+    uint64_t    alert_counter;   // When the last exception was sent
+} telemetry_aggregate_t;
+
+static uint32_t           telemetry_window_sec = CFG_DEFAULT_TELEMETRY_WINDOW_SEC;
+static telemetry_limits_t telemetry_light_limits;
+static telemetry_limits_t telemetry_temperature_limits;
+
+static const telemetry_channel_t telemetry_channels[SENSOR_COUNT] = {
+    {telemetry_name_light_span, SENSOR_LIGHT, DISABLE_LIGHT, 1.0, &telemetry_light_limits},
+    {telemetry_name_temperature_span, SENSOR_TEMPERATURE, DISABLE_TEMPERATURE, 16.0, &telemetry_temperature_limits},
+};
+
+static telemetry_aggregate_t telemetry_aggregates[SENSOR_COUNT];
+static uint64_t              telemetry_window_start_counter;
+static bool                  telemetry_window_started = false;
+static char                  pnp_telemetry_aggregate_payload_buffer[32 + SENSOR_COUNT * 192];
+
 static const az_span resp_success_span                     = AZ_SPAN_LITERAL_FROM_STR("Success");
 
 // Command
@@ -111,7 +209,12 @@ static const az_span command_resp_not_supported_span       = AZ_SPAN_LITERAL_FRO
 static const az_span command_name_sendMsg_span               = AZ_SPAN_LITERAL_FROM_STR("sendMsg");
 static const az_span command_sendMsg_payload_span            = AZ_SPAN_LITERAL_FROM_STR("sendMsgString");
 static const az_span command_resp_empty_sendMsg_payload_span = AZ_SPAN_LITERAL_FROM_STR("Message string is empty. Specify string.");
-static const az_span command_resp_alloc_error_sendMsg_span   = AZ_SPAN_LITERAL_FROM_STR("Failed to allocate memory for the message.");
+static const az_span command_resp_busy_sendMsg_span          = AZ_SPAN_LITERAL_FROM_STR("Host UART busy with the previous message.");
+static const az_span command_resp_long_sendMsg_payload_span  = AZ_SPAN_LITERAL_FROM_STR("Message string is too long.");
+static const az_span command_sendMsg_queued_span             = AZ_SPAN_LITERAL_FROM_STR("queued");
+static const az_span command_sendMsg_relayed_span            = AZ_SPAN_LITERAL_FROM_STR("relayed");
+static const az_span command_sendMsg_stalls_span             = AZ_SPAN_LITERAL_FROM_STR("stalls");
+static const az_span command_sendMsg_wait_span               = AZ_SPAN_LITERAL_FROM_STR("waitMs");
 
 static SYS_TIME_HANDLE reboot_task_handle = SYS_TIME_HANDLE_INVALID;
 
@@ -120,7 +223,7 @@ static SYS_TIME_HANDLE reboot_task_handle = SYS_TIME_HANDLE_INVALID;
 **********************************************/
 void init_twin_data(twin_properties_t* twin_properties)
 {
-    twin_properties->flag.as_uint16     = LED_FLAG_EMPTY;
+    twin_properties->flag.as_uint32     = LED_FLAG_EMPTY;
     twin_properties->version_num        = 0;
     twin_properties->desired_led_yellow = LED_TWIN_NO_CHANGE;
     twin_properties->reported_led_red   = LED_TWIN_NO_CHANGE;
@@ -132,7 +235,6 @@ void init_twin_data(twin_properties_t* twin_properties)
     twin_properties->app_property_2     = 0;
     twin_properties->app_property_3     = 0;
     twin_properties->app_property_4     = 0;
-    twin_properties->telemetry_disable_flag = 0;
 }
 
 /**************************************
@@ -269,29 +371,377 @@ static az_result append_reported_property_response_int32(
 }
 #endif
 /**********************************************
-* Build sensor telemetry JSON
+* Telemetry encoders
+* Telemetry payloads are written through a telemetry_writer_t so the
+* same builder emits either JSON or CBOR (RFC 8949).
+* CBOR maps and arrays use indefinite length so entries need not be
+* counted up front.
+**********************************************/
+#define CBOR_MAJOR_UNSIGNED   0x00
+#define CBOR_MAJOR_NEGATIVE   0x20
+#define CBOR_MAJOR_TEXT       0x60
+#define CBOR_MAJOR_ARRAY      0x80
+#define CBOR_MAJOR_MAP        0xA0
+#define CBOR_INDEFINITE       0x1F
+#define CBOR_FALSE            0xF4
+#define CBOR_TRUE             0xF5
+#define CBOR_FLOAT32          0xFA
+#define CBOR_FLOAT64          0xFB
+#define CBOR_BREAK            0xFF
+
+typedef struct
+{
+    uint8_t* buffer;
+    int32_t  size;
+    int32_t  used;
+} cbor_writer_t;
+
+typedef struct telemetry_writer telemetry_writer_t;
+
+typedef struct
+{
+    az_span content_type;   // URL encoded $.ct value, empty for the IoT Hub default (JSON)
+    az_result (*begin_object)(telemetry_writer_t* tw);
+    az_result (*end_object)(telemetry_writer_t* tw);
+    az_result (*begin_array)(telemetry_writer_t* tw);
+    az_result (*end_array)(telemetry_writer_t* tw);
+    az_result (*append_int32)(telemetry_writer_t* tw, az_span name_span, int32_t value);
+    az_result (*append_long)(telemetry_writer_t* tw, az_span name_span, int64_t value);
+    az_result (*append_double)(telemetry_writer_t* tw, az_span name_span, double value);
+    az_result (*append_bool)(telemetry_writer_t* tw, az_span name_span, bool value);
+    az_result (*append_string)(telemetry_writer_t* tw, az_span name_span, az_span value_span);
+    az_span (*get_payload)(telemetry_writer_t* tw);
+} telemetry_encoder_t;
+
+struct telemetry_writer
+{
+    const telemetry_encoder_t* encoder;
+    union
+    {
+        az_json_writer json;
+        cbor_writer_t  cbor;
+    };
+};
+
+static az_result json_encoder_begin_object(telemetry_writer_t* tw)
+{
+    return az_json_writer_append_begin_object(&tw->json);
+}
+
+static az_result json_encoder_end_object(telemetry_writer_t* tw)
+{
+    return end_json_object(&tw->json);
+}
+
+static az_result json_encoder_begin_array(telemetry_writer_t* tw)
+{
+    return az_json_writer_append_begin_array(&tw->json);
+}
+
+static az_result json_encoder_end_array(telemetry_writer_t* tw)
+{
+    return az_json_writer_append_end_array(&tw->json);
+}
+
+static az_result json_encoder_append_int32(telemetry_writer_t* tw, az_span name_span, int32_t value)
+{
+    return append_json_property_int32(&tw->json, name_span, value);
+}
+
+static az_result json_encoder_append_long(telemetry_writer_t* tw, az_span name_span, int64_t value)
+{
+    return append_json_property_long(&tw->json, name_span, value);
+}
+
+static az_result json_encoder_append_double(telemetry_writer_t* tw, az_span name_span, double value)
+{
+    return append_json_property_double(&tw->json, name_span, value);
+}
+
+static az_result json_encoder_append_bool(telemetry_writer_t* tw, az_span name_span, bool value)
+{
+    return append_json_property_bool(&tw->json, name_span, value);
+}
+
+static az_result json_encoder_append_string(telemetry_writer_t* tw, az_span name_span, az_span value_span)
+{
+    return append_json_property_string(&tw->json, name_span, value_span);
+}
+
+static az_span json_encoder_get_payload(telemetry_writer_t* tw)
+{
+    return az_json_writer_get_bytes_used_in_destination(&tw->json);
+}
+
+static az_result cbor_append_bytes(cbor_writer_t* cw, const uint8_t* data, int32_t length)
+{
+    if (cw->used + length > cw->size)
+    {
+        return AZ_ERROR_NOT_ENOUGH_SPACE;
+    }
+
+    memcpy(&cw->buffer[cw->used], data, length);
+    cw->used += length;
+    return AZ_OK;
+}
+
+/**********************************************
+* Write an initial byte followed by a big endian
+* argument of length bytes
+**********************************************/
+static az_result cbor_append_argument(cbor_writer_t* cw, uint8_t initial_byte, uint64_t value, int32_t length)
+{
+    uint8_t head[9];
+    int32_t i;
+
+    head[0] = initial_byte;
+
+    for (i = length; i > 0; i--)
+    {
+        head[i] = (uint8_t)value;
+        value >>= 8;
+    }
+
+    return cbor_append_bytes(cw, head, length + 1);
+}
+
+/**********************************************
+* Write a CBOR data item head using the
+* shortest argument encoding for the value
+**********************************************/
+static az_result cbor_append_head(cbor_writer_t* cw, uint8_t major_type, uint64_t value)
+{
+    if (value < 24)
+    {
+        return cbor_append_argument(cw, major_type | (uint8_t)value, 0, 0);
+    }
+    else if (value <= 0xFF)
+    {
+        return cbor_append_argument(cw, major_type | 24, value, 1);
+    }
+    else if (value <= 0xFFFF)
+    {
+        return cbor_append_argument(cw, major_type | 25, value, 2);
+    }
+    else if (value <= 0xFFFFFFFF)
+    {
+        return cbor_append_argument(cw, major_type | 26, value, 4);
+    }
+
+    return cbor_append_argument(cw, major_type | 27, value, 8);
+}
+
+static az_result cbor_append_text(cbor_writer_t* cw, az_span text_span)
+{
+    RETURN_ERR_IF_FAILED(cbor_append_head(cw, CBOR_MAJOR_TEXT, (uint64_t)az_span_size(text_span)));
+    return cbor_append_bytes(cw, az_span_ptr(text_span), az_span_size(text_span));
+}
+
+static az_result cbor_append_integer(cbor_writer_t* cw, int64_t value)
+{
+    if (value < 0)
+    {
+        return cbor_append_head(cw, CBOR_MAJOR_NEGATIVE, (uint64_t)(-(value + 1)));
+    }
+    return cbor_append_head(cw, CBOR_MAJOR_UNSIGNED, (uint64_t)value);
+}
+
+static az_result cbor_append_byte(cbor_writer_t* cw, uint8_t data)
+{
+    return cbor_append_bytes(cw, &data, 1);
+}
+
+static az_result cbor_encoder_begin_object(telemetry_writer_t* tw)
+{
+    return cbor_append_byte(&tw->cbor, CBOR_MAJOR_MAP | CBOR_INDEFINITE);
+}
+
+static az_result cbor_encoder_begin_array(telemetry_writer_t* tw)
+{
+    return cbor_append_byte(&tw->cbor, CBOR_MAJOR_ARRAY | CBOR_INDEFINITE);
+}
+
+static az_result cbor_encoder_end(telemetry_writer_t* tw)
+{
+    return cbor_append_byte(&tw->cbor, CBOR_BREAK);
+}
+
+static az_result cbor_encoder_append_long(telemetry_writer_t* tw, az_span name_span, int64_t value)
+{
+    RETURN_ERR_IF_FAILED(cbor_append_text(&tw->cbor, name_span));
+    return cbor_append_integer(&tw->cbor, value);
+}
+
+static az_result cbor_encoder_append_int32(telemetry_writer_t* tw, az_span name_span, int32_t value)
+{
+    return cbor_encoder_append_long(tw, name_span, value);
+}
+
+/**********************************************
+* Doubles which survive a round trip through
+* float are sent as 4 byte single precision
+**********************************************/
+static az_result cbor_encoder_append_double(telemetry_writer_t* tw, az_span name_span, double value)
+{
+    float    value_f = (float)value;
+    uint32_t bits_f;
+    uint64_t bits;
+
+    RETURN_ERR_IF_FAILED(cbor_append_text(&tw->cbor, name_span));
+
+    if ((double)value_f == value)
+    {
+        memcpy(&bits_f, &value_f, sizeof(bits_f));
+        return cbor_append_argument(&tw->cbor, CBOR_FLOAT32, bits_f, sizeof(bits_f));
+    }
+
+    memcpy(&bits, &value, sizeof(bits));
+    return cbor_append_argument(&tw->cbor, CBOR_FLOAT64, bits, sizeof(bits));
+}
+
+static az_result cbor_encoder_append_bool(telemetry_writer_t* tw, az_span name_span, bool value)
+{
+    RETURN_ERR_IF_FAILED(cbor_append_text(&tw->cbor, name_span));
+    return cbor_append_byte(&tw->cbor, value ? CBOR_TRUE : CBOR_FALSE);
+}
+
+static az_result cbor_encoder_append_string(telemetry_writer_t* tw, az_span name_span, az_span value_span)
+{
+    RETURN_ERR_IF_FAILED(cbor_append_text(&tw->cbor, name_span));
+    return cbor_append_text(&tw->cbor, value_span);
+}
+
+static az_span cbor_encoder_get_payload(telemetry_writer_t* tw)
+{
+    return az_span_create(tw->cbor.buffer, tw->cbor.used);
+}
+
+static const telemetry_encoder_t json_telemetry_encoder = {
+    .content_type  = AZ_SPAN_LITERAL_FROM_STR(""),
+    .begin_object  = json_encoder_begin_object,
+    .end_object    = json_encoder_end_object,
+    .begin_array   = json_encoder_begin_array,
+    .end_array     = json_encoder_end_array,
+    .append_int32  = json_encoder_append_int32,
+    .append_long   = json_encoder_append_long,
+    .append_double = json_encoder_append_double,
+    .append_bool   = json_encoder_append_bool,
+    .append_string = json_encoder_append_string,
+    .get_payload   = json_encoder_get_payload,
+};
+
+static const telemetry_encoder_t cbor_telemetry_encoder = {
+    .content_type  = AZ_SPAN_LITERAL_FROM_STR("application%2Fcbor"),
+    .begin_object  = cbor_encoder_begin_object,
+    .end_object    = cbor_encoder_end,
+    .begin_array   = cbor_encoder_begin_array,
+    .end_array     = cbor_encoder_end,
+    .append_int32  = cbor_encoder_append_int32,
+    .append_long   = cbor_encoder_append_long,
+    .append_double = cbor_encoder_append_double,
+    .append_bool   = cbor_encoder_append_bool,
+    .append_string = cbor_encoder_append_string,
+    .get_payload   = cbor_encoder_get_payload,
+};
+
+/**********************************************
+* Initialize a telemetry writer with the
+* currently selected encoding.
+* Nothing is written until begin_object/begin_array.
+**********************************************/
+static az_result telemetry_writer_init(
+    telemetry_writer_t* tw,
+    az_span             buffer_span)
+{
+    if (telemetry_encoding == TELEMETRY_ENCODING_CBOR)
+    {
+        tw->encoder     = &cbor_telemetry_encoder;
+        tw->cbor.buffer = az_span_ptr(buffer_span);
+        tw->cbor.size   = az_span_size(buffer_span);
+        tw->cbor.used   = 0;
+        return AZ_OK;
+    }
+
+    tw->encoder = &json_telemetry_encoder;
+    return az_json_writer_init(&tw->json, buffer_span, NULL);
+}
+
+/**********************************************
+* Publish a telemetry payload built by tw.
+* Non-JSON payloads carry their content type
+* as a $.ct message property on the topic.
+**********************************************/
+static az_result publish_telemetry_payload(
+    telemetry_writer_t* tw,
+    char*               topic_buffer,
+    size_t              topic_buffer_size)
+{
+    az_result                  rc;
+    az_iot_message_properties  properties;
+    az_iot_message_properties* properties_ptr = NULL;
+    az_span                    payload_span   = tw->encoder->get_payload(tw);
+
+    if (az_span_size(tw->encoder->content_type) > 0)
+    {
+        RETURN_ERR_IF_FAILED(az_iot_message_properties_init(&properties, AZ_SPAN_FROM_BUFFER(telemetry_properties_buffer), 0));
+        RETURN_ERR_IF_FAILED(az_iot_message_properties_append(&properties,
+                                                              AZ_SPAN_FROM_STR(AZ_IOT_MESSAGE_PROPERTIES_CONTENT_TYPE),
+                                                              tw->encoder->content_type));
+        properties_ptr = &properties;
+        debug_printGood("AZURE: Telemetry %.*s (%d bytes)",
+                        az_span_size(tw->encoder->content_type),
+                        az_span_ptr(tw->encoder->content_type),
+                        az_span_size(payload_span));
+    }
+    else
+    {
+        debug_printGood("AZURE: %.*s", az_span_size(payload_span), az_span_ptr(payload_span));
+    }
+
+#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
+    rc = az_iot_pnp_client_telemetry_get_publish_topic(&pnp_client,
+                                                       AZ_SPAN_EMPTY,
+#else
+    rc = az_iot_hub_client_telemetry_get_publish_topic(&iothub_client,
+#endif
+                                                       properties_ptr,
+                                                       topic_buffer,
+                                                       topic_buffer_size,
+                                                       NULL);
+
+    if (az_result_succeeded(rc))
+    {
+        CLOUD_publishTelemetry((uint8_t*)topic_buffer,
+                               az_span_ptr(payload_span),
+                               az_span_size(payload_span));
+    }
+
+    return rc;
+}
+
+/**********************************************
+* Build sensor telemetry with the selected encoder
 **********************************************/
 az_result build_sensor_telemetry_message(
-    az_span* out_payload_span,
-    int32_t  temperature,
-    int32_t  light)
+    telemetry_writer_t* tw,
+    int32_t             temperature,
+    int32_t             light)
 {
-    az_json_writer jw;
     memset(&pnp_telemetry_payload_buffer, 0, sizeof(pnp_telemetry_payload_buffer));
-    RETURN_ERR_IF_FAILED(start_json_object(&jw, AZ_SPAN_FROM_BUFFER(pnp_telemetry_payload_buffer)));
+    RETURN_ERR_IF_FAILED(telemetry_writer_init(tw, AZ_SPAN_FROM_BUFFER(pnp_telemetry_payload_buffer)));
+    RETURN_ERR_IF_FAILED(tw->encoder->begin_object(tw));
 
     if ((telemetry_disable_flag & DISABLE_LIGHT) == 0)
     {
-        RETURN_ERR_IF_FAILED(append_json_property_int32(&jw, telemetry_name_light_span, light));
+        RETURN_ERR_IF_FAILED(tw->encoder->append_int32(tw, telemetry_name_light_span, light));
     }
 
     if ((telemetry_disable_flag & DISABLE_TEMPERATURE) == 0)
     {
-        RETURN_ERR_IF_FAILED(append_json_property_int32(&jw, telemetry_name_temperature_span, temperature));
+        RETURN_ERR_IF_FAILED(tw->encoder->append_int32(tw, telemetry_name_temperature_span, temperature));
     }
 
-    RETURN_ERR_IF_FAILED(end_json_object(&jw));
-    *out_payload_span = az_json_writer_get_bytes_used_in_destination(&jw);
+    RETURN_ERR_IF_FAILED(tw->encoder->end_object(tw));
     return AZ_OK;
 }
 
@@ -454,32 +904,142 @@ void check_button_status(void)
 
     if (az_result_succeeded(rc))
     {
-        CLOUD_publishData((uint8_t*)pnp_telemetry_topic_buffer,
-                          az_span_ptr(button_event_payload_span),
-                          az_span_size(button_event_payload_span),
-                          1);
+        CLOUD_publishTelemetry((uint8_t*)pnp_telemetry_topic_buffer,
+                               az_span_ptr(button_event_payload_span),
+                               az_span_size(button_event_payload_span));
     }
     return;
 }
 
-#define NUM_PAYLOAD_CHUNKS 8
+/**********************************************
+* Build batched sensor telemetry array
+* e.g. in JSON
+* [
+*   {"ts":1650000000250,"light":120,"temperature":24},
+*   {"ts":1650000000500,"light":121,"temperature":24}
+* ]
+**********************************************/
+static az_result build_sensor_telemetry_batch_message(
+    telemetry_writer_t* tw,
+    uint8_t             count)
+{
+    uint8_t i;
+
+    RETURN_ERR_IF_FAILED(telemetry_writer_init(tw, AZ_SPAN_FROM_BUFFER(pnp_telemetry_batch_payload_buffer)));
+    RETURN_ERR_IF_FAILED(tw->encoder->begin_array(tw));
+
+    for (i = 0; i < count; i++)
+    {
+        const telemetry_sample_t* sample = &telemetry_batch[(telemetry_batch_head + i) & (CFG_TELEMETRY_RING_SIZE - 1)];
+
+        RETURN_ERR_IF_FAILED(tw->encoder->begin_object(tw));
+        RETURN_ERR_IF_FAILED(tw->encoder->append_long(tw,
+                                                      telemetry_name_timestamp_span,
+                                                      (int64_t)telemetry_batch_start_time * 1000 + sample->offset_ms));
+
+        if ((telemetry_disable_flag & DISABLE_LIGHT) == 0)
+        {
+            RETURN_ERR_IF_FAILED(tw->encoder->append_int32(tw, telemetry_name_light_span, sample->light));
+        }
+
+        if ((telemetry_disable_flag & DISABLE_TEMPERATURE) == 0)
+        {
+            RETURN_ERR_IF_FAILED(tw->encoder->append_int32(tw, telemetry_name_temperature_span, sample->temperature));
+        }
+        RETURN_ERR_IF_FAILED(tw->encoder->end_object(tw));
+    }
+
+    RETURN_ERR_IF_FAILED(tw->encoder->end_array(tw));
+    return AZ_OK;
+}
 
 /**********************************************
-* Read sensor data and send telemetry to cloud
+* Send the oldest queued telemetry samples,
+* up to telemetryBatchSize, as one message
 **********************************************/
-az_result send_telemetry_message(void)
+static az_result flush_telemetry_batch(void)
 {
-    az_result rc = AZ_OK;
+    az_result          rc;
+    telemetry_writer_t tw;
+    uint8_t            count = telemetry_batch_count;
 
-    az_span   telemetry_payload_span;
+    if (count > telemetry_batch_size)
+    {
+        count = telemetry_batch_size;
+    }
 
-    int16_t temp;
-    int32_t light;
+    // Samples that cannot be built are dropped, not retried
+    rc = build_sensor_telemetry_batch_message(&tw, count);
+    telemetry_batch_head = (telemetry_batch_head + count) & (CFG_TELEMETRY_RING_SIZE - 1);
+    telemetry_batch_count -= count;
+    RETURN_ERR_WITH_MESSAGE_IF_FAILED(rc, "Failed to build batched telemetry payload");
 
-    if ((telemetry_disable_flag & (DISABLE_LIGHT | DISABLE_TEMPERATURE)) == 0x3)
+    return publish_telemetry_payload(&tw, pnp_telemetry_topic_buffer, sizeof(pnp_telemetry_topic_buffer));
+}
+
+/**********************************************
+* Add one telemetry sample to the ring,
+* the oldest one is dropped when it is full
+**********************************************/
+static void add_telemetry_sample(
+    uint64_t counter,
+    int16_t  temperature,
+    int32_t  light)
+{
+    telemetry_sample_t* sample;
+
+    if (telemetry_batch_count == 0)
     {
-        debug_printTrace("AZURE: Telemetry disabled");
-        return rc;
+        struct tm sys_time;
+        RTC_RTCCTimeGet(&sys_time);
+        telemetry_batch_start_time    = mktime(&sys_time);
+        telemetry_batch_start_counter = counter;
+    }
+    else if (telemetry_batch_count == CFG_TELEMETRY_RING_SIZE)
+    {
+        telemetry_batch_head = (telemetry_batch_head + 1) & (CFG_TELEMETRY_RING_SIZE - 1);
+        telemetry_batch_count--;
+        telemetry_batch_dropped++;
+    }
+
+    sample              = &telemetry_batch[(telemetry_batch_head + telemetry_batch_count) & (CFG_TELEMETRY_RING_SIZE - 1)];
+    sample->offset_ms   = SYS_TIME_CountToMS((uint32_t)(counter - telemetry_batch_start_counter));
+    sample->light       = light;
+    sample->temperature = temperature;
+    telemetry_batch_count++;
+}
+
+/**********************************************
+* Capture a telemetry sample for batching once
+* telemetryBatchSampleMs has passed.
+* Called on every sample timer tick, whether
+* or not a batch is being sent.
+**********************************************/
+void check_telemetry_sample(void)
+{
+    uint64_t counter = SYS_TIME_Counter64Get();
+    int16_t  temp    = 0;
+    int32_t  light   = 0;
+
+    if (telemetry_batch_size <= 1 || telemetry_window_sec > 0 ||
+        (telemetry_disable_flag & (DISABLE_LIGHT | DISABLE_TEMPERATURE)) == 0x3)
+    {
+        telemetry_sample_due_counter = 0;
+        return;
+    }
+
+    if (telemetry_sample_due_counter != 0 && counter < telemetry_sample_due_counter)
+    {
+        return;
+    }
+
+    // Due times advance by the period so a tick that is late does not
+    // delay the samples after it.  After a longer gap, or a new period,
+    // sampling starts again from now.
+    telemetry_sample_due_counter += SYS_TIME_MSToCount(telemetry_batch_sample_ms);
+    if (telemetry_sample_due_counter <= counter)
+    {
+        telemetry_sample_due_counter = counter + SYS_TIME_MSToCount(telemetry_batch_sample_ms);
     }
 
     if ((telemetry_disable_flag & DISABLE_LIGHT) == 0)
@@ -492,61 +1052,487 @@ az_result send_telemetry_message(void)
         temp = APP_GetTempSensorValue();
     }
 
-    RETURN_ERR_WITH_MESSAGE_IF_FAILED(
-        build_sensor_telemetry_message(&telemetry_payload_span, temp, light),
-        "Failed to build sensor telemetry JSON payload");
+    add_telemetry_sample(counter, temp, light);
+}
 
-    debug_printGood("AZURE: %s", az_span_ptr(telemetry_payload_span));
+/**********************************************
+* Send a batch once telemetryBatchSize samples
+* are queued or the oldest one reached the
+* flush deadline.
+* Called from the application data task.
+**********************************************/
+void check_telemetry_batch(void)
+{
+    uint32_t age_ms;
 
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-    rc = az_iot_pnp_client_telemetry_get_publish_topic(&pnp_client,
-                                                       AZ_SPAN_EMPTY,
-#else
-    rc = az_iot_hub_client_telemetry_get_publish_topic(&iothub_client,
-#endif
-                                                       NULL,
-                                                       pnp_telemetry_topic_buffer,
-                                                       sizeof(pnp_telemetry_topic_buffer),
-                                                       NULL);
+    if (telemetry_batch_dropped > 0)
+    {
+        debug_printWarn("AZURE: %lu telemetry samples dropped, ring full", telemetry_batch_dropped);
+        telemetry_batch_dropped = 0;
+    }
 
-    if (az_result_succeeded(rc))
+    if (telemetry_batch_count == 0)
     {
-        CLOUD_publishData((uint8_t*)pnp_telemetry_topic_buffer,
-                          az_span_ptr(telemetry_payload_span),
-                          az_span_size(telemetry_payload_span),
-                          1);
+        return;
     }
 
-    return rc;
+    age_ms = SYS_TIME_CountToMS((uint32_t)(SYS_TIME_Counter64Get() - telemetry_batch_start_counter)) -
+             telemetry_batch[telemetry_batch_head].offset_ms;
+
+    if (telemetry_batch_count >= telemetry_batch_size || age_ms >= telemetry_batch_flush_ms)
+    {
+        flush_telemetry_batch();
+    }
 }
 
 /**********************************************
-* Check if LED status has changed or not.
-* If any LED status has changed, update Device Twin
+* Telemetry Aggregation
+* With telemetryWindowSec > 0 every sensor sample is added to a running
+* min/max/mean/variance (Welford) and one summary is sent per window.
+* A value is sent at once when it moves the deadband away from the last
+* value sent, or when it leaves or re-enters the low/high range
+* (report-by-exception).  The deadband is also the hysteresis for
+* re-entering the range.  Exceptions for one value are at least
+* CFG_TELEMETRY_ALERT_MIN_INTERVAL_MS apart.
 **********************************************/
-void check_led_status(twin_properties_t* twin_properties)
+static int8_t telemetry_zone(
+    const telemetry_limits_t* limits,
+    int8_t                    zone,
+    double                    value)
 {
-    twin_properties_t* twin_properties_ptr;
-    twin_properties_t  twin_properties_local;
-
-    bool force_sync = false;   // force LED status synchronization if this request is coming from Twin Get
-
-    if (twin_properties == NULL)
+    if (limits->high <= limits->low)
     {
-        // twin data is not provided by the caller
-        init_twin_data(&twin_properties_local);
-        twin_properties_ptr = &twin_properties_local;
+        return 0;
     }
-    else
+
+    if (value > limits->high || (zone > 0 && value > (double)limits->high - limits->deadband))
     {
-        // twin data is provided by the caller through Get Twin
-        twin_properties_ptr = twin_properties;
+        return 1;
     }
 
-    if (led_status.change_flag.as_uint16 == LED_FLAG_EMPTY && twin_properties_ptr->flag.is_initial_get == 0)
+    if (value < limits->low || (zone < 0 && value < (double)limits->low + limits->deadband))
     {
-        // no changes, nothing to update
-        return;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void add_telemetry_aggregate_sample(
+    const telemetry_channel_t* channel,
+    telemetry_aggregate_t*     aggregate,
+    double                     value)
+{
+    double delta = value - aggregate->mean;
+    int8_t zone;
+
+    if (aggregate->count == 0 || value < aggregate->min)
+    {
+        aggregate->min = value;
+    }
+
+    if (aggregate->count == 0 || value > aggregate->max)
+    {
+        aggregate->max = value;
+    }
+
+    aggregate->count++;
+    aggregate->mean += delta / aggregate->count;
+    aggregate->m2 += delta * (value - aggregate->mean);
+
+    if (!aggregate->has_reference)
+    {
+        aggregate->reference     = value;
+        aggregate->has_reference = true;
+    }
+
+    zone = telemetry_zone(channel->limits, aggregate->zone, value);
+
+    if (zone != aggregate->zone)
+    {
+        aggregate->zone        = zone;
+        aggregate->alert       = zone > 0 ? "high" : (zone < 0 ? "low" : "normal");
+        aggregate->alert_value = value;
+    }
+    else if (channel->limits->deadband > 0 && fabs(value - aggregate->reference) >= channel->limits->deadband)
+    {
+        if (aggregate->alert == NULL)
+        {
+            aggregate->alert = "deadband";
+        }
+        aggregate->alert_value = value;
+    }
+}
+
+static void reset_telemetry_aggregates(void)
+{
+    uint8_t id;
+
+    for (id = 0; id < SENSOR_COUNT; id++)
+    {
+        telemetry_aggregates[id].count = 0;
+        telemetry_aggregates[id].mean  = 0;
+        telemetry_aggregates[id].m2    = 0;
+    }
+}
+
+static void twin_set_telemetry_window(int32_t value)
+{
+    reset_telemetry_aggregates();
+    telemetry_window_started = false;
+}
+
+/**********************************************
+* Build telemetry exception message
+* e.g. in JSON
+* {"light":1210,"lightAlert":"high"}
+**********************************************/
+static az_result build_telemetry_alert_message(
+    telemetry_writer_t* tw)
+{
+    char    name_buffer[24];
+    uint8_t id;
+
+    RETURN_ERR_IF_FAILED(telemetry_writer_init(tw, AZ_SPAN_FROM_BUFFER(pnp_telemetry_aggregate_payload_buffer)));
+    RETURN_ERR_IF_FAILED(tw->encoder->begin_object(tw));
+
+    for (id = 0; id < SENSOR_COUNT; id++)
+    {
+        const telemetry_aggregate_t* aggregate = &telemetry_aggregates[id];
+
+        if (!aggregate->alert_due)
+        {
+            continue;
+        }
+
+        RETURN_ERR_IF_FAILED(tw->encoder->append_double(tw, telemetry_channels[id].name_span, aggregate->alert_value));
+
+        snprintf(name_buffer, sizeof(name_buffer), "%sAlert", az_span_ptr(telemetry_channels[id].name_span));
+        RETURN_ERR_IF_FAILED(tw->encoder->append_string(tw,
+                                                        az_span_create_from_str(name_buffer),
+                                                        az_span_create_from_str((char*)aggregate->alert)));
+    }
+
+    RETURN_ERR_IF_FAILED(tw->encoder->end_object(tw));
+    return AZ_OK;
+}
+
+/**********************************************
+* Build telemetry window summary
+* e.g. in JSON
+* {
+*   "windowSec":300,
+*   "lightMin":801,"lightMax":840,"lightMean":822.4,"lightStddev":9.1,"lightCount":3000,
+*   "temperatureMin":24.5,...
+* }
+**********************************************/
+static az_result build_telemetry_summary_message(
+    telemetry_writer_t* tw)
+{
+    char    name_buffer[24];
+    uint8_t id;
+
+    RETURN_ERR_IF_FAILED(telemetry_writer_init(tw, AZ_SPAN_FROM_BUFFER(pnp_telemetry_aggregate_payload_buffer)));
+    RETURN_ERR_IF_FAILED(tw->encoder->begin_object(tw));
+    RETURN_ERR_IF_FAILED(tw->encoder->append_long(tw, telemetry_name_window_span, telemetry_window_sec));
+
+    for (id = 0; id < SENSOR_COUNT; id++)
+    {
+        const telemetry_aggregate_t* aggregate = &telemetry_aggregates[id];
+        const char*                  name      = (const char*)az_span_ptr(telemetry_channels[id].name_span);
+
+        if (aggregate->count == 0)
+        {
+            continue;
+        }
+
+        snprintf(name_buffer, sizeof(name_buffer), "%sMin", name);
+        RETURN_ERR_IF_FAILED(tw->encoder->append_double(tw, az_span_create_from_str(name_buffer), aggregate->min));
+
+        snprintf(name_buffer, sizeof(name_buffer), "%sMax", name);
+        RETURN_ERR_IF_FAILED(tw->encoder->append_double(tw, az_span_create_from_str(name_buffer), aggregate->max));
+
+        snprintf(name_buffer, sizeof(name_buffer), "%sMean", name);
+        RETURN_ERR_IF_FAILED(tw->encoder->append_double(tw, az_span_create_from_str(name_buffer), aggregate->mean));
+
+        // Sample standard deviation
+        snprintf(name_buffer, sizeof(name_buffer), "%sStddev", name);
+        RETURN_ERR_IF_FAILED(tw->encoder->append_double(tw,
+                                                        az_span_create_from_str(name_buffer),
+                                                        aggregate->count > 1 ? sqrt(aggregate->m2 / (aggregate->count - 1)) : 0));
+
+        snprintf(name_buffer, sizeof(name_buffer), "%sCount", name);
+        RETURN_ERR_IF_FAILED(tw->encoder->append_long(tw, az_span_create_from_str(name_buffer), aggregate->count));
+    }
+
+    RETURN_ERR_IF_FAILED(tw->encoder->end_object(tw));
+    return AZ_OK;
+}
+
+/**********************************************
+* Aggregate new sensor samples, send exceptions
+* at once and the summary when the window ends.
+* Called from the application data task.
+**********************************************/
+void check_telemetry_aggregation(void)
+{
+    sensor_sample_t    samples[8];
+    telemetry_writer_t tw;
+    uint64_t           counter  = SYS_TIME_Counter64Get();
+    bool               alerts   = false;
+    bool               summary  = false;
+    uint8_t            id;
+    uint8_t            count;
+    uint8_t            i;
+
+    if (telemetry_window_sec == 0)
+    {
+        return;
+    }
+
+    if (!telemetry_window_started)
+    {
+        telemetry_window_start_counter = counter;
+        telemetry_window_started       = true;
+    }
+
+    for (id = 0; id < SENSOR_COUNT; id++)
+    {
+        const telemetry_channel_t* channel   = &telemetry_channels[id];
+        telemetry_aggregate_t*     aggregate = &telemetry_aggregates[id];
+
+        while ((count = SENSOR_ReadSamples(channel->sensor, &aggregate->cursor, samples, sizeof(samples) / sizeof(samples[0]))) > 0)
+        {
+            if ((telemetry_disable_flag & channel->disable_flag) != 0)
+            {
+                continue;
+            }
+
+            for (i = 0; i < count; i++)
+            {
+                add_telemetry_aggregate_sample(channel, aggregate, samples[i].value / channel->scale);
+            }
+        }
+
+        // An alert held back by the minimum interval keeps the latest value that triggered it
+        aggregate->alert_due = aggregate->alert != NULL &&
+                               (!aggregate->alerted ||
+                                counter - aggregate->alert_counter >= SYS_TIME_MSToCount(CFG_TELEMETRY_ALERT_MIN_INTERVAL_MS));
+        alerts |= aggregate->alert_due;
+        summary |= aggregate->count > 0;
+    }
+
+    if (alerts)
+    {
+        if (az_result_failed(build_telemetry_alert_message(&tw)))
+        {
+            debug_printError("AZURE: Failed to build telemetry alert payload");
+        }
+        else
+        {
+            publish_telemetry_payload(&tw, pnp_telemetry_topic_buffer, sizeof(pnp_telemetry_topic_buffer));
+        }
+
+        for (id = 0; id < SENSOR_COUNT; id++)
+        {
+            telemetry_aggregate_t* aggregate = &telemetry_aggregates[id];
+
+            if (aggregate->alert_due)
+            {
+                aggregate->reference     = aggregate->alert_value;
+                aggregate->alert         = NULL;
+                aggregate->alert_due     = false;
+                aggregate->alerted       = true;
+                aggregate->alert_counter = counter;
+            }
+        }
+    }
+
+    if (counter - telemetry_window_start_counter < (uint64_t)telemetry_window_sec * SYS_TIME_MSToCount(1000))
+    {
+        return;
+    }
+
+    telemetry_window_start_counter = counter;
+
+    if (!summary)
+    {
+        return;
+    }
+
+    if (az_result_failed(build_telemetry_summary_message(&tw)))
+    {
+        debug_printError("AZURE: Failed to build telemetry summary payload");
+    }
+    else
+    {
+        publish_telemetry_payload(&tw, pnp_telemetry_topic_buffer, sizeof(pnp_telemetry_topic_buffer));
+    }
+
+    for (id = 0; id < SENSOR_COUNT; id++)
+    {
+        if (telemetry_aggregates[id].count > 0)
+        {
+            telemetry_aggregates[id].reference = telemetry_aggregates[id].mean;
+        }
+    }
+
+    reset_telemetry_aggregates();
+}
+
+/**********************************************
+* Build direct method latency diagnostics
+* e.g. in JSON
+* {
+*   "commandCount":12,
+*   "DispatchP99Us":511,"DispatchMaxUs":420,
+*   ...
+* }
+**********************************************/
+static az_result build_diagnostics_telemetry_message(
+    telemetry_writer_t* tw)
+{
+    trace_stage_stats_t stats;
+    char                name_buffer[24];
+    uint8_t             stage;
+
+    RETURN_ERR_IF_FAILED(telemetry_writer_init(tw, AZ_SPAN_FROM_BUFFER(pnp_diagnostics_payload_buffer)));
+    RETURN_ERR_IF_FAILED(tw->encoder->begin_object(tw));
+
+    TRACE_GetStageStats(TRACE_STAGE_TOTAL, &stats);
+    RETURN_ERR_IF_FAILED(tw->encoder->append_long(tw, AZ_SPAN_FROM_STR("commandCount"), stats.count));
+
+    for (stage = 0; stage < TRACE_STAGE_COUNT; stage++)
+    {
+        TRACE_GetStageStats((trace_stage_t)stage, &stats);
+
+        snprintf(name_buffer, sizeof(name_buffer), "%sP99Us", TRACE_GetStageName((trace_stage_t)stage));
+        RETURN_ERR_IF_FAILED(tw->encoder->append_long(tw, az_span_create_from_str(name_buffer), TRACE_GetPercentileUs(&stats, 99)));
+
+        snprintf(name_buffer, sizeof(name_buffer), "%sMaxUs", TRACE_GetStageName((trace_stage_t)stage));
+        RETURN_ERR_IF_FAILED(tw->encoder->append_long(tw, az_span_create_from_str(name_buffer), stats.maxUs));
+    }
+
+    RETURN_ERR_IF_FAILED(tw->encoder->end_object(tw));
+    return AZ_OK;
+}
+
+/**********************************************
+* Send direct method latency diagnostics every
+* CFG_DIAGNOSTICS_TELEMETRY_INTERVAL_SEC seconds.
+* Nothing is sent until a direct method completed.
+* Called from the application data task.
+**********************************************/
+void check_diagnostics_telemetry(void)
+{
+    trace_stage_stats_t stats;
+    telemetry_writer_t  tw;
+    uint64_t            counter = SYS_TIME_Counter64Get();
+
+    if (CFG_DIAGNOSTICS_TELEMETRY_INTERVAL_SEC == 0)
+    {
+        return;
+    }
+
+    if (diagnostics_last_counter != 0 &&
+        SYS_TIME_CountToMS((uint32_t)(counter - diagnostics_last_counter)) < CFG_DIAGNOSTICS_TELEMETRY_INTERVAL_SEC * 1000UL)
+    {
+        return;
+    }
+
+    TRACE_GetStageStats(TRACE_STAGE_TOTAL, &stats);
+    if (stats.count == 0)
+    {
+        return;
+    }
+
+    diagnostics_last_counter = counter;
+
+    if (az_result_failed(build_diagnostics_telemetry_message(&tw)))
+    {
+        debug_printError("AZURE: Failed to build diagnostics telemetry payload");
+        return;
+    }
+
+    publish_telemetry_payload(&tw, pnp_telemetry_topic_buffer, sizeof(pnp_telemetry_topic_buffer));
+}
+
+#define NUM_PAYLOAD_CHUNKS 8
+
+/**********************************************
+* Read sensor data and send telemetry to cloud
+**********************************************/
+az_result send_telemetry_message(void)
+{
+    az_result rc = AZ_OK;
+
+    telemetry_writer_t tw;
+
+    int16_t temp;
+    int32_t light;
+
+    if ((telemetry_disable_flag & (DISABLE_LIGHT | DISABLE_TEMPERATURE)) == 0x3)
+    {
+        debug_printTrace("AZURE: Telemetry disabled");
+        return rc;
+    }
+
+    if (telemetry_window_sec > 0)
+    {
+        // Summaries and exceptions are sent by check_telemetry_aggregation()
+        return rc;
+    }
+
+    if (telemetry_batch_size > 1)
+    {
+        // Samples are captured by check_telemetry_sample() and sent by check_telemetry_batch()
+        return rc;
+    }
+
+    if ((telemetry_disable_flag & DISABLE_LIGHT) == 0)
+    {
+        light = APP_GetLightSensorValue();
+    }
+
+    if ((telemetry_disable_flag & DISABLE_TEMPERATURE) == 0)
+    {
+        temp = APP_GetTempSensorValue();
+    }
+
+    RETURN_ERR_WITH_MESSAGE_IF_FAILED(
+        build_sensor_telemetry_message(&tw, temp, light),
+        "Failed to build sensor telemetry payload");
+
+    return publish_telemetry_payload(&tw, pnp_telemetry_topic_buffer, sizeof(pnp_telemetry_topic_buffer));
+}
+
+/**********************************************
+* Check if LED status has changed or not.
+* If any LED status has changed, update Device Twin
+**********************************************/
+void check_led_status(twin_properties_t* twin_properties)
+{
+    twin_properties_t* twin_properties_ptr;
+    twin_properties_t  twin_properties_local;
+
+    bool force_sync = false;   // force LED status synchronization if this request is coming from Twin Get
+
+    if (twin_properties == NULL)
+    {
+        // twin data is not provided by the caller
+        init_twin_data(&twin_properties_local);
+        twin_properties_ptr = &twin_properties_local;
+    }
+    else
+    {
+        // twin data is provided by the caller through Get Twin
+        twin_properties_ptr = twin_properties;
+    }
+
+    if (led_status.change_flag.as_uint16 == LED_FLAG_EMPTY && twin_properties_ptr->flag.is_initial_get == 0)
+    {
+        // no changes, nothing to update
+        return;
     }
 
     debug_printInfo("AZURE: %s() LED Status 0x%x", __func__, led_status.change_flag.as_uint16);
@@ -659,6 +1645,8 @@ static int send_command_response(
     uint16_t status,
     az_span  response)
 {
+    TRACE_Point(TRACE_METHOD_HANDLED);
+
     // Get the response topic to publish the command response
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
     int rc = az_iot_pnp_client_commands_response_get_publish_topic(
@@ -682,6 +1670,8 @@ static int send_command_response(
                       az_span_size(response),
                       1);
 
+    TRACE_Point(TRACE_RESPONSE_QUEUED);
+
     return rc;
 }
 
@@ -707,7 +1697,7 @@ static az_result process_reboot_command(
 
     if (az_span_size(payload_span) > 0)
     {
-        debug_printInfo("AZURE: %s() : Payload %s", __func__, az_span_ptr(payload_span));
+        debug_printInfo("AZURE: %s() : Payload %.*s", __func__, az_span_size(payload_span), az_span_ptr(payload_span));
 
         RETURN_ERR_IF_FAILED(az_json_reader_init(&jr, payload_span, NULL));
 
@@ -789,50 +1779,302 @@ static az_result process_reboot_command(
     return ret;
 }
 
-/**********************************************
- *	Handle send message command
- **********************************************/
+/**********************************************
+ *	Handle send message command
+ **********************************************/
+/**********************************************
+* sendMsg relay
+* The message string is unescaped from the received
+* payload into sendmsg_relay and written to the console
+* (SERCOM5) TX ring by check_sendMsg_relay() from the
+* main loop, as much as the ring takes on each pass.
+**********************************************/
+typedef struct
+{
+    uint8_t  message[CFG_SENDMSG_BUFFER_SIZE];   // unescaped message and \4 terminator
+    int32_t  length;
+    int32_t  relayed;      // bytes accepted by the TX ring
+    uint32_t stalls;       // times the TX ring was full
+    uint64_t waitCount;    // time spent waiting for room in the TX ring
+    uint64_t stallStart;   // when the TX ring was found full, 0 while it is draining
+    bool     active;
+} sendmsg_relay_t;
+
+static sendmsg_relay_t sendmsg_relay;
+
+/**********************************************
+* Resume the sendMsg relay, called on every
+* pass of the main loop
+**********************************************/
+void check_sendMsg_relay(void)
+{
+    sendmsg_relay_t* relay = &sendmsg_relay;
+    ssize_t          written;
+
+    if (!relay->active)
+    {
+        return;
+    }
+
+    while (relay->relayed < relay->length)
+    {
+        written = 0;
+        if (SYS_CONSOLE_WriteFreeBufferCountGet(SYS_CONSOLE_DEFAULT_INSTANCE) > 0)
+        {
+            written = SYS_CONSOLE_Write(SYS_CONSOLE_DEFAULT_INSTANCE, &relay->message[relay->relayed], relay->length - relay->relayed);
+        }
+
+        if (written <= 0)
+        {
+            break;
+        }
+
+        if (relay->stallStart != 0)
+        {
+            relay->waitCount += SYS_TIME_Counter64Get() - relay->stallStart;
+            relay->stallStart = 0;
+        }
+        relay->relayed += written;
+    }
+
+    if (relay->relayed < relay->length)
+    {
+        if (relay->stallStart == 0)
+        {
+            relay->stalls++;
+            relay->stallStart = SYS_TIME_Counter64Get();
+            return;
+        }
+
+        if (SYS_TIME_CountToMS(SYS_TIME_Counter64Get() - relay->stallStart) < CFG_SENDMSG_STALL_TIMEOUT_MS)
+        {
+            return;
+        }
+
+        relay->waitCount += SYS_TIME_Counter64Get() - relay->stallStart;
+    }
+
+    relay->active = false;
+    debug_disable(false);
+
+    if (relay->relayed < relay->length)
+    {
+        debug_printError("AZURE: sendMsg relay stopped after %d of %d bytes, host UART not draining", relay->relayed, relay->length);
+    }
+    else
+    {
+        debug_printInfo("AZURE: sendMsg relayed %d bytes, %lu stalls, %lu ms waiting",
+                        relay->relayed, relay->stalls, SYS_TIME_CountToMS(relay->waitCount));
+    }
+}
+
+static int hex_digit_value(uint8_t c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+}
+
+// Reads the 4 hex digits of a \u escape, -1 if malformed
+static int32_t read_unicode_escape(const uint8_t* src, int32_t remaining)
+{
+    int32_t code = 0;
+    int     i;
+
+    if (remaining < 4)
+    {
+        return -1;
+    }
+
+    for (i = 0; i < 4; i++)
+    {
+        int digit = hex_digit_value(src[i]);
+        if (digit < 0)
+        {
+            return -1;
+        }
+        code = (code << 4) | digit;
+    }
+    return code;
+}
+
+static int encode_utf8(uint32_t code, uint8_t* out)
+{
+    if (code < 0x80)
+    {
+        out[0] = (uint8_t)code;
+        return 1;
+    }
+    else if (code < 0x800)
+    {
+        out[0] = 0xC0 | (code >> 6);
+        out[1] = 0x80 | (code & 0x3F);
+        return 2;
+    }
+    else if (code < 0x10000)
+    {
+        out[0] = 0xE0 | (code >> 12);
+        out[1] = 0x80 | ((code >> 6) & 0x3F);
+        out[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+    out[0] = 0xF0 | (code >> 18);
+    out[1] = 0x80 | ((code >> 12) & 0x3F);
+    out[2] = 0x80 | ((code >> 6) & 0x3F);
+    out[3] = 0x80 | (code & 0x3F);
+    return 4;
+}
+
+/**********************************************
+* Unescape a JSON string token, followed by
+* the \4 terminator, into the relay buffer
+**********************************************/
+static az_result relay_json_string(az_span escaped_span, sendmsg_relay_t* relay)
+{
+    const uint8_t* src  = az_span_ptr(escaped_span);
+    int32_t        size = az_span_size(escaped_span);
+    int32_t        i    = 0;
+
+    relay->length = 0;
+
+    while (i < size)
+    {
+        uint8_t  utf8[4];
+        int      length = 1;
+        uint32_t code;
+
+        utf8[0] = src[i++];
+
+        if (utf8[0] == '\\')
+        {
+            if (i == size)
+            {
+                return AZ_ERROR_UNEXPECTED_CHAR;
+            }
+
+            switch (src[i++])
+            {
+                case 'b': utf8[0] = '\b'; break;
+                case 'f': utf8[0] = '\f'; break;
+                case 'n': utf8[0] = '\n'; break;
+                case 'r': utf8[0] = '\r'; break;
+                case 't': utf8[0] = '\t'; break;
+                case 'u':
+                {
+                    int32_t high = read_unicode_escape(&src[i], size - i);
+                    if (high < 0)
+                    {
+                        return AZ_ERROR_UNEXPECTED_CHAR;
+                    }
+                    i += 4;
+                    code = (uint32_t)high;
+
+                    // Combine a surrogate pair, a lone surrogate is replaced by '?'
+                    if (high >= 0xD800 && high <= 0xDBFF)
+                    {
+                        int32_t low = (size - i >= 6 && src[i] == '\\' && src[i + 1] == 'u') ? read_unicode_escape(&src[i + 2], size - i - 2) : -1;
+
+                        if (low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            code = 0x10000 + (((uint32_t)high - 0xD800) << 10) + ((uint32_t)low - 0xDC00);
+                            i += 6;
+                        }
+                        else
+                        {
+                            code = '?';
+                        }
+                    }
+                    else if (high >= 0xDC00 && high <= 0xDFFF)
+                    {
+                        code = '?';
+                    }
+                    length = encode_utf8(code, utf8);
+                }
+                break;
+                default:
+                    // \" \\ and \/
+                    utf8[0] = src[i - 1];
+                    break;
+            }
+        }
+
+        // Room is kept for the terminator
+        if (relay->length + length >= (int32_t)sizeof(relay->message))
+        {
+            return AZ_ERROR_NOT_ENOUGH_SPACE;
+        }
+        memcpy(&relay->message[relay->length], utf8, length);
+        relay->length += length;
+    }
+
+    relay->message[relay->length++] = '\4';
+
+    return AZ_OK;
+}
+
+static az_result build_sendMsg_resp_payload(
+    az_span                response_span,
+    az_span                status_string_span,
+    const sendmsg_relay_t* relay,
+    az_span*               response_payload_span)
+{
+    az_json_writer jw;
+
+    RETURN_ERR_IF_FAILED(start_json_object(&jw, response_span));
+    RETURN_ERR_IF_FAILED(append_json_property_string(&jw, command_status_span, status_string_span));
+    RETURN_ERR_IF_FAILED(append_json_property_int32(&jw, command_sendMsg_queued_span, relay->length));
+    RETURN_ERR_IF_FAILED(append_json_property_int32(&jw, command_sendMsg_relayed_span, relay->relayed));
+    RETURN_ERR_IF_FAILED(append_json_property_int32(&jw, command_sendMsg_stalls_span, relay->stalls));
+    RETURN_ERR_IF_FAILED(append_json_property_int32(&jw, command_sendMsg_wait_span, SYS_TIME_CountToMS(relay->waitCount)));
+    RETURN_ERR_IF_FAILED(end_json_object(&jw));
+    *response_payload_span = az_json_writer_get_bytes_used_in_destination(&jw);
+    return AZ_OK;
+}
+
 static az_result process_sendMsg_command(
     az_span   payload_span,
     az_span   response_span,
     az_span*  out_response_span,
     uint16_t* out_response_status)
 {
-    az_result      ret           = AZ_OK;
-    size_t         spanSize      = -1;
-    char*          messageString = NULL;
+    az_result      ret   = AZ_OK;
+    bool           found = false;
     az_json_reader jr;
 
     *out_response_status = AZ_IOT_STATUS_SERVER_ERROR;
 
+    if (sendmsg_relay.active)
+    {
+        debug_printError("AZURE: sendMsg relay busy, %d of %d bytes relayed", sendmsg_relay.relayed, sendmsg_relay.length);
+
+        RETURN_ERR_IF_FAILED(build_sendMsg_resp_payload(response_span, command_resp_busy_sendMsg_span, &sendmsg_relay, out_response_span));
+
+        *out_response_status = AZ_IOT_STATUS_SERVICE_UNAVAILABLE;
+        return AZ_OK;
+    }
+
     if (az_span_size(payload_span) > 0)
     {
-        debug_printInfo("AZURE: %s() : Payload %s", __func__, az_span_ptr(payload_span));
+        debug_printInfo("AZURE: %s() : Payload %d bytes", __func__, az_span_size(payload_span));
 
         RETURN_ERR_IF_FAILED(az_json_reader_init(&jr, payload_span, NULL));
 
-        while (jr.token.kind != AZ_JSON_TOKEN_END_OBJECT)
+        while (az_result_succeeded(ret = az_json_reader_next_token(&jr)))
         {
-            if (jr.token.kind == AZ_JSON_TOKEN_PROPERTY_NAME)
+            if (jr.token.kind == AZ_JSON_TOKEN_PROPERTY_NAME &&
+                az_json_token_is_text_equal(&jr.token, command_sendMsg_payload_span))
             {
-                if (az_json_token_is_text_equal(&jr.token, command_sendMsg_payload_span))
+                if (az_result_failed(ret = az_json_reader_next_token(&jr)))
                 {
-                    if (az_result_failed(ret = az_json_reader_next_token(&jr)))
-                    {
-                        debug_printError("AZURE: Error getting next token");
-                        break;
-                    }
-                    else
-                    {
-                        spanSize = (size_t)az_span_size(jr.token.slice);
-                        break;
-                    }
-
-                    break;
+                    debug_printError("AZURE: Error getting next token");
+                }
+                else
+                {
+                    found = jr.token.kind == AZ_JSON_TOKEN_STRING;
                 }
-            } else if (az_result_failed(ret = az_json_reader_next_token(&jr)))
-            {
-                debug_printError("AZURE: Error getting next token");
                 break;
             }
         }
@@ -842,7 +2084,7 @@ static az_result process_sendMsg_command(
         debug_printError("AZURE: %s() : Payload Empty", __func__);
     }
 
-    if (spanSize == -1)
+    if (!found)
     {
         debug_printError("AZURE: Message string not found");
 
@@ -851,53 +2093,43 @@ static az_result process_sendMsg_command(
                                                    out_response_span);
 
         *out_response_status = AZ_IOT_STATUS_BAD_REQUEST;
+        return ret;
     }
-    else if (spanSize > SERCOM5_USART_WRITE_BUFFER_SIZE)
-    {
-        debug_printError("AZURE: Message too big for TX Buffer %lu", spanSize);
 
-        ret = build_command_error_response_payload(response_span,
-                                                   command_resp_alloc_error_sendMsg_span,
-                                                   out_response_span);
+    memset(&sendmsg_relay, 0, sizeof(sendmsg_relay));
 
-        *out_response_status = AZ_IOT_STATUS_BAD_REQUEST;
-    }
-    else if ((messageString = malloc(spanSize + 1)) == NULL)
+    ret = relay_json_string(jr.token.slice, &sendmsg_relay);
+    if (ret == AZ_ERROR_NOT_ENOUGH_SPACE)
     {
-        debug_printError("AZURE: Failed to allocate memory for message string : Size %ld", spanSize);
+        debug_printError("AZURE: Message string longer than %d bytes", CFG_SENDMSG_BUFFER_SIZE - 1);
 
         ret = build_command_error_response_payload(response_span,
-                                                   command_resp_alloc_error_sendMsg_span,
+                                                   command_resp_long_sendMsg_payload_span,
                                                    out_response_span);
 
         *out_response_status = AZ_IOT_STATUS_BAD_REQUEST;
+        return ret;
     }
-    else
-    {
-        RETURN_ERR_IF_FAILED(az_json_token_get_string(&jr.token, messageString, spanSize + 1, NULL));
+    RETURN_ERR_IF_FAILED(ret);
 
-        strlcat(messageString, "\4", spanSize + 1);
-        debug_disable(true);
-        SYS_CONSOLE_Message(0, messageString);
-        debug_disable(false);
-        RETURN_ERR_IF_FAILED(build_command_resp_payload(response_span, out_response_span));
+    // Debug messages would be mixed into the message, they are held off
+    // until check_sendMsg_relay() has written the terminator
+    debug_disable(true);
+    sendmsg_relay.active = true;
+    check_sendMsg_relay();
 
-        *out_response_status = AZ_IOT_STATUS_ACCEPTED;
-    }
+    RETURN_ERR_IF_FAILED(build_sendMsg_resp_payload(response_span, resp_success_span, &sendmsg_relay, out_response_span));
 
-    if (messageString)
-    {
-        free(messageString);
-    }
+    *out_response_status = AZ_IOT_STATUS_ACCEPTED;
 
-    return ret;
+    return AZ_OK;
 }
 
 /**********************************************
 * Process Command
 **********************************************/
 az_result process_direct_method_command(
-    uint8_t* payload,
+    az_span payload_span,
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
     az_iot_pnp_client_command_request* command_request)
 #else
@@ -907,12 +2139,11 @@ az_result process_direct_method_command(
     az_result rc                = AZ_OK;
     uint16_t  response_status   = AZ_IOT_STATUS_BAD_REQUEST;   // assume error
     az_span   command_resp_span = AZ_SPAN_FROM_BUFFER(command_resp_buffer);
-    az_span   payload_span      = az_span_create_from_str((char*)payload);
 
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-    debug_printInfo("AZURE: Processing Command '%s'", command_request->command_name);
+    debug_printInfo("AZURE: Processing Command '%.*s'", az_span_size(command_request->command_name), az_span_ptr(command_request->command_name));
 #else
-    debug_printInfo("AZURE: Processing Command '%s'", method_request->name);
+    debug_printInfo("AZURE: Processing Command '%.*s'", az_span_size(method_request->name), az_span_ptr(method_request->name));
 #endif
 
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
@@ -965,9 +2196,9 @@ az_result process_direct_method_command(
         rc = AZ_ERROR_NOT_SUPPORTED;
         // Unsupported command
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-        debug_printError("AZURE: Unsupported command received: %s.", az_span_ptr(command_request->command_name));
+        debug_printError("AZURE: Unsupported command received: %.*s.", az_span_size(command_request->command_name), az_span_ptr(command_request->command_name));
 #else
-        debug_printError("AZURE: Unsupported command received: %s.", az_span_ptr(method_request->name));
+        debug_printError("AZURE: Unsupported command received: %.*s.", az_span_size(method_request->name), az_span_ptr(method_request->name));
 #endif
         // if response is empty, payload was not in the right format.
         if (az_result_failed(rc = build_command_error_response_payload(command_resp_span,
@@ -1067,6 +2298,492 @@ static az_result get_twin_desired(
 }
 
 #endif
+/**********************************************
+* Writable Properties
+* One row per desired property.  process_device_twin_property() stores the
+* received value, clamped to the row's range, and sets found_flag.
+* send_reported_property() calls on_change and the next reported property
+* PATCH acknowledges every row whose flag is set, or reports the current
+* value on the initial GET.
+* Adding a writable property only needs a new row.
+**********************************************/
+#define TWIN_PROPERTY_UINT32 0   // Rejects negative values
+#define TWIN_PROPERTY_INT32  1
+
+typedef struct
+{
+    az_span  name_span;
+    uint8_t  type;
+    bool     report_on_initial_get;
+    uint32_t found_flag;    // TWIN_FLAG_xxx
+    volatile void* value;   // Global holding the value, NULL for twin_offset
+    uint16_t twin_offset;   // Field of twin_properties_t holding the value
+    int32_t  min_value;
+    int32_t  max_value;
+    void (*on_change)(int32_t value);   // Applies a received value
+    int32_t (*get_reported)(void);      // Value to report, NULL for the stored value
+} twin_property_t;
+
+int32_t get_led_value(uint16_t led_flag);
+
+static void twin_set_debug_level(int32_t value)
+{
+    debug_setSeverity((debug_severity_t)value);
+}
+
+static int32_t twin_get_debug_level(void)
+{
+    return (int32_t)debug_getSeverity();
+}
+
+static int32_t twin_get_yellow_led(void)
+{
+    return get_led_value(led_status.state_flag.yellow);
+}
+
+static void twin_send_app_property(int number, int32_t value)
+{
+    char messageString[11 + 8 + 1 + 1];   // 11 for 'property N,' + 8 for uint32 in string in hex + \4 + null
+
+    snprintf(messageString, sizeof(messageString), "property %d,%lx\4", number, (uint32_t)value);
+    debug_disable(true);
+    SYS_CONSOLE_Message(0, messageString);
+    debug_disable(false);
+}
+
+static void twin_set_app_property_3(int32_t value)
+{
+    twin_send_app_property(3, value);
+}
+
+static void twin_set_app_property_4(int32_t value)
+{
+    twin_send_app_property(4, value);
+}
+
+static const twin_property_t twin_property_table[] = {
+    {property_telemetry_interval_span, TWIN_PROPERTY_UINT32, true, TWIN_FLAG_TELEMETRY_INTERVAL,
+     &telemetryInterval, 0, 0, INT32_MAX, NULL, NULL},
+    {property_telemetry_batch_size_span, TWIN_PROPERTY_UINT32, true, TWIN_FLAG_TELEMETRY_BATCH_SIZE,
+     &telemetry_batch_size, 0, 1, CFG_TELEMETRY_BATCH_MAX_SAMPLES, NULL, NULL},
+    {property_telemetry_batch_flush_span, TWIN_PROPERTY_UINT32, true, TWIN_FLAG_TELEMETRY_BATCH_FLUSH,
+     &telemetry_batch_flush_ms, 0, 0, INT32_MAX, NULL, NULL},
+    {property_telemetry_batch_sample_span, TWIN_PROPERTY_UINT32, true, TWIN_FLAG_TELEMETRY_BATCH_SAMPLE,
+     &telemetry_batch_sample_ms, 0, CFG_TELEMETRY_SAMPLE_TICK_MS, INT32_MAX, NULL, NULL},
+    {property_telemetry_encoding_span, TWIN_PROPERTY_UINT32, true, TWIN_FLAG_TELEMETRY_ENCODING,
+     &telemetry_encoding, 0, TELEMETRY_ENCODING_JSON, TELEMETRY_ENCODING_CBOR, NULL, NULL},
+    {led_yellow_property_name_span, TWIN_PROPERTY_INT32, true, TWIN_FLAG_YELLOW_LED,
+     NULL, offsetof(twin_properties_t, desired_led_yellow), LED_TWIN_ON, LED_TWIN_BLINK, NULL, twin_get_yellow_led},
+    {debug_level_property_name_span, TWIN_PROPERTY_INT32, true, TWIN_FLAG_DEBUG_LEVEL,
+     NULL, offsetof(twin_properties_t, debugLevel), SEVERITY_NONE, SEVERITY_TRACE, twin_set_debug_level, twin_get_debug_level},
+    {app_property_3_name_span, TWIN_PROPERTY_INT32, false, TWIN_FLAG_APP_PROPERTY_3,
+     NULL, offsetof(twin_properties_t, app_property_3), INT32_MIN, INT32_MAX, twin_set_app_property_3, NULL},
+    {app_property_4_name_span, TWIN_PROPERTY_INT32, false, TWIN_FLAG_APP_PROPERTY_4,
+     NULL, offsetof(twin_properties_t, app_property_4), INT32_MIN, INT32_MAX, twin_set_app_property_4, NULL},
+    {disable_telemetry_name_span, TWIN_PROPERTY_UINT32, true, TWIN_FLAG_TELEMETRY_DISABLE,
+     &telemetry_disable_flag, 0, 0, INT32_MAX, NULL, NULL},
+    {property_telemetry_window_span, TWIN_PROPERTY_UINT32, true, TWIN_FLAG_TELEMETRY_WINDOW,
+     &telemetry_window_sec, 0, 0, CFG_TELEMETRY_WINDOW_MAX_SEC, twin_set_telemetry_window, NULL},
+    {property_light_deadband_span, TWIN_PROPERTY_UINT32, false, TWIN_FLAG_LIGHT_DEADBAND,
+     &telemetry_light_limits.deadband, 0, 0, INT32_MAX, NULL, NULL},
+    {property_light_high_span, TWIN_PROPERTY_INT32, false, TWIN_FLAG_LIGHT_HIGH,
+     &telemetry_light_limits.high, 0, INT32_MIN, INT32_MAX, NULL, NULL},
+    {property_light_low_span, TWIN_PROPERTY_INT32, false, TWIN_FLAG_LIGHT_LOW,
+     &telemetry_light_limits.low, 0, INT32_MIN, INT32_MAX, NULL, NULL},
+    {property_temperature_deadband_span, TWIN_PROPERTY_UINT32, false, TWIN_FLAG_TEMPERATURE_DEADBAND,
+     &telemetry_temperature_limits.deadband, 0, 0, INT32_MAX, NULL, NULL},
+    {property_temperature_high_span, TWIN_PROPERTY_INT32, false, TWIN_FLAG_TEMPERATURE_HIGH,
+     &telemetry_temperature_limits.high, 0, INT32_MIN, INT32_MAX, NULL, NULL},
+    {property_temperature_low_span, TWIN_PROPERTY_INT32, false, TWIN_FLAG_TEMPERATURE_LOW,
+     &telemetry_temperature_limits.low, 0, INT32_MIN, INT32_MAX, NULL, NULL},
+};
+
+#define TWIN_PROPERTY_COUNT     (sizeof(twin_property_table) / sizeof(twin_property_table[0]))
+#define TWIN_PROPERTY_SLOTS     32            // Power of 2, more than TWIN_PROPERTY_COUNT
+#define TWIN_PROPERTY_HASH_SEED 0x811C9E98UL  // No slot collision for the names above
+#define TWIN_PROPERTY_NO_SLOT   0xFF
+
+static uint8_t twin_property_slot[TWIN_PROPERTY_SLOTS];
+static bool    twin_property_slot_ready   = false;
+static bool    twin_property_slot_perfect = false;
+
+static uint32_t twin_property_hash(const uint8_t* name, int32_t length)
+{
+    uint32_t hash = TWIN_PROPERTY_HASH_SEED;
+
+    while (length-- > 0)
+    {
+        hash ^= *name++;
+        hash *= 16777619UL;
+    }
+
+    return (hash ^ (hash >> 16)) & (TWIN_PROPERTY_SLOTS - 1);
+}
+
+//
+// Build the name -> row lookup once.  A collision means a row was added
+// without checking the seed, the lookup then falls back to comparing names.
+//
+static void twin_property_build_slots(void)
+{
+    uint8_t  index;
+    uint32_t slot;
+
+    memset(twin_property_slot, TWIN_PROPERTY_NO_SLOT, sizeof(twin_property_slot));
+    twin_property_slot_perfect = true;
+
+    for (index = 0; index < TWIN_PROPERTY_COUNT; index++)
+    {
+        slot = twin_property_hash(az_span_ptr(twin_property_table[index].name_span),
+                                  az_span_size(twin_property_table[index].name_span));
+
+        if (twin_property_slot[slot] != TWIN_PROPERTY_NO_SLOT)
+        {
+            debug_printError("AZURE: Property '%s' collides with '%s', change TWIN_PROPERTY_HASH_SEED",
+                             az_span_ptr(twin_property_table[index].name_span),
+                             az_span_ptr(twin_property_table[twin_property_slot[slot]].name_span));
+            twin_property_slot_perfect = false;
+        }
+        else
+        {
+            twin_property_slot[slot] = index;
+        }
+    }
+
+    twin_property_slot_ready = true;
+}
+
+static const twin_property_t* twin_property_find(az_json_token* token)
+{
+    const uint8_t* name   = az_span_ptr(token->slice);
+    int32_t        length = az_span_size(token->slice);
+    uint8_t        index;
+
+    if (!twin_property_slot_ready)
+    {
+        twin_property_build_slots();
+    }
+
+    // Escaped names do not hash to their unescaped text
+    if (memchr(name, '\\', (size_t)length) == NULL)
+    {
+        index = twin_property_slot[twin_property_hash(name, length)];
+
+        if (index != TWIN_PROPERTY_NO_SLOT && az_json_token_is_text_equal(token, twin_property_table[index].name_span))
+        {
+            return &twin_property_table[index];
+        }
+        else if (twin_property_slot_perfect)
+        {
+            return NULL;
+        }
+    }
+
+    for (index = 0; index < TWIN_PROPERTY_COUNT; index++)
+    {
+        if (az_json_token_is_text_equal(token, twin_property_table[index].name_span))
+        {
+            return &twin_property_table[index];
+        }
+    }
+
+    return NULL;
+}
+
+static volatile int32_t* twin_property_value(
+    const twin_property_t* property,
+    twin_properties_t*     twin_properties)
+{
+    if (property->value != NULL)
+    {
+        return (volatile int32_t*)property->value;
+    }
+
+    return (volatile int32_t*)((uint8_t*)twin_properties + property->twin_offset);
+}
+
+//
+// Reader is on a property name.  Stores the value of a table property and
+// leaves the reader on the value, returns AZ_ERROR_ITEM_NOT_FOUND otherwise.
+//
+static az_result twin_property_dispatch(
+    az_json_reader*    jr,
+    twin_properties_t* twin_properties)
+{
+    const twin_property_t* property = twin_property_find(&jr->token);
+    int32_t                value;
+    uint32_t               data;
+
+    if (property == NULL)
+    {
+        return AZ_ERROR_ITEM_NOT_FOUND;
+    }
+
+    RETURN_ERR_IF_FAILED(az_json_reader_next_token(jr));
+
+    if (property->type == TWIN_PROPERTY_UINT32)
+    {
+        RETURN_ERR_IF_FAILED(az_json_token_get_uint32(&jr->token, &data));
+        value = data > (uint32_t)property->max_value ? property->max_value : (int32_t)data;
+    }
+    else
+    {
+        RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr->token, &value));
+    }
+
+    if (value < property->min_value)
+    {
+        value = property->min_value;
+    }
+    else if (value > property->max_value)
+    {
+        value = property->max_value;
+    }
+
+    *twin_property_value(property, twin_properties) = value;
+    twin_properties->flag.as_uint32 |= property->found_flag;
+
+    return AZ_OK;
+}
+
+static void twin_property_unknown(az_json_token* token)
+{
+    char   buffer[32];
+    size_t spanSize = (size_t)az_span_size(token->slice) + 1;
+    size_t size     = sizeof(buffer) < spanSize ? sizeof(buffer) : spanSize;
+    snprintf(buffer, size, "%s", az_span_ptr(token->slice));
+
+    debug_printWarn("AZURE: Received unknown property '%s'", buffer);
+}
+
+//
+// Acknowledge a received property, or report the current value on the initial GET
+//
+static az_result append_twin_property(
+    az_json_writer*        jw,
+    const twin_property_t* property,
+    twin_properties_t*     twin_properties)
+{
+    az_result rc;
+    bool      found = (twin_properties->flag.as_uint32 & property->found_flag) != 0;
+    int32_t   value = *twin_property_value(property, twin_properties);
+
+    if (!found && !(twin_properties->flag.is_initial_get && property->report_on_initial_get))
+    {
+        return AZ_OK;
+    }
+
+    if (property->get_reported != NULL)
+    {
+        value = property->get_reported();
+    }
+
+    if (az_result_failed(
+#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
+            rc = append_reported_property_response_int32(
+                jw,
+                property->name_span,
+                value,
+                AZ_IOT_STATUS_OK,
+                found ? twin_properties->version_num : 1,
+                resp_success_span)))
+#else
+            rc = append_json_property_int32(
+                jw,
+                property->name_span,
+                value)))
+#endif
+    {
+        debug_printError("AZURE: Unable to add property '%s', return code 0x%08x", az_span_ptr(property->name_span), rc);
+    }
+
+    return rc;
+}
+
+/**********************************************
+* Reported Property Cache
+* send_reported_property() merges updates into reported_pending and
+* check_reported_property() publishes them as one PATCH once the oldest
+* update is CFG_REPORTED_PROPERTY_WINDOW_MS old.  Reported-only values equal
+* to what the hub last acknowledged are not sent again.  Only one PATCH is
+* in flight at a time, updates made meanwhile wait in reported_pending.
+**********************************************/
+static twin_properties_t reported_pending;    // Updates not published yet
+static twin_properties_t reported_inflight;   // Last PATCH, waiting for its response
+static twin_properties_t reported_acked;      // Values acknowledged by the hub
+static char              reported_inflight_id[16];
+static uint64_t          reported_pending_counter;    // When reported_pending became dirty
+static uint64_t          reported_inflight_counter;   // When the last PATCH was published
+static bool              reported_cache_ready = false;
+
+static bool reported_property_dirty(
+    const twin_properties_t* twin_properties)
+{
+    twin_update_flag_t flag = twin_properties->flag;
+
+    // The version alone does not need a PATCH
+    flag.version_found = 0;
+
+    return flag.as_uint32 != 0 ||
+           twin_properties->reported_led_red != LED_TWIN_NO_CHANGE ||
+           twin_properties->reported_led_blue != LED_TWIN_NO_CHANGE ||
+           twin_properties->reported_led_green != LED_TWIN_NO_CHANGE;
+}
+
+//
+// Copy the fields flagged in update into target, newer values win
+//
+static void merge_reported_property(
+    twin_properties_t* target,
+    twin_properties_t* update)
+{
+    uint8_t index;
+
+    for (index = 0; index < TWIN_PROPERTY_COUNT; index++)
+    {
+        const twin_property_t* property = &twin_property_table[index];
+
+        // Rows stored in globals are read when the PATCH is built
+        if ((update->flag.as_uint32 & property->found_flag) != 0 && property->value == NULL)
+        {
+            *twin_property_value(property, target) = *twin_property_value(property, update);
+        }
+    }
+
+    if (update->flag.version_found)
+    {
+        target->version_num = update->version_num;
+    }
+
+    if (update->reported_led_red != LED_TWIN_NO_CHANGE)
+    {
+        target->reported_led_red = update->reported_led_red;
+    }
+
+    if (update->reported_led_blue != LED_TWIN_NO_CHANGE)
+    {
+        target->reported_led_blue = update->reported_led_blue;
+    }
+
+    if (update->reported_led_green != LED_TWIN_NO_CHANGE)
+    {
+        target->reported_led_green = update->reported_led_green;
+    }
+
+    if (update->flag.ip_address_updated)
+    {
+        memcpy(target->ip_address, update->ip_address, sizeof(target->ip_address));
+    }
+
+    if (update->flag.app_property_1_updated)
+    {
+        target->app_property_1 = update->app_property_1;
+    }
+
+    if (update->flag.app_property_2_updated)
+    {
+        target->app_property_2 = update->app_property_2;
+    }
+
+    target->flag.as_uint32 |= update->flag.as_uint32;
+}
+
+//
+// Drop reported-only values the hub already has.  Writable property acks
+// always go out, the service expects one for every desired version.
+//
+static void drop_acknowledged_values(void)
+{
+    if (reported_pending.flag.is_initial_get)
+    {
+        return;
+    }
+
+    if (reported_pending.reported_led_red == reported_acked.reported_led_red)
+    {
+        reported_pending.reported_led_red = LED_TWIN_NO_CHANGE;
+    }
+
+    if (reported_pending.reported_led_blue == reported_acked.reported_led_blue)
+    {
+        reported_pending.reported_led_blue = LED_TWIN_NO_CHANGE;
+    }
+
+    if (reported_pending.reported_led_green == reported_acked.reported_led_green)
+    {
+        reported_pending.reported_led_green = LED_TWIN_NO_CHANGE;
+    }
+
+    if (reported_pending.flag.ip_address_updated && reported_acked.flag.ip_address_updated &&
+        strcmp(reported_pending.ip_address, reported_acked.ip_address) == 0)
+    {
+        reported_pending.flag.ip_address_updated = 0;
+        shared_networking_params.reported        = 1;
+    }
+
+    if (reported_pending.flag.app_property_1_updated && reported_acked.flag.app_property_1_updated &&
+        reported_pending.app_property_1 == reported_acked.app_property_1)
+    {
+        reported_pending.flag.app_property_1_updated = 0;
+    }
+
+    if (reported_pending.flag.app_property_2_updated && reported_acked.flag.app_property_2_updated &&
+        reported_pending.app_property_2 == reported_acked.app_property_2)
+    {
+        reported_pending.flag.app_property_2_updated = 0;
+    }
+}
+
+//
+// Give up on the PATCH in flight.  Its updates are merged back under the
+// pending ones, which are newer, so they go out with the next PATCH.
+//
+static void requeue_reported_inflight(void)
+{
+    twin_properties_t retry;
+
+    if (reported_inflight_id[0] == '\0')
+    {
+        return;
+    }
+
+    reported_inflight_id[0] = '\0';
+
+    if (!reported_property_dirty(&reported_pending))
+    {
+        reported_pending_counter = SYS_TIME_Counter64Get();
+    }
+
+    retry = reported_inflight;
+    merge_reported_property(&retry, &reported_pending);
+    reported_pending = retry;
+}
+
+//
+// Response to a reported property PATCH.  A rejected PATCH is requeued.
+//
+static void reported_property_response(
+    az_span request_id,
+    int     status)
+{
+    if (reported_inflight_id[0] == '\0' ||
+        !az_span_is_content_equal(request_id, az_span_create_from_str(reported_inflight_id)))
+    {
+        return;
+    }
+
+    if (az_iot_status_succeeded(status))
+    {
+        reported_inflight_id[0] = '\0';
+        merge_reported_property(&reported_acked, &reported_inflight);
+    }
+    else
+    {
+        debug_printWarn("AZURE: Reported property PATCH rejected (%d)", status);
+        requeue_reported_inflight();
+    }
+}
+
 /**********************************************
 * Parse Desired Property (Writable Property)
 * Respond by updating Writable Property with IoT Plug and Play convention
@@ -1081,13 +2798,12 @@ static az_result get_twin_desired(
 * }
 **********************************************/
 az_result process_device_twin_property(
-    uint8_t*           topic,
-    uint8_t*           payload,
+    az_span            topic_span,
+    az_span            payload_span,
     twin_properties_t* twin_properties)
 {
     az_result rc;
-    az_span   property_topic_span;
-    az_span   payload_span;
+    az_result property_rc;
 
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
     az_span component_name_span;
@@ -1098,27 +2814,26 @@ az_result process_device_twin_property(
 #endif
     az_json_reader jr;
 
-    property_topic_span = az_span_create(topic, strlen((char*)topic));
-    payload_span        = az_span_create_from_str((char*)payload);
-
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
     rc = az_iot_pnp_client_property_parse_received_topic(&pnp_client,
 #else
     rc = az_iot_hub_client_twin_parse_received_topic(&iothub_client,
 #endif
-                                                         property_topic_span,
+                                                         topic_span,
                                                          &property_response);
 
     if (az_result_succeeded(rc))
     {
-        debug_printTrace("AZURE: Property Topic   : %s", az_span_ptr(property_topic_span));
+        debug_printTrace("AZURE: Property Topic   : %.*s", az_span_size(topic_span), az_span_ptr(topic_span));
         debug_printTrace("AZURE: Property Type    : %d", property_response.response_type);
-        debug_printTrace("AZURE: Property Payload : %s", (char*)payload);
+        debug_printTrace("AZURE: Property Payload : %.*s", az_span_size(payload_span), az_span_ptr(payload_span));
     }
     else
     {
         debug_printError("AZURE: Failed to parse property topic 0x%08x.", rc);
-        debug_printError("AZURE: Topic: '%s' Payload: '%s'", (char*)topic, (char*)payload);
+        debug_printError("AZURE: Topic: '%.*s' Payload: '%.*s'",
+                         az_span_size(topic_span), az_span_ptr(topic_span),
+                         az_span_size(payload_span), az_span_ptr(payload_span));
         return rc;
     }
 
@@ -1162,6 +2877,7 @@ az_result process_device_twin_property(
         }
 
         // This is an acknowledgement from the service that it received our properties. No need to respond.
+        reported_property_response(property_response.request_id, property_response.status);
         return rc;
     }
     else
@@ -1210,63 +2926,15 @@ az_result process_device_twin_property(
         property_response.response_type,
         &component_name_span)))
     {
-        if (az_json_token_is_text_equal(&jr.token, property_telemetry_interval_span))
-        {
-            uint32_t data;
-            // found writable property to adjust telemetry interval
-            RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-            RETURN_ERR_IF_FAILED(az_json_token_get_uint32(&jr.token, &data));
-            twin_properties->flag.telemetry_interval_found = 1;
-            telemetryInterval                              = data;
-        }
-        else if (az_json_token_is_text_equal(&jr.token, led_yellow_property_name_span))
-        {
-            // found writable property to control Yellow LED
-            RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-            RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                         &twin_properties->desired_led_yellow));
-            twin_properties->flag.yellow_led_found = 1;
-        }
-        else if (az_json_token_is_text_equal(&jr.token, debug_level_property_name_span))
-        {
-            // found writable property to control Yellow LED
-            RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-            RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                         &twin_properties->debugLevel));
-            twin_properties->flag.debug_level_found = 1;
-        }
-        else if (az_json_token_is_text_equal(&jr.token, app_property_3_name_span))
-        {
-            // found writable property : Property 3
-            RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-            RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                         &twin_properties->app_property_3));
-            twin_properties->flag.app_property_3_found = 1;
-        }
-        else if (az_json_token_is_text_equal(&jr.token, app_property_4_name_span))
-        {
-            // found writable property : Property 4
-            RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-            RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                         &twin_properties->app_property_4));
-            twin_properties->flag.app_property_4_found = 1;
-        }
-        else if (az_json_token_is_text_equal(&jr.token, disable_telemetry_name_span))
+        property_rc = twin_property_dispatch(&jr, twin_properties);
+
+        if (property_rc == AZ_ERROR_ITEM_NOT_FOUND)
         {
-            // found writable property : Disable Telemetry
-            RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-            RETURN_ERR_IF_FAILED(az_json_token_get_uint32(&jr.token,
-                                                          &twin_properties->telemetry_disable_flag));
-            twin_properties->flag.telemetry_disable_found = 1;
+            twin_property_unknown(&jr.token);
         }
         else
         {
-            char   buffer[32];
-            size_t spanSize = (size_t)az_span_size(jr.token.slice);
-            size_t size     = sizeof(buffer) < spanSize ? sizeof(buffer) : spanSize;
-            snprintf(buffer, size, "%s", az_span_ptr(jr.token.slice));
-
-            debug_printWarn("AZURE: Received unknown property '%s'", buffer);
+            RETURN_ERR_IF_FAILED(property_rc);
         }
         RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
     }
@@ -1297,68 +2965,19 @@ az_result process_device_twin_property(
         {
             if (jr.token.kind == AZ_JSON_TOKEN_PROPERTY_NAME)
             {
-                if (az_json_token_is_text_equal(&jr.token, property_telemetry_interval_span))
-                {
-                    uint32_t data;
-                    // found writable property to adjust telemetry interval
-                    RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-                    RETURN_ERR_IF_FAILED(az_json_token_get_uint32(&jr.token, &data));
-                    twin_properties->flag.telemetry_interval_found = 1;
-                    telemetryInterval                              = data;
-                }
-                else if (az_json_token_is_text_equal(&jr.token, led_yellow_property_name_span))
-                {
-                    // found writable property to control Yellow LED
-                    RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-                    RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                                 &twin_properties->desired_led_yellow));
-                    twin_properties->flag.yellow_led_found = 1;
-                }
-                else if (az_json_token_is_text_equal(&jr.token, debug_level_property_name_span))
-                {
-                    // found writable property to control debug level
-                    RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-                    RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                                &twin_properties->debugLevel));
-                    twin_properties->flag.debug_level_found = 1;
-                }
-                else if (az_json_token_is_text_equal(&jr.token, app_property_3_name_span))
-                {
-                    // found writable property to control property_3
-                    RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-                    RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                                &twin_properties->app_property_3));
-                    twin_properties->flag.app_property_3_found = 1;
-                }
-                else if (az_json_token_is_text_equal(&jr.token, app_property_4_name_span))
-                {
-                    // found writable property to control property_4
-                    RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-                    RETURN_ERR_IF_FAILED(az_json_token_get_int32(&jr.token,
-                                                                &twin_properties->app_property_4));
-                    twin_properties->flag.app_property_4_found = 1;
-                }
-                else if (az_json_token_is_text_equal(&jr.token, disable_telemetry_name_span))
-                {
-                    // found writable property : Disable Telemetry
-                    RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
-                    RETURN_ERR_IF_FAILED(az_json_token_get_uint32(&jr.token,
-                                                                  &twin_properties->telemetry_disable_flag));
-                    twin_properties->flag.telemetry_disable_found = 1;
-                }
-                else if (az_json_token_is_text_equal(&jr.token, iot_hub_property_desired_version))
+                property_rc = twin_property_dispatch(&jr, twin_properties);
+
+                if (property_rc == AZ_ERROR_ITEM_NOT_FOUND)
                 {
+                    if (!az_json_token_is_text_equal(&jr.token, iot_hub_property_desired_version))
+                    {
+                        twin_property_unknown(&jr.token);
+                    }
                     RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
                 }
                 else
                 {
-                    char   buffer[32];
-                    size_t spanSize = (size_t)az_span_size(jr.token.slice) + 1;
-                    size_t size     = sizeof(buffer) < spanSize ? sizeof(buffer) : spanSize;
-                    snprintf(buffer, size, "%s", az_span_ptr(jr.token.slice));
-
-                    debug_printWarn("AZURE: Received unknown property '%s'", buffer);
-                    RETURN_ERR_IF_FAILED(az_json_reader_next_token(&jr));
+                    RETURN_ERR_IF_FAILED(property_rc);
                 }
                 RETURN_ERR_WITH_MESSAGE_IF_FAILED((az_json_reader_next_token(&jr)), "az_json_reader_next_token() failed.");
             }
@@ -1408,24 +3027,17 @@ static az_span get_request_id(void)
 }
 
 /**********************************************
-* Send Reported Property 
+* Publish Reported Property
 **********************************************/
-az_result send_reported_property(
+static az_result publish_reported_property(
     twin_properties_t* twin_properties)
 {
     az_result      rc;
     az_json_writer jw;
     az_span        identifier_span;
-    int32_t        led_property_value;
+    uint8_t        index;
 
-    if (twin_properties->flag.as_uint16 == 0)
-    {
-        // Nothing to do.
-        debug_printTrace("AZURE: No property update");
-        return AZ_OK;
-    }
-
-    debug_printTrace("AZURE: Sending Property flag 0x%x", twin_properties->flag.as_uint16);
+    debug_printTrace("AZURE: Sending Property flag 0x%lx", twin_properties->flag.as_uint32);
 
     // Clear buffer and initialize JSON Payload. This creates "{"
     memset(pnp_property_payload_buffer, 0, sizeof(pnp_property_payload_buffer));
@@ -1434,150 +3046,10 @@ az_result send_reported_property(
     rc = start_json_object(&jw, payload_span);
     RETURN_ERR_WITH_MESSAGE_IF_FAILED(rc, "AZURE:Unable to initialize json writer for property PATCH");
 
-    if (twin_properties->flag.telemetry_interval_found)
-    {
-        if (az_result_failed(
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                rc = append_reported_property_response_int32(
-                    &jw,
-                    property_telemetry_interval_span,
-                    telemetryInterval,
-                    AZ_IOT_STATUS_OK,
-                    twin_properties->version_num,
-                    resp_success_span)))
-#else
-                rc = append_json_property_int32(
-                    &jw,
-                    property_telemetry_interval_span,
-                    telemetryInterval)))
-#endif
-        {
-            debug_printError("AZURE: Unable to add property for telemetry interval, return code 0x%08x", rc);
-            return rc;
-        }
-    }
-    else if (twin_properties->flag.is_initial_get)
-    {
-        if (az_result_failed(
-
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                rc = append_reported_property_response_int32(
-                    &jw,
-                    property_telemetry_interval_span,
-                    telemetryInterval,
-                    AZ_IOT_STATUS_OK,
-                    1,
-                    resp_success_span)))
-#else
-                rc = append_json_property_int32(
-                    &jw,
-                    property_telemetry_interval_span,
-                    telemetryInterval)))
-#endif
-        {
-            debug_printError("AZURE: Unable to add property for telemetry interval, return code 0x%08x", rc);
-            return rc;
-        }
-    }
-    // Add Yellow LED to the reported property
-    // Example with integer Enum
-    if (twin_properties->desired_led_yellow != LED_TWIN_NO_CHANGE)
-    {
-        led_property_value = get_led_value(led_status.state_flag.yellow);
-
-        if (az_result_failed(
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                rc = append_reported_property_response_int32(
-                    &jw,
-                    led_yellow_property_name_span,
-                    led_property_value,
-                    AZ_IOT_STATUS_OK,
-                    twin_properties->version_num,
-                    resp_success_span)))
-#else
-                rc = append_json_property_int32(
-                    &jw,
-                    led_yellow_property_name_span,
-                    led_property_value)))
-#endif
-        {
-            debug_printError("AZURE: Unable to add property for Yellow LED, return code 0x%08x", rc);
-            return rc;
-        }
-    }
-    else if (twin_properties->flag.is_initial_get)
-    {
-        led_property_value = get_led_value(led_status.state_flag.yellow);
-
-        if (az_result_failed(
-
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                rc = append_reported_property_response_int32(
-                    &jw,
-                    led_yellow_property_name_span,
-                    led_property_value,
-                    AZ_IOT_STATUS_OK,
-                    1,
-                    resp_success_span)))
-#else
-                rc = append_json_property_int32(
-                    &jw,
-                    led_yellow_property_name_span,
-                    led_property_value)))
-#endif
-        {
-            debug_printError("AZURE: Unable to add property for Yellow LED, return code 0x%08x", rc);
-            return rc;
-        }
-    }
-
-    // Set debug level
-    if (twin_properties->flag.debug_level_found)
-    {
-        debug_setSeverity((debug_severity_t)twin_properties->debugLevel);
-
-        if (az_result_failed(
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                rc = append_reported_property_response_int32(
-                    &jw,
-                    debug_level_property_name_span,
-                    (uint32_t)debug_getSeverity(),
-                    AZ_IOT_STATUS_OK,
-                    twin_properties->version_num,
-                    resp_success_span)))
-#else
-                rc = append_json_property_int32(
-                    &jw,
-                    debug_level_property_name_span,
-                    (uint32_t)debug_getSeverity)))
-#endif
-        {
-            debug_printError("AZURE: Unable to add property for Debug Level, return code 0x%08x", rc);
-            return rc;
-        }
-    }
-    else if (twin_properties->flag.is_initial_get)
+    // Writable properties
+    for (index = 0; index < TWIN_PROPERTY_COUNT; index++)
     {
-        if (az_result_failed(
-
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                rc = append_reported_property_response_int32(
-                    &jw,
-                    debug_level_property_name_span,
-                    (uint32_t)debug_getSeverity(),
-                    AZ_IOT_STATUS_OK,
-                    1,
-                    resp_success_span)))
-#else
-                rc = append_json_property_int32(
-                    &jw,
-                    debug_level_property_name_span,
-                    (uint32_t)debug_getSeverity())))
-#endif
-        {
-            debug_printError("AZURE: Unable to add property for Debug Level, return code 0x%08x", rc);
-            return rc;
-        }
+        RETURN_ERR_IF_FAILED(append_twin_property(&jw, &twin_property_table[index], twin_properties));
     }
 
     // Add Red LED
@@ -1666,97 +3138,6 @@ az_result send_reported_property(
         }
     }
 
-    if (twin_properties->flag.is_initial_get || twin_properties->flag.app_property_3_found != 0)
-    {
-        if (twin_properties->flag.app_property_3_found != 0)
-        {
-            char messageString[11 + 8 + 1]; // 11 for 'property 3,' + 8 for uint32 in string in hex + null
-
-            sprintf(messageString, "property 3,%lx\4", twin_properties->app_property_3);
-            debug_disable(true);
-            SYS_CONSOLE_Message(0, messageString);
-            debug_disable(false);
-
-            if (az_result_failed(
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                    rc = append_reported_property_response_int32(
-                        &jw,
-                        app_property_3_name_span,
-                        twin_properties->app_property_3,
-                        AZ_IOT_STATUS_OK,
-                        twin_properties->version_num,
-                        resp_success_span)))
-#else
-                    rc = append_json_property_int32(
-                        &jw,
-                        app_property_3_name_span,
-                        twin_properties->app_property_3)))
-#endif
-            {
-                debug_printError("AZURE: Unable to add property for App MCU Property 3, return code 0x%08x", rc);
-                return rc;
-            }
-        }
-    }
-
-    if (twin_properties->flag.is_initial_get || twin_properties->flag.app_property_4_found != 0)
-    {
-        if (twin_properties->flag.app_property_4_found != 0)
-        {
-            char messageString[11 + 8 + 1]; // 11 for 'property 3,' + 8 for uint32 in string in hex + null
-
-            sprintf(messageString, "property 4,%lx\4", twin_properties->app_property_4);
-            debug_disable(true);
-            SYS_CONSOLE_Message(0, messageString);
-            debug_disable(false);
-
-            if (az_result_failed(
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                    rc = append_reported_property_response_int32(
-                        &jw,
-                        app_property_4_name_span,
-                        twin_properties->app_property_4,
-                        AZ_IOT_STATUS_OK,
-                        twin_properties->version_num,
-                        resp_success_span)))
-#else
-                    rc = append_json_property_int32(
-                        &jw,
-                        app_property_4_name_span,
-                        twin_properties->app_property_4)))
-#endif
-            {
-                debug_printError("AZURE: Unable to add property for App MCU Property 4, return code 0x%08x", rc);
-                return rc;
-            }
-        }
-    }
-
-    if (twin_properties->flag.is_initial_get || twin_properties->flag.telemetry_disable_found != 0)
-    {
-        telemetry_disable_flag = twin_properties->telemetry_disable_flag;
-
-        if (az_result_failed(
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-                rc = append_reported_property_response_int32(
-                    &jw,
-                    disable_telemetry_name_span,
-                    telemetry_disable_flag,
-                    AZ_IOT_STATUS_OK,
-                    twin_properties->version_num,
-                    resp_success_span)))
-#else
-                rc = append_json_property_int32(
-                    &jw,
-                    disable_telemetry_name_span,
-                    telemetry_disable_flag)))
-#endif
-        {
-            debug_printError("AZURE: Unable to add property for Telemetry Disabled Flag, return code 0x%08x", rc);
-            return rc;
-        }
-    }
-
     if (twin_properties->flag.is_initial_get)
     {
         tstrM2mRev fwInfo;
@@ -1814,33 +3195,151 @@ az_result send_reported_property(
                                                             NULL);
     RETURN_ERR_WITH_MESSAGE_IF_FAILED(rc, "AZURE:Failed to get property PATCH topic");
 
+    // The response carries the same request id
+    snprintf(reported_inflight_id, sizeof(reported_inflight_id), "%.*s",
+             az_span_size(identifier_span), az_span_ptr(identifier_span));
+
     // Send the reported property
-    CLOUD_publishData((uint8_t*)pnp_property_topic_buffer,
-                      az_span_ptr(property_payload_span),
-                      az_span_size(property_payload_span),
-                      1);
+    if (!CLOUD_publishData((uint8_t*)pnp_property_topic_buffer,
+                           az_span_ptr(property_payload_span),
+                           az_span_size(property_payload_span),
+                           1))
+    {
+        // Nothing is in flight, the caller retries after another window
+        reported_inflight_id[0] = '\0';
+        return AZ_ERROR_NOT_ENOUGH_SPACE;
+    }
 
     return rc;
 }
 
-bool process_telemetry_command(int cmdIndex, char* data)
+/**********************************************
+* Send Reported Property
+* Applies received writable properties now and queues the update for
+* the next reported property PATCH
+**********************************************/
+az_result send_reported_property(
+    twin_properties_t* twin_properties)
 {
-    az_result      rc = AZ_OK;
-    az_json_writer jw;
-    char           telemetry_name_buffer[64];
-    az_span        telemetry_name_span;
-    az_span        telemetry_payload_span;
+    uint8_t index;
 
-    memset(&pnp_uart_telemetry_payload_buffer, 0, sizeof(pnp_uart_telemetry_payload_buffer));
-    start_json_object(&jw, AZ_SPAN_FROM_BUFFER(pnp_uart_telemetry_payload_buffer));
+    if (!reported_property_dirty(twin_properties))
+    {
+        // Nothing to do.
+        debug_printTrace("AZURE: No property update");
+        return AZ_OK;
+    }
+
+    if (!reported_cache_ready)
+    {
+        init_twin_data(&reported_pending);
+        init_twin_data(&reported_inflight);
+        init_twin_data(&reported_acked);
+        reported_cache_ready = true;
+    }
+
+    for (index = 0; index < TWIN_PROPERTY_COUNT; index++)
+    {
+        const twin_property_t* property = &twin_property_table[index];
+
+        if ((twin_properties->flag.as_uint32 & property->found_flag) != 0 && property->on_change != NULL)
+        {
+            property->on_change(*twin_property_value(property, twin_properties));
+        }
+    }
+
+    if (!reported_property_dirty(&reported_pending))
+    {
+        reported_pending_counter = SYS_TIME_Counter64Get();
+    }
+
+    merge_reported_property(&reported_pending, twin_properties);
+
+    debug_printTrace("AZURE: Queued property flag 0x%lx", reported_pending.flag.as_uint32);
+
+    return AZ_OK;
+}
+
+/**********************************************
+* Publish queued reported properties as one PATCH
+* once the oldest update is CFG_REPORTED_PROPERTY_WINDOW_MS old
+* and the previous PATCH has been answered
+**********************************************/
+void check_reported_property(void)
+{
+    az_result rc;
+
+    if (reported_inflight_id[0] != '\0')
+    {
+        if (SYS_TIME_CountToMS((uint32_t)(SYS_TIME_Counter64Get() - reported_inflight_counter)) < CFG_REPORTED_PROPERTY_RESPONSE_TIMEOUT_MS)
+        {
+            return;
+        }
+
+        // A late response is ignored, the updates are sent again
+        debug_printWarn("AZURE: No response to reported property PATCH %s", reported_inflight_id);
+        requeue_reported_inflight();
+    }
+
+    if (!reported_property_dirty(&reported_pending) ||
+        SYS_TIME_CountToMS((uint32_t)(SYS_TIME_Counter64Get() - reported_pending_counter)) < CFG_REPORTED_PROPERTY_WINDOW_MS)
+    {
+        return;
+    }
+
+    if (reported_pending.flag.is_initial_get || reported_pending.flag.ip_address_updated)
+    {
+        snprintf(reported_pending.ip_address, sizeof(reported_pending.ip_address), "%s", (char*)&deviceIpAddress);
+        reported_pending.flag.ip_address_updated = 1;
+    }
+
+    drop_acknowledged_values();
+
+    if (!reported_property_dirty(&reported_pending))
+    {
+        debug_printTrace("AZURE: Reported properties unchanged");
+        init_twin_data(&reported_pending);
+        return;
+    }
+
+    if (az_result_failed(rc = publish_reported_property(&reported_pending)))
+    {
+        // Keep the updates and try again after another window
+        debug_printError("AZURE: Reported property PATCH failed 0x%08x", rc);
+        reported_pending_counter = SYS_TIME_Counter64Get();
+        return;
+    }
+
+    reported_inflight         = reported_pending;
+    reported_inflight_counter = SYS_TIME_Counter64Get();
+    init_twin_data(&reported_pending);
+}
+
+/**********************************************
+* Requeue the reported property PATCH in flight
+* when the connection to IoT Hub is lost
+**********************************************/
+void reset_reported_property(void)
+{
+    if (reported_inflight_id[0] != '\0')
+    {
+        debug_printWarn("AZURE: Reported property PATCH %s lost with the connection", reported_inflight_id);
+        requeue_reported_inflight();
+    }
+}
+
+/**********************************************
+* Append the telemetry value selected by
+* cmdIndex, converted from its text form.
+**********************************************/
+static az_result append_telemetry_field(telemetry_writer_t* tw, int cmdIndex, char* data)
+{
+    char      telemetry_name_buffer[64];
+    az_span   telemetry_name_span;
+    az_result rc = AZ_OK;
 
     switch (cmdIndex)
     {
-        case 0:
-            // Reset the DTI command buffer pointer to the start of the array
-            DTI_bufferPtr = 0;
-            return true;
-        break;
         case 1:
         case 2:
         case 3:
@@ -1851,7 +3350,7 @@ bool process_telemetry_command(int cmdIndex, char* data)
             int32_t data_i = strtoll(data, 0, 16);
             sprintf(telemetry_name_buffer, "telemetry_Int_%d", cmdIndex);
             telemetry_name_span = az_span_create_from_str((char*)telemetry_name_buffer);
-            append_json_property_int32(&jw, telemetry_name_span, data_i);
+            rc = tw->encoder->append_int32(tw, telemetry_name_span, data_i);
         }
         break;
 
@@ -1863,7 +3362,7 @@ bool process_telemetry_command(int cmdIndex, char* data)
             uint64_t data_d = strtoll(data, 0, 16);
             sprintf(telemetry_name_buffer, "telemetry_Dbl_%d", cmdIndex - 4);
             telemetry_name_span = az_span_create_from_str((char*)telemetry_name_buffer);
-            append_json_property_double(&jw, telemetry_name_span, data_d);
+            rc = tw->encoder->append_double(tw, telemetry_name_span, data_d);
         }
         break;
         case 7:
@@ -1882,7 +3381,7 @@ bool process_telemetry_command(int cmdIndex, char* data)
 
             sprintf(telemetry_name_buffer, "telemetry_Flt_%d", cmdIndex - 6);
             telemetry_name_span = az_span_create_from_str((char*)telemetry_name_buffer);
-            append_json_property_float(&jw, telemetry_name_span, data_f);
+            rc = tw->encoder->append_double(tw, telemetry_name_span, data_f);
         }
         break;
         case 9:
@@ -1890,7 +3389,7 @@ bool process_telemetry_command(int cmdIndex, char* data)
             // long
             // A signed 8-byte integer
             int64_t data_l = (int64_t)strtoll(data, 0, 16);
-            append_json_property_long(&jw, telemetry_name_long, data_l);
+            rc = tw->encoder->append_long(tw, telemetry_name_long, data_l);
         }
         break;
         case 10:
@@ -1909,61 +3408,102 @@ bool process_telemetry_command(int cmdIndex, char* data)
             else
             {
                 debug_printError("AZURE: Case sensitive boolean value not 'true' or 'false' : %s", data);
-                break;
+                return AZ_ERROR_ARG;
             }
-            append_json_property_bool(&jw, telemetry_name_bool, bValue);
+            rc = tw->encoder->append_bool(tw, telemetry_name_bool, bValue);
         }
         break;
         case 11:
         {
             // string #1
-            append_json_property_string(&jw, telemetry_name_string_1, az_span_create_from_str(data));
+            rc = tw->encoder->append_string(tw, telemetry_name_string_1, az_span_create_from_str(data));
         }
         break;
         case 12:
         {
             // string #2
-            append_json_property_string(&jw, telemetry_name_string_2, az_span_create_from_str(data));
+            rc = tw->encoder->append_string(tw, telemetry_name_string_2, az_span_create_from_str(data));
         }
         break;
         case 13:
         {
             // string #3
-            append_json_property_string(&jw, telemetry_name_string_3, az_span_create_from_str(data));
+            rc = tw->encoder->append_string(tw, telemetry_name_string_3, az_span_create_from_str(data));
         }
         break;
         case 14:
         {
             // string #4
-            append_json_property_string(&jw, telemetry_name_string_4, az_span_create_from_str(data));
+            rc = tw->encoder->append_string(tw, telemetry_name_string_4, az_span_create_from_str(data));
         }
         break;
     }
 
-    end_json_object(&jw);
-    telemetry_payload_span = az_json_writer_get_bytes_used_in_destination(&jw);
+    return rc;
+}
+
+/**********************************************
+* Publish telemetry values as one message.
+* Invalid or repeated indexes are skipped.
+**********************************************/
+bool process_telemetry_fields(const telemetry_field_t* fields, int count)
+{
+    telemetry_writer_t tw;
+    az_result          rc;
+    uint32_t           appended = 0;
+    int                i;
 
-#ifdef IOT_PLUG_AND_PLAY_MODEL_ID
-    rc = az_iot_pnp_client_telemetry_get_publish_topic(&pnp_client,
-                                                       AZ_SPAN_EMPTY,
-#else
-    rc = az_iot_hub_client_telemetry_get_publish_topic(&iothub_client,
-#endif
-                                                       NULL,
-                                                       pnp_uart_telemetry_topic_buffer,
-                                                       sizeof(pnp_uart_telemetry_topic_buffer),
-                                                       NULL);
+    memset(&pnp_uart_telemetry_payload_buffer, 0, sizeof(pnp_uart_telemetry_payload_buffer));
+    telemetry_writer_init(&tw, AZ_SPAN_FROM_BUFFER(pnp_uart_telemetry_payload_buffer));
+    tw.encoder->begin_object(&tw);
 
-    if (az_result_succeeded(rc))
+    for (i = 0; i < count; i++)
+    {
+        // The index is a DTI wire byte, range check it before it is used as a shift count
+        if (fields[i].index < 1 || fields[i].index > TELEMETRY_FIELD_INDEX_MAX ||
+            (appended & (1UL << fields[i].index)) != 0)
+        {
+            debug_printError("AZURE: Telemetry index %d skipped", fields[i].index);
+            continue;
+        }
+
+        rc = append_telemetry_field(&tw, fields[i].index, fields[i].data);
+        if (rc == AZ_ERROR_NOT_ENOUGH_SPACE)
+        {
+            debug_printError("AZURE: Telemetry payload full at index %d", fields[i].index);
+            return false;
+        }
+        else if (az_result_succeeded(rc))
+        {
+            appended |= 1UL << fields[i].index;
+        }
+    }
+
+    if (appended == 0)
     {
-        CLOUD_publishData((uint8_t*)pnp_uart_telemetry_topic_buffer,
-                          az_span_ptr(telemetry_payload_span),
-                          az_span_size(telemetry_payload_span),
-                          1);
+        return false;
     }
 
+    tw.encoder->end_object(&tw);
+    publish_telemetry_payload(&tw, pnp_uart_telemetry_topic_buffer, sizeof(pnp_uart_telemetry_topic_buffer));
+
     return true;
+}
+
+bool process_telemetry_command(int cmdIndex, char* data)
+{
+    telemetry_field_t field;
+
+    if (cmdIndex == 0)
+    {
+        // Discard a partially received DTI frame
+        DTI_Reset();
+        return true;
+    }
 
+    field.index = cmdIndex;
+    field.data  = data;
+    return process_telemetry_fields(&field, 1);
 }
 
 bool send_property_from_uart(int cmdIndex, char* data)
@@ -1990,7 +3530,7 @@ bool send_property_from_uart(int cmdIndex, char* data)
             break;
     }
 
-    if (twin_properties.flag.as_uint16 != 0)
+    if (twin_properties.flag.as_uint32 != 0)
     {
         send_reported_property(&twin_properties);
     }
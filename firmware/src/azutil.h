@@ -92,22 +92,52 @@ typedef union
 {
     struct
     {
-        uint16_t version_found : 1;
-        uint16_t is_initial_get : 1;
-        uint16_t telemetry_interval_found : 1;
-        uint16_t yellow_led_found : 1;
-        uint16_t debug_level_found : 1;
-        uint16_t ip_address_updated : 1;
-        uint16_t app_property_1_updated : 1;
-        uint16_t app_property_2_updated : 1;
-        uint16_t app_property_3_found : 1;
-        uint16_t app_property_4_found : 1;
-        uint16_t telemetry_disable_found : 1;
-        uint16_t reserved : 5;
+        uint32_t version_found : 1;
+        uint32_t is_initial_get : 1;
+        uint32_t telemetry_interval_found : 1;
+        uint32_t yellow_led_found : 1;
+        uint32_t debug_level_found : 1;
+        uint32_t ip_address_updated : 1;
+        uint32_t app_property_1_updated : 1;
+        uint32_t app_property_2_updated : 1;
+        uint32_t app_property_3_found : 1;
+        uint32_t app_property_4_found : 1;
+        uint32_t telemetry_disable_found : 1;
+        uint32_t telemetry_batch_size_found : 1;
+        uint32_t telemetry_batch_flush_found : 1;
+        uint32_t telemetry_encoding_found : 1;
+        uint32_t telemetry_window_found : 1;
+        uint32_t light_deadband_found : 1;
+        uint32_t light_high_found : 1;
+        uint32_t light_low_found : 1;
+        uint32_t temperature_deadband_found : 1;
+        uint32_t temperature_high_found : 1;
+        uint32_t temperature_low_found : 1;
+        uint32_t telemetry_batch_sample_found : 1;
+        uint32_t reserved : 10;
     };
-    uint16_t as_uint16;
+    uint32_t as_uint32;
 } twin_update_flag_t;
 
+// twin_update_flag_t bits set by the writable property table in azutil.c
+#define TWIN_FLAG_TELEMETRY_INTERVAL     0x00000004
+#define TWIN_FLAG_YELLOW_LED             0x00000008
+#define TWIN_FLAG_DEBUG_LEVEL            0x00000010
+#define TWIN_FLAG_APP_PROPERTY_3         0x00000100
+#define TWIN_FLAG_APP_PROPERTY_4         0x00000200
+#define TWIN_FLAG_TELEMETRY_DISABLE      0x00000400
+#define TWIN_FLAG_TELEMETRY_BATCH_SIZE   0x00000800
+#define TWIN_FLAG_TELEMETRY_BATCH_FLUSH  0x00001000
+#define TWIN_FLAG_TELEMETRY_ENCODING     0x00002000
+#define TWIN_FLAG_TELEMETRY_WINDOW       0x00004000
+#define TWIN_FLAG_LIGHT_DEADBAND         0x00008000
+#define TWIN_FLAG_LIGHT_HIGH             0x00010000
+#define TWIN_FLAG_LIGHT_LOW              0x00020000
+#define TWIN_FLAG_TEMPERATURE_DEADBAND   0x00040000
+#define TWIN_FLAG_TEMPERATURE_HIGH       0x00080000
+#define TWIN_FLAG_TEMPERATURE_LOW        0x00100000
+#define TWIN_FLAG_TELEMETRY_BATCH_SAMPLE 0x00200000
+
 typedef struct
 {
     twin_update_flag_t flag;
@@ -122,7 +152,6 @@ typedef struct
     int32_t            app_property_2;
     int32_t            app_property_3;
     int32_t            app_property_4;
-    uint32_t           telemetry_disable_flag;
 } twin_properties_t;
 
 typedef union
@@ -145,6 +174,15 @@ typedef struct
 
 extern button_press_data_t button_press_data;
 
+#define TELEMETRY_FIELD_INDEX_MAX 14
+
+// One value of a multi-field telemetry message (DTI frame or "telemetry" CLI command)
+typedef struct
+{
+    int   index;   // telemetry index 1 ~ TELEMETRY_FIELD_INDEX_MAX, selects name and type
+    char* data;    // value text in the format of process_telemetry_command()
+} telemetry_field_t;
+
 void init_twin_data(
     twin_properties_t* twin_properties);
 
@@ -166,14 +204,21 @@ az_result append_json_property_string(
     az_span         property_val_span);
 
 void check_button_status(void);
+void check_sendMsg_relay(void);
 
 az_result send_telemetry_message(void);
+void      check_telemetry_sample(void);
+void      check_telemetry_batch(void);
+void      check_diagnostics_telemetry(void);
+void      check_telemetry_aggregation(void);
 
 az_result send_reported_property(
     twin_properties_t* twin_properties);
+void      check_reported_property(void);
+void      reset_reported_property(void);
 
 az_result process_direct_method_command(
-    uint8_t*                           payload,
+    az_span                            payload_span,
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
     az_iot_pnp_client_command_request* command_request
 #else
@@ -182,8 +227,8 @@ az_result process_direct_method_command(
     );
 
 az_result process_device_twin_property(
-    uint8_t*           topic,
-    uint8_t*           payload,
+    az_span            topic_span,
+    az_span            payload_span,
     twin_properties_t* twin_properties);
 
 void update_leds(twin_properties_t* twin_properties);
@@ -192,6 +237,10 @@ bool process_telemetry_command(
     int   cmdIndex,
     char* data);
 
+bool process_telemetry_fields(
+    const telemetry_field_t* fields,
+    int                      count);
+
 bool send_property_from_uart(
     int   cmdIndex,
     char* data);
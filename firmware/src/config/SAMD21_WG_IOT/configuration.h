@@ -132,7 +132,7 @@ extern "C" {
 #define DRV_SPI_DMA_MODE
 #define DRV_SPI_XMIT_DMA_CH_IDX0 SYS_DMA_CHANNEL_0
 #define DRV_SPI_RCV_DMA_CH_IDX0  SYS_DMA_CHANNEL_1
-#define DRV_SPI_QUEUE_SIZE_IDX0  4
+#define DRV_SPI_QUEUE_SIZE_IDX0  8
 
 /* SPI Driver Common Configuration Options */
 #define DRV_SPI_INSTANCES_NUMBER 1
@@ -64,6 +64,7 @@
 #include "peripheral/eic/plib_eic.h"
 #include "peripheral/rtc/plib_rtc.h"
 #include "peripheral/tc/plib_tc3.h"
+#include "peripheral/tc/plib_tc4.h"
 #include "system/time/sys_time.h"
 #include "system/console/sys_console.h"
 #include "system/console/src/sys_console_uart_definitions.h"
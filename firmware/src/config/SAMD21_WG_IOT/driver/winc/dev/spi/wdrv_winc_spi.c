@@ -39,6 +39,7 @@
 #include "definitions.h"
 #include "osal/osal.h"
 #include "wdrv_winc_common.h"
+#include "wdrv_winc_spi.h"
 
 #if defined(USE_CACHE_MAINTENANCE)
 /* Cache Management to be enabled in core & system components of MHC Project Graph*/
@@ -60,9 +61,15 @@
 #define SPI_DMA_DCACHE_CLEAN(addr, size) do { } while (0)
 #endif /* (DRV_SPI_DMA != 0) */
 
+/* Transfers queued by WDRV_WINC_SPIQueueSend/Receive before the caller waits */
+#define SPI_QUEUE_MAX_TRANSFERS DRV_SPI_QUEUE_SIZE_IDX0
+
 static DRV_HANDLE spiHandle = DRV_HANDLE_INVALID;
 static OSAL_SEM_HANDLE_TYPE txSyncSem;
 static OSAL_SEM_HANDLE_TYPE rxSyncSem;
+static OSAL_SEM_HANDLE_TYPE queueSyncSem;
+static uint8_t queuedTransfers = 0;
+static volatile bool queueError = false;
 
 #if defined(__PIC32MZ__) && defined(USE_CACHE_MAINTENANCE)
 /****************************************************************************
@@ -125,6 +132,34 @@ static bool _SPI_Rx(unsigned char *const buf, uint32_t size)
     return true;
 }
 
+/* Adds a transfer behind the ones already queued. The SPI driver starts
+   each one from the DMA completion interrupt of the previous one. */
+static bool _SPI_QueueAdd(unsigned char *txBuf, uint32_t txSize, unsigned char *rxBuf, uint32_t rxSize)
+{
+    DRV_SPI_TRANSFER_HANDLE transferHandle;
+
+    /* The driver queue is full, wait for it to drain */
+    if ((SPI_QUEUE_MAX_TRANSFERS == queuedTransfers) && (false == WDRV_WINC_SPIQueueFlush()))
+    {
+        return false;
+    }
+
+    SPI_DMA_DCACHE_CLEAN(txBuf, txSize);
+    SPI_DMA_DCACHE_CLEAN(rxBuf, rxSize);
+
+    DRV_SPI_WriteReadTransferAdd(spiHandle, txBuf, txSize, rxBuf, rxSize, &transferHandle);
+
+    if (transferHandle == DRV_SPI_TRANSFER_HANDLE_INVALID)
+    {
+        queueError = true;
+        return false;
+    }
+
+    queuedTransfers++;
+
+    return true;
+}
+
 static void _WDRV_WINC_SPITransferEventHandler(DRV_SPI_TRANSFER_EVENT event,
         DRV_SPI_TRANSFER_HANDLE handle, uintptr_t context)
 {
@@ -144,11 +179,20 @@ static void _WDRV_WINC_SPITransferEventHandler(DRV_SPI_TRANSFER_EVENT event,
             {
                 OSAL_SEM_PostISR(&rxSyncSem);
             }
+            else
+            {
+                OSAL_SEM_PostISR(&queueSyncSem);
+            }
 
             break;
 
         case DRV_SPI_TRANSFER_EVENT_ERROR:
             // Error handling here.
+            if ((transferTxHandle != handle) && (transferRxHandle != handle))
+            {
+                queueError = true;
+                OSAL_SEM_PostISR(&queueSyncSem);
+            }
             break;
 
         default:
@@ -212,6 +256,86 @@ bool WDRV_WINC_SPIReceive(unsigned char *const buf, uint32_t size)
     return ret;
 }
 
+/****************************************************************************
+ * Function:        WDRV_WINC_SPIQueueSend
+ * Summary: Queues data to send to the module without waiting for the bus.
+ *****************************************************************************/
+bool WDRV_WINC_SPIQueueSend(unsigned char *const buf, uint32_t size)
+{
+    bool ret = true;
+    unsigned char *pData;
+
+    pData = buf;
+
+#ifdef DRV_SPI_DMA_MODE
+    while ((true == ret) && (size > SPI_DMA_MAX_TX_SIZE))
+    {
+        ret = _SPI_QueueAdd(pData, SPI_DMA_MAX_TX_SIZE, NULL, 0);
+        size -= SPI_DMA_MAX_TX_SIZE;
+        pData += SPI_DMA_MAX_TX_SIZE;
+    }
+#endif
+
+    if ((true == ret) && (size > 0))
+    {
+        ret = _SPI_QueueAdd(pData, size, NULL, 0);
+    }
+
+    return ret;
+}
+
+/****************************************************************************
+ * Function:        WDRV_WINC_SPIQueueReceive
+ * Summary: Queues a receive from the module without waiting for the bus.
+ *****************************************************************************/
+bool WDRV_WINC_SPIQueueReceive(unsigned char *const buf, uint32_t size)
+{
+    static uint8_t dummy = 0;
+    bool ret = true;
+    unsigned char *pData;
+
+    pData = buf;
+
+#ifdef DRV_SPI_DMA_MODE
+    while ((true == ret) && (size > SPI_DMA_MAX_RX_SIZE))
+    {
+        ret = _SPI_QueueAdd(&dummy, 1, pData, SPI_DMA_MAX_RX_SIZE);
+        size -= SPI_DMA_MAX_RX_SIZE;
+        pData += SPI_DMA_MAX_RX_SIZE;
+    }
+#endif
+
+    if ((true == ret) && (size > 0))
+    {
+        ret = _SPI_QueueAdd(&dummy, 1, pData, size);
+    }
+
+    return ret;
+}
+
+/****************************************************************************
+ * Function:        WDRV_WINC_SPIQueueFlush
+ * Summary: Waits until every queued transfer has completed.
+ *****************************************************************************/
+bool WDRV_WINC_SPIQueueFlush(void)
+{
+    bool ret;
+
+    while (queuedTransfers > 0)
+    {
+        while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&queueSyncSem, OSAL_WAIT_FOREVER))
+        {
+        }
+
+        queuedTransfers--;
+    }
+
+    ret = (false == queueError);
+    queueError = false;
+
+    return ret;
+}
+
 /****************************************************************************
  * Function:        WDRV_WINC_SPIInitialize
  * Summary: Initializes the SPI object for the WiFi driver.
@@ -228,6 +352,11 @@ void WDRV_WINC_SPIInitialize(void)
         return;
     }
 
+    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&queueSyncSem, OSAL_SEM_TYPE_COUNTING, SPI_QUEUE_MAX_TRANSFERS, 0))
+    {
+        return;
+    }
+
     if (DRV_HANDLE_INVALID == spiHandle)
     {
         spiHandle = DRV_SPI_Open(WDRV_WINC_SPI_INDEX, DRV_IO_INTENT_READWRITE | DRV_IO_INTENT_BLOCKING);
@@ -253,6 +382,9 @@ void WDRV_WINC_SPIDeinitialize(void)
     OSAL_SEM_Post(&rxSyncSem);
     OSAL_SEM_Delete(&rxSyncSem);
 
+    OSAL_SEM_Post(&queueSyncSem);
+    OSAL_SEM_Delete(&queueSyncSem);
+
     DRV_SPI_Close(spiHandle);
 }
 
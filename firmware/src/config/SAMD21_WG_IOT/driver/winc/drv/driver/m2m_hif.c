@@ -265,9 +265,48 @@ int8_t hif_deinit(void * arg)
 
 int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16CtrlBufSize,
                uint8_t *pu8DataBuf,uint16_t u16DataSize, uint16_t u16DataOffset)
+{
+    tstrHifDataSeg strSeg;
+
+    strSeg.pu8Buf   = pu8DataBuf;
+    strSeg.u16Size  = u16DataSize;
+
+    return hif_send_segments(u8Gid, u8Opcode, pu8CtrlBuf, u16CtrlBufSize,
+                             &strSeg, (pu8DataBuf != NULL) ? 1 : 0, u16DataOffset);
+}
+/**
+*   @fn     int8_t hif_send_segments(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16CtrlBufSize,
+                       tstrHifDataSeg *pstrSegs,uint8_t u8SegCount, uint16_t u16DataOffset)
+*   @brief  Send packet using host interface, gathering the data from several caller buffers.
+
+*   @param [in] u8Gid
+*               Group ID.
+*   @param [in] u8Opcode
+*               Operation ID.
+*   @param [in] pu8CtrlBuf
+*               Pointer to the Control buffer.
+*   @param [in] u16CtrlBufSize
+                Control buffer size.
+*   @param [in] pstrSegs
+*               Data segments, written back to back starting at u16DataOffset.
+*   @param [in] u8SegCount
+                Number of data segments, ZERO for a control only packet.
+*   @param [in] u16DataOffset
+                Packet Data offset.
+*    @return        The function shall return ZERO for successful operation and a negative value otherwise.
+*/
+int8_t hif_send_segments(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16CtrlBufSize,
+               tstrHifDataSeg *pstrSegs,uint8_t u8SegCount, uint16_t u16DataOffset)
 {
     int8_t     ret = M2M_ERR_SEND;
     tstrHifHdr strHif;
+    uint16_t   u16DataSize = 0;
+    uint8_t    u8Seg;
+
+    for(u8Seg = 0; u8Seg < u8SegCount; u8Seg++)
+    {
+        u16DataSize += pstrSegs[u8Seg].u16Size;
+    }
 
     while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&hifSemaphore, OSAL_WAIT_FOREVER))
     {
@@ -276,7 +315,7 @@ int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16C
     strHif.u8Opcode     = u8Opcode&(~NBIT7);
     strHif.u8Gid        = u8Gid;
     strHif.u16Length    = M2M_HIF_HDR_OFFSET;
-    if(pu8DataBuf != NULL)
+    if(u8SegCount != 0)
     {
         strHif.u16Length += u16DataOffset + u16DataSize;
     }
@@ -347,12 +386,16 @@ int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16C
                     if(M2M_SUCCESS != ret) goto ERR1;
                     u32CurrAddr += u16CtrlBufSize;
                 }
-                if(pu8DataBuf != NULL)
+                if(u8SegCount != 0)
                 {
                     u32CurrAddr += (u16DataOffset - u16CtrlBufSize);
-                    ret = nm_write_block(u32CurrAddr, pu8DataBuf, u16DataSize);
-                    if(M2M_SUCCESS != ret) goto ERR1;
-                    u32CurrAddr += u16DataSize;
+                    for(u8Seg = 0; u8Seg < u8SegCount; u8Seg++)
+                    {
+                        if(pstrSegs[u8Seg].u16Size == 0) continue;
+                        ret = nm_write_block(u32CurrAddr, pstrSegs[u8Seg].pu8Buf, pstrSegs[u8Seg].u16Size);
+                        if(M2M_SUCCESS != ret) goto ERR1;
+                        u32CurrAddr += pstrSegs[u8Seg].u16Size;
+                    }
                 }
 
                 reg = dma_addr << 2;
@@ -42,6 +42,7 @@
 #include "nmasic.h"
 #include "wdrv_winc_common.h"
 #include "wdrv_winc_spi.h"
+#include "system/time/sys_time.h"
 
 #define NMI_PERIPH_REG_BASE 0x1000
 #define NMI_INTR_REG_BASE (NMI_PERIPH_REG_BASE+0xa00)
@@ -94,6 +95,8 @@ static uint8_t gu8Crc_off = 0;
 
 static OSAL_MUTEX_HANDLE_TYPE s_spiLock = 0;
 
+static tstrNmSpiStats gstrSpiStats;
+
 static inline int8_t spi_read(uint8_t *b, uint16_t sz)
 {
     if (true == WDRV_WINC_SPIReceive((unsigned char *const) b, sz))
@@ -360,8 +363,10 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
 {
     int16_t retry, ix, nbytes;
     int8_t result = N_OK;
-    uint8_t crc[2];
-    uint8_t rsp;
+    uint8_t trailer[3];
+    uint8_t trailerLen;
+    uint8_t rsp = 0;
+    bool queued;
 
     /**
         Data
@@ -374,56 +379,61 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
             nbytes = DATA_PKT_SZ;
 
         /**
-            Data Response header
+            Data Response header, already read with the previous chunk's Crc
         **/
-        retry = SPI_RESP_RETRY_COUNT;
-        do
+        if ((rsp & 0xf0) != 0xf0)
         {
-            if (N_OK != spi_read(&rsp, 1))
+            retry = SPI_RESP_RETRY_COUNT;
+            do
             {
-                M2M_ERR("  M2M: [spi_data_read]: Failed data response read, bus error...");
-                result = N_FAIL;
-                break;
+                if (N_OK != spi_read(&rsp, 1))
+                {
+                    M2M_ERR("  M2M: [spi_data_read]: Failed data response read, bus error...");
+                    result = N_FAIL;
+                    break;
+                }
+                if ((rsp & 0xf0) == 0xf0)
+                    break;
             }
-            if ((rsp & 0xf0) == 0xf0)
-                break;
-        }
-        while (retry--);
+            while (retry--);
 
-        if (result == N_FAIL)
-            break;
+            if (result == N_FAIL)
+                break;
 
-        if (retry <= 0)
-        {
-            M2M_ERR("  M2M: [spi_data_read]: Failed data response read...(%02x)", rsp);
-            result = N_FAIL;
-            break;
+            if (retry <= 0)
+            {
+                M2M_ERR("  M2M: [spi_data_read]: Failed data response read...(%02x)", rsp);
+                result = N_FAIL;
+                break;
+            }
         }
 
         /**
-            Read bytes
+            Read bytes, Crc and the next chunk's response header back to back
         **/
-        if (N_OK != spi_read(&b[ix], nbytes))
+        trailerLen = 0;
+        if ((!clockless) && (!gu8Crc_off))
+            trailerLen = 2;
+        if (sz > nbytes)
+            trailerLen++;
+
+        queued = WDRV_WINC_SPIQueueReceive(&b[ix], nbytes);
+        if ((true == queued) && (trailerLen > 0))
+            queued = WDRV_WINC_SPIQueueReceive(trailer, trailerLen);
+        if (false == WDRV_WINC_SPIQueueFlush())
+            queued = false;
+
+        if (false == queued)
         {
             M2M_ERR("  M2M: [spi_data_read]: Failed data block read, bus error...");
             result = N_FAIL;
             break;
         }
-        if(!clockless)
-        {
-            /**
-            Read Crc
-            **/
-            if (!gu8Crc_off)
-            {
-                if (N_OK != spi_read(crc, 2))
-                {
-                    M2M_ERR("  M2M: [spi_data_read]: Failed data block CRC read, bus error...");
-                    result = N_FAIL;
-                    break;
-                }
-            }
-        }
+
+        rsp = 0;
+        if (sz > nbytes)
+            rsp = trailer[trailerLen - 1];
+
         ix += nbytes;
         sz -= nbytes;
 
@@ -432,13 +442,18 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
     return result;
 }
 
+/*
+    Queues command, data and Crc of every chunk. The caller queues the data
+    response and flushes.
+*/
 static int8_t spi_data_write(uint8_t *b, uint16_t sz)
 {
+    static uint8_t cmd[4] = {0xf0, 0xf1, 0xf2, 0xf3};
+    static uint8_t crc[2] = {0};
     int16_t ix = 0;
     uint16_t nbytes;
     int8_t result = N_OK;
-    uint8_t cmd, order, crc[2] = {0};
-    //uint8_t rsp;
+    uint8_t order;
 
     /**
         Data
@@ -453,7 +468,6 @@ static int8_t spi_data_write(uint8_t *b, uint16_t sz)
         /**
             Write command
         **/
-        cmd = 0xf0;
         if (ix == 0)
         {
             if (sz <= DATA_PKT_SZ)
@@ -469,8 +483,7 @@ static int8_t spi_data_write(uint8_t *b, uint16_t sz)
                 order = 0x2;
         }
 
-        cmd |= order;
-        if (N_OK != spi_write(&cmd, 1))
+        if (false == WDRV_WINC_SPIQueueSend(&cmd[order], 1))
         {
             M2M_ERR("  M2M: [spi_data_write]: Failed data block cmd write, bus error...");
             result = N_FAIL;
@@ -480,7 +493,7 @@ static int8_t spi_data_write(uint8_t *b, uint16_t sz)
         /**
             Write data
         **/
-        if (N_OK != spi_write(&b[ix], nbytes))
+        if (false == WDRV_WINC_SPIQueueSend(&b[ix], nbytes))
         {
             M2M_ERR("  M2M: [spi_data_write]: Failed data block write, bus error...");
             result = N_FAIL;
@@ -492,7 +505,7 @@ static int8_t spi_data_write(uint8_t *b, uint16_t sz)
         **/
         if (!gu8Crc_off)
         {
-            if (N_OK != spi_write(crc, 2))
+            if (false == WDRV_WINC_SPIQueueSend(crc, 2))
             {
                 M2M_ERR("  M2M: [spi_data_write]: Failed data block CRC write, bus error...");
                 result = N_FAIL;
@@ -552,6 +565,7 @@ static int8_t spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
 {
     uint8_t len;
     uint8_t rsp[3];
+    bool queued;
 
     /**
         Command
@@ -573,18 +587,23 @@ static int8_t spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
     **/
     if (spi_data_write(puBuf, u16Sz) != N_OK)
     {
+        WDRV_WINC_SPIQueueFlush();
         M2M_ERR("  M2M: [spi_write_block]: Failed block data write...");
         return N_FAIL;
     }
     /**
-        Data RESP
+        Data RESP, read right after the last Crc
     **/
     if (!gu8Crc_off)
         len = 2;
     else
         len = 3;
 
-    if (N_OK != spi_read(&rsp[0], len))
+    queued = WDRV_WINC_SPIQueueReceive(&rsp[0], len);
+    if (false == WDRV_WINC_SPIQueueFlush())
+        queued = false;
+
+    if (false == queued)
     {
         M2M_ERR("  M2M: [spi_write_block]: Failed bus error...");
         return N_FAIL;
@@ -670,6 +689,13 @@ static int8_t spi_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
     return N_OK;
 }
 
+static void spi_stats_add(uint32_t *pu32Blocks, uint32_t *pu32Bytes, uint32_t *pu32TimeUs, uint16_t u16Sz, uint64_t u64Start)
+{
+    (*pu32Blocks)++;
+    *pu32Bytes += u16Sz;
+    *pu32TimeUs += SYS_TIME_CountToUS((uint32_t)(SYS_TIME_Counter64Get() - u64Start));
+}
+
 static void spi_init_pkt_sz(void)
 {
     uint32_t val32;
@@ -904,10 +930,13 @@ int8_t nm_spi_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
     uint8_t retry = SPI_RETRY_COUNT;
     uint8_t tmpBuf[2] = {0,0};
     uint8_t *puTmpBuf;
+    uint64_t u64Start;
 
     if (OSAL_RESULT_TRUE != OSAL_MUTEX_Lock(&s_spiLock, OSAL_WAIT_FOREVER))
         return M2M_ERR_BUS_FAIL;
 
+    u64Start = SYS_TIME_Counter64Get();
+
     if (u16Sz == 1)
     {
         u16Sz = 2;
@@ -922,6 +951,7 @@ int8_t nm_spi_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
     {
         if (spi_read_block(u32Addr, puTmpBuf, u16Sz) == N_OK)
         {
+            spi_stats_add(&gstrSpiStats.u32BlockReads, &gstrSpiStats.u32BytesRead, &gstrSpiStats.u32ReadTimeUs, u16Sz, u64Start);
             OSAL_MUTEX_Unlock(&s_spiLock);
 
             if (puTmpBuf == tmpBuf)
@@ -931,6 +961,7 @@ int8_t nm_spi_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
         }
 
         M2M_ERR("  M2M: Reset and retry %d %x %d", retry, u32Addr, u16Sz);
+        gstrSpiStats.u32Retries++;
         spi_reset();
     }
 
@@ -956,10 +987,13 @@ int8_t nm_spi_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
 int8_t nm_spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
 {
     uint8_t retry = SPI_RETRY_COUNT;
+    uint64_t u64Start;
 
     if (OSAL_RESULT_TRUE != OSAL_MUTEX_Lock(&s_spiLock, OSAL_WAIT_FOREVER))
         return M2M_ERR_BUS_FAIL;
 
+    u64Start = SYS_TIME_Counter64Get();
+
     //Workaround hardware problem with single byte transfers over SPI bus
     if (u16Sz == 1)
         u16Sz = 2;
@@ -968,12 +1002,14 @@ int8_t nm_spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
     {
         if (spi_write_block(u32Addr, puBuf, u16Sz) == N_OK)
         {
+            spi_stats_add(&gstrSpiStats.u32BlockWrites, &gstrSpiStats.u32BytesWritten, &gstrSpiStats.u32WriteTimeUs, u16Sz, u64Start);
             OSAL_MUTEX_Unlock(&s_spiLock);
 
             return M2M_SUCCESS;
         }
 
         M2M_ERR("  M2M: Reset and retry %d %x %d", retry, u32Addr, u16Sz);
+        gstrSpiStats.u32Retries++;
         spi_reset();
     }
 
@@ -982,4 +1018,25 @@ int8_t nm_spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
     return M2M_ERR_BUS_FAIL;
 }
 
+/*
+*   @fn     nm_spi_get_stats
+*   @brief  Get block transfer statistics
+*   @param [out]    pstrStats
+*               Pointer to the structure receiving the statistics
+*   @param [in] bClear
+*               Restart the statistics after reading them
+*/
+void nm_spi_get_stats(tstrNmSpiStats *pstrStats, bool bClear)
+{
+    if (OSAL_RESULT_TRUE != OSAL_MUTEX_Lock(&s_spiLock, OSAL_WAIT_FOREVER))
+        return;
+
+    *pstrStats = gstrSpiStats;
+
+    if (bClear)
+        memset(&gstrSpiStats, 0, sizeof(gstrSpiStats));
+
+    OSAL_MUTEX_Unlock(&s_spiLock);
+}
+
 //DOM-IGNORE-END
@@ -783,6 +783,72 @@ int16_t send(SOCKET sock, void *pvSendBuffer, uint16_t u16SendLength, uint16_t f
     return s16Ret;
 }
 /*********************************************************************
+Function
+        sendv
+
+Description
+        Gathering variant of send. The buffers are handed to the HIF
+        as separate data segments instead of being copied together.
+
+Return
+        SOCK_ERR_NO_ERROR on success, a negative error code otherwise.
+*********************************************************************/
+int16_t sendv(SOCKET sock, tstrSocketIovec *pstrIov, uint8_t u8IovCount, uint16_t flags)
+{
+    int16_t s16Ret = SOCK_ERR_INVALID_ARG;
+    tstrHifDataSeg  astrSegs[SOCKET_IOV_MAX];
+    uint32_t        u32SendLength = 0;
+    uint8_t         u8Idx;
+
+    if((sock < 0) || (pstrIov == NULL) || (u8IovCount == 0) || (u8IovCount > SOCKET_IOV_MAX) || (gastrSockets[sock].bIsUsed != 1))
+    {
+        return s16Ret;
+    }
+
+    for(u8Idx = 0; u8Idx < u8IovCount; u8Idx++)
+    {
+        if((pstrIov[u8Idx].pvBuf == NULL) && (pstrIov[u8Idx].u16Len != 0))
+        {
+            return s16Ret;
+        }
+        astrSegs[u8Idx].pu8Buf  = (uint8_t*)pstrIov[u8Idx].pvBuf;
+        astrSegs[u8Idx].u16Size = pstrIov[u8Idx].u16Len;
+        u32SendLength += pstrIov[u8Idx].u16Len;
+    }
+
+    if(u32SendLength <= SOCKET_BUFFER_MAX_LENGTH)
+    {
+        uint16_t        u16DataOffset;
+        tstrSendCmd     strSend;
+        uint8_t         u8Cmd;
+
+        u8Cmd           = SOCKET_CMD_SEND;
+        u16DataOffset   = TCP_TX_PACKET_OFFSET;
+
+        strSend.sock            = sock;
+        strSend.u16DataSize     = NM_BSP_B_L_16((uint16_t)u32SendLength);
+        strSend.u16SessionID    = gastrSockets[sock].u16SessionID;
+
+        if(sock >= TCP_SOCK_MAX)
+        {
+            u16DataOffset = UDP_TX_PACKET_OFFSET;
+        }
+        if(gastrSockets[sock].u8SSLFlags & SSL_FLAGS_ACTIVE)
+        {
+            u8Cmd           = SOCKET_CMD_SSL_SEND;
+            u16DataOffset   = gastrSockets[sock].u16DataOffset;
+        }
+
+        s16Ret = hif_send_segments(M2M_REQ_GROUP_IP, u8Cmd|M2M_REQ_DATA_PKT, (uint8_t*)&strSend, sizeof(tstrSendCmd),
+                                   astrSegs, u8IovCount, u16DataOffset);
+        if(s16Ret != SOCK_ERR_NO_ERROR)
+        {
+            s16Ret = SOCK_ERR_BUFFER_FULL;
+        }
+    }
+    return s16Ret;
+}
+/*********************************************************************
 Function
         sendto
 
@@ -94,6 +94,90 @@ bool WDRV_WINC_SPISend(unsigned char *const buf, uint32_t size);
  */
 bool WDRV_WINC_SPIReceive(unsigned char *const buf, uint32_t size);
 
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPIQueueSend(unsigned char *const buf, uint32_t size)
+
+  Summary:
+    Queues data to send to the module through the SPI bus.
+
+  Description:
+    This function adds a send behind the transfers already queued and returns
+    without waiting. The SPI driver starts each queued transfer from the DMA
+    completion of the previous one.
+
+  Precondition:
+    WDRV_WINC_SPIInitialize must have been called.
+
+  Parameters:
+    buf  - buffer pointer of output data, must stay valid until
+           WDRV_WINC_SPIQueueFlush returns
+    size - the output data size
+
+  Returns:
+    true  - Indicates success
+    false - Indicates failure
+
+  Remarks:
+    WDRV_WINC_SPISend and WDRV_WINC_SPIReceive must not be called until the
+    queue has been flushed.
+ */
+bool WDRV_WINC_SPIQueueSend(unsigned char *const buf, uint32_t size);
+
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPIQueueReceive(unsigned char *const buf, uint32_t size)
+
+  Summary:
+    Queues a receive from the module through the SPI bus.
+
+  Description:
+    This function adds a receive behind the transfers already queued and
+    returns without waiting.
+
+  Precondition:
+    WDRV_WINC_SPIInitialize must have been called.
+
+  Parameters:
+    buf  - buffer pointer of input data, filled when WDRV_WINC_SPIQueueFlush
+           returns
+    size - the input data size
+
+  Returns:
+    true  - Indicates success
+    false - Indicates failure
+
+  Remarks:
+    None.
+ */
+bool WDRV_WINC_SPIQueueReceive(unsigned char *const buf, uint32_t size);
+
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPIQueueFlush(void)
+
+  Summary:
+    Waits for the queued SPI transfers.
+
+  Description:
+    This function waits until every transfer queued by WDRV_WINC_SPIQueueSend
+    and WDRV_WINC_SPIQueueReceive has completed.
+
+  Precondition:
+    WDRV_WINC_SPIInitialize must have been called.
+
+  Returns:
+    true  - Indicates every queued transfer succeeded
+    false - Indicates a transfer could not be queued or failed
+
+  Remarks:
+    Must also be called after a queue function failed.
+ */
+bool WDRV_WINC_SPIQueueFlush(void);
+
 //*******************************************************************************
 /*
   Function:
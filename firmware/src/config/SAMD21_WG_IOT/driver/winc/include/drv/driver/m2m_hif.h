@@ -81,6 +81,17 @@ typedef struct
                 HIF group type.
 */
 typedef void (*tpfHifCallBack)(uint8_t u8OpCode, uint16_t u16DataSize, uint32_t u32Addr);
+/*!
+@struct \
+    tstrHifDataSeg
+@brief
+    One caller buffer of a scattered HIF data payload, see @ref hif_send_segments.
+*/
+typedef struct
+{
+    uint8_t   *pu8Buf;  /*!< Segment data */
+    uint16_t  u16Size;  /*!< Segment length in bytes */
+}tstrHifDataSeg;
 /**
 *   @fn         int8_t hif_init(void * arg);
 *   @brief
@@ -125,6 +136,31 @@ int8_t hif_deinit(void * arg);
 int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16CtrlBufSize,
                        uint8_t *pu8DataBuf,uint16_t u16DataSize, uint16_t u16DataOffset);
 /**
+*   @fn     int8_t hif_send_segments(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16CtrlBufSize,
+                       tstrHifDataSeg *pstrSegs,uint8_t u8SegCount, uint16_t u16DataOffset)
+*   @brief  Send packet using host interface. The data is gathered from several
+            caller buffers, written back to back, so the caller does not need a
+            contiguous staging copy.
+
+*   @param [in] u8Gid
+*               Group ID.
+*   @param [in] u8Opcode
+*               Operation ID.
+*   @param [in] pu8CtrlBuf
+*               Pointer to the Control buffer.
+*   @param [in] u16CtrlBufSize
+                Control buffer size.
+*   @param [in] pstrSegs
+*               Data segments Allocated by the caller.
+*   @param [in] u8SegCount
+                Number of data segments, ZERO for a control only packet.
+*   @param [in] u16DataOffset
+                Packet Data offset.
+*    @return    The function shall return ZERO for successful operation and a negative value otherwise.
+*/
+int8_t hif_send_segments(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16CtrlBufSize,
+                       tstrHifDataSeg *pstrSegs,uint8_t u8SegCount, uint16_t u16DataOffset);
+/**
 *   @fn     hif_receive
 *   @brief  Host interface interrupt service routine
 *   @param [in] u32Addr
@@ -45,6 +45,21 @@
      extern "C" {
 #endif
 
+/**
+*   @struct tstrNmSpiStats
+*   @brief  Block transfer statistics. Times run from taking the bus to the
+*           last byte and include the command and response phases.
+*/
+typedef struct {
+    uint32_t u32BlockReads;
+    uint32_t u32BytesRead;
+    uint32_t u32ReadTimeUs;
+    uint32_t u32BlockWrites;
+    uint32_t u32BytesWritten;
+    uint32_t u32WriteTimeUs;
+    uint32_t u32Retries;        /* Bus resets after a failed block transfer */
+} tstrNmSpiStats;
+
 /**
 *   @fn     nm_spi_init
 *   @brief  Initialize the SPI
@@ -130,6 +145,16 @@ int8_t nm_spi_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz);
 */
 int8_t nm_spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz);
 
+/**
+*   @fn     nm_spi_get_stats
+*   @brief  Get block transfer statistics
+*   @param [out]    pstrStats
+*               Pointer to the structure receiving the statistics
+*   @param [in] bClear
+*               Restart the statistics after reading them
+*/
+void nm_spi_get_stats(tstrNmSpiStats *pstrStats, bool bClear);
+
 #ifdef __cplusplus
      }
 #endif
@@ -83,6 +83,11 @@ MACROS
     function to ensure that the buffer sent is within the allowed range.
 */
 
+#define SOCKET_IOV_MAX                                      4
+/*!<
+    Maximum number of buffers that can be gathered by a single call to @ref sendv.
+*/
+
 #define  AF_INET                                            2
 /*!<
     The AF_INET is the address family used for IPv4. An IPv4 transport address is specified with the @ref sockaddr_in structure.
@@ -602,6 +607,27 @@ typedef enum {
 } tenuSocketCallbackMsgType;
 
 
+/*!
+@struct \
+    tstrSocketIovec
+
+@brief  One buffer of a gathered send.
+
+    An array of these structures is passed to @ref sendv. The buffers are sent back to back as a single socket write.
+@see
+     sendv
+*/
+typedef struct {
+    void        *pvBuf;
+    /*!<
+        Pointer to the data of this buffer.
+    */
+    uint16_t    u16Len;
+    /*!<
+        Length of this buffer in bytes.
+    */
+} tstrSocketIovec;
+
 /*!
 @struct \
     tstrSocketBindMsg
@@ -1693,6 +1719,42 @@ int16_t recvfrom(SOCKET sock, void *pvRecvBuf, uint16_t u16BufLen, uint32_t u32T
 int16_t send(SOCKET sock, void *pvSendBuffer, uint16_t u16SendLength, uint16_t u16Flags);
 /**@}*/     //SendFn
 
+/** @defgroup SendvFn sendv
+ *   @ingroup SocketAPI
+*  Asynchronous gathering send function, used to send data held in several buffers on a TCP socket.
+
+*  Behaves like @ref send, except that the data is taken from up to @ref SOCKET_IOV_MAX caller buffers which are written
+*  directly to the WINC, so no contiguous staging copy is needed.
+ */
+/**@{*/
+/*!
+@fn \
+    int16_t sendv(SOCKET sock, tstrSocketIovec *pstrIov, uint8_t u8IovCount, uint16_t u16Flags);
+
+@param[in]  sock
+                Socket ID, must hold a non negative value.
+
+@param[in]  pstrIov
+                Array of buffers holding the data to be transmitted.
+
+@param[in]  u8IovCount
+                Number of entries in pstrIov, must not exceed @ref SOCKET_IOV_MAX.
+
+@param[in]  u16Flags
+                Not used in the current implementation.
+
+@warning
+    The total length must not exceed @ref SOCKET_BUFFER_MAX_LENGTH.\n
+
+@see
+    send
+
+@return
+    The function shall return @ref SOCK_ERR_NO_ERROR for successful operation and a negative value (indicating the error) otherwise.
+*/
+int16_t sendv(SOCKET sock, tstrSocketIovec *pstrIov, uint8_t u8IovCount, uint16_t u16Flags);
+/**@}*/     //SendvFn
+
 /** @defgroup SendToSocketFn sendto
  *  @ingroup SocketAPI
 *    Asynchronous sending function, used to send data on a UDP socket.
@@ -286,6 +286,8 @@ void SYS_Initialize(void* data)
 
     TC3_TimerInitialize();
 
+    TC4_TimerInitialize();
+
 
     /* Initialize the WINC Driver */
     sysObj.drvWifiWinc = WDRV_WINC_Initialize(0, NULL);
@@ -97,7 +97,7 @@ void TCC2_Handler(void) __attribute__((weak, alias("Dummy_Handler")));
 void TC3_TimerInterruptHandler(void) __attribute__((weak, alias("Dummy_Handler")));
 void TC4_Handler(void) __attribute__((weak, alias("Dummy_Handler")));
 void TC5_Handler(void) __attribute__((weak, alias("Dummy_Handler")));
-void ADC_Handler(void) __attribute__((weak, alias("Dummy_Handler")));
+void ADC_InterruptHandler(void) __attribute__((weak, alias("Dummy_Handler")));
 void AC_Handler(void) __attribute__((weak, alias("Dummy_Handler")));
 void DAC_Handler(void) __attribute__((weak, alias("Dummy_Handler")));
 void PTC_Handler(void) __attribute__((weak, alias("Dummy_Handler")));
@@ -140,7 +140,7 @@ const DeviceVectors exception_table =
         .pfnTC3_Handler            = (void*)TC3_TimerInterruptHandler,
         .pfnTC4_Handler            = (void*)TC4_Handler,
         .pfnTC5_Handler            = (void*)TC5_Handler,
-        .pfnADC_Handler            = (void*)ADC_Handler,
+        .pfnADC_Handler            = (void*)ADC_InterruptHandler,
         .pfnAC_Handler             = (void*)AC_Handler,
         .pfnDAC_Handler            = (void*)DAC_Handler,
         .pfnPTC_Handler            = (void*)PTC_Handler,
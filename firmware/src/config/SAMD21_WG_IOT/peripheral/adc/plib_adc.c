@@ -70,6 +70,8 @@
 #define ADC_BIASCAL_POS  (3)
 #define ADC_BIASCAL_Msk   ((0x7 << ADC_BIASCAL_POS))
 
+ADC_CALLBACK_OBJ ADC_CallbackObject;
+
 // *****************************************************************************
 // *****************************************************************************
 // Section: ADC Implementation
@@ -106,12 +108,21 @@ void ADC_Initialize( void )
         | ADC_INPUTCTRL_INPUTSCAN(0) | ADC_INPUTCTRL_INPUTOFFSET(0) | ADC_INPUTCTRL_GAIN_1X;
 
     /* Prescaler, Resolution & Operation Mode */
-    ADC_REGS->ADC_CTRLB = ADC_CTRLB_PRESCALER_DIV32 | ADC_CTRLB_RESSEL_12BIT | ADC_CTRLB_FREERUN_Msk;
+    ADC_REGS->ADC_CTRLB = ADC_CTRLB_PRESCALER_DIV32 | ADC_CTRLB_RESSEL_16BIT;
+
+    /* Result averaging */
+    ADC_REGS->ADC_AVGCTRL = ADC_AVGCTRL_SAMPLENUM_4 | ADC_AVGCTRL_ADJRES(2U);
 
+    /* Events configuration  */
+    ADC_REGS->ADC_EVCTRL = ADC_EVCTRL_STARTEI_Msk;
 
     /* Clear all interrupt flags */
     ADC_REGS->ADC_INTFLAG = ADC_INTFLAG_Msk;
 
+    ADC_CallbackObject.callback = NULL;
+    /* Enable interrupts */
+    ADC_REGS->ADC_INTENSET = ADC_INTENSET_RESRDY_Msk;
+
     while(ADC_REGS->ADC_STATUS & ADC_STATUS_SYNCBUSY_Msk)
     {
         /* Wait for Synchronization */
@@ -194,14 +205,23 @@ uint16_t ADC_ConversionResultGet( void )
 }
 
 
-/* Check whether result is ready */
-bool ADC_ConversionStatusGet( void )
+/* Register the callback function */
+void ADC_CallbackRegister( ADC_CALLBACK callback, uintptr_t context )
+{
+    ADC_CallbackObject.callback = callback;
+
+    ADC_CallbackObject.context = context;
+}
+
+/* ADC interrupt handler */
+void ADC_InterruptHandler( void )
 {
-    bool status;
-    status =  (bool)((ADC_REGS->ADC_INTFLAG & ADC_INTFLAG_RESRDY_Msk) >> ADC_INTFLAG_RESRDY_Pos);
-    if (status == true)
+    ADC_STATUS status;
+    status = (ADC_STATUS)ADC_REGS->ADC_INTFLAG;
+    /* Clear interrupt flags */
+    ADC_REGS->ADC_INTFLAG = ADC_INTFLAG_Msk;
+    if (ADC_CallbackObject.callback != NULL)
     {
-        ADC_REGS->ADC_INTFLAG = ADC_INTFLAG_RESRDY_Msk;
+        ADC_CallbackObject.callback(status, ADC_CallbackObject.context);
     }
-    return status;
 }
@@ -105,7 +105,7 @@ void ADC_ComparisonWindowSet(uint16_t low_threshold, uint16_t high_threshold);
 void ADC_WindowModeSet(ADC_WINMODE mode);
 
 
-bool ADC_ConversionStatusGet( void );
+void ADC_CallbackRegister( ADC_CALLBACK callback, uintptr_t context );
 
 
 
@@ -79,6 +79,8 @@ typedef enum
     DMAC_CHANNEL_0 = 0,
     /* DMAC Channel 1 */
     DMAC_CHANNEL_1 = 1,
+    /* DMAC Channel 2 */
+    DMAC_CHANNEL_2 = 2,
 } DMAC_CHANNEL;
 
 typedef enum
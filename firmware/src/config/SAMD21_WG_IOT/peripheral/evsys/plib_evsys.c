@@ -44,7 +44,11 @@
 void EVSYS_Initialize( void )
 {
     /*Event Channel User Configuration*/
+    EVSYS_REGS->EVSYS_USER = EVSYS_USER_CHANNEL(0x1) | EVSYS_USER_USER(23);
 
+    /* Event Channel 0 Configuration */
+    EVSYS_REGS->EVSYS_CHANNEL = EVSYS_CHANNEL_EVGEN(54) | EVSYS_CHANNEL_PATH(2) | EVSYS_CHANNEL_EDGSEL(0) \
+                                     | EVSYS_CHANNEL_CHANNEL(0);
 
 }
 
@@ -71,6 +71,8 @@ void NVIC_Initialize( void )
     NVIC_EnableIRQ(SERCOM5_IRQn);
     NVIC_SetPriority(TC3_IRQn, 3);
     NVIC_EnableIRQ(TC3_IRQn);
+    NVIC_SetPriority(ADC_IRQn, 3);
+    NVIC_EnableIRQ(ADC_IRQn);
 
 
 
@@ -9,6 +9,13 @@
 
  *******************************************************************************/
 
+#ifndef DTI_H
+#define DTI_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "iot_config/IoT_Sensor_Node_config.h"
+
 // *****************************************************************************
 // *****************************************************************************
 // Section: Definitions
@@ -32,6 +39,12 @@
 /* Valid command byte values */
 #define DTI_CMDCHAR_TELEMETRY_1 'T'
 #define DTI_CMDCHAR_TELEMETRY_2 't'
+/* Multi-field telemetry : the payload is a list of (index, length, value) fields,
+   published as one message. The index selects the telemetry name and type as
+   parameter1 does for 'T', the value uses the same text format. */
+#define DTI_CMDCHAR_TELEMETRY_MULTI_1 'M'
+#define DTI_CMDCHAR_TELEMETRY_MULTI_2 'm'
+#define DTI_FIELD_HEADER_NUMBYTES 2
 
 #define CHAR_NULL '\0'
 
@@ -42,6 +55,46 @@ typedef struct {
     uint8_t *payloadData; // pointer to the beginning of the payload array/string
 } DTI_DataFrameInfo;
 
+/* Receive statistics, reported by the "dti" CLI command */
+typedef struct {
+    uint32_t frames;         // complete frames queued for the application
+    uint32_t bytes;          // header and payload bytes of every received frame
+    uint32_t payloadBytes;   // payload bytes of every received frame
+    uint32_t dropped;        // frames discarded because all frame buffers were in use
+    uint32_t lengthErrors;   // frames discarded because of a payload length above DTI_PAYLOADDATA_NUMBYTES
+    uint32_t overflows;      // SERCOM receive buffer overflows
+    uint32_t fieldErrors;    // multi-field frames discarded because of a malformed field list
+    uint32_t interrupts;     // interrupts taken on the DTI receive path
+    uint32_t isrTimeUs;      // time spent in those interrupts
+    uint32_t payloadTimeUs;  // time from end of header to end of payload, summed over frames
+    uint32_t elapsedMs;      // time since the statistics were cleared
+    uint8_t  queueHighWater; // most frames waiting for DTI_Tasks() at once
+    bool     dmaReceive;     // frames are received by DMA instead of per byte interrupts
+} DTI_Statistics;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Routines
+// *****************************************************************************
+// *****************************************************************************
+
+/* Sets up the receive path; called once after SERCOM0 and the DMAC are initialized */
+void DTI_Initialize(void);
+
+/* Processes the frames queued by the receive path; called from the application task */
+void DTI_Tasks(void);
+
+/* Discards a partially received frame so the next byte is taken as a command character */
+void DTI_Reset(void);
+
+/* Per byte receive path, called from the SERCOM0 interrupt handler */
+void DTI_ReceiveByte(uint8_t data);
+void DTI_ReceiveOverflow(void);
+
+void DTI_GetStatistics(DTI_Statistics* stats, bool clear);
+
+#endif // DTI_H
+
 /*******************************************************************************
  End of File
 */
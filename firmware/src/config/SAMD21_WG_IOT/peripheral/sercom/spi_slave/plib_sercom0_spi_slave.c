@@ -48,15 +48,6 @@
 #include "plib_sercom0_spi_slave.h"
 #include <string.h>
 #include "dti.h"
-#include "../../azutil.h"
-#include "../../led.h"
-
-// *****************************************************************************
-// *****************************************************************************
-// Section: Global Variables
-// *****************************************************************************
-// *****************************************************************************
-uint16_t DTI_bufferPtr = 0;
 
 // *****************************************************************************
 // *****************************************************************************
@@ -68,8 +59,6 @@ uint16_t DTI_bufferPtr = 0;
 
 static uint8_t SERCOM0_SPI_ReadBuffer[SERCOM0_SPI_READ_BUFFER_SIZE];
 static uint8_t SERCOM0_SPI_WriteBuffer[SERCOM0_SPI_WRITE_BUFFER_SIZE];
-static uint8_t DTI_cmdBuffer[DTI_MAXTOTAL_NUMBYTES];
-static DTI_DataFrameInfo DTI_parsedInfo;
 
 /* Global object to save SPI Exchange related data  */
 static SPI_SLAVE_OBJECT sercom0SPISObj;
@@ -226,6 +215,7 @@ void SERCOM0_SPI_InterruptHandler(void)
     {
         /* Save the error to report it to application later, when the transfer is complete (TXC = 1) */
         sercom0SPISObj.errorStatus = SERCOM_SPIS_STATUS_BUFOVF_Msk;
+        DTI_ReceiveOverflow();
 
         /* Clear the status register */
         SERCOM0_REGS->SPIS.SERCOM_STATUS = SERCOM_SPIS_STATUS_BUFOVF_Msk;
@@ -244,44 +234,10 @@ void SERCOM0_SPI_InterruptHandler(void)
     {
         /* Reading DATA register will also clear the RXC flag */
         txRxData = SERCOM0_REGS->SPIS.SERCOM_DATA;
-        
-        /***** [---START---] DTI Module Processing [---START---] *****/
-        // Save the current received data byte into buffer
-        DTI_cmdBuffer[DTI_bufferPtr] = txRxData;
-        // Did we just receive the command character?
-        if (DTI_bufferPtr == DTI_pIDX_CMDCHAR)
-        {
-            DTI_parsedInfo.commandChar = txRxData;
-        }
-        // Did we just receive the parameter1 byte?
-        if (DTI_bufferPtr == DTI_pIDX_PARAM1)
-        {
-            DTI_parsedInfo.parameter1 = txRxData;
-        }
-        // Did we just receive the LSB of the 16-bit length parameter?
-        if (DTI_bufferPtr == DTI_pIDX_PAYLENLSB)
-        {
-            DTI_parsedInfo.payloadLen = ( (DTI_cmdBuffer[DTI_pIDX_PAYLENMSB] << 8) + txRxData);
-        }
-        // Increment pointer for next incoming byte
-        DTI_bufferPtr++;
-        
-        // Did we just receive the final byte of the payload data?
-        if (DTI_bufferPtr == (DTI_HEADER_NUMBYTES + DTI_parsedInfo.payloadLen))
-        {
-            DTI_cmdBuffer[DTI_bufferPtr] = CHAR_NULL; // Terminate the array/string
-            DTI_bufferPtr = 0; // Reset pointer to the beginning of the buffer
-            DTI_parsedInfo.payloadData = &DTI_cmdBuffer[DTI_HEADER_NUMBYTES];
-            if ( (DTI_parsedInfo.commandChar == DTI_CMDCHAR_TELEMETRY_1) || 
-                 (DTI_parsedInfo.commandChar == DTI_CMDCHAR_TELEMETRY_2) )
-            {
-                    process_telemetry_command(DTI_parsedInfo.parameter1, 
-                            (char*)DTI_parsedInfo.payloadData);
-                    LED_YELLOW_Toggle_EX();
-            }
-        }
-        /****** [---END---] DTI Module Processing [---END---] ********/
-        
+
+        /* Frames are assembled by the DTI module */
+        DTI_ReceiveByte(txRxData);
+
         if (sercom0SPISObj.rdInIndex < SERCOM0_SPI_READ_BUFFER_SIZE)
         {
             SERCOM0_SPI_ReadBuffer[sercom0SPISObj.rdInIndex++] = txRxData;
@@ -56,14 +56,6 @@
 #include "plib_tc4.h"
 
 
-// *****************************************************************************
-// *****************************************************************************
-// Section: Global Data
-// *****************************************************************************
-// *****************************************************************************
-
-TC_TIMER_CALLBACK_OBJ TC4_CallbackObject;
-
 // *****************************************************************************
 // *****************************************************************************
 // Section: TC4 Implementation
@@ -86,14 +78,12 @@ void TC4_TimerInitialize( void )
     TC4_REGS->COUNT16.TC_CTRLA = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_PRESCALER_DIV1 | TC_CTRLA_WAVEGEN_MPWM ;
 
     /* Configure timer period */
-    TC4_REGS->COUNT16.TC_CC[0U] = 10U;
+    TC4_REGS->COUNT16.TC_CC[0U] = 101U;
 
     /* Clear all interrupt flags */
     TC4_REGS->COUNT16.TC_INTFLAG = TC_INTFLAG_Msk;
 
-    TC4_CallbackObject.callback = NULL;
-    /* Enable interrupt*/
-    TC4_REGS->COUNT16.TC_INTENSET = TC_INTENSET_OVF_Msk;
+    TC4_REGS->COUNT16.TC_EVCTRL = TC_EVCTRL_OVFEO_Msk;
 
 
     while((TC4_REGS->COUNT16.TC_STATUS & TC_STATUS_SYNCBUSY_Msk))
@@ -178,24 +168,12 @@ uint16_t TC4_Timer16bitPeriodGet( void )
 
 
 
-/* Register callback function */
-void TC4_TimerCallbackRegister( TC_TIMER_CALLBACK callback, uintptr_t context )
+/* Check whether timer period is elapsed */
+bool TC4_TimerPeriodHasExpired( void )
 {
-    TC4_CallbackObject.callback = callback;
-
-    TC4_CallbackObject.context = context;
-}
-
-/* Timer Interrupt handler */
-void TC4_TimerInterruptHandler( void )
-{
-    TC_TIMER_STATUS status;
-    status = TC4_REGS->COUNT16.TC_INTFLAG;
-    /* Clear interrupt flags */
-    TC4_REGS->COUNT16.TC_INTFLAG = TC_INTFLAG_Msk;
-    if(TC4_CallbackObject.callback != NULL)
-    {
-        TC4_CallbackObject.callback(status, TC4_CallbackObject.context);
-    }
+    bool timer_status;
+    timer_status = ((TC4_REGS->COUNT16.TC_INTFLAG) & TC_INTFLAG_OVF_Msk) != 0U;
+    TC4_REGS->COUNT16.TC_INTFLAG =  TC_INTFLAG_OVF_Msk;
+    return timer_status;
 }
 
@@ -107,7 +107,7 @@ void TC4_Timer16bitCounterSet( uint16_t count );
 
 
 
-void TC4_TimerCallbackRegister( TC_TIMER_CALLBACK callback, uintptr_t context );
+bool TC4_TimerPeriodHasExpired( void );
 
 
 
@@ -109,6 +109,469 @@ void debug_mutex_lock(OSAL_MUTEX_HANDLE_TYPE* mutexID)
     }
 }
 
+#if (CFG_DEBUG_DEFERRED == 1)
+// *****************************************************************************
+// *****************************************************************************
+// Deferred logging.
+// debug_printer() only stores the format string pointer and the raw arguments.
+// The format strings are literals in flash (see the debug_print macros), so the
+// pointer identifies the message. debug_flush() formats the queued records
+// from the main loop. Cortex-M0+ has no exclusive load/store, the ring space
+// is reserved and filled with interrupts masked instead of taking consoleMutex.
+// *****************************************************************************
+// *****************************************************************************
+
+#define DEBUG_LOG_RING_WORDS   256U   // Must be a power of 2
+#define DEBUG_LOG_RECORD_WORDS 40U    // Header, format and arguments of one record
+#define DEBUG_LOG_MAX_STRING   48U    // Longer %s arguments are truncated
+#define DEBUG_LOG_SPEC_SIZE    16U
+
+// Pointers take one word on the SAMD21 and two in a 64 bit host build
+#define DEBUG_LOG_POINTER_WORDS ((uint16_t)((sizeof(void*) + 3) / 4))
+#define DEBUG_LOG_HEADER_WORDS  (1 + DEBUG_LOG_POINTER_WORDS)
+
+#define DEBUG_LOG_WIDTH_STAR     0x01
+#define DEBUG_LOG_PRECISION_STAR 0x02
+
+typedef enum
+{
+    DEBUG_ARG_INT,
+    DEBUG_ARG_LONGLONG,
+    DEBUG_ARG_DOUBLE,
+    DEBUG_ARG_POINTER,
+    DEBUG_ARG_STRING,
+    DEBUG_ARG_SKIP   // %n, the argument is consumed and nothing is written
+} debug_arg_t;
+
+static uint32_t          debugLogRing[DEBUG_LOG_RING_WORDS];
+static volatile uint16_t debugLogHead    = 0;   // Advanced by debug_printer()
+static volatile uint16_t debugLogTail    = 0;   // Advanced by debug_flush()
+static volatile uint32_t debugLogDropped = 0;
+
+/** \brief Find the next conversion specification of a printf format.
+ *
+ * @return start of the conversion or NULL at the end of the format.
+ *         specEnd points past the conversion character, stars holds
+ *         DEBUG_LOG_WIDTH_STAR/DEBUG_LOG_PRECISION_STAR.
+ */
+static const char* debug_parseConversion(const char* format, const char** specEnd, debug_arg_t* argType, uint8_t* stars)
+{
+    const char* p;
+    bool        longLong;
+
+    for (; *format != '\0'; format++)
+    {
+        if (*format != '%')
+        {
+            continue;
+        }
+
+        p = format + 1;
+
+        if (*p == '%')
+        {
+            format++;
+            continue;
+        }
+
+        *stars  = 0;
+        longLong = false;
+
+        while (*p != '\0' && strchr("-+ #0", *p) != NULL)
+        {
+            p++;
+        }
+
+        if (*p == '*')
+        {
+            *stars |= DEBUG_LOG_WIDTH_STAR;
+            p++;
+        }
+
+        while (*p >= '0' && *p <= '9')
+        {
+            p++;
+        }
+
+        if (*p == '.')
+        {
+            p++;
+
+            if (*p == '*')
+            {
+                *stars |= DEBUG_LOG_PRECISION_STAR;
+                p++;
+            }
+
+            while (*p >= '0' && *p <= '9')
+            {
+                p++;
+            }
+        }
+
+        while (*p != '\0' && strchr("hlLjzt", *p) != NULL)
+        {
+            // long, size_t and ptrdiff_t are 64 bit in a host build
+            if ((*p == 'l' && p[1] == 'l') || *p == 'j' || (strchr("lzt", *p) != NULL && sizeof(long) > sizeof(int)))
+            {
+                longLong = true;
+            }
+            p++;
+        }
+
+        switch (*p)
+        {
+            case 'd':
+            case 'i':
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+            case 'c':
+                *argType = longLong ? DEBUG_ARG_LONGLONG : DEBUG_ARG_INT;
+                break;
+
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                *argType = DEBUG_ARG_DOUBLE;
+                break;
+
+            case 'p':
+                *argType = DEBUG_ARG_POINTER;
+                break;
+
+            case 's':
+                *argType = DEBUG_ARG_STRING;
+                break;
+
+            case 'n':
+                *argType = DEBUG_ARG_SKIP;
+                break;
+
+            default:
+                // Malformed conversion, treat the rest as text
+                return NULL;
+        }
+
+        *specEnd = p + 1;
+        return format;
+    }
+
+    return NULL;
+}
+
+static void debug_record(debug_severity_t debug_severity, debug_errorLevel_t error_level, const char* format, va_list args)
+{
+    uint32_t    record[DEBUG_LOG_RECORD_WORDS];
+    uint16_t    words      = DEBUG_LOG_HEADER_WORDS;
+    const char* conversion = format;
+    const char* specEnd;
+    debug_arg_t argType;
+    uint8_t     stars;
+    int32_t     precision;
+    uint16_t    i;
+    bool        interruptState;
+
+    while ((conversion = debug_parseConversion(conversion, &specEnd, &argType, &stars)) != NULL)
+    {
+        // Worst case : two star arguments, string length and string
+        if (words + 3 + (DEBUG_LOG_MAX_STRING + 3) / 4 > DEBUG_LOG_RECORD_WORDS)
+        {
+            break;
+        }
+
+        precision = -1;
+
+        if (stars & DEBUG_LOG_WIDTH_STAR)
+        {
+            record[words++] = (uint32_t)va_arg(args, int);
+        }
+
+        if (stars & DEBUG_LOG_PRECISION_STAR)
+        {
+            precision       = va_arg(args, int);
+            record[words++] = (uint32_t)precision;
+        }
+
+        switch (argType)
+        {
+            case DEBUG_ARG_INT:
+                record[words++] = va_arg(args, unsigned int);
+                break;
+
+            case DEBUG_ARG_LONGLONG:
+            {
+                unsigned long long value = va_arg(args, unsigned long long);
+                memcpy(&record[words], &value, sizeof(value));
+                words += 2;
+                break;
+            }
+
+            case DEBUG_ARG_DOUBLE:
+            {
+                double value = va_arg(args, double);
+                memcpy(&record[words], &value, sizeof(value));
+                words += 2;
+                break;
+            }
+
+            case DEBUG_ARG_POINTER:
+            case DEBUG_ARG_SKIP:
+            {
+                void* value = va_arg(args, void*);
+                memcpy(&record[words], &value, sizeof(value));
+                words += DEBUG_LOG_POINTER_WORDS;
+                break;
+            }
+
+            case DEBUG_ARG_STRING:
+            {
+                // The string may not outlive the call, keep a copy
+                const char* value  = va_arg(args, const char*);
+                uint32_t    maxLen = DEBUG_LOG_MAX_STRING;
+                uint32_t    len;
+
+                if (value == NULL)
+                {
+                    value = "(null)";
+                }
+
+                if (precision >= 0 && (uint32_t)precision < maxLen)
+                {
+                    maxLen = precision;
+                }
+
+                for (len = 0; len < maxLen && value[len] != '\0'; len++)
+                {
+                }
+
+                record[words++] = len;
+                memcpy(&record[words], value, len);
+                words += (len + 3) / 4;
+                break;
+            }
+        }
+
+        conversion = specEnd;
+    }
+
+    record[0] = words | ((uint32_t)debug_severity << 16) | ((uint32_t)error_level << 24);
+    memcpy(&record[1], &format, sizeof(format));
+
+    interruptState = SYS_INT_Disable();
+
+    if ((uint16_t)(DEBUG_LOG_RING_WORDS - (uint16_t)(debugLogHead - debugLogTail)) < words)
+    {
+        debugLogDropped++;
+    }
+    else
+    {
+        for (i = 0; i < words; i++)
+        {
+            debugLogRing[(debugLogHead + i) & (DEBUG_LOG_RING_WORDS - 1)] = record[i];
+        }
+        debugLogHead += words;
+    }
+
+    SYS_INT_Restore(interruptState);
+}
+
+static size_t debug_appendText(char* buffer, size_t len, const char* start, const char* end)
+{
+    for (; start < end && len < APP_PRINT_BUFFER_SIZE - 1; start++)
+    {
+        buffer[len++] = *start;
+
+        if (*start == '%')
+        {
+            // "%%" between conversions
+            start++;
+        }
+    }
+
+    return len;
+}
+
+#define DEBUG_FORMAT_ARG(value)                                                                                     \
+    ((starCount == 0)   ? snprintf(out, size, spec, value)                                                          \
+     : (starCount == 1) ? snprintf(out, size, spec, (int)record[words - 1], value)                                  \
+                        : snprintf(out, size, spec, (int)record[words - 2], (int)record[words - 1], value))
+
+/** \brief Format one deferred record into tmpBuf.
+ *
+ * @return length of the message
+ */
+static size_t debug_formatRecord(const uint32_t* record, uint16_t recordWords)
+{
+    const char*        format;
+    debug_severity_t   severity = (debug_severity_t)((record[0] >> 16) & 0xFF);
+    debug_errorLevel_t level    = (debug_errorLevel_t)(record[0] >> 24);
+    const char*        conversion;
+    const char*        specEnd;
+    debug_arg_t        argType;
+    uint8_t            stars;
+    uint8_t            starCount;
+    char               spec[DEBUG_LOG_SPEC_SIZE];
+    char               string[DEBUG_LOG_MAX_STRING + 1];
+    uint16_t           words = DEBUG_LOG_HEADER_WORDS;
+    size_t             len;
+    int                written;
+
+    memcpy(&format, &record[1], sizeof(format));
+
+    written = snprintf(tmpBuf, APP_PRINT_BUFFER_SIZE, "%s %s %s ", debug_message_prefix, severity_strings[severity], level_strings[level]);
+    len     = (written > 0) ? written : 0;
+
+    while ((conversion = debug_parseConversion(format, &specEnd, &argType, &stars)) != NULL)
+    {
+        char*  out;
+        size_t size;
+
+        starCount = ((stars & DEBUG_LOG_WIDTH_STAR) ? 1 : 0) + ((stars & DEBUG_LOG_PRECISION_STAR) ? 1 : 0);
+
+        if (words >= recordWords || (size_t)(specEnd - conversion) >= sizeof(spec))
+        {
+            // Arguments were truncated when recording
+            break;
+        }
+
+        len = debug_appendText(tmpBuf, len, format, conversion);
+        out  = &tmpBuf[len];
+        size = APP_PRINT_BUFFER_SIZE - len;
+
+        memcpy(spec, conversion, specEnd - conversion);
+        spec[specEnd - conversion] = '\0';
+        words += starCount;
+        written = 0;
+
+        switch (argType)
+        {
+            case DEBUG_ARG_INT:
+                written = DEBUG_FORMAT_ARG(record[words]);
+                words += 1;
+                break;
+
+            case DEBUG_ARG_LONGLONG:
+            {
+                unsigned long long value;
+                memcpy(&value, &record[words], sizeof(value));
+                written = DEBUG_FORMAT_ARG(value);
+                words += 2;
+                break;
+            }
+
+            case DEBUG_ARG_DOUBLE:
+            {
+                double value;
+                memcpy(&value, &record[words], sizeof(value));
+                written = DEBUG_FORMAT_ARG(value);
+                words += 2;
+                break;
+            }
+
+            case DEBUG_ARG_POINTER:
+            {
+                void* value;
+                memcpy(&value, &record[words], sizeof(value));
+                written = DEBUG_FORMAT_ARG(value);
+                words += DEBUG_LOG_POINTER_WORDS;
+                break;
+            }
+
+            case DEBUG_ARG_SKIP:
+                words += DEBUG_LOG_POINTER_WORDS;
+                break;
+
+            case DEBUG_ARG_STRING:
+            {
+                uint32_t stringLen = record[words];
+                memcpy(string, &record[words + 1], stringLen);
+                string[stringLen] = '\0';
+                written           = DEBUG_FORMAT_ARG(string);
+                words += 1 + (stringLen + 3) / 4;
+                break;
+            }
+        }
+
+        if (written > 0)
+        {
+            len = (len + written < APP_PRINT_BUFFER_SIZE) ? len + written : APP_PRINT_BUFFER_SIZE - 1;
+        }
+
+        format = specEnd;
+    }
+
+    len = debug_appendText(tmpBuf, len, format, format + strlen(format));
+
+    written = snprintf(&tmpBuf[len], APP_PRINT_BUFFER_SIZE - len, "\r\n" CSI_RESET);
+    if (written > 0)
+    {
+        len = (len + written < APP_PRINT_BUFFER_SIZE) ? len + written : APP_PRINT_BUFFER_SIZE - 1;
+    }
+
+    return len;
+}
+
+/** \brief Write queued log records to the console.
+ *
+ * Called from the main loop. Stops when the console write buffer cannot
+ * take the next message, the record is kept for the next call.
+ */
+void debug_flush(void)
+{
+    uint32_t record[DEBUG_LOG_RECORD_WORDS];
+    uint16_t words;
+    uint16_t i;
+    size_t   len;
+
+    while (debugLogTail != debugLogHead)
+    {
+        words = debugLogRing[debugLogTail & (DEBUG_LOG_RING_WORDS - 1)] & 0xFFFF;
+
+        for (i = 0; i < words; i++)
+        {
+            record[i] = debugLogRing[(debugLogTail + i) & (DEBUG_LOG_RING_WORDS - 1)];
+        }
+
+        if (debug_disabled == false || (debug_errorLevel_t)(record[0] >> 24) == LEVEL_ERROR)   // always print error
+        {
+            len = debug_formatRecord(record, words);
+
+            if (SYS_CONSOLE_WriteFreeBufferCountGet(0) < (ssize_t)len)
+            {
+                return;
+            }
+
+            SYS_CONSOLE_Write(0, tmpBuf, len);
+        }
+
+        debugLogTail += words;
+    }
+
+    if (debugLogDropped != 0)
+    {
+        len = snprintf(tmpBuf, APP_PRINT_BUFFER_SIZE, "%s %s %s %lu log messages dropped\r\n" CSI_RESET,
+                       debug_message_prefix, severity_strings[SEVERITY_WARN], level_strings[LEVEL_WARN], debugLogDropped);
+
+        if (SYS_CONSOLE_WriteFreeBufferCountGet(0) >= (ssize_t)len)
+        {
+            SYS_CONSOLE_Write(0, tmpBuf, len);
+            debugLogDropped = 0;
+        }
+    }
+}
+#else
+void debug_flush(void)
+{
+}
+#endif
+
 void debug_printer(debug_severity_t debug_severity, debug_errorLevel_t error_level, const char* format, ...)
 {
     size_t  len = 0;
@@ -124,6 +587,12 @@ void debug_printer(debug_severity_t debug_severity, debug_errorLevel_t error_lev
             if (error_level > LEVEL_ERROR)
                 error_level = LEVEL_ERROR;
 
+#if (CFG_DEBUG_DEFERRED == 1)
+            va_start(args, format);
+            debug_record(debug_severity, error_level, format, args);
+            va_end(args);
+            return;
+#endif
             debug_mutex_lock(&consoleMutex);
 
             if (debug_disabled == false || error_level == LEVEL_ERROR) // always print error
@@ -71,6 +71,7 @@ static const char*     severity_strings[] = {
     CSI_YELLOW "  WARN" CSI_WHITE,
     CSI_CYAN " DEBUG" CSI_WHITE,
     CSI_WHITE "  INFO" CSI_NORMAL CSI_WHITE,
+    CSI_WHITE " TRACE" CSI_NORMAL CSI_WHITE,
 };
 
 static const char* level_strings[] = {
@@ -88,6 +89,7 @@ void debug_printer(debug_severity_t debug_severity, debug_errorLevel_t error_lev
 void debug_setPrefix(const char* prefix);
 void debug_init(const char* prefix);
 void debug_disable(bool disable);
+void debug_flush(void);
 //void debug_printf(const char* format, ...);
 
 
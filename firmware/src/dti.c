@@ -0,0 +1,415 @@
+/*******************************************************************************
+  Data Transfer Interface (DTI) Source File
+
+  Company:
+    Microchip Technology Inc.
+
+  File Name:
+    dti.c
+
+  Summary:
+    Receives DTI frames from the host MCU on the SERCOM0 SPI slave.
+
+  Description:
+    A frame is a 4 byte header (command, parameter1, payload length MSB/LSB)
+    followed by the payload. With CFG_DTI_DMA_RECEIVE set, the header is
+    received by one DMA transfer and the payload by a second one, which the
+    header completion callback starts once it knows the payload length.
+    Otherwise the SERCOM0 interrupt handler passes every byte to
+    DTI_ReceiveByte().
+
+    Complete frames are queued in CFG_DTI_FRAME_BUFFERS buffers and processed
+    by DTI_Tasks() from the application task, never from the interrupt.
+    The receive path only fills a buffer DTI_Tasks() has released, so the
+    queue needs no lock. A frame arriving while every buffer is in use is
+    discarded and counted.
+
+    The interrupt time reported in the statistics is measured in CPU cycles
+    with SysTick. Nothing else in this firmware uses SysTick (SYS_TIME runs
+    on TC3 and there is no RTOS), so DTI_Initialize() takes it over as a free
+    running 24 bit down counter with its interrupt left disabled. A port that
+    needs SysTick for a tick interrupt must set CFG_DTI_ISR_TIMING to 0.
+ *******************************************************************************/
+
+#include <string.h>
+#include "definitions.h"
+#include "config/SAMD21_WG_IOT/peripheral/sercom/spi_slave/dti.h"
+#include "app.h"
+#include "azutil.h"
+#include "led.h"
+#include "debug_print.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Definitions
+// *****************************************************************************
+// *****************************************************************************
+
+#define DTI_DMAC_CHANNEL   DMAC_CHANNEL_2
+#define DTI_DMAC_SETTINGS  (DMAC_BTCTRL_BLOCKACT_INT | DMAC_BTCTRL_BEATSIZE_BYTE | DMAC_BTCTRL_VALID_Msk | DMAC_BTCTRL_DSTINC_Msk)
+#define DTI_CYCLES_PER_US  (SYS_TIME_CPU_CLOCK_FREQUENCY / 1000000)
+
+// SysTick runs free as a CPU cycle counter for the interrupt time, see the file description
+#define DTI_CYCLES_MASK    SysTick_LOAD_RELOAD_Msk
+#if (CFG_DTI_ISR_TIMING == 1)
+#define DTI_CYCLES_GET()   (SysTick->VAL)
+#else
+#define DTI_CYCLES_GET()   0
+#endif
+
+static uint8_t       DTI_frameBuffer[CFG_DTI_FRAME_BUFFERS][DTI_MAXTOTAL_NUMBYTES];
+static volatile bool DTI_frameReady[CFG_DTI_FRAME_BUFFERS];
+static uint8_t       DTI_fillIndex;   // receive path : next buffer to fill
+static uint8_t       DTI_readIndex;   // DTI_Tasks() : next buffer to process
+static volatile uint32_t DTI_framesQueued;
+static volatile uint32_t DTI_framesProcessed;
+
+// Frame being received
+static uint8_t  DTI_header[DTI_HEADER_NUMBYTES];
+static uint8_t* DTI_rxFrame;        // NULL while the payload is discarded
+static uint16_t DTI_rxPayloadLen;
+static uint16_t DTI_rxCount;        // per byte receive : bytes of the frame so far
+static uint32_t DTI_payloadStart;
+#if (CFG_DTI_DMA_RECEIVE == 1)
+static bool     DTI_rxPayload;      // payload transfer in progress
+static bool     DTI_rxDiscard;      // destination increment is off
+static uint8_t  DTI_discardByte;
+#endif
+
+static DTI_Statistics DTI_stats;
+static uint64_t       DTI_isrCycles;
+static uint64_t       DTI_payloadCounts;
+static uint64_t       DTI_statsStart;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Receive Path (interrupt context)
+// *****************************************************************************
+// *****************************************************************************
+
+static void DTI_HeaderReceived(void)
+{
+    DTI_rxPayloadLen = ((uint16_t)DTI_header[DTI_pIDX_PAYLENMSB] << 8) | DTI_header[DTI_pIDX_PAYLENLSB];
+    DTI_rxFrame      = NULL;
+
+    // The payload of a discarded frame is still received to stay in step with the host
+    if (DTI_rxPayloadLen > DTI_PAYLOADDATA_NUMBYTES)
+    {
+        DTI_stats.lengthErrors++;
+    }
+    else if (DTI_frameReady[DTI_fillIndex])
+    {
+        DTI_stats.dropped++;
+    }
+    else
+    {
+        DTI_rxFrame = DTI_frameBuffer[DTI_fillIndex];
+        memcpy(DTI_rxFrame, DTI_header, DTI_HEADER_NUMBYTES);
+    }
+}
+
+static void DTI_FrameReceived(void)
+{
+    uint32_t queued;
+
+    DTI_stats.bytes += DTI_HEADER_NUMBYTES + DTI_rxPayloadLen;
+    if (DTI_rxPayloadLen > 0)
+    {
+        DTI_stats.payloadBytes += DTI_rxPayloadLen;
+        DTI_payloadCounts += SYS_TIME_CounterGet() - DTI_payloadStart;
+    }
+
+    if (DTI_rxFrame == NULL)
+    {
+        return;
+    }
+
+    DTI_rxFrame[DTI_HEADER_NUMBYTES + DTI_rxPayloadLen] = CHAR_NULL;
+    DTI_rxFrame                                         = NULL;
+    DTI_frameReady[DTI_fillIndex]                       = true;
+    DTI_fillIndex                                       = (DTI_fillIndex + 1) % CFG_DTI_FRAME_BUFFERS;
+    DTI_framesQueued++;
+    DTI_stats.frames++;
+
+    queued = DTI_framesQueued - DTI_framesProcessed;
+    if (queued > DTI_stats.queueHighWater)
+    {
+        DTI_stats.queueHighWater = queued;
+    }
+
+    APP_PostEvent(APP_EVENT_DTI);
+}
+
+static void DTI_AccountInterrupt(uint32_t startCycles)
+{
+    DTI_isrCycles += (startCycles - DTI_CYCLES_GET()) & DTI_CYCLES_MASK;
+    DTI_stats.interrupts++;
+}
+
+void DTI_ReceiveByte(uint8_t data)
+{
+    uint32_t startCycles = DTI_CYCLES_GET();
+
+    if (DTI_rxCount < DTI_HEADER_NUMBYTES)
+    {
+        DTI_header[DTI_rxCount++] = data;
+        if (DTI_rxCount == DTI_HEADER_NUMBYTES)
+        {
+            DTI_HeaderReceived();
+            DTI_payloadStart = SYS_TIME_CounterGet();
+        }
+    }
+    else
+    {
+        if (DTI_rxFrame != NULL)
+        {
+            DTI_rxFrame[DTI_rxCount] = data;
+        }
+        DTI_rxCount++;
+    }
+
+    if (DTI_rxCount >= DTI_HEADER_NUMBYTES && DTI_rxCount == DTI_HEADER_NUMBYTES + DTI_rxPayloadLen)
+    {
+        DTI_FrameReceived();
+        DTI_rxCount = 0;
+    }
+
+    DTI_AccountInterrupt(startCycles);
+}
+
+void DTI_ReceiveOverflow(void)
+{
+    DTI_stats.overflows++;
+}
+
+#if (CFG_DTI_DMA_RECEIVE == 1)
+static void DTI_ReceiveHeaderDMA(void)
+{
+    if (DTI_rxDiscard)
+    {
+        DMAC_ChannelSettingsSet(DTI_DMAC_CHANNEL, DTI_DMAC_SETTINGS);
+        DTI_rxDiscard = false;
+    }
+
+    DTI_rxPayload = false;
+    DMAC_ChannelTransfer(DTI_DMAC_CHANNEL, (const void*)&SERCOM0_REGS->SPIS.SERCOM_DATA, DTI_header, DTI_HEADER_NUMBYTES);
+}
+
+static void DTI_ReceivePayloadDMA(void)
+{
+    uint8_t* destination = &DTI_discardByte;
+
+    if (DTI_rxFrame != NULL)
+    {
+        destination = &DTI_rxFrame[DTI_HEADER_NUMBYTES];
+    }
+    else
+    {
+        // A discarded payload is written over a single byte
+        DMAC_ChannelSettingsSet(DTI_DMAC_CHANNEL, DTI_DMAC_SETTINGS & ~DMAC_BTCTRL_DSTINC_Msk);
+        DTI_rxDiscard = true;
+    }
+
+    DTI_rxPayload = true;
+    DMAC_ChannelTransfer(DTI_DMAC_CHANNEL, (const void*)&SERCOM0_REGS->SPIS.SERCOM_DATA, destination, DTI_rxPayloadLen);
+}
+
+// The SERCOM holds one byte besides the shift register, so the next transfer is
+// started before any bookkeeping. An overrun shows up in the overflow count.
+static void DTI_DmaHandler(DMAC_TRANSFER_EVENT event, uintptr_t context)
+{
+    uint32_t startCycles = DTI_CYCLES_GET();
+
+    // The SERCOM interrupt is off in this mode, the overflow is polled here
+    if (SERCOM0_REGS->SPIS.SERCOM_STATUS & SERCOM_SPIS_STATUS_BUFOVF_Msk)
+    {
+        SERCOM0_REGS->SPIS.SERCOM_STATUS  = SERCOM_SPIS_STATUS_BUFOVF_Msk;
+        SERCOM0_REGS->SPIS.SERCOM_INTFLAG = SERCOM_SPIS_INTFLAG_ERROR_Msk;
+        DTI_ReceiveOverflow();
+    }
+
+    if (event != DMAC_TRANSFER_EVENT_COMPLETE)
+    {
+        DTI_rxFrame = NULL;
+        DTI_ReceiveHeaderDMA();
+    }
+    else if (DTI_rxPayload)
+    {
+        DTI_ReceiveHeaderDMA();
+        DTI_FrameReceived();
+    }
+    else
+    {
+        DTI_HeaderReceived();
+        if (DTI_rxPayloadLen == 0)
+        {
+            DTI_ReceiveHeaderDMA();
+            DTI_FrameReceived();
+        }
+        else
+        {
+            DTI_ReceivePayloadDMA();
+            DTI_payloadStart = SYS_TIME_CounterGet();
+        }
+    }
+
+    DTI_AccountInterrupt(startCycles);
+}
+#endif
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Routines
+// *****************************************************************************
+// *****************************************************************************
+
+void DTI_Initialize(void)
+{
+#if (CFG_DTI_ISR_TIMING == 1)
+    // No TICKINT : SysTick only counts, SysTick_Handler is never taken
+    SysTick->LOAD = DTI_CYCLES_MASK;
+    SysTick->VAL  = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif
+
+    DTI_statsStart       = SYS_TIME_Counter64Get();
+    DTI_stats.dmaReceive = (CFG_DTI_DMA_RECEIVE == 1);
+
+#if (CFG_DTI_DMA_RECEIVE == 1)
+    // Received bytes trigger the DMA. Every SERCOM interrupt is turned off so
+    // the generated SERCOM0 handler never runs and never reads DATA.
+    SERCOM0_REGS->SPIS.SERCOM_INTENCLR = SERCOM_SPIS_INTENCLR_Msk;
+
+    DMAC_ChannelCallbackRegister(DTI_DMAC_CHANNEL, DTI_DmaHandler, 0);
+    DTI_ReceiveHeaderDMA();
+#endif
+}
+
+void DTI_Reset(void)
+{
+    bool interruptState = SYS_INT_Disable();
+
+    DTI_rxFrame      = NULL;
+    DTI_rxPayloadLen = 0;
+    DTI_rxCount      = 0;
+
+#if (CFG_DTI_DMA_RECEIVE == 1)
+    {
+        uint8_t channelId = (uint8_t)DMAC_REGS->DMAC_CHID;
+
+        // Drop a completion of the aborted transfer that is still pending
+        DMAC_ChannelDisable(DTI_DMAC_CHANNEL);
+        DMAC_REGS->DMAC_CHID       = DTI_DMAC_CHANNEL;
+        DMAC_REGS->DMAC_CHINTFLAG  = DMAC_CHINTFLAG_TCMPL_Msk | DMAC_CHINTFLAG_TERR_Msk;
+        DMAC_REGS->DMAC_CHID       = channelId;
+        NVIC_ClearPendingIRQ(DMAC_IRQn);
+
+        DTI_ReceiveHeaderDMA();
+    }
+#endif
+
+    SYS_INT_Restore(interruptState);
+}
+
+// Values are moved over their index and length bytes to make room for the
+// terminating NUL, so the fields are passed on without copying the frame
+static void DTI_ProcessFields(uint8_t* payload, uint16_t payloadLen)
+{
+    telemetry_field_t fields[TELEMETRY_FIELD_INDEX_MAX];
+    int               count = 0;
+    uint16_t          pos   = 0;
+
+    while (pos < payloadLen)
+    {
+        uint8_t index;
+        uint8_t length;
+
+        if (count == TELEMETRY_FIELD_INDEX_MAX ||
+            payloadLen - pos < DTI_FIELD_HEADER_NUMBYTES ||
+            payload[pos + 1] > payloadLen - pos - DTI_FIELD_HEADER_NUMBYTES)
+        {
+            debug_printError("  DTI: Malformed field list at byte %d", pos);
+            DTI_stats.fieldErrors++;
+            return;
+        }
+
+        index  = payload[pos];
+        length = payload[pos + 1];
+        memmove(&payload[pos], &payload[pos + DTI_FIELD_HEADER_NUMBYTES], length);
+        payload[pos + length] = CHAR_NULL;
+
+        fields[count].index = index;
+        fields[count].data  = (char*)&payload[pos];
+        count++;
+        pos += DTI_FIELD_HEADER_NUMBYTES + length;
+    }
+
+    process_telemetry_fields(fields, count);
+}
+
+void DTI_Tasks(void)
+{
+    while (DTI_frameReady[DTI_readIndex])
+    {
+        uint8_t*          frame = DTI_frameBuffer[DTI_readIndex];
+        DTI_DataFrameInfo info;
+
+        // Frame contents are read only after its ready flag
+        __DMB();
+
+        info.commandChar = frame[DTI_pIDX_CMDCHAR];
+        info.parameter1  = frame[DTI_pIDX_PARAM1];
+        info.payloadLen  = ((uint16_t)frame[DTI_pIDX_PAYLENMSB] << 8) | frame[DTI_pIDX_PAYLENLSB];
+        info.payloadData = &frame[DTI_HEADER_NUMBYTES];
+
+        if ((info.commandChar == DTI_CMDCHAR_TELEMETRY_1) ||
+            (info.commandChar == DTI_CMDCHAR_TELEMETRY_2))
+        {
+            // Index 0 resynchronizes the receiver, which a complete frame already is
+            if (info.parameter1 != 0)
+            {
+                process_telemetry_command(info.parameter1, (char*)info.payloadData);
+            }
+            LED_YELLOW_Toggle_EX();
+        }
+        else if ((info.commandChar == DTI_CMDCHAR_TELEMETRY_MULTI_1) ||
+                 (info.commandChar == DTI_CMDCHAR_TELEMETRY_MULTI_2))
+        {
+            DTI_ProcessFields(info.payloadData, info.payloadLen);
+            LED_YELLOW_Toggle_EX();
+        }
+
+        // Release the buffer to the receive path only after it is processed
+        __DMB();
+        DTI_frameReady[DTI_readIndex] = false;
+        DTI_readIndex                 = (DTI_readIndex + 1) % CFG_DTI_FRAME_BUFFERS;
+        DTI_framesProcessed++;
+    }
+}
+
+void DTI_GetStatistics(DTI_Statistics* stats, bool clear)
+{
+    bool     interruptState = SYS_INT_Disable();
+    uint64_t now            = SYS_TIME_Counter64Get();
+    uint32_t countsPerUs    = SYS_TIME_FrequencyGet() / 1000000;
+
+    *stats               = DTI_stats;
+    stats->isrTimeUs     = (uint32_t)(DTI_isrCycles / DTI_CYCLES_PER_US);
+    stats->payloadTimeUs = (uint32_t)(DTI_payloadCounts / countsPerUs);
+    stats->elapsedMs     = (uint32_t)((now - DTI_statsStart) / countsPerUs / 1000);
+
+    if (clear)
+    {
+        memset(&DTI_stats, 0, sizeof(DTI_stats));
+        DTI_stats.dmaReceive = stats->dmaReceive;
+        DTI_isrCycles        = 0;
+        DTI_payloadCounts    = 0;
+        DTI_statsStart       = now;
+    }
+    SYS_INT_Restore(interruptState);
+}
+
+/*******************************************************************************
+ End of File
+*/
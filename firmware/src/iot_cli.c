@@ -45,8 +45,14 @@
 #include "credentials_storage/credentials_storage.h"
 #include "debug_print.h"
 #include "m2m_wifi.h"
+#include "nmspi.h"
+#include "config/SAMD21_WG_IOT/peripheral/sercom/spi_slave/dti.h"
+#include "sensors.h"
 #include "services/iot/cloud/mqtt_packetPopulation/mqtt_iotprovisioning_packetPopulate.h"
 #include "azutil.h"
+#include "latency_trace.h"
+#include "services/iot/cloud/store_forward.h"
+#include "services/iot/cloud/reconnect_policy.h"
 
 #define MAX_PUB_KEY_LEN       200
 #define WIFI_PARAMS_UNDEFINED 0
@@ -72,20 +78,35 @@ static void get_set_dps_idscope(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** ar
 static void send_telemetry(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
 static void process_property(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
 static void get_cloud_connection_status(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_mqtt_status(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_event_latency(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_command_latency(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_connection_timing(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_reconnect_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_spi_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_dti_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
+static void get_sensor_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv);
 
 extern userdata_status_t userdata_status;
-extern uint16_t DTI_bufferPtr;
 
 #define LINE_TERM "\r\n"
 
 static const SYS_CMD_DESCRIPTOR _iotCmdTbl[] =
     {
         {"property", process_property, ": Send and receive device property from cloud //Usage: property <index>, <data(hex)>"},
-        {"telemetry", send_telemetry, ": Send data to cloud as telemetry //Usage: telemetry <index>, <data(hex)>"},
+        {"telemetry", send_telemetry, ": Send data to cloud as telemetry //Usage: telemetry <index>, <data(hex)> [<index>, <data(hex)> ...]"},
         {"idscope", get_set_dps_idscope, ": Get and Set Azure DPS ID Scope //Usage: idscope [ID Scope]"},
         {"reconnect", reconnect_cmd, ": MQTT Reconnect "},
         {"wifi", get_set_wifi, ": Set Wifi credentials //Usage: wifi <ssid>[,<pass>,[authType]] "},
         {"cloud", get_cloud_connection_status, ": Get MQTT Connection Status"},
+        {"mqtt", get_mqtt_status, ": Get MQTT PUBLISH queue statistics"},
+        {"events", get_event_latency, ": Get application event post-to-handler latency"},
+        {"latency", get_command_latency, ": Get direct method round trip latency //Usage: latency [-raw|-reset]"},
+        {"timing", get_connection_timing, ": Get boot to first telemetry and reconnect times"},
+        {"backoff", get_reconnect_stats, ": Get reconnect attempts, failures and backoff per stage"},
+        {"spi", get_spi_stats, ": Get WINC SPI block transfer throughput //Usage: spi [-reset]"},
+        {"dti", get_dti_stats, ": Get DTI frame receive throughput and CPU load //Usage: dti [-reset]"},
+        {"sensors", get_sensor_stats, ": Get latest sensor samples and read statistics"},
         {"key", get_public_key, ": Get ECC Public Key "},
         {"device", get_device_id, ": Get ECC Serial No. "},
         {"cli_version", get_cli_version, ": Get CLI version "},
@@ -336,6 +357,234 @@ static void get_cloud_connection_status(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, c
     debug_disable(false);
 }
 
+static void get_mqtt_status(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    const void*           cmdIoParam = pCmdIO->cmdIoParam;
+    mqttPublishQueueStats stats;
+    store_forward_stats_t storeStats;
+
+    MQTT_GetPublishQueueStats(&stats);
+
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "MQTT PUBLISH queue\r\n");
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Capacity  : %d\r\n", stats.capacity);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  In use    : %d\r\n", stats.inUse);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  High water: %d\r\n", stats.highWaterMark);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Queued    : %d\r\n", stats.queued);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Dropped   : %lu\r\n", stats.dropCount);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Arena     : %d (high water %d) of %d bytes\r\n", stats.arenaInUse, stats.arenaHighWater, MQTT_PUBLISH_ARENA_SIZE);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  In flight : %d\r\n", MQTT_GetInflightPublishCount());
+
+    STORE_FORWARD_GetStats(&storeStats);
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, "Store-and-forward telemetry\r\n");
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Stored    : %d (%d in flight)\r\n", storeStats.stored, storeStats.inflight);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Buffer    : %d (high water %d) of %d bytes\r\n", storeStats.bytesUsed, storeStats.highWater, CFG_STORE_FORWARD_BUFFER_SIZE);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Dropped   : %lu\r\n\4", storeStats.dropCount);
+}
+
+static void get_connection_timing(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    const void*    cmdIoParam = pCmdIO->cmdIoParam;
+    cloud_timing_t timing;
+
+    CLOUD_getTiming(&timing);
+
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Boot to (ms, 0 = not yet)\r\n");
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  WiFi      : %lu\r\n", timing.wifiMs);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Host IP   : %lu\r\n", timing.hostIpMs);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  CONNACK   : %lu\r\n", timing.connackMs);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Telemetry : %lu\r\n", timing.telemetryMs);
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, "Reconnect\r\n");
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Count     : %d\r\n", timing.reconnectCount);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Last(ms)  : %lu\r\n", timing.lastReconnectMs);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Max(ms)   : %lu\r\n", timing.maxReconnectMs);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  DNS       : %d lookups, %d cache hits\r\n", timing.dnsLookups, timing.dnsCacheHits);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Fallbacks : %d\r\n\4", timing.fallbackCount);
+}
+
+static void get_reconnect_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    static const char* const breakerNames[] = {"Closed", "Open", "Half open"};
+    const void*              cmdIoParam     = pCmdIO->cmdIoParam;
+    reconnect_stage_stats_t  stats;
+    int                      stage;
+
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Stage     Attempts   Failures   In a row   Backoff(ms) Breaker   Trips\r\n");
+    for (stage = 0; stage < RECONNECT_STAGE_COUNT; stage++)
+    {
+        RECONNECT_GetStats((reconnect_stage_t)stage, &stats);
+        (*pCmdIO->pCmdApi->print)(cmdIoParam, "  %-7s %-10lu %-10lu %-10d %-11lu %-9s %d\r\n",
+                                  RECONNECT_GetStageName((reconnect_stage_t)stage),
+                                  stats.attempts,
+                                  stats.failures,
+                                  stats.consecutiveFailures,
+                                  stats.backoffMs,
+                                  breakerNames[stats.breaker],
+                                  stats.breakerTrips);
+    }
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, "\4");
+}
+
+static uint32_t spi_throughput_kbps(uint32_t bytes, uint32_t timeUs)
+{
+    return timeUs == 0 ? 0 : (uint32_t)(((uint64_t)bytes * 8000) / timeUs);
+}
+
+static void get_spi_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    const void*    cmdIoParam = pCmdIO->cmdIoParam;
+    tstrNmSpiStats stats;
+
+    nm_spi_get_stats(&stats, argc > 1 && strcmp(argv[1], "-reset") == 0);
+
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "WINC SPI    Blocks     Bytes      Time(ms)   kbit/s\r\n");
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Read      %-10lu %-10lu %-10lu %lu\r\n",
+                              stats.u32BlockReads,
+                              stats.u32BytesRead,
+                              stats.u32ReadTimeUs / 1000,
+                              spi_throughput_kbps(stats.u32BytesRead, stats.u32ReadTimeUs));
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Write     %-10lu %-10lu %-10lu %lu\r\n",
+                              stats.u32BlockWrites,
+                              stats.u32BytesWritten,
+                              stats.u32WriteTimeUs / 1000,
+                              spi_throughput_kbps(stats.u32BytesWritten, stats.u32WriteTimeUs));
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Retries   %lu\r\n\4", stats.u32Retries);
+}
+
+static void get_dti_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    const void*    cmdIoParam = pCmdIO->cmdIoParam;
+    DTI_Statistics stats;
+    uint32_t       framesSeen;
+    uint32_t       load;
+
+    DTI_GetStatistics(&stats, argc > 1 && strcmp(argv[1], "-reset") == 0);
+
+    framesSeen = stats.frames + stats.dropped + stats.lengthErrors;
+    // CPU load in 1/100 %
+    load = stats.elapsedMs == 0 ? 0 : (uint32_t)(((uint64_t)stats.isrTimeUs * 10) / stats.elapsedMs);
+
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, LINE_TERM "DTI receive by %s\r\n", stats.dmaReceive ? "DMA" : "byte interrupt");
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Frames      %lu (dropped %lu, bad length %lu, bad fields %lu, overflows %lu)\r\n",
+                              stats.frames,
+                              stats.dropped,
+                              stats.lengthErrors,
+                              stats.fieldErrors,
+                              stats.overflows);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Bytes       %lu in %lu ms, %lu kbit/s\r\n",
+                              stats.bytes,
+                              stats.elapsedMs,
+                              stats.elapsedMs == 0 ? 0 : (uint32_t)(((uint64_t)stats.bytes * 8) / stats.elapsedMs));
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Payload     %lu kbit/s while receiving\r\n",
+                              spi_throughput_kbps(stats.payloadBytes, stats.payloadTimeUs));
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Interrupts  %lu, %lu per frame\r\n",
+                              stats.interrupts,
+                              framesSeen == 0 ? 0 : stats.interrupts / framesSeen);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  ISR time    %lu us, CPU load %lu.%02lu %%\r\n",
+                              stats.isrTimeUs,
+                              load / 100,
+                              load % 100);
+    (*pCmdIO->pCmdApi->print)(cmdIoParam, "  Queue max   %u of %u\r\n\4", stats.queueHighWater, CFG_DTI_FRAME_BUFFERS);
+}
+
+static void get_sensor_stats(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    static const char* const sensorNames[SENSOR_COUNT] = {"Light(mV)", "Temp(C/16)"};
+    const void*              cmdIoParam                = pCmdIO->cmdIoParam;
+    sensor_sample_t          sample;
+    sensor_stats_t           stats;
+    int                      id;
+
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Sensor       Value      Age(ms)    Samples    Errors     Busy\r\n");
+    for (id = 0; id < SENSOR_COUNT; id++)
+    {
+        SENSOR_GetStats((sensor_id_t)id, &stats);
+        if (!SENSOR_GetLatest((sensor_id_t)id, &sample))
+        {
+            (*pCmdIO->pCmdApi->print)(cmdIoParam, "%-12s -          -          %-10lu %-10lu %lu\r\n",
+                                      sensorNames[id],
+                                      stats.samples,
+                                      stats.errors,
+                                      stats.busy);
+            continue;
+        }
+        (*pCmdIO->pCmdApi->print)(cmdIoParam, "%-12s %-10ld %-10lu %-10lu %-10lu %lu\r\n",
+                                  sensorNames[id],
+                                  sample.value,
+                                  SYS_TIME_CountToMS(SYS_TIME_CounterGet() - sample.timestamp),
+                                  stats.samples,
+                                  stats.errors,
+                                  stats.busy);
+    }
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, "\4");
+}
+
+static void get_event_latency(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    static const char* const eventNames[APP_EVENT_COUNT] = {"Cloud tick", "Data tick", "Sample tick", "Socket", "Cloud TX", "Button", "DTI frame", "Console RX"};
+    const void*              cmdIoParam                  = pCmdIO->cmdIoParam;
+    APP_EVENT_LATENCY        latency;
+    int                      event;
+
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Event        Count      Last(us)   Avg(us)    Max(us)\r\n");
+    for (event = 0; event < APP_EVENT_COUNT; event++)
+    {
+        APP_GetEventLatency((APP_EVENT)event, &latency);
+        (*pCmdIO->pCmdApi->print)(cmdIoParam, "  %-10s %-10lu %-10lu %-10lu %lu\r\n",
+                                  eventNames[event],
+                                  latency.count,
+                                  latency.lastUs,
+                                  latency.count ? (uint32_t)(latency.totalUs / latency.count) : 0,
+                                  latency.maxUs);
+    }
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, "\4");
+}
+
+static void get_command_latency(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    const void*         cmdIoParam = pCmdIO->cmdIoParam;
+    trace_stage_stats_t stats;
+    trace_record_t      records[TRACE_RING_SIZE];
+    uint8_t             count;
+    int                 i;
+
+    if (argc == 2 && strcmp(argv[1], "-reset") == 0)
+    {
+        TRACE_Reset();
+        (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Latency statistics cleared\r\n\4");
+        return;
+    }
+
+    if (argc == 2 && strcmp(argv[1], "-raw") == 0)
+    {
+        count = TRACE_GetRecords(records, TRACE_RING_SIZE);
+
+        (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Seq    Tracepoint  Offset(us)\r\n");
+        for (i = 0; i < count; i++)
+        {
+            (*pCmdIO->pCmdApi->print)(cmdIoParam, "  %-5u %-11s %lu\r\n",
+                                      records[i].sequence,
+                                      TRACE_GetPointName(records[i].point),
+                                      (uint32_t)SYS_TIME_CountToUS((uint32_t)(records[i].timestamp - records[0].timestamp)));
+        }
+        (*pCmdIO->pCmdApi->msg)(cmdIoParam, "\4");
+        return;
+    }
+
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Stage      Count  Min(us)    Avg(us)    P99(us)    Max(us)\r\n");
+    for (i = 0; i < TRACE_STAGE_COUNT; i++)
+    {
+        TRACE_GetStageStats((trace_stage_t)i, &stats);
+        (*pCmdIO->pCmdApi->print)(cmdIoParam, "  %-8s %-6lu %-10lu %-10lu %-10lu %lu\r\n",
+                                  TRACE_GetStageName((trace_stage_t)i),
+                                  stats.count,
+                                  stats.minUs,
+                                  stats.count ? (uint32_t)(stats.totalUs / stats.count) : 0,
+                                  TRACE_GetPercentileUs(&stats, 99),
+                                  stats.maxUs);
+    }
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, "\4");
+}
+
 static void get_public_key(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
 {
     const void* cmdIoParam = pCmdIO->cmdIoParam;
@@ -419,6 +668,52 @@ static void show_send_telemetry_help(SYS_CMD_DEVICE_NODE* pCmdIO)
     (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM " 9: Update Long in hex (8 bytes max) [e.g. telemetry 9,CAFE1234BEEF5678]");
     (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM " 10: Update Boolean (true/false) [e.g. telemetry 10,true]");
     (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM " 11~14: Update String (no spaces, 67 chars max) [e.g. telemetry 13,Hello_World!!!]");
+    (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Several values are sent as one message [e.g. telemetry 2,CAFEBEEF 10,true 13,Hello]");
+}
+
+static void send_telemetry_fields(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
+{
+    const void*       cmdIoParam = pCmdIO->cmdIoParam;
+    char*             chCmdDelim = ",";
+    telemetry_field_t fields[TELEMETRY_FIELD_INDEX_MAX];
+    int               count = 0;
+    int               arg;
+
+    // Each argument holds one or more <index>,<data> pairs
+    for (arg = 1; arg < argc; arg++)
+    {
+        char* chCmdIndex = strtok(argv[arg], chCmdDelim);
+
+        while (chCmdIndex != NULL)
+        {
+            char* chCmdData = strtok(NULL, chCmdDelim);
+            char* chEnd;
+            long  cmdIndex;
+
+            errno    = 0;
+            cmdIndex = strtol(chCmdIndex, &chEnd, 10);
+
+            if (chCmdData == NULL || chCmdIndex == chEnd || errno == ERANGE)
+            {
+                (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Invalid command parameter\r\n\4");
+                show_send_telemetry_help(pCmdIO);
+                return;
+            }
+            else if (cmdIndex < 1 || cmdIndex > TELEMETRY_INDEX_MAX || count == TELEMETRY_FIELD_INDEX_MAX)
+            {
+                (*pCmdIO->pCmdApi->msg)(cmdIoParam, LINE_TERM "Invalid command index parameter\r\n\4");
+                show_send_telemetry_help(pCmdIO);
+                return;
+            }
+
+            fields[count].index = cmdIndex;
+            fields[count].data  = chCmdData;
+            count++;
+            chCmdIndex = strtok(NULL, chCmdDelim);
+        }
+    }
+
+    process_telemetry_fields(fields, count);
 }
 
 static void send_telemetry(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
@@ -436,6 +731,10 @@ static void send_telemetry(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
         show_send_telemetry_help(pCmdIO);
         return;
     }
+    else if (argc > 2 || strchr(argv[1], ',') != strrchr(argv[1], ','))
+    {
+        send_telemetry_fields(pCmdIO, argc, argv);
+    }
     else if (argc == 2)
     {
         if ((chCmdIndex = strtok(argv[1], chCmdDelim)) == NULL)
@@ -476,7 +775,7 @@ static void send_telemetry(SYS_CMD_DEVICE_NODE* pCmdIO, int argc, char** argv)
                 switch (cmdIndex)
                 {
                     case 0:
-                        DTI_bufferPtr = 0;
+                        DTI_Reset();
                     break;
                     case 1:
                     case 2:
@@ -3,14 +3,109 @@
 
 #define CFG_DEFAULT_TELEMETRY_INTERVAL_SEC 10
 
+// Telemetry batching : with telemetryBatchSize above 1 a sample is captured every telemetryBatchSampleMs,
+// independently of telemetryInterval, into a ring of CFG_TELEMETRY_RING_SIZE samples (a power of two).
+// The sample timer ticks every CFG_TELEMETRY_SAMPLE_TICK_MS, so periods below a second work.
+// The oldest samples are sent as one JSON array once telemetryBatchSize samples are queued or the
+// oldest one is telemetryBatchFlushMs old. Capture goes on while a batch waits to be sent, the
+// oldest samples are dropped when the ring is full. A batch size of 1 sends every sample on its own.
+#define CFG_TELEMETRY_BATCH_MAX_SAMPLES       8
+#define CFG_TELEMETRY_RING_SIZE               16
+#define CFG_TELEMETRY_SAMPLE_TICK_MS          100
+#define CFG_DEFAULT_TELEMETRY_BATCH_SIZE      1
+#define CFG_DEFAULT_TELEMETRY_BATCH_FLUSH_MS  10000
+#define CFG_DEFAULT_TELEMETRY_BATCH_SAMPLE_MS 1000
+
+// Telemetry payload encoding : 0 = JSON, 1 = CBOR (sent with $.ct=application/cbor)
+#define CFG_DEFAULT_TELEMETRY_ENCODING 0
+
+// Telemetry aggregation : with telemetryWindowSec > 0 every light and temperature sample goes into a
+// running min/max/mean/stddev and one summary is sent per window instead of a sample every
+// telemetryInterval. A value is also sent at once when it moves lightDeadband / temperatureDeadband
+// away from the last value sent, or leaves the lightLow..lightHigh / temperatureLow..temperatureHigh
+// range (off while High <= Low). These writable properties are in telemetry units (mV, degree C).
+#define CFG_DEFAULT_TELEMETRY_WINDOW_SEC 0
+#define CFG_TELEMETRY_WINDOW_MAX_SEC     86400
+
+// Minimum time between two exception messages for the same value. A value that keeps crossing its
+// deadband is sent at most this often, with the latest value.
+#define CFG_TELEMETRY_ALERT_MIN_INTERVAL_MS 5000
+
+// Store-and-forward : QoS 1 telemetry is kept until its PUBACK and sent again after a reconnect.
+// Telemetry is also generated while disconnected, the oldest messages are dropped when the buffer is full.
+// The queue drains while more than CFG_STORE_FORWARD_LIVE_RESERVE PUBLISH descriptors are free,
+// the reserved ones are left for property and command traffic.
+#define CFG_STORE_FORWARD_ENABLE       1
+#define CFG_STORE_FORWARD_BUFFER_SIZE  3072   // Bytes, multiple of 4
+#define CFG_STORE_FORWARD_LIVE_RESERVE 2
+
+// Connection cache : the hub assigned by DPS and its address are kept in flash.
+// A restart connects to that hub directly, the address is resolved again after the TTL.
+// After CFG_CLOUD_FALLBACK_FAILURES failed connects to the cached hub DPS runs again.
+#define CFG_CONNECTION_CACHE_ENABLE  1
+#define CFG_CONNECTION_CACHE_TTL_SEC 86400L
+#define CFG_CLOUD_FALLBACK_FAILURES  3
+
+// Reconnect circuit breaker : after this many failures in a row a connection stage is held off
+// for CFG_RECONNECT_BREAKER_OPEN_MS (plus up to half of it) before one trial attempt
+#define CFG_RECONNECT_BREAKER_FAILURES 6
+#define CFG_RECONNECT_BREAKER_OPEN_MS  600000L
+
+// Reported properties : updates are merged and sent as one PATCH once the oldest one is this old.
+// Reported-only values the hub already acknowledged are not sent again.
+// One PATCH is in flight at a time; without a response within the timeout its updates are sent again.
+#define CFG_REPORTED_PROPERTY_WINDOW_MS           1000
+#define CFG_REPORTED_PROPERTY_RESPONSE_TIMEOUT_MS 30000
+
+// Direct method latency diagnostics : per stage p99/max sent as telemetry every N seconds, 0 = off
+#define CFG_DIAGNOSTICS_TELEMETRY_INTERVAL_SEC 0
+
+// DTI (SERCOM0 SPI slave) : set to 1 to receive each frame as a header DMA transfer followed by a
+// payload DMA transfer instead of one interrupt per byte. Frames are queued in CFG_DTI_FRAME_BUFFERS
+// buffers of DTI_MAXTOTAL_NUMBYTES and processed from the application task.
+#define CFG_DTI_DMA_RECEIVE   1
+#define CFG_DTI_FRAME_BUFFERS 2
+// Set to 1 to measure the DTI interrupt time with SysTick, which is then used as a free running cycle
+// counter (its interrupt stays disabled). Set to 0 if SysTick is needed elsewhere; the time reads 0.
+#define CFG_DTI_ISR_TIMING    1
+
+// sendMsg direct method : the unescaped message is copied to a buffer of CFG_SENDMSG_BUFFER_SIZE bytes
+// (terminator included) and written to the console UART from the main loop as its TX ring drains.
+// The relay gives up, and logs it, if the ring does not drain for CFG_SENDMSG_STALL_TIMEOUT_MS.
+// The method request must fit the MQTT RX buffer (RX_BUFF_SIZE, 1024 bytes, in mqtt_comm_layer.c)
+// with its topic and JSON, which limits the message to about 950 bytes; larger requests are
+// dropped by the MQTT client and time out at the service.
+#define CFG_SENDMSG_BUFFER_SIZE      1024
+#define CFG_SENDMSG_STALL_TIMEOUT_MS 500
+
+// Sensors : TC4 starts a light sensor conversion (4 samples averaged by the ADC) every
+// CFG_SENSOR_LIGHT_PERIOD_MS, the MCP9808 is read over I2C every CFG_SENSOR_TEMP_PERIOD_MS
+// (checked from the 250 ms data task). The last CFG_SENSOR_RING_SIZE samples of each sensor are
+// kept, a power of two. Telemetry sends the mean of the samples taken in the last
+// CFG_SENSOR_AVERAGE_MS, 0 = the latest sample only.
+#define CFG_SENSOR_LIGHT_PERIOD_MS 100
+#define CFG_SENSOR_TEMP_PERIOD_MS  1000
+#define CFG_SENSOR_RING_SIZE       16
+#define CFG_SENSOR_AVERAGE_MS      0
+
 #define IOT_DEBUG_PRINT 1
 
+// Set to 1 to queue debug messages as format string and raw arguments.
+// They are formatted and written to the console from the main loop.
+#ifndef CFG_DEBUG_DEFERRED
+#define CFG_DEBUG_DEFERRED 0
+#endif
+
 //#define CFG_MQTT_DEBUG_MSG 1    //set to enable debug print messages MQTT
 
 #define CFG_ENABLE_CLI 1
 
 #define CFG_APP_WINC_DEBUG 1
 
+// Set to 1 to sleep (WFI) in the main loop while no application event is pending.
+// Work raised by a driver interrupt between the idle check and WFI waits for the next interrupt.
+#define CFG_APP_IDLE_SLEEP 0
+
 #define CFG_LED_DEBUG 0
 
 // Comment out or remove IOT_PLUG_AND_PLAY_MODEL_ID to run as non-IoT Plug and Play client
@@ -31,7 +31,13 @@
 #define CFG_MQTT_CONN_TIMEOUT    10
 #define TOPIC_SIZE               512U                       // Defines the topic length that is supported when we process a published packet
 #define PAYLOAD_SIZE             1024U                      // Defines the payload size that is supported when we process a published packet
-#define MAX_NUM_TOPICS_SUBSCRIBE 3U                         // Defines number of topics supported for Subscription
+#define MAX_NUM_TOPICS_SUBSCRIBE 8U                         // Defines number of topics supported for Subscription
+#define MQTT_TOPIC_TRIE_MAX_NODES   32U                     // Defines number of topic levels (plus one root) the subscription filters may compile into (max 254)
 #define NUM_TOPICS_UNSUBSCRIBE   MAX_NUM_TOPICS_SUBSCRIBE   // Client can Un-subscribe only from those topics already subscribed
+#define MQTT_MAX_INFLIGHT_PUBLISH   4U                      // Defines number of QoS 1 PUBLISH packets that may await PUBACK at the same time
+#define MQTT_PUBLISH_QUEUE_SIZE     8U                      // Defines number of PUBLISH packets that can be queued or awaiting PUBACK at the same time
+#define MQTT_PUBLISH_ARENA_SIZE     2048U                   // Defines bytes reserved for copies of queued PUBLISH topics and payloads (multiple of 4)
+#define MQTT_MAX_PUBLISH_RETRANSMIT 3U                      // Defines how many times an unacknowledged QoS 1 PUBLISH is re-sent (DUP flag set) before it is reported as not delivered
+#define MQTT_MAX_PUBLISH_PACKET_SIZE 1400U                  // Defines the largest PUBLISH packet that can be sent, limited by the WINC socket buffer (SOCKET_BUFFER_MAX_LENGTH)
 
 #endif   // MQTT_CONFIG_H
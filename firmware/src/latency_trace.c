@@ -0,0 +1,219 @@
+/*
+    \file   latency_trace.c
+
+    \brief  Direct method round trip tracepoints
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include "definitions.h"
+#include "latency_trace.h"
+#include "mqtt/mqtt_core/mqtt_core.h"
+
+static trace_record_t      traceRing[TRACE_RING_SIZE];
+static uint8_t             traceRingHead  = 0;   // Next record to write
+static uint8_t             traceRingCount = 0;
+static trace_stage_stats_t traceStats[TRACE_STAGE_COUNT];
+
+// Direct method currently being traced
+static uint16_t      traceSequence = 0;
+static bool          traceActive   = false;
+static trace_point_t traceLastPoint;
+static uint64_t      traceTimes[TRACE_POINT_COUNT];
+static uint64_t      traceLastRecv;             // Data for a direct method may arrive before it is known to be one
+static uint8_t       tracePublishesAhead = 0;   // PUBLISH packets queued before the response
+
+static const char* const traceStageNames[TRACE_STAGE_COUNT] = {"Dispatch", "Handler", "Response", "Transmit", "Total"};
+static const char* const tracePointNames[TRACE_POINT_COUNT] = {"Socket RX", "Method RX", "Handled", "Queued", "Sent"};
+
+static void traceRecord(trace_point_t point, uint64_t timestamp)
+{
+    traceRing[traceRingHead].timestamp = timestamp;
+    traceRing[traceRingHead].sequence  = traceSequence;
+    traceRing[traceRingHead].point     = point;
+    traceRingHead                      = (traceRingHead + 1) % TRACE_RING_SIZE;
+
+    if (traceRingCount < TRACE_RING_SIZE)
+    {
+        traceRingCount++;
+    }
+}
+
+static void traceAddStage(trace_stage_t stage, uint64_t start, uint64_t end)
+{
+    trace_stage_stats_t* stats  = &traceStats[stage];
+    uint32_t             us     = SYS_TIME_CountToUS((uint32_t)(end - start));
+    uint8_t              bucket = 0;
+
+    while (bucket < TRACE_HISTOGRAM_BUCKETS - 1 && (us >> (bucket + 1)) != 0)
+    {
+        bucket++;
+    }
+
+    if (stats->count == 0 || us < stats->minUs)
+    {
+        stats->minUs = us;
+    }
+
+    if (us > stats->maxUs)
+    {
+        stats->maxUs = us;
+    }
+
+    stats->totalUs += us;
+    stats->count++;
+
+    stats->histogram[bucket]++;
+}
+
+/** \brief Timestamp a tracepoint of the direct method round trip.
+ *
+ * Tracepoints of a direct method must be hit in trace_point_t order, anything
+ * else is ignored. The stage statistics are updated once the response has been
+ * written to the socket. PUBLISH packets leave the queue in order, so the
+ * response is the PUBLISH sent after the ones that were queued ahead of it.
+ */
+void TRACE_Point(trace_point_t point)
+{
+    uint64_t now = SYS_TIME_Counter64Get();
+
+    if (point == TRACE_SOCKET_RECV)
+    {
+        traceLastRecv = now;
+        return;
+    }
+
+    if (point == TRACE_METHOD_RECEIVED)
+    {
+        traceSequence++;
+        traceActive                   = true;
+        traceTimes[TRACE_SOCKET_RECV] = traceLastRecv;
+        traceRecord(TRACE_SOCKET_RECV, traceLastRecv);
+    }
+    else if (!traceActive || point != traceLastPoint + 1)
+    {
+        return;
+    }
+    else if (point == TRACE_RESPONSE_QUEUED)
+    {
+        mqttPublishQueueStats queueStats;
+
+        MQTT_GetPublishQueueStats(&queueStats);
+        if (queueStats.queued == 0)
+        {
+            // The response could not be queued
+            traceActive = false;
+            return;
+        }
+        tracePublishesAhead = queueStats.queued - 1;
+    }
+    else if (point == TRACE_PUBLISH_SENT && tracePublishesAhead > 0)
+    {
+        tracePublishesAhead--;
+        return;
+    }
+
+    traceTimes[point] = now;
+    traceLastPoint    = point;
+    traceRecord(point, now);
+
+    if (point == TRACE_PUBLISH_SENT)
+    {
+        traceAddStage(TRACE_STAGE_DISPATCH, traceTimes[TRACE_SOCKET_RECV], traceTimes[TRACE_METHOD_RECEIVED]);
+        traceAddStage(TRACE_STAGE_HANDLER, traceTimes[TRACE_METHOD_RECEIVED], traceTimes[TRACE_METHOD_HANDLED]);
+        traceAddStage(TRACE_STAGE_RESPONSE, traceTimes[TRACE_METHOD_HANDLED], traceTimes[TRACE_RESPONSE_QUEUED]);
+        traceAddStage(TRACE_STAGE_TRANSMIT, traceTimes[TRACE_RESPONSE_QUEUED], traceTimes[TRACE_PUBLISH_SENT]);
+        traceAddStage(TRACE_STAGE_TOTAL, traceTimes[TRACE_SOCKET_RECV], traceTimes[TRACE_PUBLISH_SENT]);
+        traceActive = false;
+    }
+}
+
+void TRACE_Reset(void)
+{
+    memset(traceStats, 0, sizeof(traceStats));
+    traceRingHead  = 0;
+    traceRingCount = 0;
+    traceActive    = false;
+}
+
+void TRACE_GetStageStats(trace_stage_t stage, trace_stage_stats_t* stats)
+{
+    *stats = traceStats[stage];
+}
+
+/** \brief Estimate a percentile from the stage histogram.
+ *
+ * @return upper bound of the bucket holding the percentile, limited to the
+ *         largest value seen
+ */
+uint32_t TRACE_GetPercentileUs(const trace_stage_stats_t* stats, uint8_t percent)
+{
+    uint32_t target = ((uint32_t)stats->count * percent + 99) / 100;
+    uint32_t seen   = 0;
+    uint32_t bound;
+    uint8_t  bucket;
+
+    if (stats->count == 0)
+    {
+        return 0;
+    }
+
+    for (bucket = 0; bucket < TRACE_HISTOGRAM_BUCKETS - 1; bucket++)
+    {
+        seen += stats->histogram[bucket];
+        if (seen >= target)
+        {
+            break;
+        }
+    }
+
+    bound = (2UL << bucket) - 1;
+    return (bound < stats->maxUs) ? bound : stats->maxUs;
+}
+
+/** \brief Copy the most recent tracepoint records, oldest first.
+ *
+ * @return number of records copied
+ */
+uint8_t TRACE_GetRecords(trace_record_t* records, uint8_t maxRecords)
+{
+    uint8_t count = (traceRingCount < maxRecords) ? traceRingCount : maxRecords;
+    uint8_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        records[i] = traceRing[(traceRingHead + TRACE_RING_SIZE - count + i) % TRACE_RING_SIZE];
+    }
+
+    return count;
+}
+
+const char* TRACE_GetStageName(trace_stage_t stage)
+{
+    return traceStageNames[stage];
+}
+
+const char* TRACE_GetPointName(trace_point_t point)
+{
+    return tracePointNames[point];
+}
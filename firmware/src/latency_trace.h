@@ -0,0 +1,83 @@
+/*
+    \file   latency_trace.h
+
+    \brief  Direct method round trip tracepoints
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define TRACE_RING_SIZE        32   // Number of tracepoint records kept for the CLI
+#define TRACE_HISTOGRAM_BUCKETS 20  // Bucket b holds stages of 2^b .. 2^(b+1)-1 us, the last one is open ended
+
+// Tracepoints along the path of a direct method
+typedef enum
+{
+    TRACE_SOCKET_RECV = 0,    // SOCKET_MSG_RECV delivered data to the MQTT layer
+    TRACE_METHOD_RECEIVED,    // APP_ReceivedFromCloud_methods() was called
+    TRACE_METHOD_HANDLED,     // The command handler started sending its response
+    TRACE_RESPONSE_QUEUED,    // The response PUBLISH was queued
+    TRACE_PUBLISH_SENT,       // A PUBLISH was written to the socket
+    TRACE_POINT_COUNT
+} trace_point_t;
+
+// Stages measured between consecutive tracepoints of one direct method
+typedef enum
+{
+    TRACE_STAGE_DISPATCH = 0,   // Socket receive to handler call (reassembly, parsing, topic dispatch)
+    TRACE_STAGE_HANDLER,        // Command processing
+    TRACE_STAGE_RESPONSE,       // Building and queueing the response
+    TRACE_STAGE_TRANSMIT,       // Response queued to written to the socket
+    TRACE_STAGE_TOTAL,          // Socket receive to response written
+    TRACE_STAGE_COUNT
+} trace_stage_t;
+
+typedef struct
+{
+    uint64_t      timestamp;   // SYS_TIME_Counter64Get() when the tracepoint was hit
+    uint16_t      sequence;    // Direct method the tracepoint belongs to
+    trace_point_t point;
+} trace_record_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+    uint32_t histogram[TRACE_HISTOGRAM_BUCKETS];
+} trace_stage_stats_t;
+
+void        TRACE_Point(trace_point_t point);
+void        TRACE_Reset(void);
+void        TRACE_GetStageStats(trace_stage_t stage, trace_stage_stats_t* stats);
+uint32_t    TRACE_GetPercentileUs(const trace_stage_stats_t* stats, uint8_t percent);
+uint8_t     TRACE_GetRecords(trace_record_t* records, uint8_t maxRecords);
+const char* TRACE_GetStageName(trace_stage_t stage);
+const char* TRACE_GetPointName(trace_point_t point);
+
+#endif   // LATENCY_TRACE_H
@@ -26,6 +26,9 @@
 #include <stdbool.h>       // Defines true
 #include <stdlib.h>        // Defines EXIT_FAILURE
 #include "definitions.h"   // SYS function prototypes
+#include "app.h"
+#include "debug_print.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
 
 // *****************************************************************************
 // *****************************************************************************
@@ -42,6 +45,20 @@ int main(void)
     {
         /* Maintain state machines of all polled MPLAB Harmony modules. */
         SYS_Tasks();
+
+        /* Write deferred debug messages */
+        debug_flush();
+
+#if (CFG_APP_IDLE_SLEEP == 1)
+        /* Sleep until the next interrupt while no application event is pending.
+           WFI also returns for an interrupt that became pending while masked. */
+        bool interruptState = SYS_INT_Disable();
+        if (APP_IsIdle())
+        {
+            __WFI();
+        }
+        SYS_INT_Restore(interruptState);
+#endif
     }
 
     /* Execution should not come here during normal operation */
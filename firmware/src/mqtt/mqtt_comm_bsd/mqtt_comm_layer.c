@@ -33,9 +33,11 @@
 #include "../../services/iot/cloud/bsd_adapter/bsdWINC.h"
 #include "debug_print.h"
 
-// MQTT Tx buffer size: (1KB + 1) bytes payload to support 1024-byte string with NULL char, 35 bytes for CONNECT packet size (mqttConnectPacket), 50 bytes for topic
-#define TX_BUFF_SIZE         ((1024 + 1) + 35 + 50)/*400*/ 
+// MQTT Tx buffer size: PUBLISH packets are sent straight from the caller's buffers with MQTT_SendSegments(),
+// so this only stages CONNECT (client ID, user name and password), SUBSCRIBE, UNSUBSCRIBE, PINGREQ and DISCONNECT
+#define TX_BUFF_SIZE         512/*((1024 + 1) + 35 + 50)*/
 // MQTT Rx buffer size: How large does this really need to be?  Original setting of 2096 bytes seems to be way overkill...1KB seems to be the minimum required
+// A received PUBLISH (topic and payload) must fit, larger ones are dropped. This is the size limit of direct method and twin payloads.
 #define RX_BUFF_SIZE         1024/*2096*/
 #define USER_LENGTH          0
 #define MQTT_KEEP_ALIVE_TIME 120
@@ -45,6 +47,9 @@ static uint8_t*    mqttTxBuff = NULL;
 static uint8_t    mqttRxBuff[RX_BUFF_SIZE];
 static int8_t      mqqtSocket = -1;
 
+// Bytes still to be dropped of a packet larger than the RX buffer
+static uint32_t mqttRxSkipLength = 0;
+
 void MQTT_ClientInitialize(void)
 {
     MQTT_initialiseState();
@@ -72,6 +77,7 @@ void MQTT_ClientInitialize(void)
     mqttConn.mqttDataExchangeBuffers.rxbuff.dataLength      = 0;
 
     mqttConn.tcpClientSocket = &mqqtSocket;
+    mqttRxSkipLength         = 0;
 }
 
 mqttContext* MQTT_GetClientConnectionInfo()
@@ -93,6 +99,25 @@ bool MQTT_Send(mqttContext* connectionPtr)
     return ret;
 }
 
+bool MQTT_SendSegments(mqttContext* connectionPtr, mqttTxSegment* segments, uint8_t segmentCount)
+{
+    struct bsd_iovec iov[MQTT_TX_SEGMENTS_MAX];
+    uint8_t          i;
+
+    if (segmentCount > MQTT_TX_SEGMENTS_MAX)
+    {
+        return false;
+    }
+
+    for (i = 0; i < segmentCount; i++)
+    {
+        iov[i].iov_base = segments[i].data;
+        iov[i].iov_len  = segments[i].length;
+    }
+
+    return (BSD_writev(*connectionPtr->tcpClientSocket, iov, segmentCount) > BSD_SUCCESS);
+}
+
 bool MQTT_Close(mqttContext* connectionPtr)
 {
     debug_printGood(" MQTT: MQTT Close");
@@ -104,10 +129,101 @@ bool MQTT_Close(mqttContext* connectionPtr)
     return ret;
 }
 
+bool MQTT_Receive(mqttContext* connectionPtr)
+{
+    uint8_t* recvLocation;
+    uint16_t freeSpace;
+
+    // Receive directly behind the data already buffered so a packet split
+    // across several reads is reassembled in place. The reception handler
+    // keeps the buffered data at the start of the buffer.
+    freeSpace = MQTT_ExchangeBufferWriteSpan(&connectionPtr->mqttDataExchangeBuffers.rxbuff, &recvLocation);
+    if (connectionPtr->mqttDataExchangeBuffers.rxbuff.start == NULL || freeSpace == 0)
+    {
+        return false;
+    }
+
+    return (BSD_recv(*connectionPtr->tcpClientSocket, recvLocation, freeSpace, 0) == BSD_SUCCESS);
+}
+
+// Drop the buffered start of a packet that can never fit in the RX buffer
+// and skip the rest of it as it arrives. The reception handler keeps the
+// buffered data at the start of the buffer, so the packets are contiguous.
+static void mqttDropOversizedPacket(exchangeBuffer* rxbuff)
+{
+    exchangeBuffer packets = *rxbuff;
+    int32_t        packetLength;
+
+    while (packets.dataLength > 0)
+    {
+        packetLength = MQTT_GetRxPacketLength(&packets);
+        if (packetLength <= 0)
+        {
+            // Incomplete fixed header, or malformed and left to the reception handler
+            return;
+        }
+        if (packetLength > packets.dataLength)
+        {
+            break;
+        }
+        packets.currentLocation += packetLength;
+        packets.dataLength -= (uint16_t)packetLength;
+    }
+
+    if (packets.dataLength > 0 && packetLength > rxbuff->bufferLength)
+    {
+        debug_printError(" MQTT: Dropping %ld byte packet (type %d), RX buffer is %d bytes", (long)packetLength, packets.currentLocation[0] >> 4, rxbuff->bufferLength);
+        mqttRxSkipLength = (uint32_t)packetLength - packets.dataLength;
+        rxbuff->dataLength -= packets.dataLength;
+    }
+}
+
 void MQTT_GetReceivedData(uint8_t* pData, uint16_t len)
 {
-    if (MQTT_ExchangeBufferInit(&mqttConn.mqttDataExchangeBuffers.rxbuff))
+    exchangeBuffer* rxbuff = &mqttConn.mqttDataExchangeBuffers.rxbuff;
+    uint8_t*        recvLocation;
+    uint16_t        freeSpace;
+    uint16_t        skipped;
+
+    if (rxbuff->start == NULL)
+    {
+        return;
+    }
+
+    skipped = (mqttRxSkipLength < len) ? (uint16_t)mqttRxSkipLength : len;
+    mqttRxSkipLength -= skipped;
+    pData += skipped;
+    len -= skipped;
+
+    freeSpace = MQTT_ExchangeBufferWriteSpan(rxbuff, &recvLocation);
+    if (len == 0)
+    {
+    }
+    else if (pData >= recvLocation && pData + len <= recvLocation + freeSpace)
+    {
+        // Data was received in place behind the buffered bytes, moved up over
+        // the skipped ones
+        if (pData != recvLocation)
+        {
+            memmove(recvLocation, pData, len);
+        }
+        MQTT_ExchangeBufferCommit(rxbuff, len);
+    }
+    else if (MQTT_ExchangeBufferWrite(rxbuff, pData, len) < len)
+    {
+        // Part of the stream is lost and cannot be re-synchronized
+        debug_printError(" MQTT: RX buffer overflow");
+        MQTT_ExchangeBufferInit(rxbuff);
+        MQTT_Close(&mqttConn);
+        return;
+    }
+
+    mqttDropOversizedPacket(rxbuff);
+    if (mqttRxSkipLength > 0)
     {
-        MQTT_ExchangeBufferWrite(&mqttConn.mqttDataExchangeBuffers.rxbuff, pData, len);
+        // The WINC reads the rest of a segment into the buffer of the latest
+        // recv() call, so point it at the space freed by the drop
+        freeSpace = MQTT_ExchangeBufferWriteSpan(rxbuff, &recvLocation);
+        BSD_recv(*mqttConn.tcpClientSocket, recvLocation, freeSpace, 0);
     }
 }
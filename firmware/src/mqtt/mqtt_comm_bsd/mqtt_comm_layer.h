@@ -44,11 +44,22 @@ typedef struct
     int8_t*     tcpClientSocket;
 } mqttContext;
 
+/** \brief One buffer of a gathered MQTT transmission, see MQTT_SendSegments(). */
+typedef struct
+{
+    uint8_t* data;
+    uint16_t length;
+} mqttTxSegment;
+
+#define MQTT_TX_SEGMENTS_MAX 4
+
 
 void         MQTT_ClientInitialize(void);
 mqttContext* MQTT_GetClientConnectionInfo();
 
 bool MQTT_Send(mqttContext* connectionPtr);
+bool MQTT_SendSegments(mqttContext* connectionPtr, mqttTxSegment* segments, uint8_t segmentCount);
+bool MQTT_Receive(mqttContext* connectionPtr);
 bool MQTT_Close(mqttContext* connectionPtr);
 void MQTT_GetReceivedData(uint8_t* pData, uint16_t len);
 #endif /* MQTT_COMM_LAYER_H */
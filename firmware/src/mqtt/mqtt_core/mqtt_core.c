@@ -31,6 +31,7 @@ IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
  *
  ******************************************************************************/
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,6 +42,7 @@ IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
 #include "../../iot_config/mqtt_config.h"
 #include "../../iot_config/IoT_Sensor_Node_config.h"
 #include "debug_print.h"
+#include "latency_trace.h"
 #include "services/iot/cloud/mqtt_packetPopulation/mqtt_packetPopulate.h"
 
 extern pf_MQTT_CLIENT* pf_mqtt_client;
@@ -51,6 +53,14 @@ extern pf_MQTT_CLIENT* pf_mqtt_client;
 #define KEEP_ALIVE_CALCULATION_CONSTANT 0x01
 #define CONNECT_CLEAN_SESSION_MASK 0x02
 
+#if MQTT_PUBLISH_QUEUE_SIZE < MQTT_MAX_INFLIGHT_PUBLISH
+#error "MQTT_PUBLISH_QUEUE_SIZE must be at least MQTT_MAX_INFLIGHT_PUBLISH"
+#endif
+
+#if (MQTT_PUBLISH_ARENA_SIZE % 4) != 0
+#error "MQTT_PUBLISH_ARENA_SIZE must be a multiple of 4"
+#endif
+
 
 // MQTT packet transmission flags. The creation and transmission processes of
 // MQTT control packets uses a set of flags to indicate that a new packet is
@@ -104,6 +114,16 @@ typedef enum
     SENDPINGREQ     = 32,
 } mqttConnectCurrentTxSubstate;
 
+// Header in front of every allocation in the PUBLISH arena. Blocks are
+// handed out in ring order and reclaimed from the tail once released, so a
+// PUBACK that arrives out of order only delays reuse of the space.
+typedef struct
+{
+    uint16_t length;   // Block size including this header, multiple of 4
+    uint8_t  inUse;
+    uint8_t  reserved;
+} mqttArenaBlock;
+
 // Function pointer for handling QoS levels.
 typedef void (*qosLevelHandler)(uint8_t);
 
@@ -133,10 +153,38 @@ static newRxDataFlags mqttRxFlags;
 /** \brief CONNECT packet to be transmitted. */
 static mqttConnectPacket txConnectPacket;
 
-/** \brief PUBLISH packet to be transmitted. */
-//static mqttPublishPacket txPublishPacket;
-static volatile mqttPublishPacket* txPublishPacketHead    = NULL;
-static volatile mqttPublishPacket* txPublishPacketPending = NULL;
+/** \brief PUBLISH packet descriptors, shared by the Tx queue and the in-flight window. */
+static mqttPublishPacket txPublishPacketPool[MQTT_PUBLISH_QUEUE_SIZE];
+
+/** \brief Stack of unused descriptor indexes into txPublishPacketPool. */
+static uint8_t txPublishPacketFreeList[MQTT_PUBLISH_QUEUE_SIZE];
+static uint8_t txPublishPacketFreeCount = 0;
+
+/** \brief PUBLISH packets to be transmitted, oldest at txPublishQueueHead. */
+static mqttPublishPacket* txPublishQueue[MQTT_PUBLISH_QUEUE_SIZE];
+static uint8_t            txPublishQueueHead  = 0;
+static uint8_t            txPublishQueueTail  = 0;
+static uint8_t            txPublishQueueCount = 0;
+
+/** \brief Copies of the topic and payload of queued PUBLISH packets. */
+static uint32_t txPublishArena[MQTT_PUBLISH_ARENA_SIZE / sizeof(uint32_t)];
+static uint16_t txPublishArenaHead = 0;   // Offset of the next allocation
+static uint16_t txPublishArenaTail = 0;   // Offset of the oldest allocation
+static uint16_t txPublishArenaUsed = 0;
+
+/** \brief PUBLISH descriptor pool statistics. */
+static uint8_t  txPublishPacketHighWater = 0;
+static uint32_t txPublishPacketDropCount = 0;
+static uint16_t txPublishArenaHighWater  = 0;
+
+/** \brief QoS 1 PUBLISH packets sent and waiting for PUBACK. */
+static mqttPublishPacket* txPublishPacketInflight[MQTT_MAX_INFLIGHT_PUBLISH];
+
+/** \brief Number of occupied entries in txPublishPacketInflight. */
+static uint8_t txPublishInflightCount = 0;
+
+/** \brief The pool is set up once, packets are kept across reconnects. */
+static bool txPublishPoolInitialised = false;
 
 /** \brief SUBSCRIBE packet to be transmitted. */
 static mqttSubscribePacket txSubscribePacket;
@@ -235,6 +283,46 @@ transmission.
  */
 static bool mqttSendPublish(mqttContext* mqttConnectionPtr);
 
+/** \brief Write a PUBLISH packet to the Tx buffer and send it.
+ *
+ * This function serializes the given PUBLISH packet and sends it using the
+underlying TCP layer. It is shared by the first transmission and by the
+retransmission of an unacknowledged QoS 1 PUBLISH packet.
+ *
+ * @param mqttConnectionPtr
+ * @param publishPacket
+ *
+ * @return
+ *  - The return code indicating success/failure of PUBLISH packet
+transmission.
+ */
+static bool mqttWritePublish(mqttContext* mqttConnectionPtr, mqttPublishPacket* publishPacket);
+
+/** \brief Retransmit QoS 1 PUBLISH packets whose PUBACK is overdue.
+ *
+ * This function re-sends, with the DUP flag set, every in-flight PUBLISH
+packet that has not been acknowledged within WAITFORPUBACK_TIMEOUT. After
+MQTT_MAX_PUBLISH_RETRANSMIT attempts the packet is dropped and the PUBACK
+callbacks are called with notDelivered set.
+ *
+ * @param mqttConnectionPtr
+ */
+static void mqttCheckPubackTimeout(mqttContext* mqttConnectionPtr);
+
+/** \brief Give up on every in-flight PUBLISH packet.
+ *
+ * The PUBACK callbacks are called with notDelivered set for each packet, so
+ * the senders can publish them again on the next connection.
+ */
+static void mqttClearInflightPublish(void);
+
+/** \brief Re-send the in-flight PUBLISH packets kept from the previous connection.
+ *
+ * Called once CONNACK is received for a CONNECT with cleanSession = 0. The
+ * packets are re-sent, with the DUP flag set, by mqttCheckPubackTimeout().
+ */
+static void mqttResendInflightPublish(void);
+
 /** \brief Send the MQTT SUBSCRIBE packet.
  *
  * This function sends the MQTT SUBSCRIBE packet using the underlying
@@ -528,9 +616,151 @@ void checkUnsubackTimeoutState(void)
     unsubackTimeoutOccured = true;   // Mark that timer has executed
 }
 
-void MQTT_initialiseState(void)
+static void mqttInitPublishPool(void)
 {
-    mqttState = DISCONNECTED;
+    uint8_t index;
+
+    memset(txPublishPacketInflight, 0, sizeof(txPublishPacketInflight));
+    txPublishInflightCount = 0;
+
+    txPublishQueueHead  = 0;
+    txPublishQueueTail  = 0;
+    txPublishQueueCount = 0;
+
+    for (index = 0; index < MQTT_PUBLISH_QUEUE_SIZE; index++)
+    {
+        txPublishPacketFreeList[index] = index;
+    }
+    txPublishPacketFreeCount = MQTT_PUBLISH_QUEUE_SIZE;
+
+    txPublishArenaHead = 0;
+    txPublishArenaTail = 0;
+    txPublishArenaUsed = 0;
+
+    mqttTxFlags.newTxPublishPacket = 0;
+    mqttRxFlags.newRxPubackPacket  = 0;
+}
+
+static uint8_t* mqttArenaAlloc(uint16_t size)
+{
+    uint8_t*        arena = (uint8_t*)txPublishArena;
+    mqttArenaBlock* block;
+    uint32_t        need  = (sizeof(mqttArenaBlock) + size + 3) & ~3UL;
+
+    if (txPublishArenaUsed == 0)
+    {
+        // Start over at the beginning to get the largest contiguous space
+        txPublishArenaHead = 0;
+        txPublishArenaTail = 0;
+    }
+
+    if (txPublishArenaUsed + need > MQTT_PUBLISH_ARENA_SIZE)
+    {
+        return NULL;
+    }
+
+    if (txPublishArenaHead >= txPublishArenaTail)
+    {
+        // Free space is [head, end) followed by [0, tail)
+        if (MQTT_PUBLISH_ARENA_SIZE - txPublishArenaHead < need)
+        {
+            if (txPublishArenaTail < need)
+            {
+                return NULL;
+            }
+
+            // Skip the unusable end of the arena; it is reclaimed together with the blocks in front of it
+            block           = (mqttArenaBlock*)&arena[txPublishArenaHead];
+            block->length   = MQTT_PUBLISH_ARENA_SIZE - txPublishArenaHead;
+            block->inUse    = 0;
+            txPublishArenaUsed += block->length;
+            txPublishArenaHead = 0;
+        }
+    }
+    else if (txPublishArenaTail - txPublishArenaHead < need)
+    {
+        return NULL;
+    }
+
+    block         = (mqttArenaBlock*)&arena[txPublishArenaHead];
+    block->length = need;
+    block->inUse  = 1;
+
+    txPublishArenaHead = (txPublishArenaHead + need) % MQTT_PUBLISH_ARENA_SIZE;
+    txPublishArenaUsed += need;
+    if (txPublishArenaUsed > txPublishArenaHighWater)
+    {
+        txPublishArenaHighWater = txPublishArenaUsed;
+    }
+
+    return (uint8_t*)(block + 1);
+}
+
+static void mqttArenaFree(uint8_t* data)
+{
+    uint8_t*        arena = (uint8_t*)txPublishArena;
+    mqttArenaBlock* block = (mqttArenaBlock*)data - 1;
+
+    block->inUse = 0;
+
+    // Reclaim every released block at the tail
+    while (txPublishArenaUsed > 0)
+    {
+        block = (mqttArenaBlock*)&arena[txPublishArenaTail];
+        if (block->inUse)
+        {
+            break;
+        }
+        txPublishArenaTail = (txPublishArenaTail + block->length) % MQTT_PUBLISH_ARENA_SIZE;
+        txPublishArenaUsed -= block->length;
+    }
+}
+
+static mqttPublishPacket* mqttAllocPublishPacket(void)
+{
+    mqttPublishPacket* packet = NULL;
+    uint8_t            inUse;
+
+    if (txPublishPacketFreeCount > 0)
+    {
+        txPublishPacketFreeCount--;
+        packet = &txPublishPacketPool[txPublishPacketFreeList[txPublishPacketFreeCount]];
+
+        inUse = MQTT_PUBLISH_QUEUE_SIZE - txPublishPacketFreeCount;
+        if (inUse > txPublishPacketHighWater)
+        {
+            txPublishPacketHighWater = inUse;
+        }
+    }
+    else
+    {
+        txPublishPacketDropCount++;
+    }
+
+    return packet;
+}
+
+static void mqttFreePublishPacket(mqttPublishPacket* packet)
+{
+    if (packet->ownedData != NULL)
+    {
+        mqttArenaFree(packet->ownedData);
+        packet->ownedData = NULL;
+    }
+
+    txPublishPacketFreeList[txPublishPacketFreeCount] = (uint8_t)(packet - txPublishPacketPool);
+    txPublishPacketFreeCount++;
+}
+
+void MQTT_GetPublishQueueStats(mqttPublishQueueStats* stats)
+{
+    stats->capacity      = MQTT_PUBLISH_QUEUE_SIZE;
+    stats->inUse         = MQTT_PUBLISH_QUEUE_SIZE - txPublishPacketFreeCount;
+    stats->queued        = txPublishQueueCount;
+    stats->highWaterMark = txPublishPacketHighWater;
+    stats->dropCount      = txPublishPacketDropCount;
+    stats->arenaInUse     = txPublishArenaUsed;
+    stats->arenaHighWater = txPublishArenaHighWater;
 }
 
 mqttCurrentState MQTT_GetConnectionState(void)
@@ -538,6 +768,69 @@ mqttCurrentState MQTT_GetConnectionState(void)
     return mqttState;
 }
 
+uint8_t MQTT_GetInflightPublishCount(void)
+{
+    return txPublishInflightCount;
+}
+
+static void mqttReleaseInflightPublish(uint8_t slot)
+{
+    mqttFreePublishPacket(txPublishPacketInflight[slot]);
+    txPublishPacketInflight[slot] = NULL;
+    txPublishInflightCount--;
+
+    if (txPublishInflightCount == 0)
+    {
+        mqttRxFlags.newRxPubackPacket = 0;
+    }
+}
+
+static void mqttNotifyPuback(mqttPublishPacket* publishPacket, mqttPubackPacket* puback)
+{
+    if (publishPacket->pubackCallback)
+    {
+        publishPacket->pubackCallback(puback);
+    }
+    if (mqttPubackCallback)
+    {
+        mqttPubackCallback(puback);
+    }
+}
+
+// Tell the sender a QoS 1 PUBLISH will not be acknowledged, so it can send it again
+static void mqttNotifyNotDelivered(mqttPublishPacket* publishPacket)
+{
+    mqttPubackPacket puback;
+
+    memset(&puback, 0, sizeof(puback));
+    puback.pubackFixedHeader.controlPacketType = PUBACK;
+    puback.remainingLength                     = 2;
+    puback.packetIdentifierLSB                 = publishPacket->packetIdentifierLSB;
+    puback.packetIdentifierMSB                 = publishPacket->packetIdentifierMSB;
+    puback.notDelivered                        = 1;
+
+    mqttNotifyPuback(publishPacket, &puback);
+}
+
+static void mqttFailInflightPublish(uint8_t slot)
+{
+    mqttNotifyNotDelivered(txPublishPacketInflight[slot]);
+    mqttReleaseInflightPublish(slot);
+}
+
+static void mqttClearInflightPublish(void)
+{
+    uint8_t slot;
+
+    for (slot = 0; slot < MQTT_MAX_INFLIGHT_PUBLISH; slot++)
+    {
+        if (txPublishPacketInflight[slot] != NULL)
+        {
+            mqttFailInflightPublish(slot);
+        }
+    }
+}
+
 bool MQTT_CreateConnectPacket(mqttConnectPacket* newConnectPacket)
 {
     uint16_t payloadLength = 0;
@@ -559,12 +852,13 @@ bool MQTT_CreateConnectPacket(mqttConnectPacket* newConnectPacket)
     txConnectPacket.connectVariableHeader.protocolLevel   = 0x04;
     if ((newConnectPacket->passwordLength > 0) || (newConnectPacket->usernameLength > 0))
     {
-        txConnectPacket.connectVariableHeader.connectFlagsByte.All = 0xC2;
+        txConnectPacket.connectVariableHeader.connectFlagsByte.All = 0xC0;
     }
     else
     {
-        txConnectPacket.connectVariableHeader.connectFlagsByte.All = 0x02;
+        txConnectPacket.connectVariableHeader.connectFlagsByte.All = 0x00;
     }
+    txConnectPacket.connectVariableHeader.connectFlagsByte.cleanSession = newConnectPacket->connectVariableHeader.connectFlagsByte.cleanSession;
     txConnectPacket.connectVariableHeader.keepAliveTimer = htons(newConnectPacket->connectVariableHeader.keepAliveTimer);
 
     // Payload
@@ -599,6 +893,28 @@ bool MQTT_CreateConnectPacket(mqttConnectPacket* newConnectPacket)
     // Clear all pending transmissions first
     mqttTxFlags.All = 0;
 
+    // PUBLISH packets still waiting for PUBACK from the previous connection
+    // are re-sent after CONNACK when the session is kept. Otherwise their
+    // senders are told through the PUBACK callback (see store_forward.c).
+    if (txPublishInflightCount > 0)
+    {
+        if (txConnectPacket.connectVariableHeader.connectFlagsByte.cleanSession == 0)
+        {
+            debug_printInfo(" MQTT: Keeping %d unacknowledged PUBLISH for the session", txPublishInflightCount);
+        }
+        else
+        {
+            debug_printWarn(" MQTT: %d unacknowledged PUBLISH not delivered", txPublishInflightCount);
+            mqttClearInflightPublish();
+        }
+    }
+
+    // Packets queued before the connection was lost are sent once connected
+    if (txPublishQueueCount > 0)
+    {
+        mqttTxFlags.newTxPublishPacket = 1;
+    }
+
     // Now mark the Connect for sending
     mqttTxFlags.newTxConnectPacket = 1;
     mqttState                      = CONNECTING;
@@ -640,11 +956,12 @@ mqttPublishPacket* MQTT_GetPublishPacket(void)
 {
     mqttPublishPacket* current = NULL;
 
-    // Retrieves the oldest Publish Packet from the list (beginning of the list)
-    if (txPublishPacketHead != NULL)
+    // Retrieves the oldest Publish Packet from the queue
+    if (txPublishQueueCount > 0)
     {
-        current             = (mqttPublishPacket*)txPublishPacketHead;
-        txPublishPacketHead = current->next;
+        current            = txPublishQueue[txPublishQueueHead];
+        txPublishQueueHead = (txPublishQueueHead + 1) % MQTT_PUBLISH_QUEUE_SIZE;
+        txPublishQueueCount--;
     }
 
     return current;
@@ -652,27 +969,48 @@ mqttPublishPacket* MQTT_GetPublishPacket(void)
 
 void MQTT_AddPublishPacketToList(mqttPublishPacket* newPacket)
 {
-    // Add to the list
+    // The queue holds as many entries as the descriptor pool, so it cannot
+    // overflow for a descriptor obtained from mqttAllocPublishPacket()
+    txPublishQueue[txPublishQueueTail] = newPacket;
+    txPublishQueueTail                 = (txPublishQueueTail + 1) % MQTT_PUBLISH_QUEUE_SIZE;
+    txPublishQueueCount++;
+}
+
+static void mqttReturnPublishPacketToList(mqttPublishPacket* packet)
+{
+    // Put the packet back where MQTT_GetPublishPacket() took it from
+    txPublishQueueHead                 = (txPublishQueueHead + MQTT_PUBLISH_QUEUE_SIZE - 1) % MQTT_PUBLISH_QUEUE_SIZE;
+    txPublishQueue[txPublishQueueHead] = packet;
+    txPublishQueueCount++;
+}
+
+void MQTT_initialiseState(void)
+{
+    mqttState = DISCONNECTED;
 
-    if (txPublishPacketHead == NULL)
+    // Packets sent or queued on the previous connection are kept for the
+    // next CONNECT, which decides on them from its cleanSession flag
+    if (txPublishPoolInitialised == false)
     {
-        // add to the head of the linked list.
-        txPublishPacketHead = newPacket;
+        mqttInitPublishPool();
+        txPublishPoolInitialised = true;
     }
-    else
-    {
-        // add to the end of the linked list
-        mqttPublishPacket* current = (mqttPublishPacket*)txPublishPacketHead;
+}
+
+void MQTT_DiscardSession(void)
+{
+    mqttPublishPacket* publishPacket;
 
-        while (current->next != NULL)
+    mqttClearInflightPublish();
+    while ((publishPacket = MQTT_GetPublishPacket()) != NULL)
+    {
+        if (publishPacket->publishHeaderFlags.qos == 1)
         {
-            current = current->next;
+            mqttNotifyNotDelivered(publishPacket);
         }
-
-        current->next = newPacket;
     }
-
-    return;
+    mqttInitPublishPool();
+    txPublishPoolInitialised = true;
 }
 
 bool MQTT_CreatePublishPacket(mqttPublishPacket* newPublishPacket)
@@ -685,10 +1023,11 @@ bool MQTT_CreatePublishPacket(mqttPublishPacket* newPublishPacket)
 
     if (mqttState == CONNECTED)
     {
-        newPacket = malloc(sizeof(mqttPublishPacket));
+        newPacket = mqttAllocPublishPacket();
 
         if (newPacket == NULL)
         {
+            debug_printWarn(" MQTT: PUBLISH queue full, %lu dropped", txPublishPacketDropCount);
             return ret;
         }
 
@@ -707,6 +1046,7 @@ bool MQTT_CreatePublishPacket(mqttPublishPacket* newPublishPacket)
         // Variable header
         newPacket->topic       = newPublishPacket->topic;
         newPacket->topicLength = strlen((char*)newPublishPacket->topic);
+
         if (newPublishPacket->publishHeaderFlags.qos > 0)
         {
             newPacket->packetIdentifierLSB = newPublishPacket->packetIdentifierLSB;
@@ -717,9 +1057,41 @@ bool MQTT_CreatePublishPacket(mqttPublishPacket* newPublishPacket)
         // Payload
         newPacket->payload       = newPublishPacket->payload;
         newPacket->payloadLength = newPublishPacket->payloadLength;
+
+        // The packet is sent as a single socket write, fixed header included
+        if ((uint32_t)1 + sizeof(newPacket->remainingLength) + newPacket->totalLength + sizeof(newPacket->topicLength) + newPacket->topicLength + newPacket->payloadLength > MQTT_MAX_PUBLISH_PACKET_SIZE)
+        {
+            txPublishPacketDropCount++;
+            debug_printError(" MQTT: PUBLISH too large (%u byte payload)", newPacket->payloadLength);
+            mqttFreePublishPacket(newPacket);
+            return ret;
+        }
+
+        if (newPublishPacket->zeroCopy == 0)
+        {
+            // Take a private copy so the caller can reuse its buffers right away
+            newPacket->ownedData = mqttArenaAlloc(newPacket->topicLength + newPacket->payloadLength);
+            if (newPacket->ownedData == NULL)
+            {
+                txPublishPacketDropCount++;
+                debug_printWarn(" MQTT: PUBLISH arena full, %lu dropped", txPublishPacketDropCount);
+                mqttFreePublishPacket(newPacket);
+                return ret;
+            }
+            memcpy(newPacket->ownedData, newPacket->topic, newPacket->topicLength);
+            newPacket->topic = newPacket->ownedData;
+            if (newPacket->payloadLength > 0)
+            {
+                memcpy(newPacket->ownedData + newPacket->topicLength, newPacket->payload, newPacket->payloadLength);
+                newPacket->payload = newPacket->ownedData + newPacket->topicLength;
+            }
+        }
+
         newPacket->totalLength += sizeof(newPacket->topicLength) + newPacket->topicLength + newPacket->payloadLength;
         newPacket->topicLength = htons(newPacket->topicLength);
 
+        newPacket->pubackCallback = newPublishPacket->pubackCallback;
+
         MQTT_AddPublishPacketToList(newPacket);
 
         mqttTxFlags.newTxPublishPacket = 1;
@@ -863,10 +1235,70 @@ static bool mqttSendConnect(mqttContext* mqttConnectionPtr)
     return ret;
 }
 
+static bool mqttWritePublish(mqttContext* mqttConnectionPtr, mqttPublishPacket* publishPacket)
+{
+    // Fixed header, up to 4 remaining length bytes and the topic length
+    uint8_t         header[1 + sizeof(publishPacket->remainingLength) + sizeof(publishPacket->topicLength)];
+    uint8_t         packetIdentifier[2];
+    mqttTxSegment   segments[MQTT_TX_SEGMENTS_MAX];
+    exchangeBuffer* txbuff = &mqttConnectionPtr->mqttDataExchangeBuffers.txbuff;
+    uint8_t         headerLength;
+    uint16_t        topicLength;
+    uint8_t         segmentCount = 0;
+
+    // The header is built in a scratch area and the payload is streamed to
+    // the socket from where it is held, so the payload is never copied.
+    header[0]    = publishPacket->publishHeaderFlags.All;
+    headerLength = 1 + mqttEncodeLength(publishPacket->totalLength, &header[1]);
+    memcpy(&header[headerLength], &publishPacket->topicLength, sizeof(publishPacket->topicLength));
+    headerLength += sizeof(publishPacket->topicLength);
+    topicLength = ntohs(publishPacket->topicLength);
+
+    packetIdentifier[0] = publishPacket->packetIdentifierMSB;
+    packetIdentifier[1] = publishPacket->packetIdentifierLSB;
+
+    // The HIF writes every segment in its own SPI transaction, so the header,
+    // topic and packet identifier are gathered in the TX exchange buffer, which
+    // is free between packets, and sent with the payload as two segments.
+    if (MQTT_ExchangeBufferInit(txbuff) && (headerLength + topicLength + sizeof(packetIdentifier) <= txbuff->bufferLength))
+    {
+        MQTT_ExchangeBufferWrite(txbuff, header, headerLength);
+        MQTT_ExchangeBufferWrite(txbuff, publishPacket->topic, topicLength);
+        if (publishPacket->publishHeaderFlags.qos == 1)
+        {
+            MQTT_ExchangeBufferWrite(txbuff, packetIdentifier, sizeof(packetIdentifier));
+        }
+
+        segments[segmentCount].data     = txbuff->start;
+        segments[segmentCount++].length = txbuff->dataLength;
+        segments[segmentCount].data     = publishPacket->payload;
+        segments[segmentCount++].length = publishPacket->payloadLength;
+
+        return MQTT_SendSegments(mqttConnectionPtr, segments, segmentCount);
+    }
+
+    segments[segmentCount].data     = header;
+    segments[segmentCount++].length = headerLength;
+    segments[segmentCount].data     = publishPacket->topic;
+    segments[segmentCount++].length = topicLength;
+
+    if (publishPacket->publishHeaderFlags.qos == 1)
+    {
+        segments[segmentCount].data     = packetIdentifier;
+        segments[segmentCount++].length = sizeof(packetIdentifier);
+    }
+
+    segments[segmentCount].data     = publishPacket->payload;
+    segments[segmentCount++].length = publishPacket->payloadLength;
+
+    return MQTT_SendSegments(mqttConnectionPtr, segments, segmentCount);
+}
+
 static bool mqttSendPublish(mqttContext* mqttConnectionPtr)
 {
     bool               ret           = false;
     mqttPublishPacket* publishPacket = NULL;
+    uint8_t            slot;
 
     publishPacket = MQTT_GetPublishPacket();
 
@@ -878,58 +1310,97 @@ static bool mqttSendPublish(mqttContext* mqttConnectionPtr)
         return ret;
     }
 
-    if (!MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff))
+    // Find the in-flight slot before sending, a QoS 1 packet is not sent without one
+    for (slot = 0; slot < MQTT_MAX_INFLIGHT_PUBLISH && txPublishPacketInflight[slot] != NULL; slot++)
     {
-        debug_printError(" MQTT: txBuffer Null");
     }
-    else if (!MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff))
+
+    if (publishPacket->publishHeaderFlags.qos == 1 && slot == MQTT_MAX_INFLIGHT_PUBLISH)
     {
-        debug_printError(" MQTT: rxBuffer Null");
+        mqttReturnPublishPacketToList(publishPacket);
+        return ret;
     }
-    else
+
+    ret = mqttWritePublish(mqttConnectionPtr, publishPacket);
+
+    if (ret == true)
     {
-        // Copy the txPublishPacket data in TCP Tx buffer
-        MQTT_ExchangeBufferWrite(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff, &publishPacket->publishHeaderFlags.All, sizeof(publishPacket->publishHeaderFlags.All));
-        MQTT_ExchangeBufferWrite(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff, publishPacket->remainingLength, mqttEncodeLength(publishPacket->totalLength, publishPacket->remainingLength));
-        MQTT_ExchangeBufferWrite(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff, (uint8_t*)&publishPacket->topicLength, sizeof(publishPacket->topicLength));
-        MQTT_ExchangeBufferWrite(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff, publishPacket->topic, ntohs(publishPacket->topicLength));
+        TRACE_Point(TRACE_PUBLISH_SENT);
 
         if (publishPacket->publishHeaderFlags.qos == 1)
         {
-            MQTT_ExchangeBufferWrite(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff, &publishPacket->packetIdentifierMSB, sizeof(publishPacket->packetIdentifierMSB));
-            MQTT_ExchangeBufferWrite(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff, &publishPacket->packetIdentifierLSB, sizeof(publishPacket->packetIdentifierLSB));
+            publishPacket->sentTimestamp  = SYS_TIME_CounterGet();
+            txPublishPacketInflight[slot] = publishPacket;
+            txPublishInflightCount++;
+            mqttRxFlags.newRxPubackPacket = 1;
+        }
+        else
+        {
+            mqttFreePublishPacket(publishPacket);
+        }
+    }
+    else
+    {
+        // Put the packet back at the head of the queue and retry on the next pass
+        mqttReturnPublishPacketToList(publishPacket);
+    }
+
+    if (txPublishQueueCount == 0)
+    {
+        // no more publish packet to send.  Clear flag
+        mqttTxFlags.newTxPublishPacket = 0;
+    }
+    return ret;
+}
+
+static void mqttResendInflightPublish(void)
+{
+    uint8_t slot;
+
+    for (slot = 0; slot < MQTT_MAX_INFLIGHT_PUBLISH; slot++)
+    {
+        if (txPublishPacketInflight[slot] != NULL)
+        {
+            // Overdue now, with the full retransmit budget for the new connection
+            txPublishPacketInflight[slot]->sentTimestamp   = SYS_TIME_CounterGet() - SYS_TIME_MSToCount(WAITFORPUBACK_TIMEOUT);
+            txPublishPacketInflight[slot]->retransmitCount = 0;
         }
-        MQTT_ExchangeBufferWrite(&mqttConnectionPtr->mqttDataExchangeBuffers.txbuff, publishPacket->payload, publishPacket->payloadLength);
+    }
+}
+
+static void mqttCheckPubackTimeout(mqttContext* mqttConnectionPtr)
+{
+    mqttPublishPacket* publishPacket;
+    uint16_t           packetId;
+    uint8_t            slot;
 
-        // Function call to TCP_Send() is abstracted
-        if (mqttTxFlags.newTxPublishPacket == 1 || publishPacket->publishHeaderFlags.duplicate == 1)
+    for (slot = 0; slot < MQTT_MAX_INFLIGHT_PUBLISH; slot++)
+    {
+        publishPacket = txPublishPacketInflight[slot];
+
+        if (publishPacket == NULL || (SYS_TIME_CounterGet() - publishPacket->sentTimestamp) < SYS_TIME_MSToCount(WAITFORPUBACK_TIMEOUT))
         {
-            ret = MQTT_Send(mqttConnectionPtr);
-            if (ret == true)
-            {
-                if (txPublishPacketHead == NULL)
-                {
-                    // no more publish packet to send.  Clear flag
-                    mqttTxFlags.newTxPublishPacket = 0;
-                }
+            continue;
+        }
 
-                if (publishPacket->publishHeaderFlags.qos == 1)
-                {
-                    txPublishPacketPending        = publishPacket;
-                    mqttRxFlags.newRxPubackPacket = 1;
-                }
-                else
-                {
-                    free(publishPacket);
-                }
-            }
-            else
+        packetId = (publishPacket->packetIdentifierMSB << 8) | publishPacket->packetIdentifierLSB;
+
+        if (publishPacket->retransmitCount >= MQTT_MAX_PUBLISH_RETRANSMIT)
+        {
+            debug_printError(" MQTT: PUBACK Timeout, Packet ID %d not delivered", packetId);
+            mqttFailInflightPublish(slot);
+        }
+        else
+        {
+            debug_printWarn(" MQTT: PUBACK Timeout, re-sending Packet ID %d", packetId);
+            publishPacket->publishHeaderFlags.duplicate = 1;
+            if (mqttWritePublish(mqttConnectionPtr, publishPacket) == true)
             {
-                free(publishPacket);
+                publishPacket->retransmitCount++;
+                publishPacket->sentTimestamp = SYS_TIME_CounterGet();
             }
         }
     }
-    return ret;
 }
 
 static uint8_t mqttEncodeLength(uint16_t length, uint8_t* output)
@@ -999,9 +1470,6 @@ static void mqttProcessPingresp(mqttContext* mqttConnectionPtr)
     {
         mqttTxFlags.newTxPingreqPacket = 1;
     }
-    // Re-initialise the RX exchange buffer to be able to process the
-    // next incoming MQTT packet
-    MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff);
 }
 
 static mqttCurrentState mqttProcessSuback(mqttContext* mqttConnectionPtr)
@@ -1010,6 +1478,7 @@ static mqttCurrentState mqttProcessSuback(mqttContext* mqttConnectionPtr)
     mqttSubackPacket rxSubackPacket;
     uint8_t          topicNumbers = 0;
     uint8_t          topicCount   = 0;
+    uint8_t          returnCode;
 
     memset(&rxSubackPacket, 0, sizeof(rxSubackPacket));
 
@@ -1030,40 +1499,42 @@ static mqttCurrentState mqttProcessSuback(mqttContext* mqttConnectionPtr)
     }
     else
     {
-        // ToDo remove hardcoding
-        MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, rxSubackPacket.returnCode, 1);
-        // ToDo This calculation needs to be modified after removing
-        // hardcoding
-        topicNumbers = (sizeof(rxSubackPacket.returnCode) / sizeof(rxSubackPacket.returnCode[0]));
-        for (topicCount = 0; topicCount < topicNumbers; topicCount++)
+        // MQTT-3.9.3-1: one return code per topic filter, in the order of the
+        // SUBSCRIBE payload. At most MAX_NUM_TOPICS_SUBSCRIBE filters keep the
+        // remaining length in one byte.
+        while (topicNumbers < MAX_NUM_TOPICS_SUBSCRIBE && txSubscribePacket.subscribePayload[topicNumbers].topicLength > 0)
         {
-            if (rxSubackPacket.returnCode[topicCount] == SUBSCRIBE_FAILURE)
-            {
-                // Change state appropriately
-                ret = DISCONNECTED;
-                break;
-            }
-            else
+            topicNumbers++;
+        }
+
+        if (rxSubackPacket.remainingLength[0] != sizeof(rxSubackPacket.packetIdentifierMSB) + sizeof(rxSubackPacket.packetIdentifierLSB) + topicNumbers)
+        {
+            debug_printError(" MQTT: SUBACK has %d return codes for %d topic filters", rxSubackPacket.remainingLength[0] - 2, topicNumbers);
+            ret = DISCONNECTED;
+        }
+        else
+        {
+            // Every code is checked, so each refused filter is reported
+            for (topicCount = 0; topicCount < topicNumbers; topicCount++)
             {
-                //The Server might grant a lower maximum QoS than the subscriber requested.
-                if (rxSubackPacket.returnCode[topicCount] <= txSubscribePacket.subscribePayload[topicCount].requestedQoS)
-                {
-                    ret = CONNECTED;
-                }
-                else
+                MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &returnCode, sizeof(returnCode));
+                rxSubackPacket.returnCode[topicCount] = (subscribeAckReturnCode)returnCode;
+
+                // The Server might grant a lower maximum QoS than the subscriber requested.
+                if (returnCode == SUBSCRIBE_FAILURE || returnCode > txSubscribePacket.subscribePayload[topicCount].requestedQoS)
                 {
-                    // Change state appropriately
+                    debug_printError(" MQTT: SUBACK filter %d (%.*s) failed with 0x%02x",
+                                     topicCount,
+                                     ntohs(txSubscribePacket.subscribePayload[topicCount].topicLength),
+                                     txSubscribePacket.subscribePayload[topicCount].topic,
+                                     returnCode);
                     ret = DISCONNECTED;
-                    break;
                 }
             }
         }
     }
 
     mqttRxFlags.newRxSubackPacket = 0;
-    // Re-initialize the RX exchange buffer to be able to process the
-    // next incoming MQTT packet
-    MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff);
 
     if (ret == CONNECTED)
     {
@@ -1106,129 +1577,96 @@ static mqttCurrentState mqttProcessUnsuback(mqttContext* mqttConnectionPtr)
     }
 
     mqttRxFlags.newRxUnsubackPacket = 0;
-    // Re-initialize the RX exchange buffer to be able to process the
-    // next incoming MQTT packet
-    MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff);
     return ret;
 }
 
-bool matchTopicSubscribe(char* SubTopic, char* publishTopic)
-{
-    while (SubTopic != NULL && publishTopic != NULL)
-    {
-        int   subTopicLen, publishTopicLen;
-        char* endSubTopic     = strchr(SubTopic, '/');
-        char* endPublishTopic = strchr(publishTopic, '/');
-        if (endSubTopic == NULL && endPublishTopic == NULL)
-        {
-            return true;
-        }
-
-        if (endSubTopic == NULL)
-        {
-            subTopicLen = strlen(SubTopic);
-        }
-        else
-        {
-            subTopicLen = endSubTopic - SubTopic;
-        }
-
-        if (endPublishTopic == NULL)
-        {
-            publishTopicLen = strlen(publishTopic);
-        }
-        else
-        {
-            publishTopicLen = endPublishTopic - publishTopic;
-        }
-
-        if (memcmp(SubTopic, "+", 1) == 0 && subTopicLen == 1)
-        {
-            // wildcard
-        }
-        else if (memcmp(SubTopic, "#", 1) == 0 && subTopicLen == 1)
-        {
-            return true;   // end wild card
-        }
-        else if (memcmp(SubTopic, publishTopic, publishTopicLen) != 0 || publishTopicLen != subTopicLen)
-        {
-            break;
-        }
-
-        SubTopic     = endSubTopic + 1;
-        publishTopic = endPublishTopic + 1;
-    }
-
-    return false;
-}
-
 static mqttCurrentState mqttProcessPublish(mqttContext* mqttConnectionPtr)
 {
-    mqttCurrentState                 ret;
-    uint32_t                         decodedLength;
-    mqttPublishPacket                rxPublishPacket;
+    exchangeBuffer*                  rxbuff = &mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff;
     const publishReceptionHandler_t* publishRecvHandlerInfo;
+    uint8_t*                         packet;
+    uint8_t*                         topic;
+    uint8_t*                         payload;
+    uint32_t                         decodedLength;
+    uint32_t                         multiplier;
+    uint16_t                         topicLength;
+    uint16_t                         headerLength;
     uint8_t                          i;
 
-    uint8_t mqttTopic[TOPIC_SIZE];
-    uint8_t mqttPayload[PAYLOAD_SIZE];
+    // The packet is decoded in place, so the data must not wrap around the
+    // end of the receive buffer.
+    if (MQTT_ExchangeBufferReadSpan(rxbuff, &packet) < rxbuff->dataLength)
+    {
+        debug_printError(" MQTT: PUBLISH not contiguous in receive buffer");
+        return CONNECTED;
+    }
 
+    // Fixed header: packet type byte followed by up to 4 bytes of remaining length
     decodedLength = 0;
+    multiplier    = 1;
+    i             = 1;
+    do
+    {
+        if (i >= rxbuff->dataLength || i > 4)
+        {
+            debug_printError(" MQTT: Malformed PUBLISH remaining length");
+            return CONNECTED;
+        }
+        decodedLength += (packet[i] & 0x7F) * multiplier;
+        multiplier *= 128;
+    } while ((packet[i++] & 0x80) != 0);
+    headerLength = i;
 
-    memset(&rxPublishPacket, 0, sizeof(rxPublishPacket));
-    memset(mqttTopic, 0, sizeof(mqttTopic));
-    memset(mqttPayload, 0, sizeof(mqttPayload));
-
-    // Fixed header
-    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &rxPublishPacket.publishHeaderFlags.All, sizeof(rxPublishPacket.publishHeaderFlags.All));
-    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &rxPublishPacket.remainingLength[0], sizeof(rxPublishPacket.remainingLength[0]));
-    for (i = 1; (rxPublishPacket.remainingLength[i - 1] & 0x80) && (i < sizeof(rxPublishPacket.remainingLength)); i++)
+    if (decodedLength < sizeof(topicLength) || (uint32_t)headerLength + decodedLength > rxbuff->dataLength)
     {
-        MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &rxPublishPacket.remainingLength[i], 1);
+        debug_printError(" MQTT: Truncated PUBLISH (%lu of %u bytes)", (unsigned long)(headerLength + decodedLength), rxbuff->dataLength);
+        return CONNECTED;
     }
-    decodedLength = mqttDecodeLength(&rxPublishPacket.remainingLength[0]);
-
-    // Variable header
-    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, (uint8_t*)&rxPublishPacket.topicLength, sizeof(rxPublishPacket.topicLength));
-    decodedLength -= sizeof(rxPublishPacket.topicLength);
-
-    // Topic
-    rxPublishPacket.topic = (uint8_t*)mqttTopic;
-    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, rxPublishPacket.topic, ntohs(rxPublishPacket.topicLength));
-    decodedLength -= ntohs(rxPublishPacket.topicLength);
 
-    // Payload
-    rxPublishPacket.payload = (uint8_t*)mqttPayload;
-    MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, rxPublishPacket.payload, decodedLength);
+    // Variable header: big endian topic length, topic and the packet
+    // identifier for QoS 1/2
+    topicLength = ((uint16_t)packet[headerLength] << 8) | packet[headerLength + 1];
+    topic       = &packet[headerLength + sizeof(topicLength)];
+    decodedLength -= sizeof(topicLength);
 
-    mqttPayload[sizeof(mqttPayload) - 1] = 0;   // make sure buffer is null terminated
-    mqttTopic[sizeof(mqttTopic) - 1]     = 0;   // make sure buffer is null terminated
+    if (topicLength > decodedLength)
+    {
+        debug_printError(" MQTT: Malformed PUBLISH topic length %u", topicLength);
+        return CONNECTED;
+    }
+    decodedLength -= topicLength;
+    payload = topic + topicLength;
 
-    // Send payload information to the application
-    publishRecvHandlerInfo = MQTT_GetPublishReceptionHandlerTable();
-    for (i = 0; i < MAX_NUM_TOPICS_SUBSCRIBE; i++)
+    if (((packet[0] >> 1) & 0x03) != 0)
     {
-        if (publishRecvHandlerInfo)
+        if (decodedLength < 2)
         {
-            if (publishRecvHandlerInfo && matchTopicSubscribe((char*)publishRecvHandlerInfo->topic, (char*)rxPublishPacket.topic))
-            {
-                publishRecvHandlerInfo->mqttHandlePublishDataCallBack(rxPublishPacket.topic, rxPublishPacket.payload);
-                break;
-            }
+            debug_printError(" MQTT: Malformed PUBLISH packet identifier");
+            return CONNECTED;
         }
-        publishRecvHandlerInfo++;
+        payload += 2;
+        decodedLength -= 2;
     }
 
-    // Re-initialize the RX exchange buffer to be able to process the
-    // next incoming MQTT packet
-    MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff);
-    ret = CONNECTED;
-    return ret;
+    // Send topic and payload views to the application
+    publishRecvHandlerInfo = MQTT_GetPublishReceptionHandler(topic, topicLength);
+    if (publishRecvHandlerInfo != NULL)
+    {
+        publishRecvHandlerInfo->mqttHandlePublishDataCallBack(topic, topicLength, payload, (uint16_t)decodedLength);
+    }
+    else
+    {
+        debug_printWarn(" MQTT: No handler for PUBLISH topic '%.*s'", topicLength, topic);
+    }
+
+    return CONNECTED;
 }
 
 static void mqttProcessPuback(mqttContext* mqttConnectionPtr)
 {
-    mqttPubackPacket rxPubackPacket;
+    mqttPubackPacket   rxPubackPacket;
+    mqttPublishPacket* publishPacket;
+    uint8_t            slot;
 
     debug_printTrace(" MQTT: mqttProcessPuback()");
 
@@ -1238,19 +1676,23 @@ static void mqttProcessPuback(mqttContext* mqttConnectionPtr)
     MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &rxPubackPacket.packetIdentifierMSB, sizeof(rxPubackPacket.packetIdentifierMSB));
     MQTT_ExchangeBufferRead(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff, &rxPubackPacket.packetIdentifierLSB, sizeof(rxPubackPacket.packetIdentifierLSB));
 
-    if (txPublishPacketPending != NULL)
+    // PUBACKs may arrive in any order, so match on the packet identifier
+    for (slot = 0; slot < MQTT_MAX_INFLIGHT_PUBLISH; slot++)
     {
-        if (rxPubackPacket.packetIdentifierLSB == txPublishPacketPending->packetIdentifierLSB && rxPubackPacket.packetIdentifierMSB == txPublishPacketPending->packetIdentifierMSB)
+        publishPacket = txPublishPacketInflight[slot];
+
+        if (publishPacket != NULL && rxPubackPacket.packetIdentifierLSB == publishPacket->packetIdentifierLSB && rxPubackPacket.packetIdentifierMSB == publishPacket->packetIdentifierMSB)
         {
-            if (mqttPubackCallback)
-            {
-                mqttPubackCallback(&rxPubackPacket);
-            }
-            mqttRxFlags.newRxPubackPacket = 0;
-            free((void*)txPublishPacketPending);
-            txPublishPacketPending = NULL;
+            mqttNotifyPuback(publishPacket, &rxPubackPacket);
+            mqttReleaseInflightPublish(slot);
+            break;
         }
     }
+
+    if (slot == MQTT_MAX_INFLIGHT_PUBLISH)
+    {
+        debug_printWarn(" MQTT: PUBACK for unknown Packet ID %d", (rxPubackPacket.packetIdentifierMSB << 8) | rxPubackPacket.packetIdentifierLSB);
+    }
 }
 
 mqttCurrentState MQTT_TransmissionHandler(mqttContext* mqttConnectionPtr)
@@ -1258,6 +1700,7 @@ mqttCurrentState MQTT_TransmissionHandler(mqttContext* mqttConnectionPtr)
     uint16_t keepAliveTimeout = 0;
     bool     packetSent       = false;
     uint8_t  getSetFlag       = 0;
+    uint8_t  txFlags          = 0;
 
     switch (mqttState)
     {
@@ -1278,10 +1721,27 @@ mqttCurrentState MQTT_TransmissionHandler(mqttContext* mqttConnectionPtr)
             break;
 
         case CONNECTED:
+            if (txPublishInflightCount > 0)
+            {
+                mqttCheckPubackTimeout(mqttConnectionPtr);
+            }
+
+            // A full in-flight window must not hold back the other packet types
+            txFlags = mqttTxFlags.All;
+            if (txPublishInflightCount >= MQTT_MAX_INFLIGHT_PUBLISH)
+            {
+                if (txFlags & SENDPUBLISH)
+                {
+                    // Messages were published with QoS.  Wait for PUBACK.
+                    debug_printTrace(" MQTT: Waiting for PUBACK");
+                }
+                txFlags &= ~SENDPUBLISH;
+            }
+
             // ToDo Find out ways to improve this logic
-            if (mqttTxFlags.All > 0)
+            if (txFlags > 0)
             {
-                while ((mqttTxFlags.All & (MQTT_TX_PACKET_DECISION_CONSTANT << getSetFlag)) == 0)
+                while ((txFlags & (MQTT_TX_PACKET_DECISION_CONSTANT << getSetFlag)) == 0)
                 {
                     getSetFlag++;
                 }
@@ -1298,22 +1758,18 @@ mqttCurrentState MQTT_TransmissionHandler(mqttContext* mqttConnectionPtr)
                         }
                         break;
                     case SENDPUBLISH:
+                        stopDestroyTimer(checkPingreqTimeoutStateHandle);
 
-                        if (txPublishPacketPending != NULL)
+                        // Pipeline queued packets until the list is empty or the in-flight window is full
+                        do
                         {
-                            // A messsage was published with QoS.  Wait for PUBACK.
-                            debug_printGood(" MQTT: Waiting for PUBACK");
-                        }
-                        else
-                        {
-                            stopDestroyTimer(checkPingreqTimeoutStateHandle);
                             packetSent = mqttSendPublish(mqttConnectionPtr);
+                        } while (packetSent == true && mqttTxFlags.newTxPublishPacket == 1 && txPublishInflightCount < MQTT_MAX_INFLIGHT_PUBLISH);
 
-                            keepAliveTimeout = ntohs(txConnectPacket.connectVariableHeader.keepAliveTimer);
-                            if (txConnectPacket.connectVariableHeader.keepAliveTimer > 0)
-                            {
-                                checkPingreqTimeoutStateHandle = SYS_TIME_CallbackRegisterMS(checkPingreqTimeoutStatecb, 0, ((keepAliveTimeout - KEEP_ALIVE_CALCULATION_CONSTANT) * SECONDS), SYS_TIME_SINGLE);
-                            }
+                        keepAliveTimeout = ntohs(txConnectPacket.connectVariableHeader.keepAliveTimer);
+                        if (txConnectPacket.connectVariableHeader.keepAliveTimer > 0)
+                        {
+                            checkPingreqTimeoutStateHandle = SYS_TIME_CallbackRegisterMS(checkPingreqTimeoutStatecb, 0, ((keepAliveTimeout - KEEP_ALIVE_CALCULATION_CONSTANT) * SECONDS), SYS_TIME_SINGLE);
                         }
                         break;
                     case SENDSUBSCRIBE:
@@ -1346,7 +1802,56 @@ mqttCurrentState MQTT_TransmissionHandler(mqttContext* mqttConnectionPtr)
     return mqttState;
 }
 
-mqttCurrentState MQTT_ReceptionHandler(mqttContext* mqttConnectionPtr)
+/** \brief Decode the total length of the MQTT control packet at the head of
+ * the RX buffer.
+ *
+ * The remaining length is decoded from the bytes received so far, so a packet
+ * split across several socket reads is simply reported as incomplete.
+ *
+ * @param rxbuff RX exchange buffer holding the received stream
+ *
+ * @return Fixed header plus remaining length in bytes, 0 if more data is
+ * needed to decode the length, or -1 if the remaining length is malformed
+ */
+int32_t MQTT_GetRxPacketLength(exchangeBuffer* rxbuff)
+{
+    uint32_t remainingLength = 0;
+    uint32_t multiplier      = 1;
+    uint8_t  i;
+
+    for (i = 1; i <= 4; i++)
+    {
+        if (i >= rxbuff->dataLength)
+        {
+            return 0;
+        }
+        remainingLength += (rxbuff->currentLocation[i] & 0x7F) * multiplier;
+        if ((rxbuff->currentLocation[i] & 0x80) == 0)
+        {
+            return (int32_t)(i + 1 + remainingLength);
+        }
+        multiplier *= 128;
+    }
+    return -1;
+}
+
+/** \brief Move a partially received packet to the start of the RX buffer so
+ * the next socket read is appended contiguously behind it.
+ */
+static void mqttCompactRxBuffer(exchangeBuffer* rxbuff)
+{
+    if (rxbuff->dataLength == 0)
+    {
+        MQTT_ExchangeBufferInit(rxbuff);
+    }
+    else if (rxbuff->currentLocation != rxbuff->start)
+    {
+        memmove(rxbuff->start, rxbuff->currentLocation, rxbuff->dataLength);
+        rxbuff->currentLocation = rxbuff->start;
+    }
+}
+
+static void mqttProcessReceivedPacket(mqttContext* mqttConnectionPtr)
 {
     uint16_t        keepAliveTimeout;
     mqttHeaderFlags receivedPacketHeader;
@@ -1354,19 +1859,6 @@ mqttCurrentState MQTT_ReceptionHandler(mqttContext* mqttConnectionPtr)
     keepAliveTimeout         = 0;
     receivedPacketHeader.All = 0;
 
-    if (pingrespTimeoutOccured == true || subackTimeoutOccured == true || unsubackTimeoutOccured == true)
-    {
-        // This implies that expected response has not been received from
-        // the server in a reasonable period of time (currently set to 30s).
-        // This is treated as a protocol violation. The client therefore
-        // will close the Network Connection (MQTT RFC, section 4.8).
-        mqttState = DISCONNECTED;
-        MQTT_Close(mqttConnectionPtr);
-    }
-    // If nothing to process
-    if (mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff.dataLength == 0)
-        return mqttState;
-
     switch (mqttState)
     {
         case WAITFORCONNACK:
@@ -1398,6 +1890,11 @@ mqttCurrentState MQTT_ReceptionHandler(mqttContext* mqttConnectionPtr)
                         connectTime = mktime(&sys_time);
                         //connectTime = time(NULL);
                         debug_printGood(" MQTT: CONNACK Accepted at %s", ctime(&connectTime));
+
+                        if (txPublishInflightCount > 0)
+                        {
+                            mqttResendInflightPublish();
+                        }
                     }
                     else
                     {
@@ -1472,6 +1969,68 @@ mqttCurrentState MQTT_ReceptionHandler(mqttContext* mqttConnectionPtr)
             debug_printWarn(" MQTT: Unexpect mqttState=%d", mqttState);
             break;
     }
+}
+
+mqttCurrentState MQTT_ReceptionHandler(mqttContext* mqttConnectionPtr)
+{
+    exchangeBuffer* rxbuff = &mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff;
+    int32_t         packetLength;
+    uint8_t*        nextPacket;
+    uint16_t        remainingData;
+
+    if (pingrespTimeoutOccured == true || subackTimeoutOccured == true || unsubackTimeoutOccured == true)
+    {
+        // This implies that expected response has not been received from
+        // the server in a reasonable period of time (currently set to 30s).
+        // This is treated as a protocol violation. The client therefore
+        // will close the Network Connection (MQTT RFC, section 4.8).
+        mqttState = DISCONNECTED;
+        MQTT_Close(mqttConnectionPtr);
+    }
+
+    // Dispatch every complete packet in the RX buffer. A trailing partial
+    // packet is kept until the rest of it has been received.
+    while (rxbuff->dataLength > 0)
+    {
+        packetLength = MQTT_GetRxPacketLength(rxbuff);
+        if (packetLength == 0)
+        {
+            break;
+        }
+        if (packetLength < 0 || packetLength > rxbuff->bufferLength)
+        {
+            // The stream cannot be re-synchronized, drop the connection. A
+            // packet larger than the buffer is normally dropped as it arrives
+            // by MQTT_GetReceivedData().
+            debug_printError(" MQTT: Invalid RX packet length %ld", (long)packetLength);
+            MQTT_ExchangeBufferInit(rxbuff);
+            mqttState = DISCONNECTED;
+            MQTT_Close(mqttConnectionPtr);
+            break;
+        }
+        if (packetLength > rxbuff->dataLength)
+        {
+            break;
+        }
+
+        // Present exactly one packet to the packet processors
+        nextPacket         = rxbuff->currentLocation + packetLength;
+        remainingData      = rxbuff->dataLength - (uint16_t)packetLength;
+        rxbuff->dataLength = (uint16_t)packetLength;
+
+        mqttProcessReceivedPacket(mqttConnectionPtr);
+
+        rxbuff->currentLocation = nextPacket;
+        rxbuff->dataLength      = remainingData;
+
+        if (mqttState == DISCONNECTED)
+        {
+            MQTT_ExchangeBufferInit(rxbuff);
+            break;
+        }
+    }
+
+    mqttCompactRxBuffer(rxbuff);
 
     return mqttState;
 }
@@ -1486,7 +2045,7 @@ static bool mqttSendSubscribe(mqttContext* mqttConnectionPtr)
     {
         debug_printError(" MQTT: txBuffer Null");
     }
-    else if (!MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff))
+    else if (mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff.start == NULL)
     {
         debug_printError(" MQTT: rxBuffer Null");
     }
@@ -1530,7 +2089,7 @@ static bool mqttSendUnsubscribe(mqttContext* mqttConnectionPtr)
     {
         debug_printError(" MQTT: txBuffer Null");
     }
-    else if (!MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff))
+    else if (mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff.start == NULL)
     {
         debug_printError(" MQTT: rxBuffer Null");
     }
@@ -1575,7 +2134,7 @@ static bool mqttSendPingreq(mqttContext* mqttConnectionPtr)
     {
         debug_printError(" MQTT: txBuffer Null");
     }
-    else if (!MQTT_ExchangeBufferInit(&mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff))
+    else if (mqttConnectionPtr->mqttDataExchangeBuffers.rxbuff.start == NULL)
     {
         debug_printError(" MQTT: rxBuffer Null");
     }
@@ -48,6 +48,7 @@
 #define WAITFORPINGRESP_TIMEOUT (30 * SECONDS)
 #define WAITFORSUBACK_TIMEOUT   (30 * SECONDS)
 #define WAITFORUNSUBACK_TIMEOUT (30 * SECONDS)
+#define WAITFORPUBACK_TIMEOUT   (10 * SECONDS)
 
 #pragma pack(push, 1)
 
@@ -205,6 +206,25 @@ typedef struct
 
 } mqttConnackPacket_t;
 
+/** \brief MQTT PUBACK packet
+ *
+ * This is used by the application to process a PUBACK packet. 
+ */
+typedef struct
+{
+    mqttHeaderFlags pubackFixedHeader;
+    uint8_t         remainingLength;
+    uint8_t         packetIdentifierLSB;
+    uint8_t         packetIdentifierMSB;
+
+    // Not part of the packet. Set when the MQTT core gave up on the PUBLISH
+    // without a PUBACK: MQTT_MAX_PUBLISH_RETRANSMIT re-sends timed out, or
+    // the session was not kept across a reconnect.
+    uint8_t notDelivered;
+} mqttPubackPacket;
+
+typedef void (*MQTTPubAckCallbackPtr)(mqttPubackPacket* data);
+
 /** \brief MQTT PUBLISH packet
  *
  * This is used by the application to form and process a PUBLISH packet. 
@@ -229,20 +249,21 @@ typedef struct _mqttPublishPacket
 
     uint16_t totalLength;
 
-    struct _mqttPublishPacket *next;
-} mqttPublishPacket;
+    // Optional per-message PUBACK notification for QoS level 1. Called in
+    // addition to the callback registered with MQTT_Set_Puback_callback().
+    MQTTPubAckCallbackPtr pubackCallback;
 
-/** \brief MQTT PUBACK packet
- *
- * This is used by the application to process a PUBACK packet. 
- */
-typedef struct
-{
-    mqttHeaderFlags pubackFixedHeader;
-    uint8_t         remainingLength;
-    uint8_t         packetIdentifierLSB;
-    uint8_t         packetIdentifierMSB;
-} mqttPubackPacket;
+    // By default the MQTT core copies topic and payload when the packet is
+    // queued, so the caller may reuse its buffers immediately. Set zeroCopy
+    // only if both buffers stay untouched until the packet has been sent
+    // (QoS 0) or acknowledged (QoS 1).
+    uint8_t  zeroCopy;
+    uint8_t* ownedData;   // Arena copy of topic and payload. Owned by the MQTT core.
+
+    // In-flight bookkeeping for QoS level 1. Owned by the MQTT core.
+    uint32_t sentTimestamp;
+    uint8_t  retransmitCount;
+} mqttPublishPacket;
 
 
 /** \brief MQTT PING packet
@@ -376,6 +397,22 @@ typedef struct
 
 
 #pragma pack(pop)
+
+/** \brief MQTT PUBLISH queue statistics
+ *
+ * This is used by the application to monitor the sizing of the PUBLISH
+ * descriptor pool (MQTT_PUBLISH_QUEUE_SIZE).
+ */
+typedef struct
+{
+    uint8_t  capacity;        // Number of descriptors in the pool
+    uint8_t  inUse;           // Descriptors queued for transmission or awaiting PUBACK
+    uint8_t  queued;          // Descriptors waiting for their first transmission
+    uint8_t  highWaterMark;   // Largest inUse value seen since power up
+    uint32_t dropCount;       // PUBLISH requests rejected because the pool or the arena was exhausted
+    uint16_t arenaInUse;      // Bytes of the topic/payload arena currently allocated
+    uint16_t arenaHighWater;  // Largest arenaInUse value seen since power up
+} mqttPublishQueueStats;
 /***********************MQTT Client definitions*(END)**************************/
 
 int32_t MQTT_getConnectionAge(void);
@@ -384,13 +421,15 @@ bool    MQTT_CreatePublishPacket(mqttPublishPacket* newPublishPacket);
 bool    MQTT_CreateSubscribePacket(mqttSubscribePacket* newSubscribePacket);
 bool    MQTT_CreateUnsubscribePacket(mqttUnsubscribePacket* newUnsubscribePacket);
 void    MQTT_initialiseState(void);
+void    MQTT_DiscardSession(void);
 
 mqttCurrentState MQTT_Disconnect(mqttContext* mqttContextPtr);
 mqttCurrentState MQTT_TransmissionHandler(mqttContext* mqttContextPtr);
 mqttCurrentState MQTT_ReceptionHandler(mqttContext* mqttContextPtr);
 mqttCurrentState MQTT_GetConnectionState(void);
-
-typedef void (*MQTTPubAckCallbackPtr)(mqttPubackPacket* data);
+uint8_t          MQTT_GetInflightPublishCount(void);
+int32_t          MQTT_GetRxPacketLength(exchangeBuffer* rxbuff);
+void             MQTT_GetPublishQueueStats(mqttPublishQueueStats* stats);
 
 void MQTT_Set_Puback_callback(MQTTPubAckCallbackPtr callback);
 void MQTT_sched(void);
@@ -25,8 +25,14 @@
     SOFTWARE.
 */
 
+#include <string.h>
 #include "mqtt_exchange_buffer.h"
 
+/* The buffer is a ring: the valid data starts at currentLocation and may wrap
+ * around the end of the buffer. Every copy is done as at most two memcpy()
+ * segments, one up to the end of the buffer and one from its start.
+ */
+
 bool MQTT_ExchangeBufferInit(exchangeBuffer* buffer)
 {
     buffer->currentLocation = buffer->start;
@@ -37,69 +43,117 @@ bool MQTT_ExchangeBufferInit(exchangeBuffer* buffer)
 
 uint16_t MQTT_ExchangeBufferWrite(exchangeBuffer* buffer, uint8_t* data, uint16_t length)
 {
-    uint8_t* bend;
-    uint8_t* dend;
-    uint16_t i    = 0;
+    uint8_t* dest;
+    uint16_t contiguous;
 
     if (buffer->start == NULL)
     {
         return 0;
     }
 
-    bend = buffer->start + buffer->bufferLength - 1;
-    dend = (buffer->currentLocation - buffer->start + buffer->dataLength) % buffer->bufferLength + buffer->start;
+    if (length > buffer->bufferLength - buffer->dataLength)
+    {
+        length = buffer->bufferLength - buffer->dataLength;
+    }
 
-    for (i = length; i > 0; i--)
+    contiguous = MQTT_ExchangeBufferWriteSpan(buffer, &dest);
+    if (contiguous >= length)
+    {
+        memcpy(dest, data, length);
+    }
+    else
     {
-        if (dend > bend)
-        {
-            dend = buffer->start;
-        }
-        if (buffer->dataLength != 0 && dend == buffer->currentLocation)
-        {
-            break;
-        }
-        *dend = *data;
-        dend++;
-        data++;
-        buffer->dataLength++;
+        memcpy(dest, data, contiguous);
+        memcpy(buffer->start, data + contiguous, length - contiguous);
     }
+    buffer->dataLength += length;
 
     return length;
 }
 
 uint16_t MQTT_ExchangeBufferPeek(exchangeBuffer* buffer, uint8_t* data, uint16_t length)
 {
-    uint8_t* ptr  = buffer->currentLocation;
-    uint8_t* bend = buffer->start + buffer->bufferLength - 1;
-    uint16_t i    = 0;
+    uint8_t* src;
+    uint16_t contiguous;
 
-    for (i = 0; i < length && i < buffer->dataLength; i++)
+    if (length > buffer->dataLength)
+    {
+        length = buffer->dataLength;
+    }
+
+    contiguous = MQTT_ExchangeBufferReadSpan(buffer, &src);
+    if (contiguous >= length)
+    {
+        memcpy(data, src, length);
+    }
+    else
     {
-        data[i] = ptr[i];
-        if (ptr > bend)
-        {
-            ptr = buffer->start;
-        }
+        memcpy(data, src, contiguous);
+        memcpy(data + contiguous, buffer->start, length - contiguous);
     }
 
-    return i;
+    return length;
 }
 
 uint16_t MQTT_ExchangeBufferRead(exchangeBuffer* buffer, uint8_t* data, uint16_t length)
 {
-    uint8_t* bend = buffer->start + buffer->bufferLength - 1;
-    uint16_t i    = 0;
+    length = MQTT_ExchangeBufferPeek(buffer, data, length);
+    MQTT_ExchangeBufferConsume(buffer, length);
 
-    for (i = 0; i < length && buffer->dataLength > 0; i++)
+    return length;
+}
+
+uint16_t MQTT_ExchangeBufferReadSpan(exchangeBuffer* buffer, uint8_t** data)
+{
+    uint16_t offset = buffer->currentLocation - buffer->start;
+
+    *data = buffer->currentLocation;
+    if (buffer->dataLength > buffer->bufferLength - offset)
+    {
+        return buffer->bufferLength - offset;
+    }
+    return buffer->dataLength;
+}
+
+void MQTT_ExchangeBufferConsume(exchangeBuffer* buffer, uint16_t length)
+{
+    uint16_t offset;
+
+    if (length > buffer->dataLength)
+    {
+        length = buffer->dataLength;
+    }
+
+    offset = (buffer->currentLocation - buffer->start) + length;
+    if (offset >= buffer->bufferLength)
+    {
+        offset -= buffer->bufferLength;
+    }
+    buffer->currentLocation = buffer->start + offset;
+    buffer->dataLength -= length;
+}
+
+uint16_t MQTT_ExchangeBufferWriteSpan(exchangeBuffer* buffer, uint8_t** data)
+{
+    uint16_t offset = (buffer->currentLocation - buffer->start) + buffer->dataLength;
+
+    if (offset >= buffer->bufferLength)
+    {
+        // Free space is between the wrapped data and currentLocation
+        offset -= buffer->bufferLength;
+        *data = buffer->start + offset;
+        return buffer->bufferLength - buffer->dataLength;
+    }
+
+    *data = buffer->start + offset;
+    return buffer->bufferLength - offset;
+}
+
+void MQTT_ExchangeBufferCommit(exchangeBuffer* buffer, uint16_t length)
+{
+    if (length > buffer->bufferLength - buffer->dataLength)
     {
-        data[i] = *buffer->currentLocation;
-        buffer->currentLocation++;
-        buffer->dataLength--;
-        if (buffer->currentLocation > bend)
-        {
-            buffer->currentLocation = buffer->start;
-        }
+        length = buffer->bufferLength - buffer->dataLength;
     }
-    return i;
+    buffer->dataLength += length;
 }
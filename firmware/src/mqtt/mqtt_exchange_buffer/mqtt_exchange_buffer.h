@@ -50,3 +50,10 @@ bool     MQTT_ExchangeBufferInit(exchangeBuffer* buffer);
 uint16_t MQTT_ExchangeBufferPeek(exchangeBuffer* buffer, uint8_t* data, uint16_t length);
 uint16_t MQTT_ExchangeBufferWrite(exchangeBuffer* buffer, uint8_t* data, uint16_t length);
 uint16_t MQTT_ExchangeBufferRead(exchangeBuffer* buffer, uint8_t* data, uint16_t length);
+
+// Zero-copy access: the span functions return the number of contiguous bytes
+// available at *data. Consume/Commit then advance the read/write position.
+uint16_t MQTT_ExchangeBufferReadSpan(exchangeBuffer* buffer, uint8_t** data);
+void     MQTT_ExchangeBufferConsume(exchangeBuffer* buffer, uint16_t length);
+uint16_t MQTT_ExchangeBufferWriteSpan(exchangeBuffer* buffer, uint8_t** data);
+void     MQTT_ExchangeBufferCommit(exchangeBuffer* buffer, uint16_t length);
@@ -35,8 +35,26 @@
 #include <stdint.h>
 #include <string.h>
 #include "mqtt_packetTransfer_interface.h"
+#include "../iot_config/mqtt_config.h"
 #include "debug_print.h"
 
+#define MQTT_TOPIC_TRIE_NONE 0xFF
+
+/** \brief One topic level of the subscription filter trie.
+ *
+ * Nodes are kept in a static pool and linked as first child / next sibling.
+ * Literal levels are kept ahead of '+' and '#' siblings so exact matches are
+ * tried first. The level text points into the registered topic filter.
+ */
+typedef struct
+{
+    const uint8_t* level;
+    uint16_t       levelLength;
+    uint8_t        firstChild;
+    uint8_t        nextSibling;
+    uint8_t        handlerIndex;   // Handler of the filter that ends at this level
+} mqttTopicTrieNode;
+
 /**********************MQTT Interface layer variables**************************/
 
 /** \brief Publish handler table information.
@@ -46,13 +64,201 @@
  * the application for further processing.
  */
 publishReceptionHandler_t* publishRecvInfo;
+
+/** \brief Subscription filters of publishRecvInfo compiled into a level trie.
+ *
+ * Node 0 is the root. The trie is rebuilt whenever the handler table is set.
+ */
+static mqttTopicTrieNode topicTrie[MQTT_TOPIC_TRIE_MAX_NODES];
+static uint8_t           topicTrieNodeCount;
 /*******************MQTT Interface layer variables*(END)***********************/
 
 /**********************Function implementations********************************/
 
+static bool mqttTopicTrieIsWildcard(const mqttTopicTrieNode* node)
+{
+    return node->levelLength == 1 && (node->level[0] == '+' || node->level[0] == '#');
+}
+
+// MQTT-4.7.1-2: "sport/#" also matches "sport", the '#' child of the last level
+static uint8_t mqttTopicTrieParentMatch(uint8_t node)
+{
+    uint8_t child;
+
+    for (child = topicTrie[node].firstChild; child != MQTT_TOPIC_TRIE_NONE; child = topicTrie[child].nextSibling)
+    {
+        if (topicTrie[child].levelLength == 1 && topicTrie[child].level[0] == '#')
+        {
+            return topicTrie[child].handlerIndex;
+        }
+    }
+
+    return MQTT_TOPIC_TRIE_NONE;
+}
+
+/** \brief Add one topic filter to the trie.
+ *
+ * @param filter NULL terminated topic filter, may contain '+' and '#'
+ * @param handlerIndex Index of the filter in the handler table
+ *
+ * @return false if the node pool is exhausted
+ */
+static bool mqttTopicTrieInsert(const uint8_t* filter, uint8_t handlerIndex)
+{
+    uint8_t node = 0;
+
+    while (true)
+    {
+        const uint8_t* levelEnd    = (const uint8_t*)strchr((const char*)filter, '/');
+        uint16_t       levelLength = (levelEnd == NULL) ? strlen((const char*)filter) : (uint16_t)(levelEnd - filter);
+        uint8_t        child;
+        uint8_t*       link;
+
+        for (child = topicTrie[node].firstChild; child != MQTT_TOPIC_TRIE_NONE; child = topicTrie[child].nextSibling)
+        {
+            if (topicTrie[child].levelLength == levelLength && memcmp(topicTrie[child].level, filter, levelLength) == 0)
+            {
+                break;
+            }
+        }
+
+        if (child == MQTT_TOPIC_TRIE_NONE)
+        {
+            if (topicTrieNodeCount >= MQTT_TOPIC_TRIE_MAX_NODES)
+            {
+                return false;
+            }
+
+            child                         = topicTrieNodeCount++;
+            topicTrie[child].level        = filter;
+            topicTrie[child].levelLength  = levelLength;
+            topicTrie[child].firstChild   = MQTT_TOPIC_TRIE_NONE;
+            topicTrie[child].handlerIndex = MQTT_TOPIC_TRIE_NONE;
+
+            // Literal levels go to the front of the sibling list, wildcards to the back
+            link = &topicTrie[node].firstChild;
+            if (mqttTopicTrieIsWildcard(&topicTrie[child]))
+            {
+                while (*link != MQTT_TOPIC_TRIE_NONE)
+                {
+                    link = &topicTrie[*link].nextSibling;
+                }
+            }
+            topicTrie[child].nextSibling = *link;
+            *link                        = child;
+        }
+
+        node = child;
+
+        if (levelEnd == NULL)
+        {
+            break;
+        }
+        filter = levelEnd + 1;
+    }
+
+    // The first registered handler wins for duplicate filters
+    if (topicTrie[node].handlerIndex == MQTT_TOPIC_TRIE_NONE)
+    {
+        topicTrie[node].handlerIndex = handlerIndex;
+    }
+    return true;
+}
+
+/** \brief Find the handler for the topic levels below node.
+ *
+ * Each topic level is compared once per candidate child. Backtracking only
+ * happens where a literal and a '+' sibling both match the same level.
+ *
+ * @return index in the handler table or MQTT_TOPIC_TRIE_NONE
+ */
+static uint8_t mqttTopicTrieMatch(uint8_t node, const uint8_t* topic, const uint8_t* topicEnd)
+{
+    const uint8_t* levelEnd    = memchr(topic, '/', topicEnd - topic);
+    uint16_t       levelLength = (levelEnd == NULL) ? (uint16_t)(topicEnd - topic) : (uint16_t)(levelEnd - topic);
+    uint8_t        child;
+    uint8_t        handlerIndex;
+
+    for (child = topicTrie[node].firstChild; child != MQTT_TOPIC_TRIE_NONE; child = topicTrie[child].nextSibling)
+    {
+        const mqttTopicTrieNode* candidate = &topicTrie[child];
+
+        if (mqttTopicTrieIsWildcard(candidate))
+        {
+            // MQTT-4.7.2-1: Topics starting with '$' are not matched by a leading wildcard
+            if (node == 0 && topic[0] == '$')
+            {
+                continue;
+            }
+
+            if (candidate->level[0] == '#')
+            {
+                return candidate->handlerIndex;
+            }
+        }
+        else if (candidate->levelLength != levelLength || memcmp(candidate->level, topic, levelLength) != 0)
+        {
+            continue;
+        }
+
+        if (levelEnd == NULL)
+        {
+            handlerIndex = candidate->handlerIndex;
+            if (handlerIndex == MQTT_TOPIC_TRIE_NONE)
+            {
+                handlerIndex = mqttTopicTrieParentMatch(child);
+            }
+        }
+        else
+        {
+            handlerIndex = mqttTopicTrieMatch(child, levelEnd + 1, topicEnd);
+        }
+
+        if (handlerIndex != MQTT_TOPIC_TRIE_NONE)
+        {
+            return handlerIndex;
+        }
+    }
+
+    return MQTT_TOPIC_TRIE_NONE;
+}
+
 void MQTT_SetPublishReceptionHandlerTable(publishReceptionHandler_t* appPublishReceptionInfo)
 {
+    uint8_t i;
+
     publishRecvInfo = appPublishReceptionInfo;
+
+    topicTrie[0].firstChild   = MQTT_TOPIC_TRIE_NONE;
+    topicTrie[0].handlerIndex = MQTT_TOPIC_TRIE_NONE;
+    topicTrieNodeCount        = 1;
+
+    for (i = 0; i < MAX_NUM_TOPICS_SUBSCRIBE && publishRecvInfo; i++)
+    {
+        if (publishRecvInfo[i].topic == NULL || publishRecvInfo[i].mqttHandlePublishDataCallBack == NULL)
+        {
+            continue;
+        }
+
+        if (!mqttTopicTrieInsert(publishRecvInfo[i].topic, i))
+        {
+            debug_printError(" MQTT: Topic filter trie full, '%s' is not dispatched", publishRecvInfo[i].topic);
+        }
+    }
+}
+
+publishReceptionHandler_t* MQTT_GetPublishReceptionHandler(uint8_t* topic, uint16_t topicLength)
+{
+    uint8_t handlerIndex;
+
+    if (publishRecvInfo == NULL || topic == NULL)
+    {
+        return NULL;
+    }
+
+    handlerIndex = mqttTopicTrieMatch(0, topic, topic + topicLength);
+
+    return (handlerIndex == MQTT_TOPIC_TRIE_NONE) ? NULL : &publishRecvInfo[handlerIndex];
 }
 
 publishReceptionHandler_t* MQTT_GetPublishReceptionHandlerTable()
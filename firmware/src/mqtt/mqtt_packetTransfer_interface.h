@@ -29,14 +29,18 @@
 #define MQTT_PACKET_TRANSFER_INTERFACE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 
 /*********************MQTT Interface layer definitions*************************/
 /** \brief Function pointer for interaction between the MQTT core and user 
  * application to transfer the information received as part of the published  
  * packet to the application.
+ *
+ * The topic and payload point directly into the MQTT receive buffer. They are
+ * not NULL terminated and are only valid for the duration of the call.
  **/
-typedef void (*imqttHandlePublishDataFuncPtr)(uint8_t* topic, uint8_t* payload);
+typedef void (*imqttHandlePublishDataFuncPtr)(uint8_t* topic, uint16_t topicLength, uint8_t* payload, uint16_t payloadLength);
 
 // The call back table prototype for sending the payload received as part of
 // PUBLISH packet to the correct publish reception handler function defined in
@@ -74,4 +78,17 @@ void MQTT_SetPublishReceptionHandlerTable(publishReceptionHandler_t* appPublishR
  */
 publishReceptionHandler_t* MQTT_GetPublishReceptionHandlerTable();
 
+/** \brief Find the publish reception handler for a received topic.
+ *
+ * The topic filters of the handler table are compiled into a level trie when
+ * the table is set, so the lookup walks the topic once instead of matching
+ * every filter in turn. Literal levels take precedence over '+' and '#'.
+ *
+ * @param topic Topic name of the received PUBLISH packet, not NULL terminated
+ * @param topicLength Length of the topic name in bytes
+ *
+ * @return matching handler table entry, or NULL if no filter matches
+ */
+publishReceptionHandler_t* MQTT_GetPublishReceptionHandler(uint8_t* topic, uint16_t topicLength);
+
 #endif /* MQTT_PACKET_TRANSFER_INTERFACE_H */
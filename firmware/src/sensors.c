@@ -0,0 +1,266 @@
+/*
+    \file   sensors.c
+
+    \brief  Interrupt driven light and temperature sampling
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include "definitions.h"
+#include "sensors.h"
+#include "led.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
+
+#define MCP9808_I2C_ADDRESS 0x18
+#define MCP9808_REG_TA      0x05   // Ambient temperature register
+
+// INTVCC1 reference, full scale of the 12 bit result is VDDANA / 2
+#define LIGHT_FULL_SCALE_MV 1650
+
+typedef struct
+{
+    sensor_sample_t   ring[CFG_SENSOR_RING_SIZE];
+    volatile uint32_t head;   // Samples written so far, the next one goes to ring[head % CFG_SENSOR_RING_SIZE]
+    volatile uint32_t errors;
+    uint32_t          busy;
+} sensor_channel_t;
+
+static sensor_channel_t sensorChannels[SENSOR_COUNT];
+
+// The crypto HAL polls the same I2C bus without a callback, so only completions of
+// a transfer started here are handled
+static volatile bool sensorTempPending = false;
+static volatile bool sensorTempFailed  = false;
+static bool          sensorTempStarted = false;
+static uint32_t      sensorTempLastStart;
+static uint8_t       sensorTempRegister = MCP9808_REG_TA;
+static uint8_t       sensorTempRx[2];
+
+// Called from interrupt context
+static void sensorPush(sensor_id_t id, int32_t value)
+{
+    sensor_channel_t* channel = &sensorChannels[id];
+    sensor_sample_t*  sample  = &channel->ring[channel->head % CFG_SENSOR_RING_SIZE];
+
+    sample->timestamp = SYS_TIME_CounterGet();
+    sample->value     = value;
+    channel->head++;
+}
+
+static void sensorAdcCallback(ADC_STATUS status, uintptr_t context)
+{
+    if ((status & ADC_STATUS_RESRDY) != 0)
+    {
+        sensorPush(SENSOR_LIGHT, (int32_t)ADC_ConversionResultGet() * LIGHT_FULL_SCALE_MV / 4095);
+    }
+}
+
+static void sensorI2CCallback(uintptr_t context)
+{
+    int32_t raw;
+
+    if (!sensorTempPending)
+    {
+        return;
+    }
+    sensorTempPending = false;
+
+    if (SERCOM3_I2C_ErrorGet() != SERCOM_I2C_ERROR_NONE)
+    {
+        sensorChannels[SENSOR_TEMPERATURE].errors++;
+        sensorTempFailed = true;
+        return;
+    }
+
+    // 13 bit two's complement in 1/16 degree C, the top 3 bits are alert flags
+    raw = ((sensorTempRx[0] & 0x1F) << 8) | sensorTempRx[1];
+    if ((raw & 0x1000) != 0)
+    {
+        raw -= 0x2000;
+    }
+    sensorPush(SENSOR_TEMPERATURE, raw);
+}
+
+/** \brief Start sampling.
+ *
+ * TC4 counts the 1024 Hz GCLK1 and each overflow starts a light sensor
+ * conversion through EVSYS channel 0. The ADC averages 4 conversions in
+ * hardware and raises one result ready interrupt.
+ */
+void SENSOR_Initialize(void)
+{
+    memset(sensorChannels, 0, sizeof(sensorChannels));
+
+    ADC_CallbackRegister(sensorAdcCallback, 0);
+    SERCOM3_I2C_CallbackRegister(sensorI2CCallback, 0);
+    ADC_Enable();
+
+    TC4_Timer16bitPeriodSet((uint16_t)(CFG_SENSOR_LIGHT_PERIOD_MS * TC4_TimerFrequencyGet() / 1000 - 1));
+    TC4_TimerStart();
+}
+
+/** \brief Start the next temperature read once it is due.
+ *
+ * Runs from the application task, the same context the crypto HAL uses the
+ * I2C bus from, so a transfer is only started while the bus is idle.
+ */
+void SENSOR_Tasks(void)
+{
+    uint32_t now = SYS_TIME_CounterGet();
+
+    if (sensorTempFailed)
+    {
+        sensorTempFailed = false;
+        LED_SetRed(LED_STATE_BLINK_SLOW);
+    }
+
+    if (sensorTempPending || (sensorTempStarted && (now - sensorTempLastStart) < SYS_TIME_MSToCount(CFG_SENSOR_TEMP_PERIOD_MS)))
+    {
+        return;
+    }
+
+    if (SERCOM3_I2C_IsBusy())
+    {
+        sensorChannels[SENSOR_TEMPERATURE].busy++;
+        return;
+    }
+
+    sensorTempPending = true;
+    if (SERCOM3_I2C_WriteRead(MCP9808_I2C_ADDRESS, &sensorTempRegister, 1, sensorTempRx, sizeof(sensorTempRx)))
+    {
+        sensorTempStarted   = true;
+        sensorTempLastStart = now;
+    }
+    else
+    {
+        sensorTempPending = false;
+        sensorChannels[SENSOR_TEMPERATURE].busy++;
+    }
+}
+
+bool SENSOR_GetLatest(sensor_id_t id, sensor_sample_t* sample)
+{
+    sensor_channel_t* channel        = &sensorChannels[id];
+    bool              interruptState = SYS_INT_Disable();
+    bool              found          = channel->head != 0;
+
+    if (found)
+    {
+        *sample = channel->ring[(channel->head - 1) % CFG_SENSOR_RING_SIZE];
+    }
+
+    SYS_INT_Restore(interruptState);
+    return found;
+}
+
+/** \brief Mean of the samples taken in the last windowMs.
+ *
+ * A window of 0 returns the latest sample. The window is limited to the
+ * CFG_SENSOR_RING_SIZE most recent samples.
+ *
+ * @return false if there is no sample in the window
+ */
+bool SENSOR_GetAverage(sensor_id_t id, uint32_t windowMs, int32_t* value)
+{
+    sensor_channel_t* channel = &sensorChannels[id];
+    uint32_t          window  = SYS_TIME_MSToCount(windowMs);
+    int64_t           sum     = 0;
+    uint32_t          count   = 0;
+    uint32_t          available;
+    uint32_t          now;
+    bool              interruptState;
+
+    if (windowMs == 0)
+    {
+        sensor_sample_t sample;
+
+        if (!SENSOR_GetLatest(id, &sample))
+        {
+            return false;
+        }
+        *value = sample.value;
+        return true;
+    }
+
+    // Read the time with interrupts off so no sample can be newer than it
+    interruptState = SYS_INT_Disable();
+    now            = SYS_TIME_CounterGet();
+    available      = (channel->head < CFG_SENSOR_RING_SIZE) ? channel->head : CFG_SENSOR_RING_SIZE;
+
+    while (count < available)
+    {
+        const sensor_sample_t* sample = &channel->ring[(channel->head - 1 - count) % CFG_SENSOR_RING_SIZE];
+
+        if (now - sample->timestamp > window)
+        {
+            break;
+        }
+        sum += sample->value;
+        count++;
+    }
+
+    SYS_INT_Restore(interruptState);
+
+    if (count == 0)
+    {
+        return false;
+    }
+
+    *value = (int32_t)(sum / (int32_t)count);
+    return true;
+}
+
+/** \brief Copy the samples taken since *cursor, oldest first, and advance it.
+ *
+ * A cursor starts at 0. Samples overwritten before they were read are skipped.
+ *
+ * @return number of samples copied
+ */
+uint8_t SENSOR_ReadSamples(sensor_id_t id, uint32_t* cursor, sensor_sample_t* samples, uint8_t maxSamples)
+{
+    sensor_channel_t* channel        = &sensorChannels[id];
+    bool              interruptState = SYS_INT_Disable();
+    uint32_t          head           = channel->head;
+    uint8_t           count          = 0;
+
+    if (head - *cursor > CFG_SENSOR_RING_SIZE)
+    {
+        *cursor = head - CFG_SENSOR_RING_SIZE;
+    }
+
+    while (*cursor != head && count < maxSamples)
+    {
+        samples[count++] = channel->ring[*cursor % CFG_SENSOR_RING_SIZE];
+        (*cursor)++;
+    }
+
+    SYS_INT_Restore(interruptState);
+    return count;
+}
+
+void SENSOR_GetStats(sensor_id_t id, sensor_stats_t* stats)
+{
+    stats->samples = sensorChannels[id].head;
+    stats->errors  = sensorChannels[id].errors;
+    stats->busy    = sensorChannels[id].busy;
+}
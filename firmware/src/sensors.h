@@ -0,0 +1,61 @@
+/*
+    \file   sensors.h
+
+    \brief  Interrupt driven light and temperature sampling
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum
+{
+    SENSOR_LIGHT = 0,     // Light sensor voltage in mV
+    SENSOR_TEMPERATURE,   // MCP9808 ambient temperature in 1/16 degree C
+    SENSOR_COUNT
+} sensor_id_t;
+
+typedef struct
+{
+    uint32_t timestamp;   // SYS_TIME_CounterGet() when the sample was taken
+    int32_t  value;
+} sensor_sample_t;
+
+typedef struct
+{
+    uint32_t samples;     // Samples written to the ring since start up
+    uint32_t errors;      // Failed reads
+    uint32_t busy;        // Reads skipped because the bus was in use
+} sensor_stats_t;
+
+void    SENSOR_Initialize(void);
+void    SENSOR_Tasks(void);
+bool    SENSOR_GetLatest(sensor_id_t id, sensor_sample_t* sample);
+bool    SENSOR_GetAverage(sensor_id_t id, uint32_t windowMs, int32_t* value);
+uint8_t SENSOR_ReadSamples(sensor_id_t id, uint32_t* cursor, sensor_sample_t* samples, uint8_t maxSamples);
+void    SENSOR_GetStats(sensor_id_t id, sensor_stats_t* stats);
+
+#endif   // SENSORS_H
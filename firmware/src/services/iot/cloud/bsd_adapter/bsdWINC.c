@@ -35,6 +35,7 @@
 #include "../../../../iot_config/IoT_Sensor_Node_config.h"
 #include "socket.h"
 #include "debug_print.h"
+#include "latency_trace.h"
 
 #define MAX_SUPPORTED_SOCKETS 2
 /**********************BSD (WINC) Enumerator Translators ********************************/
@@ -260,6 +261,54 @@ packetReceptionHandler_t* BSD_GetRecvHandlerTable()
     return packetRecvInfo;
 }
 
+int BSD_writev(int socket, const struct bsd_iovec* iov, int iovcnt)
+{
+    wincSocketResponses_t wincSendReturn;
+    tstrSocketIovec       wincIov[SOCKET_IOV_MAX];
+    size_t                len = 0;
+    int                   i;
+
+    if (iov == NULL || iovcnt <= 0 || iovcnt > SOCKET_IOV_MAX)
+    {
+        bsd_setErrNo(EINVAL);
+        return BSD_ERROR;
+    }
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        wincIov[i].pvBuf  = iov[i].iov_base;
+        wincIov[i].u16Len = (uint16_t)iov[i].iov_len;
+        len += iov[i].iov_len;
+    }
+
+    if (len > SOCKET_BUFFER_MAX_LENGTH)
+    {
+        bsd_setErrNo(EMSGSIZE);
+        return BSD_ERROR;
+    }
+
+    wincSendReturn = sendv((SOCKET)socket, wincIov, (uint8_t)iovcnt, 0);
+    if (wincSendReturn != WINC_SOCK_ERR_NO_ERROR)
+    {
+        debug_printError("  BSD: wincSendReturn (%d)", wincSendReturn);
+        switch (wincSendReturn)
+        {
+            case WINC_SOCK_ERR_INVALID_ARG:
+                bsd_setErrNo((socket < 0) ? ENOTSOCK : EINVAL);
+                break;
+            case WINC_SOCK_ERR_BUFFER_FULL:
+                bsd_setErrNo(ENOBUFS);
+                break;
+            default:
+                break;
+        }
+        return BSD_ERROR;
+    }
+
+    // As for BSD_send(), the WINC either sends everything or nothing
+    return len;
+}
+
 int BSD_recv(int socket, const void* buf, size_t len, int flags)
 {
     wincSocketResponses_t wincRecvReturn;
@@ -825,6 +874,7 @@ void BSD_SocketHandler(int8_t sock, uint8_t msgType, void* pMsg)
 
                 if (pstrRecv->s16BufferSize > 0)
                 {
+                    TRACE_Point(TRACE_SOCKET_RECV);
                     bsdSocketInfo->recvCallBack(pstrRecv->pu8Buffer, pstrRecv->s16BufferSize);
                     bsdSocketInfo->socketState = SOCKET_CONNECTED;
                 }
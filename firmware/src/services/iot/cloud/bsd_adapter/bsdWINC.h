@@ -207,6 +207,11 @@ struct bsd_sockaddr_in{							/* Socket address internet style */
 	char	sin_zero[8];
 };
 
+struct bsd_iovec{							/* Buffer for gathered writes */
+	void	*iov_base;
+	size_t	iov_len;
+};
+
 struct pollfd {
 	 int	fd;	  /* file descriptor */
 	 short	events;	  /* events to look for	*/
@@ -249,6 +254,8 @@ int BSD_connect(int socket, const struct bsd_sockaddr *name, socklen_t namelen);
 
 int BSD_send(int socket, const void *msg, size_t len, int flags);
 
+int BSD_writev(int socket, const struct bsd_iovec *iov, int iovcnt);
+
 int BSD_recv(int socket, const void *msg, size_t len, int flags);
 
 int BSD_close(int socket);
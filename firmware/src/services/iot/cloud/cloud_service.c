@@ -42,6 +42,9 @@
 #include "../cloud/mqtt_packetPopulation/mqtt_packetPopulate.h"
 #include "../../../mqtt/mqtt_core/mqtt_core.h"
 #include "wifi_service.h"
+#include "store_forward.h"
+#include "connection_cache.h"
+#include "reconnect_policy.h"
 #include "../../../credentials_storage/credentials_storage.h"
 #include "../../../mqtt/mqtt_packetTransfer_interface.h"
 #include "definitions.h"
@@ -57,17 +60,25 @@ static bool waitingForMQTT   = false;
 pf_MQTT_CLIENT*   pf_mqtt_client;
 char*             mqtt_host;
 volatile uint32_t mqttHostIP;
-volatile uint32_t dnsRetryCount = 0;
+volatile bool     dnsRequestPending = false;
+static uint64_t   dnsRequestCount;
 char              mqttSubscribeTopic[TOPIC_SIZE];
 
+static pf_MQTT_CLIENT* fallbackClient      = NULL;
+static char*           fallbackHost        = NULL;
+static uint8_t         connectFailures     = 0;
+static bool            usingCachedHostIp   = false;
+static volatile bool   socketConnectFailed = false;
+static uint32_t        reconnectStartMs    = 0;
+static cloud_timing_t  cloudTiming;
+
 static int8_t  connectMQTTSocket(void);
 static void    connectMQTT();
 
 bool sendSubscribe = true;
-#define CLOUD_TASK_INTERVAL_MS      500L
 #define CLOUD_MQTT_TIMEOUT_COUNT_MS 30000L   // 30 seconds max allowed to establish a connection
 #define CLOUD_RESET_TIMEOUT_MS      2000L    // 2 seconds
-#define DNS_RETRY_COUNT_MS          10000L / CLOUD_TASK_INTERVAL_MS
+#define DNS_RETRY_TIMEOUT_MS        10000L   // 10 seconds
 #define WIFI_CONNECT_TIMEOUT_MS     5000L   // 5 seconds
 
 SYS_TIME_HANDLE cloudResetTaskHandle  = SYS_TIME_HANDLE_INVALID;
@@ -90,7 +101,7 @@ void wifiTimeoutTask(void);
  * be a corresponding publish handler.
  * E.g.: For a particular topic 
  *       mchp/mySubscribedTopic/myDetailedPath
- *       Sample publish handler function  = void handlePublishMessage(uint8_t *topic, uint8_t *payload)
+ *       Sample publish handler function  = void handlePublishMessage(uint8_t *topic, uint16_t topicLength, uint8_t *payload, uint16_t payloadLength)
  * 
  */
 
@@ -98,6 +109,69 @@ packetReceptionHandler_t cloud_packetReceiveCallBackTable[CLOUD_PACKET_RECV_TABL
 
 static char* ateccsn = NULL;
 
+static uint32_t cloudTimeMs(void)
+{
+    return (uint32_t)(SYS_TIME_Counter64Get() / (SYS_TIME_FrequencyGet() / 1000));
+}
+
+// Boot milestones are only recorded the first time
+static void cloudTimingMark(uint32_t* mark)
+{
+    if (*mark == 0)
+    {
+        *mark = cloudTimeMs();
+    }
+}
+
+//
+// A connection stage failed and backs off. A cached host address is resolved
+// again, the fallback host is used after CFG_CLOUD_FALLBACK_FAILURES failures.
+// Returns true if the host was switched and the connection must be reset.
+//
+static bool cloudConnectFailed(reconnect_stage_t stage)
+{
+    RECONNECT_Failure(stage);
+    connectFailures++;
+
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+    if (usingCachedHostIp)
+    {
+        usingCachedHostIp = false;
+        CONNECTION_CACHE_InvalidateHostIp();
+        shared_networking_params.haveHostIp = 0;
+    }
+#endif
+
+    if (fallbackClient == NULL || connectFailures < CFG_CLOUD_FALLBACK_FAILURES)
+    {
+        return false;
+    }
+
+    debug_printWarn("CLOUD: %d connect failures, falling back to '%s'", connectFailures, fallbackHost);
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+    CONNECTION_CACHE_InvalidateHub();
+#endif
+    cloudTiming.fallbackCount++;
+    CLOUD_init_host(fallbackHost, ateccsn, fallbackClient);
+    return true;
+}
+
+//
+// First telemetry after boot completes the boot timing report
+//
+static void cloudTelemetrySent(void)
+{
+    if (cloudTiming.telemetryMs == 0)
+    {
+        cloudTimingMark(&cloudTiming.telemetryMs);
+        debug_printGood("CLOUD: Boot to first telemetry %lu ms (WiFi %lu ms, host IP %lu ms, CONNACK %lu ms)",
+                        cloudTiming.telemetryMs,
+                        cloudTiming.wifiMs,
+                        cloudTiming.hostIpMs,
+                        cloudTiming.connackMs);
+    }
+}
+
 void NETWORK_wifiSslCallback(uint8_t u8MsgType, void* pvMsg)
 {
     switch (u8MsgType)
@@ -131,7 +205,16 @@ socketState_t getSocketState()
 
 void CLOUD_setdeviceId(char* id)
 {
+    uint32_t seed = (uint32_t)SYS_TIME_Counter64Get();
+
     ateccsn = id;
+
+    // Devices draw different reconnect delays
+    while (id != NULL && *id != '\0')
+    {
+        seed = (seed ^ (uint8_t)*id++) * 16777619UL;
+    }
+    RECONNECT_Seed(seed);
 }
 
 //
@@ -159,6 +242,13 @@ void CLOUD_reset(void)
 {
     debug_printInfo("CLOUD: Resetting cloud connection");
     cloudInitialized = false;
+
+    // Only count reconnects of a connection that carried telemetry, not
+    // the switch from DPS to the hub
+    if (cloudTiming.telemetryMs != 0 && reconnectStartMs == 0)
+    {
+        reconnectStartMs = cloudTimeMs();
+    }
     CLOUD_disconnect();
 }
 
@@ -179,6 +269,7 @@ void mqttTimeoutTask(void)
     if (shared_networking_params.haveMqttConnection == 0)
     {
         debug_printWarn("CLOUD: MQTT Connection Timeout");
+        cloudConnectFailed(RECONNECT_STAGE_CONNACK);
         CLOUD_reset();
         waitingForMQTT = false;
     }
@@ -195,6 +286,7 @@ void wifiTimeoutTask(void)
     {
         LED_SetWiFi(LED_INDICATOR_ERROR);
         debug_printWarn("CLOUD: WiFi Connection Timeout");
+        RECONNECT_Failure(RECONNECT_STAGE_WIFI);
         CLOUD_reset();
     }
 }
@@ -209,7 +301,31 @@ void CLOUD_init_host(char* host, char* attDeviceID, pf_MQTT_CLIENT* pf_table)
     shared_networking_params.haveHostIp = 1;
     pf_mqtt_client                      = pf_table;
     CLOUD_setdeviceId(attDeviceID);
+
+    // The session belongs to the previous host. Its PUBLISH packets are
+    // reported to the PUBACK callback before the callback is removed.
+    MQTT_DiscardSession();
     MQTT_Set_Puback_callback(NULL);
+
+    fallbackClient    = NULL;
+    fallbackHost      = NULL;
+    connectFailures   = 0;
+    usingCachedHostIp = false;
+}
+
+//
+// Called by App after CLOUD_init_host() to name the host to use when the
+// first one cannot be reached, e.g. DPS when connecting to a cached hub.
+//
+void CLOUD_setFallbackHost(char* host, pf_MQTT_CLIENT* pf_table)
+{
+    fallbackHost   = host;
+    fallbackClient = pf_table;
+}
+
+void CLOUD_getTiming(cloud_timing_t* timing)
+{
+    *timing = cloudTiming;
 }
 
 //
@@ -271,6 +387,7 @@ static int8_t connectMQTTSocket(void)
 
         if (ret == BSD_SUCCESS)
         {
+            RECONNECT_Attempt(RECONNECT_STAGE_TLS);
             ret = BSD_connect(*context->tcpClientSocket,
                               (struct bsd_sockaddr*)&addr,
                               sizeof(struct bsd_sockaddr_in));
@@ -302,6 +419,7 @@ static void connectMQTT()
 
     if (currentTime > 0)
     {
+        RECONNECT_Attempt(RECONNECT_STAGE_CONNACK);
         pf_mqtt_client->MQTT_CLIENT_connect(ateccsn);
     }
 
@@ -344,6 +462,37 @@ void CLOUD_disconnect(void)
     }
 }
 
+#if (CFG_STORE_FORWARD_ENABLE == 1)
+//
+// Send the oldest stored telemetry message while more than
+// CFG_STORE_FORWARD_LIVE_RESERVE PUBLISH descriptors are free.
+// Descriptors of QoS 1 packets are freed by PUBACK, so the
+// queue drains at the rate the broker acknowledges.
+//
+static void cloudSendStoredTelemetry(void)
+{
+    store_forward_message_t message;
+    mqttPublishQueueStats   stats;
+    uint16_t                packetId;
+
+    MQTT_GetPublishQueueStats(&stats);
+
+    if (stats.capacity - stats.inUse <= CFG_STORE_FORWARD_LIVE_RESERVE || !STORE_FORWARD_GetNext(&message))
+    {
+        return;
+    }
+
+    if (pf_mqtt_client->MQTT_CLIENT_publish(message.topic, message.payload, message.payloadLength, 1, &packetId))
+    {
+        STORE_FORWARD_MarkSent(&message, packetId);
+        cloudTelemetrySent();
+
+        // Come back for the next one
+        APP_PostEvent(APP_EVENT_CLOUD_TX);
+    }
+}
+#endif
+
 // Todo: This declaration supports the hack below
 packetReceptionHandler_t* getSocketInfo(uint8_t sock);
 
@@ -357,14 +506,28 @@ void CLOUD_task(void)
     {
         case NOT_A_SOCKET:   // 0
         {
+            if (socketConnectFailed)
+            {
+                socketConnectFailed = false;
+                if (cloudConnectFailed(RECONNECT_STAGE_TLS))
+                {
+                    CLOUD_reset();
+                }
+            }
+
             if (!cloudInitialized)
             {
                 if (shared_networking_params.cloudInitPending != 1)
                 {
+                    // A lost connection is retried after a random delay, failed
+                    // stages hold the reset off until their backoff has passed
+                    uint32_t resetDelayMs = RECONNECT_GetResetDelayMs(CLOUD_RESET_TIMEOUT_MS,
+                                                                      (reconnectStartMs != 0) ? 2 * CLOUD_RESET_TIMEOUT_MS : 0);
+
                     shared_networking_params.cloudInitPending = 1;
                     // Start initialization
-                    debug_printInfo("CLOUD: Cloud Reset timer start with %d ms", CLOUD_RESET_TIMEOUT_MS);
-                    cloudResetTaskHandle = SYS_TIME_CallbackRegisterMS(cloudResetTaskcb, 0, CLOUD_RESET_TIMEOUT_MS, SYS_TIME_SINGLE);
+                    debug_printInfo("CLOUD: Cloud Reset timer start with %lu ms", resetDelayMs);
+                    cloudResetTaskHandle = SYS_TIME_CallbackRegisterMS(cloudResetTaskcb, 0, resetDelayMs, SYS_TIME_SINGLE);
                 }
             }
             else if (shared_networking_params.haveAPConnection == 0)
@@ -380,24 +543,65 @@ void CLOUD_task(void)
             //else if (shared_networking_params.haveHostIp == 0)
             else if (shared_networking_params.haveHostIp == 0)
             {
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+                uint32_t cachedHostIp;
+#endif
+
+                cloudTimingMark(&cloudTiming.wifiMs);
+                RECONNECT_Success(RECONNECT_STAGE_WIFI);
+
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+                if (!dnsRequestPending && CONNECTION_CACHE_GetHostIp(mqtt_host, &cachedHostIp))
+                {
+                    // Skip DNS, a failed connect resolves the host again
+                    debug_printInfo("CLOUD: Using cached IP for %s", mqtt_host);
+                    mqttHostIP                          = cachedHostIp;
+                    shared_networking_params.haveHostIp = 1;
+                    usingCachedHostIp                   = true;
+                    cloudTiming.dnsCacheHits++;
+                    cloudTimingMark(&cloudTiming.hostIpMs);
+                    APP_PostEvent(APP_EVENT_SOCKET);
+                    break;
+                }
+#endif
                 // Need IP Address of MQTT Host to connect socket.
-                if (dnsRetryCount > 0)
+                if (dnsRequestPending && SYS_TIME_CountToMS((uint32_t)(SYS_TIME_Counter64Get() - dnsRequestCount)) < DNS_RETRY_TIMEOUT_MS)
                 {
                     // still waiting for DNS look up
-                    dnsRetryCount--;
                     break;
                 }
                 else
                 {
+                    if (dnsRequestPending)
+                    {
+                        // No answer within DNS_RETRY_TIMEOUT_MS
+                        dnsRequestPending = false;
+                        if (cloudConnectFailed(RECONNECT_STAGE_DNS))
+                        {
+                            // Host could not be resolved, e.g. the cached hub was removed
+                            CLOUD_reset();
+                            break;
+                        }
+                    }
+
+                    if (!RECONNECT_Allowed(RECONNECT_STAGE_DNS))
+                    {
+                        break;
+                    }
+
                     // send request to get Host IP
                     debug_printInfo("CLOUD: Getting IP for %s", mqtt_host);
+                    RECONNECT_Attempt(RECONNECT_STAGE_DNS);
                     if (gethostbyname((char*)mqtt_host) != M2M_SUCCESS)
                     {
                         debug_printError("CLOUD: gethostbyname failed");
+                        RECONNECT_Failure(RECONNECT_STAGE_DNS);
                     }
                     else
                     {
-                        dnsRetryCount = DNS_RETRY_COUNT_MS;
+                        dnsRequestPending = true;
+                        dnsRequestCount   = SYS_TIME_Counter64Get();
+                        cloudTiming.dnsLookups++;
                     }
                 }
             }
@@ -405,6 +609,10 @@ void CLOUD_task(void)
             {
                 CLOUD_reset();
             }
+            else if (!RECONNECT_Allowed(RECONNECT_STAGE_TLS))
+            {
+                // Backing off after a failed socket connect
+            }
             else
             {
                 // Ready to connect socket
@@ -448,6 +656,7 @@ void CLOUD_task(void)
             if (mqttState == DISCONNECTED)
             {
                 // Start MQTT CONNECT
+                RECONNECT_Success(RECONNECT_STAGE_TLS);
                 connectMQTT();
             }
             else
@@ -460,15 +669,35 @@ void CLOUD_task(void)
                 mqttState = MQTT_TransmissionHandler(mqttConnnectionInfo);
                 //debug_printWarn("CLOUD: MQTT Transmission %d", mqttState);
 
-                // Todo: We already processed the data in place using PEEK, this just flushes the buffer
-                BSD_recv(*MQTT_GetClientConnectionInfo()->tcpClientSocket,
-                         MQTT_GetClientConnectionInfo()->mqttDataExchangeBuffers.rxbuff.start,
-                         MQTT_GetClientConnectionInfo()->mqttDataExchangeBuffers.rxbuff.bufferLength,
-                         0);
+                // Post the next receive behind any partially received packet
+                MQTT_Receive(mqttConnnectionInfo);
             }
 
             if (mqttState == CONNECTED)
             {
+                if (waitingForMQTT)
+                {
+                    // Connection established
+                    connectFailures = 0;
+                    RECONNECT_Success(RECONNECT_STAGE_CONNACK);
+                    cloudTimingMark(&cloudTiming.connackMs);
+
+                    if (reconnectStartMs != 0)
+                    {
+                        cloudTiming.lastReconnectMs = cloudTimeMs() - reconnectStartMs;
+                        if (cloudTiming.lastReconnectMs > cloudTiming.maxReconnectMs)
+                        {
+                            cloudTiming.maxReconnectMs = cloudTiming.lastReconnectMs;
+                        }
+                        cloudTiming.reconnectCount++;
+                        reconnectStartMs = 0;
+                        debug_printInfo("CLOUD: Reconnected in %lu ms", cloudTiming.lastReconnectMs);
+                    }
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+                    CONNECTION_CACHE_Commit();
+#endif
+                }
+
                 waitingForMQTT                              = false;
                 shared_networking_params.haveMqttConnection = 1;
 
@@ -492,6 +721,12 @@ void CLOUD_task(void)
                     // Send MQTT SUBSCRIBE
                     CLOUD_subscribe();
                 }
+#if (CFG_STORE_FORWARD_ENABLE == 1)
+                else
+                {
+                    cloudSendStoredTelemetry();
+                }
+#endif
             }
             break;
         }
@@ -512,18 +747,61 @@ bool CLOUD_isConnected(void)
     }
 }
 
-void CLOUD_publishData(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos)
+bool CLOUD_publishData(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos)
 {
-    pf_mqtt_client->MQTT_CLIENT_publish(topic, payload, payload_len, qos);
+    if (!pf_mqtt_client->MQTT_CLIENT_publish(topic, payload, payload_len, qos, NULL))
+    {
+        return false;
+    }
+
+    APP_PostEvent(APP_EVENT_CLOUD_TX);
+    return true;
+}
+
+//
+// Publish telemetry with QoS 1. With store-and-forward the message is
+// copied into the queue, also while disconnected, and sent by CLOUD_task().
+//
+void CLOUD_publishTelemetry(uint8_t* topic, uint8_t* payload, uint16_t payload_len)
+{
+#if (CFG_STORE_FORWARD_ENABLE == 1)
+    if (STORE_FORWARD_Put(topic, strlen((char*)topic), payload, payload_len))
+    {
+        APP_PostEvent(APP_EVENT_CLOUD_TX);
+        return;
+    }
+#endif
+    CLOUD_publishData(topic, payload, payload_len, 1);
+    cloudTelemetrySent();
+}
+
+// Let the application run CLOUD_task() as soon as the socket state changes
+// or data arrives instead of on the next cloud tick
+static void cloudSocketHandler(int8_t sock, uint8_t msgType, void* pMsg)
+{
+    if (msgType == SOCKET_MSG_CONNECT && pMsg != NULL && ((tstrSocketConnectMsg*)pMsg)->s8Error < 0)
+    {
+        // Counted by CLOUD_task() once the socket is closed
+        socketConnectFailed = true;
+    }
+
+    BSD_SocketHandler(sock, msgType, pMsg);
+    APP_PostEvent(APP_EVENT_SOCKET);
 }
 
 void dnsHandler(uint8_t* domainName, uint32_t serverIP)
 {
     if (serverIP != 0)
     {
-        dnsRetryCount                       = 0;
+        dnsRequestPending                   = false;
         shared_networking_params.haveHostIp = 1;
         mqttHostIP                          = serverIP;
+        usingCachedHostIp                   = false;
+        RECONNECT_Success(RECONNECT_STAGE_DNS);
+        cloudTimingMark(&cloudTiming.hostIpMs);
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+        CONNECTION_CACHE_SetHostIp(mqtt_host, serverIP);
+#endif
 
         debug_printGood(" WIFI: mqttHostIP '%lu.%lu.%lu.%lu'",
                         (0x0FF & (serverIP)),
@@ -531,6 +809,7 @@ void dnsHandler(uint8_t* domainName, uint32_t serverIP)
                         (0x0FF & (serverIP >> 16)),
                         (0x0FF & (serverIP >> 24)));
     }
+    APP_PostEvent(APP_EVENT_SOCKET);
 }
 
 uint8_t reInit(void)
@@ -550,7 +829,7 @@ uint8_t reInit(void)
     socketDeinit();
     socketInit();
 
-    registerSocketCallback(BSD_SocketHandler, dnsHandler);
+    registerSocketCallback(cloudSocketHandler, dnsHandler);
 
     MQTT_ClientInitialize();
 
@@ -576,9 +855,11 @@ uint8_t reInit(void)
     // Blink Blue LED to indicate WiFi connection is pending
     LED_SetWiFi(LED_INDICATOR_PENDING);
 
+    RECONNECT_Attempt(RECONNECT_STAGE_WIFI);
     if (!wifi_connectToAp(wifi_creds))
     {
         LED_SetWiFi(LED_INDICATOR_ERROR);
+        RECONNECT_Failure(RECONNECT_STAGE_WIFI);
         debug_printError(" WIFI: Failed to connect to AP");
         return false;
     }
@@ -14,16 +14,34 @@
 // this must be = to MAX_SUPPORTED_SOCKETS
 #define CLOUD_PACKET_RECV_TABLE_SIZE 2
 
+// Milliseconds since boot, 0 = not reached yet
+typedef struct
+{
+    uint32_t wifiMs;            // Wi-Fi connected with a DHCP address
+    uint32_t hostIpMs;          // MQTT host address known, from DNS or the cache
+    uint32_t connackMs;         // First MQTT CONNACK
+    uint32_t telemetryMs;       // First telemetry PUBLISH
+    uint32_t lastReconnectMs;   // Connection lost to CONNACK, most recent
+    uint32_t maxReconnectMs;
+    uint16_t reconnectCount;
+    uint16_t dnsLookups;
+    uint16_t dnsCacheHits;
+    uint16_t fallbackCount;     // Switches to the fallback host
+} cloud_timing_t;
+
 void CLOUD_init_host(char* host, char* deviceId, pf_MQTT_CLIENT* pf_table);
+void CLOUD_setFallbackHost(char* host, pf_MQTT_CLIENT* pf_table);
 void CLOUD_reset(void);
 void CLOUD_subscribe(void);
 void CLOUD_disconnect(void);
 bool CLOUD_isConnected(void);
-void CLOUD_publishData(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos);
+bool CLOUD_publishData(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos);
+void CLOUD_publishTelemetry(uint8_t* topic, uint8_t* payload, uint16_t payload_len);
 void CLOUD_task(void);
 void CLOUD_sched(void);
 void dnsHandler(uint8_t* domainName, uint32_t serverIP);
 void CLOUD_setdeviceId(char* id);
+void CLOUD_getTiming(cloud_timing_t* timing);
 uint8_t reInit(void);
 
 #endif /* CLOUD_SERVICE_H_ */
@@ -0,0 +1,229 @@
+/*
+    \file   connection_cache.c
+
+    \brief  Connection cache for warm restarts
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include "connection_cache.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
+#include "debug_print.h"
+#include "definitions.h"
+
+#define CONNECTION_CACHE_MAGIC 0x31484343UL   // "CCH1"
+
+// The hub assigned by DPS and its resolved address. The RAM copy is used by
+// the connection; it is written to flash once a connection with it succeeds.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t hostIp;         // Address of hubHostname, 0 = resolve again
+    uint32_t resolvedTime;   // RTC seconds when hostIp was resolved
+    char     idScope[11 + 1];
+    char     hubHostname[67 + 1];
+    uint32_t checksum;
+} connection_cache_entry_t;
+
+#define CONNECTION_CACHE_PAGES ((sizeof(connection_cache_entry_t) + NVMCTRL_FLASH_PAGESIZE - 1) / NVMCTRL_FLASH_PAGESIZE)
+
+// One flash row of its own, only accessed through the NVMCTRL. Programming
+// the firmware clears it.
+static const uint8_t connectionCacheRow[NVMCTRL_FLASH_ROWSIZE] __attribute__((aligned(NVMCTRL_FLASH_ROWSIZE))) = {0};
+
+static connection_cache_entry_t cacheEntry;
+static bool                     cacheLoaded = false;
+static bool                     cacheDirty  = false;
+
+static uint32_t connectionCacheChecksum(const connection_cache_entry_t* entry)
+{
+    const uint8_t* data = (const uint8_t*)entry;
+    uint32_t       hash = 2166136261UL;   // FNV-1a
+    size_t         index;
+
+    for (index = 0; index < offsetof(connection_cache_entry_t, checksum); index++)
+    {
+        hash ^= data[index];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+static uint32_t connectionCacheNow(void)
+{
+    struct tm sys_time;
+
+    RTC_RTCCTimeGet(&sys_time);
+    return (uint32_t)mktime(&sys_time);
+}
+
+static void connectionCacheLoad(void)
+{
+    if (cacheLoaded)
+    {
+        return;
+    }
+
+    cacheLoaded = true;
+    NVMCTRL_Read((uint32_t*)&cacheEntry, sizeof(cacheEntry), (uint32_t)connectionCacheRow);
+
+    if (cacheEntry.magic != CONNECTION_CACHE_MAGIC ||
+        cacheEntry.checksum != connectionCacheChecksum(&cacheEntry) ||
+        memchr(cacheEntry.idScope, '\0', sizeof(cacheEntry.idScope)) == NULL ||
+        memchr(cacheEntry.hubHostname, '\0', sizeof(cacheEntry.hubHostname)) == NULL)
+    {
+        memset(&cacheEntry, 0, sizeof(cacheEntry));
+    }
+}
+
+static bool connectionCacheExpired(void)
+{
+    uint32_t now = connectionCacheNow();
+
+    // Until SNTP sets the RTC the clock is behind the stored time. The
+    // address is used anyway, a failed connect resolves it again.
+    return now >= cacheEntry.resolvedTime && now - cacheEntry.resolvedTime >= CFG_CONNECTION_CACHE_TTL_SEC;
+}
+
+// Hub assigned by the last registration with this ID Scope, NULL if none
+const char* CONNECTION_CACHE_GetHub(const char* idScope)
+{
+    connectionCacheLoad();
+
+    if (cacheEntry.hubHostname[0] == '\0' || strcmp(cacheEntry.idScope, idScope) != 0)
+    {
+        return NULL;
+    }
+    return cacheEntry.hubHostname;
+}
+
+void CONNECTION_CACHE_SetHub(const char* idScope, const char* hubHostname)
+{
+    connectionCacheLoad();
+
+    if (strcmp(cacheEntry.idScope, idScope) != 0 || strcmp(cacheEntry.hubHostname, hubHostname) != 0)
+    {
+        snprintf(cacheEntry.idScope, sizeof(cacheEntry.idScope), "%s", idScope);
+        snprintf(cacheEntry.hubHostname, sizeof(cacheEntry.hubHostname), "%s", hubHostname);
+        cacheEntry.hostIp       = 0;
+        cacheEntry.resolvedTime = 0;
+        cacheDirty              = true;
+    }
+}
+
+// The flash copy is kept until a new hub is assigned, a restart before that
+// tries the old hub again
+void CONNECTION_CACHE_InvalidateHub(void)
+{
+    connectionCacheLoad();
+    memset(&cacheEntry, 0, sizeof(cacheEntry));
+    cacheDirty = false;
+}
+
+bool CONNECTION_CACHE_GetHostIp(const char* host, uint32_t* hostIp)
+{
+    connectionCacheLoad();
+
+    if (cacheEntry.hostIp == 0 || strcmp(cacheEntry.hubHostname, host) != 0 || connectionCacheExpired())
+    {
+        return false;
+    }
+    *hostIp = cacheEntry.hostIp;
+    return true;
+}
+
+// Only the address of the cached hub is kept
+void CONNECTION_CACHE_SetHostIp(const char* host, uint32_t hostIp)
+{
+    connectionCacheLoad();
+
+    if (cacheEntry.hubHostname[0] == '\0' || strcmp(cacheEntry.hubHostname, host) != 0)
+    {
+        return;
+    }
+
+    if (hostIp != cacheEntry.hostIp || connectionCacheExpired())
+    {
+        cacheEntry.hostIp       = hostIp;
+        cacheEntry.resolvedTime = connectionCacheNow();
+        cacheDirty              = true;
+    }
+}
+
+void CONNECTION_CACHE_InvalidateHostIp(void)
+{
+    connectionCacheLoad();
+    cacheEntry.hostIp = 0;
+}
+
+// Write the entry to flash if it changed. Called once the connection using
+// it is established, at most once per TTL unless the hub or address changes.
+void CONNECTION_CACHE_Commit(void)
+{
+    uint32_t pageBuffer[CONNECTION_CACHE_PAGES * NVMCTRL_FLASH_PAGESIZE / sizeof(uint32_t)];
+    uint32_t address = (uint32_t)connectionCacheRow;
+    uint32_t page;
+
+    if (!cacheDirty)
+    {
+        return;
+    }
+    cacheDirty = false;
+
+    cacheEntry.magic    = CONNECTION_CACHE_MAGIC;
+    cacheEntry.checksum = connectionCacheChecksum(&cacheEntry);
+
+    memset(pageBuffer, 0xFF, sizeof(pageBuffer));
+    memcpy(pageBuffer, &cacheEntry, sizeof(cacheEntry));
+
+    while (NVMCTRL_IsBusy() == true)
+    {
+        /* Wait for the previous NVM command */
+    }
+    NVMCTRL_RowErase(address);
+    while (NVMCTRL_IsBusy() == true)
+    {
+        /* Wait for the row erase */
+    }
+
+    for (page = 0; page < CONNECTION_CACHE_PAGES; page++)
+    {
+        NVMCTRL_PageWrite(&pageBuffer[page * NVMCTRL_FLASH_PAGESIZE / sizeof(uint32_t)], address + page * NVMCTRL_FLASH_PAGESIZE);
+        while (NVMCTRL_IsBusy() == true)
+        {
+            /* Wait for the page write */
+        }
+    }
+
+    if (NVMCTRL_ErrorGet() != NVMCTRL_ERROR_NONE)
+    {
+        debug_printError("CLOUD: Connection cache write failed");
+    }
+    else
+    {
+        debug_printGood("CLOUD: Connection cache saved for '%s'", cacheEntry.hubHostname);
+    }
+}
@@ -0,0 +1,42 @@
+/*
+    \file   connection_cache.h
+
+    \brief  Connection cache for warm restarts
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef CONNECTION_CACHE_H
+#define CONNECTION_CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+const char* CONNECTION_CACHE_GetHub(const char* idScope);
+void        CONNECTION_CACHE_SetHub(const char* idScope, const char* hubHostname);
+void        CONNECTION_CACHE_InvalidateHub(void);
+bool        CONNECTION_CACHE_GetHostIp(const char* host, uint32_t* hostIp);
+void        CONNECTION_CACHE_SetHostIp(const char* host, uint32_t hostIp);
+void        CONNECTION_CACHE_InvalidateHostIp(void);
+void        CONNECTION_CACHE_Commit(void);
+
+#endif   // CONNECTION_CACHE_H
@@ -38,6 +38,7 @@
 #include "azutil.h"
 #include "debug_print.h"
 #include "led.h"
+#include "services/iot/cloud/store_forward.h"
 #include "lib/basic/atca_basic.h"
 #include "azure/iot/az_iot_pnp_client.h"
 #include "azure/core/az_span.h"
@@ -51,9 +52,9 @@ pf_MQTT_CLIENT pf_mqtt_iothub_client = {
     NULL};
 
 // Callback functions for IoT Hub SUBSCRIBE
-extern void APP_ReceivedFromCloud_methods(uint8_t* topic, uint8_t* payload);
-extern void APP_ReceivedFromCloud_twin(uint8_t* topic, uint8_t* payload);
-extern void APP_ReceivedFromCloud_patch(uint8_t* topic, uint8_t* payload);
+extern void APP_ReceivedFromCloud_methods(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len);
+extern void APP_ReceivedFromCloud_twin(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len);
+extern void APP_ReceivedFromCloud_patch(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len);
 
 extern const az_span     device_model_id_span;
 #ifdef IOT_PLUG_AND_PLAY_MODEL_ID
@@ -77,11 +78,11 @@ static volatile uint16_t packet_identifier;
  * be a corresponding publish handler.
  * E.g.: For a particular topic
  *       mchp/mySubscribedTopic/myDetailedPath
- *       Sample publish handler function  = void handlePublishMessage(uint8_t *topic, uint8_t *payload)
+ *       Sample publish handler function  = void handlePublishMessage(uint8_t *topic, uint16_t topicLength, uint8_t *payload, uint16_t payloadLength)
  */
 publishReceptionHandler_t imqtt_publishReceiveCallBackTable[MAX_NUM_TOPICS_SUBSCRIBE];
 
-void MQTT_CLIENT_iothub_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos)
+bool MQTT_CLIENT_iothub_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos, uint16_t* packet_id_out)
 {
     uint16_t packet_id = 0;
     int      qos_value = 0;
@@ -89,16 +90,22 @@ void MQTT_CLIENT_iothub_publish(uint8_t* topic, uint8_t* payload, uint16_t paylo
     if (topic == NULL)
     {
         debug_printError("  HUB: %s() missing PUBLISH topic");
-        return;
+        return false;
     }
 
     if (qos == 1)
     {
         qos_value = 1;
         packet_id = ++packet_identifier;
+
+        if (packet_id == 0)
+        {
+            // 0 is not a valid packet identifier
+            packet_id = ++packet_identifier;
+        }
     }
 
-    mqttPublishPacket cloudPublishPacket;
+    mqttPublishPacket cloudPublishPacket = {0};
     // Fixed header
     cloudPublishPacket.publishHeaderFlags.duplicate = 0;
     cloudPublishPacket.publishHeaderFlags.qos       = qos_value;
@@ -120,9 +127,15 @@ void MQTT_CLIENT_iothub_publish(uint8_t* topic, uint8_t* payload, uint16_t paylo
     if (MQTT_CreatePublishPacket(&cloudPublishPacket) != true)
     {
         debug_printError("  HUB: MQTT_CLIENT_iothub_publish() failed");
+        return false;
     }
 
-    return;
+    if (packet_id_out != NULL)
+    {
+        *packet_id_out = packet_id;
+    }
+
+    return true;
 }
 
 void MQTT_CLIENT_iothub_receive(uint8_t* data, uint16_t len)
@@ -145,6 +158,16 @@ void MQTT_CLIENT_iothub_puback_callback(mqttPubackPacket* data)
 {
 #ifdef DEBUG_PUBACK
     debug_printGood("  HUB: %s() Packet %d", __FUNCTION__, (uint16_t)(data->packetIdentifierMSB << 8 | data->packetIdentifierLSB));
+#endif
+#if (CFG_STORE_FORWARD_ENABLE == 1)
+    if (data->notDelivered)
+    {
+        STORE_FORWARD_Retry((uint16_t)(data->packetIdentifierMSB << 8 | data->packetIdentifierLSB));
+    }
+    else
+    {
+        STORE_FORWARD_Acknowledge((uint16_t)(data->packetIdentifierMSB << 8 | data->packetIdentifierLSB));
+    }
 #endif
     return;
 }
@@ -216,7 +239,8 @@ void MQTT_CLIENT_iothub_connect(char* device_id)
 
     mqttConnectPacket cloudConnectPacket;
     memset(&cloudConnectPacket, 0, sizeof(mqttConnectPacket));
-    cloudConnectPacket.connectVariableHeader.connectFlagsByte.All = 0x20;
+    // Keep the session across reconnects (cleanSession = 0)
+    cloudConnectPacket.connectVariableHeader.connectFlagsByte.cleanSession = 0;
     cloudConnectPacket.connectVariableHeader.keepAliveTimer       = AZ_IOT_DEFAULT_MQTT_CONNECT_KEEPALIVE_SECONDS;
 
     cloudConnectPacket.clientID       = az_span_ptr(device_id_span);
@@ -302,7 +326,7 @@ void MQTT_CLIENT_iothub_connected()
         return;
     }
 
-    mqttPublishPacket cloudPublishPacket;
+    mqttPublishPacket cloudPublishPacket = {0};
     // Fixed header
     cloudPublishPacket.publishHeaderFlags.duplicate = 0;
     cloudPublishPacket.publishHeaderFlags.qos       = 0;
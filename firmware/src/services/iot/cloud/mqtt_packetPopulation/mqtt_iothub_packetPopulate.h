@@ -33,7 +33,7 @@
 #include <stdint.h>
 #include "iot_config/cloud_config.h"
 
-void MQTT_CLIENT_iothub_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos);
+bool MQTT_CLIENT_iothub_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos, uint16_t* packet_id);
 void MQTT_CLIENT_iothub_receive(uint8_t* data, uint16_t len);
 void MQTT_CLIENT_iothub_connect(char* deviceID);
 bool MQTT_CLIENT_iothub_subscribe();
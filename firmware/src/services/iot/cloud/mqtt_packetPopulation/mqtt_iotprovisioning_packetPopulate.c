@@ -14,13 +14,14 @@
 #include "iot_config/IoT_Sensor_Node_config.h"
 #include "azutil.h"
 #include "debug_print.h"
+#include "services/iot/cloud/connection_cache.h"
+#include "services/iot/cloud/reconnect_policy.h"
 #include "lib/basic/atca_basic.h"
 #include "led.h"
 #include "azure/iot/az_iot_provisioning_client.h"
 #include "azure/core/az_span.h"
 
 #ifdef CFG_MQTT_PROVISIONING_HOST
-#define HALF_SECOND_MS 500L
 
 /**
 * @brief Provisioning polling interval.
@@ -51,7 +52,7 @@ extern uint8_t       device_id_buffer[128 + 1];
  * be a corresponding publish handler.
  * E.g.: For a particular topic
  *       mchp/mySubscribedTopic/myDetailedPath
- *       Sample publish handler function  = void handlePublishMessage(uint8_t *topic, uint8_t *payload)
+ *       Sample publish handler function  = void handlePublishMessage(uint8_t *topic, uint16_t topicLength, uint8_t *payload, uint16_t payloadLength)
  */
 extern publishReceptionHandler_t imqtt_publishReceiveCallBackTable[MAX_NUM_TOPICS_SUBSCRIBE];
 
@@ -65,17 +66,16 @@ az_span                                      register_payload_span;
 char                                         register_payload_buffer[1024];
 az_span                                      span_remainder;
 
-static uint16_t        dps_retry_counter;
 static SYS_TIME_HANDLE dps_retry_timer_handle = SYS_TIME_HANDLE_INVALID;
 static void            dps_retry_task(uintptr_t context);
 
 static SYS_TIME_HANDLE dps_assigning_timer_handle = SYS_TIME_HANDLE_INVALID;
 static void            dps_assigning_task(uintptr_t context);
 
-void MQTT_CLIENT_iotprovisioning_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos)
+bool MQTT_CLIENT_iotprovisioning_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos, uint16_t* packet_id)
 {
     debug_printWarn("  DPS: %s() not implemented", __FUNCTION__);
-    return;
+    return false;
 }
 
 void MQTT_CLIENT_iotprovisioning_receive(uint8_t* data, uint16_t len)
@@ -84,6 +84,29 @@ void MQTT_CLIENT_iotprovisioning_receive(uint8_t* data, uint16_t len)
     MQTT_GetReceivedData(data, len);
 }
 
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+// Use the hub assigned by the last registration with the ID Scope in the
+// secure element. Returns false if DPS has to run.
+bool MQTT_CLIENT_iotprovisioning_cachedHub(void)
+{
+    const char* cached_hub;
+
+    atcab_read_bytes_zone(ATCA_ZONE_DATA, ATCA_SLOT_DPS_IDSCOPE, 0, atca_dps_id_scope, sizeof(atca_dps_id_scope));
+    atca_dps_id_scope[sizeof(atca_dps_id_scope) - 1] = '\0';
+
+    cached_hub = CONNECTION_CACHE_GetHub((char*)atca_dps_id_scope);
+    if (cached_hub == NULL)
+    {
+        return false;
+    }
+
+    snprintf(hub_hostname_buffer, sizeof(hub_hostname_buffer), "%s", cached_hub);
+    hub_hostname = hub_hostname_buffer;
+    debug_printGood("  DPS: Using cached hub '%s' for ID Scope %s", hub_hostname, atca_dps_id_scope);
+    return true;
+}
+#endif
+
 void MQTT_CLIENT_iotprovisioning_connect(char* device_id)
 {
     size_t mqtt_username_buffer_len;
@@ -158,11 +181,9 @@ void MQTT_CLIENT_iotprovisioning_connect(char* device_id)
 }
 
 // Callback for DPS client register SUBSCRIBE
-void dps_client_register(uint8_t* topic, uint8_t* payload)
+void dps_client_register(uint8_t* topic, uint16_t topic_len, uint8_t* payload, uint16_t payload_len)
 {
     az_result rc;
-    int topic_len = strlen((const char*)topic);
-    int payload_len = strlen((const char*)payload);
 
     debug_printInfo("   DPS: %s()", __func__);
 
@@ -188,11 +209,16 @@ void dps_client_register(uint8_t* topic, uint8_t* payload)
         {
             case AZ_IOT_PROVISIONING_STATUS_ASSIGNED:
                 debug_printGood("   DPS: ASSIGNED");
+                RECONNECT_Success(RECONNECT_STAGE_DPS);
                 SYS_TIME_TimerDestroy(dps_retry_timer_handle);
                 SYS_TIME_TimerDestroy(dps_assigning_timer_handle);
 
                 az_span_to_str(hub_hostname_buffer, sizeof(hub_hostname_buffer), dps_register_response.registration_state.assigned_hub_hostname);
                 hub_hostname = hub_hostname_buffer;
+#if (CFG_CONNECTION_CACHE_ENABLE == 1)
+                // Saved once the connection to the hub succeeds
+                CONNECTION_CACHE_SetHub((char*)atca_dps_id_scope, hub_hostname_buffer);
+#endif
                 LED_SetCloud(LED_INDICATOR_PENDING);
                 pf_mqtt_iotprovisioning_client.MQTT_CLIENT_task_completed();
                 break;
@@ -317,9 +343,9 @@ void MQTT_CLIENT_iotprovisioning_connected()
             debug_printInfo("  DPS: Sending MQTT PUBLISH");
 #endif
 
-            // keep retrying connecting to DPS
-            dps_retry_counter      = 0;
-            dps_retry_timer_handle = SYS_TIME_CallbackRegisterMS(dps_retry_task, 0, HALF_SECOND_MS, SYS_TIME_PERIODIC);
+            // Register again if not assigned within the DPS backoff
+            RECONNECT_Attempt(RECONNECT_STAGE_DPS);
+            dps_retry_timer_handle = SYS_TIME_CallbackRegisterMS(dps_retry_task, 0, RECONNECT_GetRetryMs(RECONNECT_STAGE_DPS), SYS_TIME_SINGLE);
         }
     }
 
@@ -345,7 +371,7 @@ static void dps_assigning_task(uintptr_t context)
     }
     else
     {
-        mqttPublishPacket cloudPublishPacket;
+        mqttPublishPacket cloudPublishPacket = {0};
         // Fixed header
         cloudPublishPacket.publishHeaderFlags.duplicate = 0;
         cloudPublishPacket.publishHeaderFlags.qos       = 0;
@@ -373,9 +399,7 @@ static void dps_assigning_task(uintptr_t context)
 
 static void dps_retry_task(uintptr_t context)
 {
-    if (++dps_retry_counter % 240 > 0)   // retry every 2 mins
-        return;
-
+    RECONNECT_Failure(RECONNECT_STAGE_DPS);
     MQTT_CLIENT_iotprovisioning_connect((char*)device_id_buffer);
     return;
 }
@@ -35,11 +35,12 @@
 
 #define ATCA_SLOT_DPS_IDSCOPE 8   // Slot # in ATECC608A SE which stores the ID Scope
 
-void MQTT_CLIENT_iotprovisioning_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos);
+bool MQTT_CLIENT_iotprovisioning_publish(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos, uint16_t* packet_id);
 void MQTT_CLIENT_iotprovisioning_receive(uint8_t* data, uint16_t len);
 void MQTT_CLIENT_iotprovisioning_connect(char* deviceID);
 bool MQTT_CLIENT_iotprovisioning_subscribe();
 void MQTT_CLIENT_iotprovisioning_connected();
+bool MQTT_CLIENT_iotprovisioning_cachedHub(void);
 
 extern char* hub_hostname;
 
@@ -38,7 +38,7 @@ extern char              mqtt_username_buffer[203 + 1];
 
 typedef struct
 {
-    void (*MQTT_CLIENT_publish)(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos);
+    bool (*MQTT_CLIENT_publish)(uint8_t* topic, uint8_t* payload, uint16_t payload_len, int qos, uint16_t* packet_id);
     void (*MQTT_CLIENT_receive)(uint8_t* data, uint16_t len);
     void (*MQTT_CLIENT_connect)(char* device_id);
     bool (*MQTT_CLIENT_subscribe)();
@@ -0,0 +1,228 @@
+/*
+    \file   reconnect_policy.c
+
+    \brief  Reconnect backoff and circuit breaker per connection stage
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include "definitions.h"
+#include "reconnect_policy.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
+
+// Failed stages are retried after a decorrelated jitter backoff: the next
+// delay is drawn from [base, 3 x previous delay] and capped. Devices that
+// lose the connection together spread out instead of retrying in lockstep.
+typedef struct
+{
+    uint32_t baseMs;
+    uint32_t capMs;
+} reconnect_backoff_t;
+
+static const reconnect_backoff_t reconnectBackoff[RECONNECT_STAGE_COUNT] = {
+    {2000, 60000},        // WiFi
+    {1000, 60000},        // DNS
+    {1000, 120000},       // TLS
+    {2000, 300000},       // CONNACK
+    {120000, 1800000},    // DPS, first retry no earlier than the former fixed 2 minutes
+};
+
+static const char* const reconnectStageNames[RECONNECT_STAGE_COUNT] = {"WiFi", "DNS", "TLS", "CONNACK", "DPS"};
+
+typedef struct
+{
+    reconnect_stage_stats_t stats;
+    uint32_t                nextAttemptMs;   // Attempts are held off until then while backoffMs != 0
+} reconnect_stage_state_t;
+
+static reconnect_stage_state_t reconnectStages[RECONNECT_STAGE_COUNT];
+static uint32_t                reconnectRandomState = 2463534242UL;
+
+static uint32_t reconnectNowMs(void)
+{
+    return (uint32_t)(SYS_TIME_Counter64Get() / (SYS_TIME_FrequencyGet() / 1000));
+}
+
+// xorshift32, seeded per device so devices draw different delays
+static uint32_t reconnectRandom(void)
+{
+    uint32_t x = reconnectRandomState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    reconnectRandomState = x;
+    return x;
+}
+
+// Uniform in [low, high]
+static uint32_t reconnectRandomBetween(uint32_t low, uint32_t high)
+{
+    if (high <= low)
+    {
+        return low;
+    }
+    return low + reconnectRandom() % (high - low + 1);
+}
+
+static uint32_t reconnectNextBackoffMs(reconnect_stage_t stage, uint32_t previousMs)
+{
+    const reconnect_backoff_t* backoff = &reconnectBackoff[stage];
+    uint32_t                   upperMs;
+
+    if (previousMs < backoff->baseMs)
+    {
+        previousMs = backoff->baseMs;
+    }
+
+    upperMs = (previousMs > backoff->capMs / 3) ? backoff->capMs : previousMs * 3;
+    return reconnectRandomBetween(backoff->baseMs, upperMs);
+}
+
+void RECONNECT_Seed(uint32_t seed)
+{
+    // xorshift32 must not start at zero
+    reconnectRandomState = (seed != 0) ? seed : 2463534242UL;
+}
+
+void RECONNECT_Attempt(reconnect_stage_t stage)
+{
+    reconnectStages[stage].stats.attempts++;
+}
+
+//
+// Schedule the next attempt. After CFG_RECONNECT_BREAKER_FAILURES failures in
+// a row, or a failed trial attempt, the breaker opens and attempts are held off
+// for CFG_RECONNECT_BREAKER_OPEN_MS plus up to half of it again.
+//
+void RECONNECT_Failure(reconnect_stage_t stage)
+{
+    reconnect_stage_state_t* state          = &reconnectStages[stage];
+    bool                     interruptState = SYS_INT_Disable();
+
+    state->stats.failures++;
+    if (state->stats.consecutiveFailures < UINT16_MAX)
+    {
+        state->stats.consecutiveFailures++;
+    }
+
+    if (state->stats.breaker == RECONNECT_BREAKER_HALF_OPEN ||
+        (state->stats.breaker == RECONNECT_BREAKER_CLOSED && state->stats.consecutiveFailures >= CFG_RECONNECT_BREAKER_FAILURES))
+    {
+        state->stats.breaker = RECONNECT_BREAKER_OPEN;
+        state->stats.breakerTrips++;
+        state->stats.backoffMs = reconnectRandomBetween(CFG_RECONNECT_BREAKER_OPEN_MS, CFG_RECONNECT_BREAKER_OPEN_MS + CFG_RECONNECT_BREAKER_OPEN_MS / 2);
+    }
+    else if (state->stats.breaker == RECONNECT_BREAKER_CLOSED)
+    {
+        state->stats.backoffMs = reconnectNextBackoffMs(stage, state->stats.backoffMs);
+    }
+    state->nextAttemptMs = reconnectNowMs() + state->stats.backoffMs;
+
+    SYS_INT_Restore(interruptState);
+}
+
+void RECONNECT_Success(reconnect_stage_t stage)
+{
+    reconnect_stage_state_t* state          = &reconnectStages[stage];
+    bool                     interruptState = SYS_INT_Disable();
+
+    state->stats.consecutiveFailures = 0;
+    state->stats.backoffMs           = 0;
+    state->stats.breaker             = RECONNECT_BREAKER_CLOSED;
+
+    SYS_INT_Restore(interruptState);
+}
+
+//
+// True once the backoff of the stage has passed. The first call after an open
+// breaker's hold off is the trial attempt.
+//
+bool RECONNECT_Allowed(reconnect_stage_t stage)
+{
+    reconnect_stage_state_t* state          = &reconnectStages[stage];
+    bool                     allowed        = true;
+    bool                     interruptState = SYS_INT_Disable();
+
+    if (state->stats.backoffMs != 0)
+    {
+        if ((int32_t)(reconnectNowMs() - state->nextAttemptMs) < 0)
+        {
+            allowed = false;
+        }
+        else if (state->stats.breaker == RECONNECT_BREAKER_OPEN)
+        {
+            state->stats.breaker = RECONNECT_BREAKER_HALF_OPEN;
+        }
+    }
+
+    SYS_INT_Restore(interruptState);
+    return allowed;
+}
+
+// Delay for stages retried from a timer, the base delay before the first failure
+uint32_t RECONNECT_GetRetryMs(reconnect_stage_t stage)
+{
+    uint32_t backoffMs = reconnectStages[stage].stats.backoffMs;
+
+    return (backoffMs != 0) ? backoffMs : reconnectBackoff[stage].baseMs;
+}
+
+//
+// Delay before the connection is initialized again: a random delay between
+// minimumMs and minimumMs + jitterMs, or the longest backoff still running for
+// the stages a reset retries. DPS is retried from its own timer and does not
+// hold off a reset.
+//
+uint32_t RECONNECT_GetResetDelayMs(uint32_t minimumMs, uint32_t jitterMs)
+{
+    uint32_t delayMs = reconnectRandomBetween(minimumMs, minimumMs + jitterMs);
+    uint32_t nowMs   = reconnectNowMs();
+    int32_t  remainingMs;
+    int      stage;
+
+    for (stage = 0; stage < RECONNECT_STAGE_DPS; stage++)
+    {
+        if (reconnectStages[stage].stats.backoffMs == 0)
+        {
+            continue;
+        }
+
+        remainingMs = (int32_t)(reconnectStages[stage].nextAttemptMs - nowMs);
+        if (remainingMs > 0 && (uint32_t)remainingMs > delayMs)
+        {
+            delayMs = (uint32_t)remainingMs;
+        }
+    }
+    return delayMs;
+}
+
+void RECONNECT_GetStats(reconnect_stage_t stage, reconnect_stage_stats_t* stats)
+{
+    *stats = reconnectStages[stage].stats;
+}
+
+const char* RECONNECT_GetStageName(reconnect_stage_t stage)
+{
+    return reconnectStageNames[stage];
+}
@@ -0,0 +1,72 @@
+/*
+    \file   reconnect_policy.h
+
+    \brief  Reconnect backoff and circuit breaker per connection stage
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef RECONNECT_POLICY_H
+#define RECONNECT_POLICY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Stages of bringing up the cloud connection, each with its own backoff
+typedef enum
+{
+    RECONNECT_STAGE_WIFI = 0,   // Access point association and DHCP
+    RECONNECT_STAGE_DNS,        // MQTT host lookup
+    RECONNECT_STAGE_TLS,        // TCP connect and TLS handshake
+    RECONNECT_STAGE_CONNACK,    // MQTT CONNECT to CONNACK
+    RECONNECT_STAGE_DPS,        // DPS registration to assignment
+    RECONNECT_STAGE_COUNT
+} reconnect_stage_t;
+
+typedef enum
+{
+    RECONNECT_BREAKER_CLOSED = 0,   // Attempts follow the backoff
+    RECONNECT_BREAKER_OPEN,         // Too many failures, attempts held off
+    RECONNECT_BREAKER_HALF_OPEN     // One trial attempt after the hold off
+} reconnect_breaker_t;
+
+typedef struct
+{
+    uint32_t            attempts;
+    uint32_t            failures;
+    uint32_t            backoffMs;             // Delay after the last failure, 0 after a success
+    uint16_t            consecutiveFailures;
+    uint16_t            breakerTrips;
+    reconnect_breaker_t breaker;
+} reconnect_stage_stats_t;
+
+void        RECONNECT_Seed(uint32_t seed);
+void        RECONNECT_Attempt(reconnect_stage_t stage);
+void        RECONNECT_Failure(reconnect_stage_t stage);
+void        RECONNECT_Success(reconnect_stage_t stage);
+bool        RECONNECT_Allowed(reconnect_stage_t stage);
+uint32_t    RECONNECT_GetRetryMs(reconnect_stage_t stage);
+uint32_t    RECONNECT_GetResetDelayMs(uint32_t minimumMs, uint32_t jitterMs);
+void        RECONNECT_GetStats(reconnect_stage_t stage, reconnect_stage_stats_t* stats);
+const char* RECONNECT_GetStageName(reconnect_stage_t stage);
+
+#endif   // RECONNECT_POLICY_H
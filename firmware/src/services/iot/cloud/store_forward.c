@@ -0,0 +1,325 @@
+/*
+    \file   store_forward.c
+
+    \brief  Store-and-forward queue for QoS 1 telemetry
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#include <string.h>
+#include "store_forward.h"
+#include "iot_config/IoT_Sensor_Node_config.h"
+#include "debug_print.h"
+
+// Messages are kept in one circular byte buffer, oldest at storeTail. A
+// message stays until its PUBACK is received so it can be sent again after
+// a reconnect; space is reclaimed in order from the tail.
+typedef enum
+{
+    STORE_PENDING,    // Not sent on the current connection
+    STORE_INFLIGHT,   // Sent, waiting for PUBACK
+    STORE_RELEASED,   // Acknowledged or dropped
+    STORE_UNUSED      // Space at the end of the buffer that was skipped
+} store_state_t;
+
+// Only length and state are written for STORE_UNUSED, the space skipped at
+// the end of the buffer may be a single word
+typedef struct
+{
+    uint16_t length;   // Block length including this header, multiple of 4
+    uint8_t  state;
+    uint8_t  reserved;
+    uint16_t topicLength;
+    uint16_t payloadLength;
+    uint16_t packetId;
+    uint16_t reserved2;
+} store_block_t;
+
+static uint32_t storeBuffer[CFG_STORE_FORWARD_BUFFER_SIZE / sizeof(uint32_t)];
+static uint16_t storeHead      = 0;   // Offset of the next message
+static uint16_t storeTail      = 0;   // Offset of the oldest message
+static uint16_t storeUsed      = 0;
+static uint16_t storeCount     = 0;
+static uint16_t storeHighWater = 0;
+static uint32_t storeDropCount = 0;
+
+#define STORE_BLOCK(offset) ((store_block_t*)&((uint8_t*)storeBuffer)[offset])
+
+static void storeReclaim(void)
+{
+    store_block_t* block;
+
+    while (storeUsed > 0)
+    {
+        block = STORE_BLOCK(storeTail);
+        if (block->state == STORE_RELEASED)
+        {
+            storeCount--;
+        }
+        else if (block->state != STORE_UNUSED)
+        {
+            break;
+        }
+
+        storeTail = (storeTail + block->length) % CFG_STORE_FORWARD_BUFFER_SIZE;
+        storeUsed -= block->length;
+    }
+
+    if (storeUsed == 0)
+    {
+        // Start over at the beginning to get the largest contiguous space
+        storeHead = 0;
+        storeTail = 0;
+    }
+}
+
+static void storeDropOldest(void)
+{
+    // The block at the tail is a message that is still held, otherwise it was reclaimed
+    STORE_BLOCK(storeTail)->state = STORE_RELEASED;
+    storeDropCount++;
+    storeReclaim();
+}
+
+static store_block_t* storeAlloc(uint16_t need)
+{
+    store_block_t* block;
+
+    if (storeUsed + need > CFG_STORE_FORWARD_BUFFER_SIZE)
+    {
+        return NULL;
+    }
+
+    if (storeHead >= storeTail && storeUsed > 0)
+    {
+        // Free space is [head, end) followed by [0, tail)
+        if (CFG_STORE_FORWARD_BUFFER_SIZE - storeHead < need)
+        {
+            if (storeTail < need)
+            {
+                return NULL;
+            }
+
+            // Skip the unusable end of the buffer, it is reclaimed with the message in front of it
+            block         = STORE_BLOCK(storeHead);
+            block->length = CFG_STORE_FORWARD_BUFFER_SIZE - storeHead;
+            block->state  = STORE_UNUSED;
+            storeUsed += block->length;
+            storeHead = 0;
+        }
+    }
+    else if (storeUsed > 0 && storeTail - storeHead < need)
+    {
+        return NULL;
+    }
+
+    block         = STORE_BLOCK(storeHead);
+    block->length = need;
+
+    storeHead = (storeHead + need) % CFG_STORE_FORWARD_BUFFER_SIZE;
+    storeUsed += need;
+    if (storeUsed > storeHighWater)
+    {
+        storeHighWater = storeUsed;
+    }
+
+    return block;
+}
+
+/** \brief Copy a message into the queue.
+ *
+ * The oldest messages are dropped when there is not enough room.
+ *
+ * @return false if the message is larger than the whole buffer
+ */
+bool STORE_FORWARD_Put(const uint8_t* topic, uint16_t topicLength, const uint8_t* payload, uint16_t payloadLength)
+{
+    uint32_t       need = (sizeof(store_block_t) + topicLength + 1 + payloadLength + 3) & ~3UL;
+    store_block_t* block;
+    uint8_t*       data;
+
+    if (topicLength == 0 || need > CFG_STORE_FORWARD_BUFFER_SIZE)
+    {
+        return false;
+    }
+
+    while ((block = storeAlloc(need)) == NULL)
+    {
+        debug_printWarn("CLOUD: Store-and-forward full, dropping oldest message");
+        storeDropOldest();
+    }
+
+    block->topicLength   = topicLength;
+    block->payloadLength = payloadLength;
+    block->packetId      = 0;
+    block->state         = STORE_PENDING;
+
+    data = (uint8_t*)(block + 1);
+    memcpy(data, topic, topicLength);
+    data[topicLength] = '\0';
+    memcpy(data + topicLength + 1, payload, payloadLength);
+    storeCount++;
+
+    return true;
+}
+
+/** \brief Get the oldest message not sent on the current connection.
+ *
+ * The message stays where it is, topic (NUL terminated) and payload point
+ * into the queue until the next STORE_FORWARD_Put().
+ */
+bool STORE_FORWARD_GetNext(store_forward_message_t* message)
+{
+    uint16_t       offset = storeTail;
+    uint16_t       left   = storeUsed;
+    store_block_t* block;
+
+    while (left > 0)
+    {
+        block = STORE_BLOCK(offset);
+
+        if (block->state == STORE_PENDING)
+        {
+            message->topic         = (uint8_t*)(block + 1);
+            message->topicLength   = block->topicLength;
+            message->payload       = message->topic + block->topicLength + 1;
+            message->payloadLength = block->payloadLength;
+            message->handle        = block;
+            return true;
+        }
+
+        offset = (offset + block->length) % CFG_STORE_FORWARD_BUFFER_SIZE;
+        left -= block->length;
+    }
+
+    return false;
+}
+
+void STORE_FORWARD_MarkSent(store_forward_message_t* message, uint16_t packetId)
+{
+    store_block_t* block = (store_block_t*)message->handle;
+
+    block->packetId = packetId;
+    block->state    = STORE_INFLIGHT;
+}
+
+/** \brief Release the message sent with packetId.
+ *
+ * PUBACKs for other PUBLISH packets are ignored.
+ */
+void STORE_FORWARD_Acknowledge(uint16_t packetId)
+{
+    uint16_t       offset = storeTail;
+    uint16_t       left   = storeUsed;
+    store_block_t* block;
+
+    while (left > 0)
+    {
+        block = STORE_BLOCK(offset);
+
+        if (block->state == STORE_INFLIGHT && block->packetId == packetId)
+        {
+            block->state = STORE_RELEASED;
+            storeReclaim();
+            return;
+        }
+
+        offset = (offset + block->length) % CFG_STORE_FORWARD_BUFFER_SIZE;
+        left -= block->length;
+    }
+}
+
+/** \brief Send the message sent with packetId again.
+ *
+ * Called when the MQTT core reports the PUBLISH as not delivered.
+ */
+void STORE_FORWARD_Retry(uint16_t packetId)
+{
+    uint16_t       offset = storeTail;
+    uint16_t       left   = storeUsed;
+    store_block_t* block;
+
+    while (left > 0)
+    {
+        block = STORE_BLOCK(offset);
+
+        if (block->state == STORE_INFLIGHT && block->packetId == packetId)
+        {
+            block->state = STORE_PENDING;
+            return;
+        }
+
+        offset = (offset + block->length) % CFG_STORE_FORWARD_BUFFER_SIZE;
+        left -= block->length;
+    }
+}
+
+/** \brief Send every unacknowledged message again.
+ *
+ * For a caller that drops the MQTT session without MQTT_DiscardSession(),
+ * the PUBLISH packets waiting for PUBACK are then never reported.
+ */
+void STORE_FORWARD_Requeue(void)
+{
+    uint16_t       offset = storeTail;
+    uint16_t       left   = storeUsed;
+    store_block_t* block;
+
+    while (left > 0)
+    {
+        block = STORE_BLOCK(offset);
+
+        if (block->state == STORE_INFLIGHT)
+        {
+            block->state = STORE_PENDING;
+        }
+
+        offset = (offset + block->length) % CFG_STORE_FORWARD_BUFFER_SIZE;
+        left -= block->length;
+    }
+}
+
+void STORE_FORWARD_GetStats(store_forward_stats_t* stats)
+{
+    uint16_t       offset = storeTail;
+    uint16_t       left   = storeUsed;
+    store_block_t* block;
+
+    stats->stored    = storeCount;
+    stats->inflight  = 0;
+    stats->bytesUsed = storeUsed;
+    stats->highWater = storeHighWater;
+    stats->dropCount = storeDropCount;
+
+    while (left > 0)
+    {
+        block = STORE_BLOCK(offset);
+
+        if (block->state == STORE_INFLIGHT)
+        {
+            stats->inflight++;
+        }
+
+        offset = (offset + block->length) % CFG_STORE_FORWARD_BUFFER_SIZE;
+        left -= block->length;
+    }
+}
@@ -0,0 +1,60 @@
+/*
+    \file   store_forward.h
+
+    \brief  Store-and-forward queue for QoS 1 telemetry
+
+    (c) 2018 Microchip Technology Inc. and its subsidiaries.
+
+    Subject to your compliance with these terms, you may use Microchip software and any
+    derivatives exclusively with Microchip products. It is your responsibility to comply with third party
+    license terms applicable to your use of third party software (including open source software) that
+    may accompany Microchip software.
+
+    THIS SOFTWARE IS SUPPLIED BY MICROCHIP "AS IS". NO WARRANTIES, WHETHER
+    EXPRESS, IMPLIED OR STATUTORY, APPLY TO THIS SOFTWARE, INCLUDING ANY
+    IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY, AND FITNESS
+    FOR A PARTICULAR PURPOSE.
+
+    IN NO EVENT WILL MICROCHIP BE LIABLE FOR ANY INDIRECT, SPECIAL, PUNITIVE,
+    INCIDENTAL OR CONSEQUENTIAL LOSS, DAMAGE, COST OR EXPENSE OF ANY KIND
+    WHATSOEVER RELATED TO THE SOFTWARE, HOWEVER CAUSED, EVEN IF MICROCHIP
+    HAS BEEN ADVISED OF THE POSSIBILITY OR THE DAMAGES ARE FORESEEABLE. TO
+    THE FULLEST EXTENT ALLOWED BY LAW, MICROCHIP'S TOTAL LIABILITY ON ALL
+    CLAIMS IN ANY WAY RELATED TO THIS SOFTWARE WILL NOT EXCEED THE AMOUNT
+    OF FEES, IF ANY, THAT YOU HAVE PAID DIRECTLY TO MICROCHIP FOR THIS
+    SOFTWARE.
+*/
+
+#ifndef STORE_FORWARD_H
+#define STORE_FORWARD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct
+{
+    uint8_t* topic;
+    uint8_t* payload;
+    uint16_t topicLength;
+    uint16_t payloadLength;
+    void*    handle;   // Passed back to STORE_FORWARD_MarkSent()
+} store_forward_message_t;
+
+typedef struct
+{
+    uint16_t stored;      // Messages held, sent or not
+    uint16_t inflight;    // Messages sent and waiting for PUBACK
+    uint16_t bytesUsed;
+    uint16_t highWater;   // Most bytes used at the same time
+    uint32_t dropCount;   // Oldest messages dropped to make room
+} store_forward_stats_t;
+
+bool STORE_FORWARD_Put(const uint8_t* topic, uint16_t topicLength, const uint8_t* payload, uint16_t payloadLength);
+bool STORE_FORWARD_GetNext(store_forward_message_t* message);
+void STORE_FORWARD_MarkSent(store_forward_message_t* message, uint16_t packetId);
+void STORE_FORWARD_Acknowledge(uint16_t packetId);
+void STORE_FORWARD_Retry(uint16_t packetId);
+void STORE_FORWARD_Requeue(void);
+void STORE_FORWARD_GetStats(store_forward_stats_t* stats);
+
+#endif   // STORE_FORWARD_H